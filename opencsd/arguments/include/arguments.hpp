@@ -48,6 +48,12 @@ namespace qemucsd::arguments {
 		DEV_INIT_RESET, // Reset all zones of the device upon initialization
 	};
 
+	// Enum to specify the emulated ZNS device backing the filesystem
+	enum ZnsBackend {
+		ZNS_BACKEND_MEMORY, // Volatile device sparsely allocated in memory
+		ZNS_BACKEND_MMAP, // Persistent device stored in a sparse image file
+	};
+
     static const char *ARG_SEPARATOR = "--";
 
 	static const char *DEFAULT_SPDK_NAME = "";
@@ -56,6 +62,37 @@ namespace qemucsd::arguments {
     // Must be large enough to support the 512K request stride
 	static constexpr uint64_t DEFAULT_UBPF_MEM_SIZE = 1024*128*8;
     static constexpr bool DEFAULT_UBPF_JIT = false;
+    static const ZnsBackend DEFAULT_ZNS_BACKEND = ZNS_BACKEND_MEMORY;
+    // 8GB sparse using 4K sectors
+    static constexpr uint64_t DEFAULT_ZNS_NUM_ZONES = 2048;
+    static constexpr uint64_t DEFAULT_ZNS_ZONE_SIZE = 1024;
+    static const char *DEFAULT_ZNS_IMAGE = "opencsd.img";
+    // Open and active zone limits of the emulated device, 0 is unlimited
+    static constexpr uint64_t DEFAULT_ZNS_MAX_OPEN = 0;
+    static constexpr uint64_t DEFAULT_ZNS_MAX_ACTIVE = 0;
+    // Size of the sector cache in front of the ZNS device in MiB, 0 disables
+    // the cache
+    static constexpr uint64_t DEFAULT_ZNS_CACHE_SIZE = 64;
+    // Performance model of the emulated device, latency in microseconds and
+    // bandwidth in MiB/s
+    static constexpr bool DEFAULT_ZNS_MODEL = false;
+    static constexpr uint64_t DEFAULT_ZNS_MODEL_READ_LATENCY = 80;
+    static constexpr uint64_t DEFAULT_ZNS_MODEL_APPEND_LATENCY = 20;
+    static constexpr uint64_t DEFAULT_ZNS_MODEL_RESET_LATENCY = 2000;
+    static constexpr uint64_t DEFAULT_ZNS_MODEL_READ_BANDWIDTH = 3200;
+    static constexpr uint64_t DEFAULT_ZNS_MODEL_APPEND_BANDWIDTH = 1200;
+    static constexpr uint64_t DEFAULT_ZNS_MODEL_CHANNELS = 8;
+    // Trace of all device I/O, empty if disabled. Replays default to the
+    // original timing of the trace.
+    static const char *DEFAULT_ZNS_TRACE = "";
+    static constexpr bool DEFAULT_ZNS_REPLAY_MAX_SPEED = false;
+    // Limits of pending filesystem state before writers are throttled, 0
+    // disables the limit. Writeback starts in the background at half of a
+    // limit or once state has been pending for longer than the expire time
+    // in milliseconds.
+    static constexpr uint64_t DEFAULT_FLFS_DIRTY_BYTES = 268435456;
+    static constexpr uint64_t DEFAULT_FLFS_DIRTY_INODES = 4096;
+    static constexpr uint64_t DEFAULT_FLFS_DIRTY_EXPIRE = 30000;
 
 	/**
 	 * Program options structure
@@ -67,8 +104,31 @@ namespace qemucsd::arguments {
 		uint64_t ubpf_mem_size;
 		bool ubpf_jit;
 
+		ZnsBackend zns_backend;
+		uint64_t zns_num_zones;
+		uint64_t zns_zone_size;
+		uint64_t zns_max_open;
+		uint64_t zns_max_active;
+		uint64_t zns_cache_size;
+
+		bool zns_model;
+		uint64_t zns_model_read_latency;
+		uint64_t zns_model_append_latency;
+		uint64_t zns_model_reset_latency;
+		uint64_t zns_model_read_bandwidth;
+		uint64_t zns_model_append_bandwidth;
+		uint64_t zns_model_channels;
+
+		bool zns_replay_max_speed;
+
+		uint64_t flfs_dirty_bytes;
+		uint64_t flfs_dirty_inodes;
+		uint64_t flfs_dirty_expire;
+
 		/** owned / reference counted */
 		std::shared_ptr<std::string> input_file;
+		std::shared_ptr<std::string> zns_image;
+		std::shared_ptr<std::string> zns_trace;
 
 		/** Containers to prevent data going out of scope */
 		std::shared_ptr<std::string> _name;
@@ -56,6 +56,35 @@ namespace qemucsd::arguments {
 		}
 	}
 
+	std::istream &operator>>(std::istream &in, ZnsBackend &zns_backend) {
+		std::string token;
+		in >> token;
+
+		// Make token detection resilient to use of capitals.
+		boost::to_upper(token);
+
+		if (token == "MEMORY") {
+			zns_backend = ZNS_BACKEND_MEMORY;
+		} else if (token == "MMAP") {
+			zns_backend = ZNS_BACKEND_MMAP;
+		} else {
+			throw po::invalid_option_value("");
+		}
+
+		return in;
+	}
+
+	std::ostream &operator<<(std::ostream &out, const ZnsBackend &zns_backend)
+	{
+		if (zns_backend == ZNS_BACKEND_MEMORY) {
+			return out << "memory";
+		} else if (zns_backend == ZNS_BACKEND_MMAP) {
+			return out << "mmap";
+		} else {
+			throw po::invalid_option_value("");
+		}
+	}
+
 	void parse_args(int argc, char* argv[], struct options *options) {
 		po::options_description desc("Allowed options");
 		desc.add_options()
@@ -67,6 +96,48 @@ namespace qemucsd::arguments {
                  "Name of file to write to ZNS SSD (Ignored in OpenCSD / FUSE)")
 				("vmmem", po::value<uint64_t>(), "uBPF vm memory size in bytes")
                 ("jit,j", po::value<bool>(), "uBPF jit compilation")
+				// Emulated ZNS device
+				("backend,b", po::value<ZnsBackend>(&options->zns_backend)->default_value(DEFAULT_ZNS_BACKEND),
+				 R"(Emulated ZNS device backend: "memory", "mmap")")
+				("zones", po::value<uint64_t>()->default_value(DEFAULT_ZNS_NUM_ZONES),
+				 "Number of zones of the emulated ZNS device")
+				("zone-size", po::value<uint64_t>()->default_value(DEFAULT_ZNS_ZONE_SIZE),
+				 "Number of sectors per zone of the emulated ZNS device")
+				("max-open", po::value<uint64_t>(&options->zns_max_open)->default_value(DEFAULT_ZNS_MAX_OPEN),
+				 "Maximum number of open zones of the emulated ZNS device, 0 is unlimited")
+				("max-active", po::value<uint64_t>(&options->zns_max_active)->default_value(DEFAULT_ZNS_MAX_ACTIVE),
+				 "Maximum number of open or closed zones of the emulated ZNS device, 0 is unlimited")
+				("image", po::value<std::string>(),
+				 "Image file of the mmap ZNS device backend, created if it does not exist")
+				("cache-size", po::value<uint64_t>(&options->zns_cache_size)->default_value(DEFAULT_ZNS_CACHE_SIZE),
+				 "Size of the sector cache in front of the ZNS device in MiB, 0 disables the cache")
+				// Performance model of the emulated ZNS device
+				("model", po::value<bool>(&options->zns_model)->default_value(DEFAULT_ZNS_MODEL),
+				 "Model latency and bandwidth of the emulated ZNS device")
+				("model-read-latency", po::value<uint64_t>(&options->zns_model_read_latency)->default_value(DEFAULT_ZNS_MODEL_READ_LATENCY),
+				 "Modelled read latency in microseconds")
+				("model-append-latency", po::value<uint64_t>(&options->zns_model_append_latency)->default_value(DEFAULT_ZNS_MODEL_APPEND_LATENCY),
+				 "Modelled append latency in microseconds")
+				("model-reset-latency", po::value<uint64_t>(&options->zns_model_reset_latency)->default_value(DEFAULT_ZNS_MODEL_RESET_LATENCY),
+				 "Modelled zone reset latency in microseconds")
+				("model-read-bandwidth", po::value<uint64_t>(&options->zns_model_read_bandwidth)->default_value(DEFAULT_ZNS_MODEL_READ_BANDWIDTH),
+				 "Modelled device read bandwidth in MiB/s, 0 is unlimited")
+				("model-append-bandwidth", po::value<uint64_t>(&options->zns_model_append_bandwidth)->default_value(DEFAULT_ZNS_MODEL_APPEND_BANDWIDTH),
+				 "Modelled device append bandwidth in MiB/s, 0 is unlimited")
+				("model-channels", po::value<uint64_t>(&options->zns_model_channels)->default_value(DEFAULT_ZNS_MODEL_CHANNELS),
+				 "Modelled number of channels operating in parallel")
+				// Recording and replaying traces of the ZNS device
+				("trace", po::value<std::string>(),
+				 "Trace file to record device I/O into, or to replay with zcsd-replay")
+				("replay-max-speed", po::value<bool>(&options->zns_replay_max_speed)->default_value(DEFAULT_ZNS_REPLAY_MAX_SPEED),
+				 "Replay traces as fast as possible instead of with their original timing")
+				// Writeback of pending filesystem state
+				("dirty-bytes", po::value<uint64_t>(&options->flfs_dirty_bytes)->default_value(DEFAULT_FLFS_DIRTY_BYTES),
+				 "Bytes of pending data and data_blocks before writers are throttled, 0 is unlimited")
+				("dirty-inodes", po::value<uint64_t>(&options->flfs_dirty_inodes)->default_value(DEFAULT_FLFS_DIRTY_INODES),
+				 "Number of pending inodes before writers are throttled, 0 is unlimited")
+				("dirty-expire", po::value<uint64_t>(&options->flfs_dirty_expire)->default_value(DEFAULT_FLFS_DIRTY_EXPIRE),
+				 "Milliseconds before pending state is written back, 0 disables expiry")
 				// SPDK env opts
 				("name", po::value<std::string>(), "Name for SPDK environment");
 		po::variables_map vm;
@@ -90,6 +161,21 @@ namespace qemucsd::arguments {
             options->ubpf_jit = DEFAULT_UBPF_JIT;
         }
 
+		options->zns_num_zones = vm["zones"].as<uint64_t>();
+		options->zns_zone_size = vm["zone-size"].as<uint64_t>();
+
+		if(vm.count("image")) {
+			options->zns_image = std::make_shared<std::string>(vm["image"].as<std::string>());
+		} else {
+			options->zns_image = std::make_shared<std::string>(DEFAULT_ZNS_IMAGE);
+		}
+
+		if(vm.count("trace")) {
+			options->zns_trace = std::make_shared<std::string>(vm["trace"].as<std::string>());
+		} else {
+			options->zns_trace = std::make_shared<std::string>(DEFAULT_ZNS_TRACE);
+		}
+
 		if(vm.count("input-file")) {
 			options->input_file = std::make_shared<std::string>(vm["input-file"].as<std::string>());
 		} else {
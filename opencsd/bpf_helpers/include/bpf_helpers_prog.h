@@ -61,4 +61,12 @@ static void (*bpf_get_call_info)(void **call) = (void *) 8;
 
 static void (*bpf_debug)(const char *string) = (void *) 9;
 
+// Called by BPF to submit an 'on device' read without waiting for it, data is
+// only available after bpf_wait.
+static int (*bpf_submit_read)(uint64_t zone, uint64_t sector, uint64_t offset,
+    uint64_t size, void *data) = (void *) 10;
+
+// Called by BPF to wait for all submitted reads, returns < 0 if any failed.
+static int (*bpf_wait)(void) = (void *) 11;
+
 #endif //QEMU_CSD_BPF_HELPERS_PROG_H
@@ -51,4 +51,9 @@ static void bpf_get_call_info(void **call);
 
 static void bpf_debug(const char *string);
 
+static int bpf_submit_read(uint64_t zone, uint64_t sector, uint64_t offset,
+    uint64_t limit, void *data);
+
+static int bpf_wait(void);
+
 #endif //QEMU_CSD_BPF_HELPERS_VM_H
@@ -44,13 +44,24 @@ void segfault_handler(int signal, siginfo_t *si, void *arg) {
     exit(1);
 }
 
+#include <memory>
+
 #include "arguments.hpp"
 #include "flfs_wrap.hpp"
 #include "measurements.hpp"
 #include "nvme_zns_memory.hpp"
+#include "nvme_zns_mmap.hpp"
+#include "nvme_zns_cache.hpp"
+#include "nvme_zns_model.hpp"
+#include "nvme_zns_trace.hpp"
 #include "spdk_init.hpp"
 
+using qemucsd::nvme_zns::NvmeZnsBackend;
+using qemucsd::nvme_zns::NvmeZnsCacheBackend;
 using qemucsd::nvme_zns::NvmeZnsMemoryBackend;
+using qemucsd::nvme_zns::NvmeZnsMmapBackend;
+using qemucsd::nvme_zns::NvmeZnsModelBackend;
+using qemucsd::nvme_zns::NvmeZnsTraceBackend;
 
 /**
  * Entrypoint for fuse LFS filesystem
@@ -70,9 +81,11 @@ int main(int argc, char* argv[]) {
     const struct fuse_operations* ops;
     qemucsd::arguments::options opts;
 
-//    NvmeZnsMemoryBackend nvme_memory(1024, 256, 4096);
-    // 4GB (8GB sparse)
-    NvmeZnsMemoryBackend nvme_memory(2048, 1024, 4096);
+    std::unique_ptr<NvmeZnsBackend> nvme;
+    std::unique_ptr<NvmeZnsBackend> nvme_model;
+    std::unique_ptr<NvmeZnsBackend> nvme_cache;
+    std::unique_ptr<NvmeZnsBackend> nvme_trace;
+    NvmeZnsBackend *device;
 //    struct qemucsd::spdk_init::ns_entry entry = {0};
 
     // Setup segfault handler to print backward stacktraces
@@ -101,6 +114,46 @@ int main(int argc, char* argv[]) {
 //        if (qemucsd::spdk_init::initialize_zns_spdk(&opts, &entry) < 0)
 //            return EXIT_FAILURE;
 
+        if(opts.zns_backend == qemucsd::arguments::ZNS_BACKEND_MMAP) {
+            nvme = std::make_unique<NvmeZnsMmapBackend>(*opts.zns_image,
+                opts.zns_num_zones, opts.zns_zone_size,
+                qemucsd::fuse_lfs::SECTOR_SIZE, 4, opts.zns_max_open,
+                opts.zns_max_active);
+        }
+        else {
+            nvme = std::make_unique<NvmeZnsMemoryBackend>(opts.zns_num_zones,
+                opts.zns_zone_size, qemucsd::fuse_lfs::SECTOR_SIZE, 4,
+                opts.zns_max_open, opts.zns_max_active);
+        }
+
+        // Optionally add the latency and bandwidth of a modelled device
+        if(opts.zns_model) {
+            struct qemucsd::nvme_zns::nvme_zns_model model = {
+                opts.zns_model_read_latency, opts.zns_model_append_latency,
+                opts.zns_model_reset_latency,
+                opts.zns_model_read_bandwidth * 1024 * 1024,
+                opts.zns_model_append_bandwidth * 1024 * 1024,
+                opts.zns_model_channels
+            };
+            nvme_model = std::make_unique<NvmeZnsModelBackend>(nvme.get(),
+                                                               model);
+        }
+        device = nvme_model ? nvme_model.get() : nvme.get();
+
+        // Cache sectors in front of the (modelled) device
+        if(opts.zns_cache_size != 0) {
+            nvme_cache = std::make_unique<NvmeZnsCacheBackend>(device,
+                opts.zns_cache_size * 1024 * 1024);
+            device = nvme_cache.get();
+        }
+
+        // Optionally record all device I/O as seen by the filesystem
+        if(!opts.zns_trace->empty()) {
+            nvme_trace = std::make_unique<NvmeZnsTraceBackend>(device,
+                *opts.zns_trace);
+            device = nvme_trace.get();
+        }
+
         // Second set of arguments is for fuse
         if(stripped_args.size() >= 3) {
             fuse_argc = stripped_args.at(2).first;
@@ -113,7 +166,7 @@ int main(int argc, char* argv[]) {
         }
 
         int result = qemucsd::fuse_lfs::FuseLFSWrapper::initialize(
-            fuse_argc, fuse_argv, &opts, &nvme_memory);
+            fuse_argc, fuse_argv, &opts, device);
 
         std::vector<qemucsd::measurements::result> results;
         qemucsd::measurements::generate_results(&results);
@@ -44,12 +44,17 @@ void segfault_handler(int signal, siginfo_t *si, void *arg) {
     exit(1);
 }
 
+#include <memory>
+
 #include "arguments.hpp"
 #include "flfs_wrap.hpp"
 #include "measurements.hpp"
+#include "nvme_zns_cache.hpp"
 #include "nvme_zns_spdk.hpp"
 #include "spdk_init.hpp"
 
+using qemucsd::nvme_zns::NvmeZnsBackend;
+using qemucsd::nvme_zns::NvmeZnsCacheBackend;
 using qemucsd::nvme_zns::NvmeZnsSpdkBackend;
 
 /**
@@ -101,6 +106,15 @@ int main(int argc, char* argv[]) {
             return EXIT_FAILURE;
 
         NvmeZnsSpdkBackend nvme_spdk(&entry);
+        NvmeZnsBackend *device = &nvme_spdk;
+
+        // Cache sectors in front of the device
+        std::unique_ptr<NvmeZnsBackend> nvme_cache;
+        if(opts.zns_cache_size != 0) {
+            nvme_cache = std::make_unique<NvmeZnsCacheBackend>(device,
+                opts.zns_cache_size * 1024 * 1024);
+            device = nvme_cache.get();
+        }
 
         // Second set of arguments is for fuse
         if(stripped_args.size() >= 3) {
@@ -114,7 +128,7 @@ int main(int argc, char* argv[]) {
         }
 
         int result = qemucsd::fuse_lfs::FuseLFSWrapper::initialize(
-            fuse_argc, fuse_argv, &opts, &nvme_spdk);
+            fuse_argc, fuse_argv, &opts, device);
 
         std::vector<qemucsd::measurements::result> results;
         qemucsd::measurements::generate_results(&results);
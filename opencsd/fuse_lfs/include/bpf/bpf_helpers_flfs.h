@@ -71,10 +71,19 @@ struct __attribute__((packed)) flfs_call {
     enum flfs_operations op;
     struct dimensions dims;
     struct inode ino;
-    // After this struct is initial_data_lba and the subsequent flattened data
-    // blocks (for reads)
-    // Or flfs_write_call + initial_data_lba and the subsequent flattened data
-    // blocks (for writes)
+    // After this struct are the flfs_extents of the data (for reads)
+    // Or flfs_write_call + the flfs_extents of the data (for writes)
+};
+
+/**
+ * Run of consecutive sectors on the device covering part of the requested
+ * data as exposed to BPF kernels. Extents never span multiple zones. The
+ * list of extents is terminated by an extent with a length of zero.
+ */
+struct __attribute__((packed)) flfs_extent {
+    uint64_t lba;
+    // Number of sectors
+    uint64_t length;
 };
 
 /**
@@ -136,25 +145,26 @@ struct __attribute__((packed)) flfs_write_return {
 };
 
 /**
- * Find the flattened data blocks FluffleFS provides in filesystem specific
- * kernel data.
+ * Find the first extent FluffleFS provides in filesystem specific kernel data.
  * @param call_info parameter with filesystem specific data as can be retrieved
  *        from bpf_get_call_info defined in bpf_helpers_prog.h
  */
-static void find_data_lba(uint64_t **call_info, bool write) {
-    *call_info = (uint64_t*)((uint8_t*)*call_info + sizeof(struct flfs_call));
+static void find_data_extent(struct flfs_extent **call_info, bool write) {
+    *call_info = (struct flfs_extent*)(
+        (uint8_t*)*call_info + sizeof(struct flfs_call));
 
     if(write)
-        *call_info = (uint64_t*)((uint8_t*)*call_info +
-            sizeof(struct flfs_write_call));
+        *call_info = (struct flfs_extent*)(
+            (uint8_t*)*call_info + sizeof(struct flfs_write_call));
 }
 
 /**
- * Increment the cur_data_lba pointer and indicate if next data block exists.
- * @param cur_data_lba the current location of valid data for the given inode
+ * Increment the cur_extent pointer, the next extent exists if its length is
+ * not zero.
+ * @param cur_extent the current run of valid data for the given inode
  */
-static void next_data_lba(uint64_t **cur_data_lba) {
-    *cur_data_lba += 1;
+static void next_data_extent(struct flfs_extent **cur_extent) {
+    *cur_extent += 1;
 }
 
 /**
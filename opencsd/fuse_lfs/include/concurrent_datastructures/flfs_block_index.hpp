@@ -0,0 +1,86 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Dantali0n
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef QEMU_CSD_FLFS_BLOCK_INDEX_HPP
+#define QEMU_CSD_FLFS_BLOCK_INDEX_HPP
+
+extern "C" {
+    #include "fuse3/fuse_lowlevel.h"
+    #include <pthread.h>
+}
+
+#include <cstddef>
+#include <vector>
+
+#include "synchronization/flfs_rwlock.hpp"
+#include "flfs_memory.hpp"
+
+namespace qemucsd::fuse_lfs {
+
+    /**
+     * Interface for block_index_map methods, caches the positions of the
+     * data_blocks of inodes so the linked data_blocks on drive only have to be
+     * traversed once.
+     */
+    class FuseLFSBlockIndex {
+    protected:
+        // Maximum number of data_block LBAs kept across all inodes, 8MB of
+        // LBAs is sufficient to index ~2TB of file data.
+        static constexpr uint64_t BLOCK_INDEX_LIMIT = 1 << 20;
+
+        // Index of data_block LBAs per inode
+        block_index_map_t block_index_map;
+
+        // Order in which inodes should be evicted from block_index_map
+        block_index_lru_t block_index_lru;
+
+        // Total number of data_block LBAs in block_index_map
+        uint64_t block_index_lbas;
+
+        uint64_t block_index_limit;
+
+        // Concurrency management for block_index_map
+        pthread_rwlock_t block_index_lck = {};
+        pthread_rwlockattr_t block_index_attr = {};
+    public:
+        explicit FuseLFSBlockIndex(uint64_t limit = BLOCK_INDEX_LIMIT);
+        virtual ~FuseLFSBlockIndex();
+
+        uint64_t block_index_size();
+
+        int get_block_index_lba(fuse_ino_t ino, uint64_t data_lba,
+            uint64_t block_num, uint64_t &lba);
+
+        void update_block_index(fuse_ino_t ino, uint64_t data_lba,
+            std::vector<uint64_t> &&block_lbas);
+
+        void remove_block_index(fuse_ino_t ino);
+
+        void evict_block_index(uint64_t limit);
+    };
+
+}
+
+#endif // QEMU_CSD_FLFS_BLOCK_INDEX_HPP
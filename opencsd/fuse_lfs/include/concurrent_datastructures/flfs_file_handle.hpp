@@ -69,6 +69,9 @@ namespace qemucsd::fuse_lfs {
 
         int update_file_handle(uint64_t fh, struct open_file_entry *entry);
 
+        int read_ahead_window(uint64_t fh, uint64_t offset, uint64_t size,
+            uint64_t &start, uint64_t &length);
+
         int find_file_handle_unsafe(csd_unique_t *uni_t);
 
         int find_file_handle(csd_unique_t *uni_t);
@@ -0,0 +1,81 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Dantali0n
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef QEMU_CSD_FLFS_INODE_CACHE_HPP
+#define QEMU_CSD_FLFS_INODE_CACHE_HPP
+
+extern "C" {
+    #include "fuse3/fuse_lowlevel.h"
+    #include <pthread.h>
+}
+
+#include <cstddef>
+
+#include "synchronization/flfs_rwlock.hpp"
+#include "flfs_memory.hpp"
+
+namespace qemucsd::fuse_lfs {
+
+    /**
+     * Interface for inode_cache_map methods, caches decoded inode_entry_t of
+     * inodes on drive so their inode_block does not have to be read and
+     * parsed for every lookup.
+     */
+    class FuseLFSInodeCache {
+    protected:
+        // Maximum number of inodes kept in the cache
+        static constexpr uint64_t INODE_CACHE_LIMIT = 1 << 16;
+
+        // Decoded inode_entry_t per inode
+        inode_cache_map_t inode_cache_map;
+
+        // Order in which inodes should be evicted from inode_cache_map
+        inode_cache_lru_t inode_cache_lru;
+
+        uint64_t inode_cache_limit;
+
+        // Concurrency management for inode_cache_map
+        pthread_rwlock_t inode_cache_lck = {};
+        pthread_rwlockattr_t inode_cache_attr = {};
+    public:
+        explicit FuseLFSInodeCache(uint64_t limit = INODE_CACHE_LIMIT);
+        virtual ~FuseLFSInodeCache();
+
+        uint64_t inode_cache_size();
+
+        int get_inode_cache(fuse_ino_t ino, uint64_t lba,
+            inode_entry_t *entry);
+
+        void update_inode_cache(fuse_ino_t ino, uint64_t lba,
+            const inode_entry_t &entry);
+
+        void remove_inode_cache(fuse_ino_t ino);
+
+        void evict_inode_cache(uint64_t limit);
+    };
+
+}
+
+#endif // QEMU_CSD_FLFS_INODE_CACHE_HPP
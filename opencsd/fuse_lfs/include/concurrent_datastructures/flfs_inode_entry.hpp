@@ -53,6 +53,8 @@ namespace qemucsd::fuse_lfs {
         FuseLFSInodeEntry();
         virtual ~FuseLFSInodeEntry();
 
+        uint64_t inode_entries_size();
+
         int get_inode_entry(fuse_ino_t ino, inode_entry_t *entry);
 
         void update_inode_entry(inode_entry_t *entry);
@@ -60,7 +62,14 @@ namespace qemucsd::fuse_lfs {
         void erase_inode_entries(std::vector<fuse_ino_t> *ino_remove);
 
         int fill_inode_block(std::vector<fuse_ino_t> *ino_remove,
-            struct inode_block *blk);
+            struct inode_block *blk,
+            const std::vector<fuse_ino_t> *only = nullptr);
+
+        static int find_inode_block_entry(const struct inode_block *blk,
+            fuse_ino_t ino, inode_entry_t *entry);
+
+        static int get_inode_block_inodes(const struct inode_block *blk,
+            std::vector<fuse_ino_t> *inodes);
     };
 
 }
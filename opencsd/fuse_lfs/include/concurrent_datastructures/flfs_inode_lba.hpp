@@ -57,8 +57,8 @@ namespace qemucsd::fuse_lfs {
 
         int get_inode_lba(fuse_ino_t ino, struct lba_inode *data);
 
-        int lock_inode(fuse_ino_t ino);
-        int unlock_inode(fuse_ino_t ino);
+        int lock_inode(fuse_ino_t ino, bool write = true);
+        int unlock_inode(fuse_ino_t ino, bool write = true);
 
         void update_inode_lba(fuse_ino_t ino, struct lba_inode *data);
 
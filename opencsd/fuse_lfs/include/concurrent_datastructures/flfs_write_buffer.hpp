@@ -0,0 +1,104 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Dantali0n
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef QEMU_CSD_FLFS_WRITE_BUFFER_HPP
+#define QEMU_CSD_FLFS_WRITE_BUFFER_HPP
+
+extern "C" {
+    #include "fuse3/fuse_lowlevel.h"
+    #include <pthread.h>
+}
+
+#include <cstddef>
+#include <vector>
+
+#include "synchronization/flfs_rwlock.hpp"
+#include "flfs_memory.hpp"
+
+namespace qemucsd::fuse_lfs {
+
+    /**
+     * Interface for write_buffer_map methods, absorbs small writes per inode
+     * so partial sectors are coalesced in memory and reach the log as large
+     * multi sector appends.
+     */
+    class FuseLFSWriteBuffer {
+    protected:
+        // Writes of at least this size bypass the write buffer
+        static constexpr uint64_t WRITE_BUFFER_BYPASS = 131072;
+
+        // Maximum number of sectors buffered for a single inode
+        static constexpr uint64_t WRITE_BUFFER_INODE_LIMIT = 256;
+
+        // Maximum number of sectors buffered across all inodes
+        static constexpr uint64_t WRITE_BUFFER_LIMIT = 16384;
+
+        // Milliseconds before buffered writes of an inode must be flushed
+        static constexpr uint64_t WRITE_BUFFER_MAX_AGE = 5000;
+
+        // Buffered sectors per inode
+        write_buffer_map_t write_buffer_map;
+
+        // Total number of sectors in write_buffer_map
+        uint64_t write_buffer_sectors;
+
+        uint64_t write_buffer_limit;
+        uint64_t write_buffer_inode_limit;
+
+        // Concurrency management for write_buffer_map
+        pthread_rwlock_t write_buffer_lck = {};
+        pthread_rwlockattr_t write_buffer_attr = {};
+    public:
+        explicit FuseLFSWriteBuffer(uint64_t limit = WRITE_BUFFER_LIMIT,
+            uint64_t inode_limit = WRITE_BUFFER_INODE_LIMIT);
+        virtual ~FuseLFSWriteBuffer();
+
+        uint64_t write_buffer_size();
+
+        bool has_write_buffer(fuse_ino_t ino);
+
+        bool write_buffer_full(uint64_t sectors);
+
+        bool write_buffer_flush_due(fuse_ino_t ino, uint64_t sectors);
+
+        int buffer_write(fuse_ino_t ino, uint64_t size, uint64_t sector,
+            const char *data, uint32_t offset, uint32_t length);
+
+        int fill_write_buffer(fuse_ino_t ino, uint64_t sector,
+            const uint8_t *data);
+
+        int get_write_buffer(fuse_ino_t ino, struct write_buffer *buffer);
+
+        int get_write_buffer_size(fuse_ino_t ino, uint64_t &size);
+
+        void get_write_buffer_inodes(std::vector<fuse_ino_t> *inodes);
+
+        void truncate_write_buffer(fuse_ino_t ino, uint64_t size);
+
+        void remove_write_buffer(fuse_ino_t ino);
+    };
+
+}
+
+#endif // QEMU_CSD_FLFS_WRITE_BUFFER_HPP
@@ -32,22 +32,32 @@ extern "C" {
     #include <sys/xattr.h>
 }
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <condition_variable>
 #include <cstring>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "output.hpp"
 #include "arguments.hpp"
+#include "concurrent_datastructures/flfs_block_index.hpp"
 #include "concurrent_datastructures/flfs_file_handle.hpp"
+#include "concurrent_datastructures/flfs_inode_cache.hpp"
 #include "concurrent_datastructures/flfs_inode_entry.hpp"
 #include "concurrent_datastructures/flfs_inode_lba.hpp"
 #include "concurrent_datastructures/flfs_nlookup.hpp"
 #include "concurrent_datastructures/flfs_snapshot.hpp"
+#include "concurrent_datastructures/flfs_write_buffer.hpp"
 #include "nvme_csd.hpp"
+#include "flfs_allocator.hpp"
 #include "flfs_constants.hpp"
 #include "flfs_csd.hpp"
 #include "flfs_dirtyblock.hpp"
@@ -65,10 +75,12 @@ namespace qemucsd::fuse_lfs {
     /**
      * FUSE LFS filesystem for Zoned Namespaces SSDs (FluffleFS).
      */
-    class FuseLFS : public FuseLFSCSD, public FuseLFSDirtyBlock,
-        public FuseLFSInit, public FuseLFSRead, public FuseLFSFileHandle,
+    class FuseLFS : public FuseLFSBlockIndex, public FuseLFSCSD,
+        public FuseLFSDirtyBlock, public FuseLFSInit, public FuseLFSRead,
+        public FuseLFSFileHandle, public FuseLFSInodeCache,
         public FuseLFSInodeEntry, public FuseLFSInodeLba, public FuseLFSNlookup,
-        public FuseLFSSnapShot, public FuseLFSSuperBlock, public FuseLFSWrite
+        public FuseLFSSnapShot, public FuseLFSSuperBlock, public FuseLFSWrite,
+        public FuseLFSWriteBuffer
     {
     protected:
         /** Measurement Instrumentation */
@@ -139,6 +151,8 @@ namespace qemucsd::fuse_lfs {
 
         /** Super block interface methods */
 
+        int find_superblock() override;
+
         int verify_superblock() override;
 
         int write_superblock() override;
@@ -155,6 +169,9 @@ namespace qemucsd::fuse_lfs {
 
         struct data_position cblock_pos;
 
+        pthread_rwlock_t cblock_lck;
+        pthread_rwlockattr_t cblock_attr;
+
         int update_checkpointblock(uint64_t randz_lba,
                                           uint64_t logz_lba);
 
@@ -162,6 +179,8 @@ namespace qemucsd::fuse_lfs {
 
         int get_checkpointblock_locate(struct checkpoint_block &cblock);
 
+        int fetch_write_pointers(std::vector<uint64_t> &write_pointers);
+
         // TODO(Dantali0n): Move random block methods to separate interface
 
         nat_update_set_t *nat_update_set;
@@ -185,15 +204,25 @@ namespace qemucsd::fuse_lfs {
 
         int determine_random_ptr();
 
+        int determine_random_ptr(uint64_t from_lba);
+
         static void random_zone_distance(
             struct data_position lhs, struct data_position rhs,
             uint32_t &distance);
 
-        void read_random_zone(inode_lba_map_t *inode_map);
+        int read_nat_blocks(const std::vector<uint64_t> &lbas,
+            inode_lba_map_t *inode_map, nat_update_set_t *found,
+            bool partial);
+
+        int read_random_zone(inode_lba_map_t *inode_map);
+
+        int recover_random_buffer(nat_update_set_t *nat_set);
 
         void fill_nat_block(nat_update_set_t *nat_set,
                                   struct nat_block &nt_blk);
 
+        int reserve_random_block(uint64_t &zone);
+
         int append_random_block(struct rand_block_base &block);
 
         static void compute_nat_blocks(nat_update_set_t *nat_set,
@@ -216,19 +245,69 @@ namespace qemucsd::fuse_lfs {
         // Current start of the log zone
         struct data_position log_pos;
 
-        // Write pointer within the log zone
-        struct data_position log_ptr;
+        // Heads of every log stream, the write pointer of a head is invalid
+        // until it claims its first zone.
+        struct log_head log_heads[N_LOG_STREAMS][N_LOG_HEADS];
+
+        // Lba of the zone claimed by every head, stored in checkpoint blocks
+        std::atomic<uint64_t> log_head_lbas[N_LOG_STREAMS][N_LOG_HEADS];
+
+        // Next log zone that has not been claimed by any head
+        std::atomic<uint64_t> log_zone_next;
+
+        // Number of streams and heads per stream that can have a zone open
+        // simultaneously
+        uint32_t log_streams;
+        uint32_t log_heads_active;
+
+        log_classifier_t log_classifier;
+
+        static enum log_stream default_log_classifier(
+            enum log_data_type type, fuse_ino_t ino);
+
+        void set_log_classifier(log_classifier_t classifier);
+
+        enum log_stream classify_log(enum log_data_type type, fuse_ino_t ino);
 
-        int advance_log_ptr(struct data_position *log_ptr) const;
+        uint32_t log_head_index() const;
+
+        int acquire_log_head(enum log_stream &stream, uint32_t &head);
+
+        void release_log_head(enum log_stream stream, uint32_t head);
+
+        int claim_log_zone(enum log_stream stream, uint32_t head);
+
+        int advance_log_ptr(enum log_stream stream, uint32_t head,
+            uint64_t sectors = 1);
+
+        uint64_t probe_write_pointer(uint64_t zone, void *buffer);
 
         void determine_log_ptr();
 
-        int log_append(void *data, size_t size, uint64_t &lba);
+        int log_append(void *data, size_t size, uint64_t &lba,
+            enum log_stream stream = LOG_STREAM_HOT_META);
+
+        int log_append(void *data, size_t size, std::vector<uint64_t> &lbas,
+            enum log_stream stream = LOG_STREAM_HOT_META);
+
+        void lbas_to_iovec(const std::vector<uint64_t> &lbas, void *buffer,
+            std::vector<nvme_zns::nvme_zns_iovec> &iov);
+
+        int read_sectors(const std::vector<uint64_t> &lbas, void *buffer);
+
+        void read_ahead(struct inode_entry entry, uint64_t offset,
+            uint64_t size);
+
+        int reply_sectors_mapped(fuse_req_t req,
+            const std::vector<uint64_t> &lbas, uint64_t offset, uint64_t size);
 
         // TODO(Dantali0n): Move data block methods to separate interface
 
         data_blocks_t *data_blocks;
 
+        // Total number of pending data_blocks across all inodes
+        std::atomic<uint64_t> data_blocks_dirty;
+
         // TODO(Dantali0n): Get rid of this error prone method
         static void compute_data_block_num(uint64_t num_lbas, uint64_t &blocks);
 
@@ -240,12 +319,14 @@ namespace qemucsd::fuse_lfs {
         int get_data_block(inode_entry entry, uint64_t block_num,
             struct data_block *blk);
 
+        int get_data_block_lba(inode_entry entry, uint64_t block_num,
+            uint64_t &lba);
+
         int get_data_block_immediate(
             struct data_position pos, struct data_block *blk);
 
-        int get_data_block_linked(
-            struct data_position pos, uint64_t block_num,
-            struct data_block *blk);
+        int read_data_block_chain(
+            uint64_t data_lba, std::vector<uint64_t> &block_lbas);
 
         /** Inode methods */
 
@@ -257,7 +338,7 @@ namespace qemucsd::fuse_lfs {
         // TODO(Dantali0n): Create and keep track of ino_pos for log zone linear
         //                  continuity.
 
-//        static int build_path_inode_map();
+        int build_path_inode_map();
 
         int inode_stat(fuse_ino_t ino, struct stat *stbuf);
 
@@ -277,12 +358,71 @@ namespace qemucsd::fuse_lfs {
 
         int flush_inodes(bool only_if_full);
 
-        int flush_inodes_always();
+        int flush_inodes_always(
+            const std::vector<fuse_ino_t> *only = nullptr);
 
         int flush_inodes_if_full();
 
+        int flush_data_blocks(const std::vector<fuse_ino_t> &inodes);
+
         int flush_data_blocks();
 
+        int flush_write_buffers(const std::vector<fuse_ino_t> &inodes);
+
+        int flush_write_buffers();
+
+        int flush_write_buffers_if_full(uint64_t sectors);
+
+        void get_pending_inodes(std::vector<fuse_ino_t> *inodes);
+
+        int flush_pending(const std::vector<fuse_ino_t> &inodes);
+
+        int flush_pending();
+
+        int flush_pending_inode(fuse_ino_t ino);
+
+        /** Writeback methods */
+
+        // Limits of pending state copied from the options, 0 disables a limit
+        uint64_t writeback_dirty_bytes;
+        uint64_t writeback_dirty_inodes;
+        uint64_t writeback_dirty_expire;
+
+        std::thread writeback_thread;
+
+        // Protects the state shared between the writeback thread and writers
+        // waiting for it, writeback_cv wakes the writeback thread and
+        // writeback_done_cv the writers after every round.
+        std::mutex writeback_lck;
+        std::condition_variable writeback_cv;
+        std::condition_variable writeback_done_cv;
+        bool writeback_running;
+        bool writeback_failed;
+
+        // Last inode written back, the next round continues after it
+        fuse_ino_t writeback_cursor;
+
+        // Steady clock time since state has been pending, 0 if none is
+        std::atomic<int64_t> dirty_since;
+
+        uint64_t dirty_bytes();
+
+        void mark_dirty();
+
+        bool writeback_over_limit(uint64_t divisor);
+
+        bool writeback_expired();
+
+        void writeback_run();
+
+        int writeback_round(uint64_t &pending);
+
+        void start_writeback();
+
+        void stop_writeback();
+
+        void writeback_throttle();
+
         // TODO(Dantali0n): Move CSD / snapshot methods to separate interface
 
         int update_snapshot(csd_unique_t *context, fuse_ino_t kernel,
@@ -355,12 +495,21 @@ namespace qemucsd::fuse_lfs {
 
         /** Write interface methods */
 
+        int prepare_sector(size_t size, off_t offset, uint64_t cur_lba,
+             const char *data, uint8_t *buffer) override;
+
         int write_sector(size_t size, off_t offset, uint64_t cur_lba,
              const char *data, uint64_t &result_lba) override;
 
         void write_regular(fuse_req_t req, fuse_ino_t ino, const char *buf,
             size_t size, off_t off, struct write_context *wr_context,
             struct fuse_file_info *fi) override;
+
+        void write_buffered(fuse_req_t req, fuse_ino_t ino, const char *buf,
+            size_t size, off_t off, inode_entry_t *entry) override;
+
+        int fill_write_buffer_sector(struct inode_entry entry,
+            uint64_t sector);
         // Implemented but not used, commented out to remove clutter
 //        void write_snapshot(fuse_req_t req, csd_unique_t *context,
 //            const char *buf, size_t size, off_t off,
@@ -408,6 +557,8 @@ namespace qemucsd::fuse_lfs {
             struct fuse_file_info *fi);
         void write(fuse_req_t req, fuse_ino_t ino, const char *buf,
             size_t size, off_t off, struct fuse_file_info *fi);
+        void write_buf(fuse_req_t req, fuse_ino_t ino,
+            struct fuse_bufvec *bufv, off_t off, struct fuse_file_info *fi);
         void statfs(fuse_req_t req, fuse_ino_t ino);
         void fsync(fuse_req_t req, fuse_ino_t ino, int datasync,
             struct fuse_file_info *fi);
@@ -0,0 +1,141 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Dantali0n
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef QEMU_CSD_FLFS_ALLOCATOR_HPP
+#define QEMU_CSD_FLFS_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "flfs_constants.hpp"
+
+namespace qemucsd::fuse_lfs {
+
+    /**
+     * Round size up to the nearest multiple of SECTOR_SIZE
+     */
+    inline size_t sector_align(size_t size) {
+        return (size + SECTOR_SIZE - 1) & ~((size_t) SECTOR_SIZE - 1);
+    }
+
+    /**
+     * Thread local cache of fixed size buffers aligned to SECTOR_SIZE. Released
+     * buffers are kept by the releasing thread for reuse up to limit buffers,
+     * beyond that they are returned to the system. Buffers may be released by
+     * a different thread than the one that allocated them.
+     */
+    template<size_t size, size_t limit = SLAB_CACHE_LIMIT>
+    class slab {
+    public:
+        /**
+         * @return buffer of size bytes or nullptr if allocation failed
+         */
+        static void *alloc() {
+            auto &buffers = local().buffers;
+            if(buffers.empty())
+                return std::aligned_alloc(SECTOR_SIZE, sector_align(size));
+
+            void *ptr = buffers.back();
+            buffers.pop_back();
+            return ptr;
+        }
+
+        static void release(void *ptr) {
+            if(ptr == nullptr) return;
+
+            auto &buffers = local().buffers;
+            if(buffers.size() >= limit) {
+                std::free(ptr);
+                return;
+            }
+
+            buffers.push_back(ptr);
+        }
+
+    private:
+        struct cache {
+            std::vector<void*> buffers;
+
+            cache() {
+                buffers.reserve(limit);
+            }
+
+            ~cache() {
+                for(auto &ptr : buffers) std::free(ptr);
+            }
+        };
+
+        static cache &local() {
+            thread_local cache c;
+            return c;
+        }
+    };
+
+    // All on drive structures occupy exactly a single sector
+    typedef slab<SECTOR_SIZE> sector_slab;
+
+    /**
+     * Scoped bump allocator for buffers that are only required for the
+     * duration of a single request. All arenas of a thread allocate from a
+     * single region owned by that thread, the space is returned once the arena
+     * is destroyed. Arenas of the same thread must be destroyed in reverse
+     * order of construction, which scoping guarantees. Allocations that do not
+     * fit in the region fall back to the system allocator. Buffers are aligned
+     * to SECTOR_SIZE. An arena must not allocate while a more recently
+     * constructed arena of the same thread still exists.
+     * @threadsafety: single thread, an arena must not be passed between
+     *                threads.
+     */
+    class arena {
+    public:
+        arena();
+        ~arena();
+
+        arena(const arena&) = delete;
+        arena& operator=(const arena&) = delete;
+
+        void *alloc(size_t size);
+
+    private:
+        struct region {
+            uint8_t *base = nullptr;
+            size_t used = 0;
+
+            ~region();
+        };
+
+        static region &local();
+
+        // Offset in the region at construction of this arena
+        size_t mark;
+
+        // Allocations that did not fit in the region
+        std::vector<void*> overflow;
+    };
+}
+
+#endif // QEMU_CSD_FLFS_ALLOCATOR_HPP
@@ -103,8 +103,43 @@ namespace qemucsd::fuse_lfs {
 
         // Indicate the requested inode is a directory
         FLFS_RET_EISDIR             =  7,
+
+        // Indicate the write_buffer sector must be completed from drive first
+        FLFS_RET_WRBUF_FILL         =  8,
     };
 
+    /**
+     * Streams in the log zone each with their own write pointer, data with a
+     * different expected lifetime is placed in separate zones to reduce the
+     * amount of live data garbage collection has to relocate. If fewer
+     * streams can be open at once a stream shares the zone of the highest
+     * stream preceding it.
+     */
+    enum log_stream {
+        LOG_STREAM_HOT_META  = 0,
+        LOG_STREAM_HOT_DATA  = 1,
+        LOG_STREAM_COLD_DATA = 2,
+        LOG_STREAM_GC        = 3,
+    };
+    static constexpr uint32_t N_LOG_STREAMS = 4;
+
+    // Maximum number of heads per log stream, every head owns a zone and
+    // threads append through their own head to avoid contention.
+    static constexpr uint32_t N_LOG_HEADS = 16;
+
+    // Type of data appended to the log used to classify it into a log_stream
+    enum log_data_type {
+        LOG_DATA_INODE_BLOCK = 0,
+        LOG_DATA_DATA_BLOCK  = 1,
+        LOG_DATA_BUFFERED    = 2,  // Small writes flushed from write buffer
+        LOG_DATA_DIRECT      = 3,  // Large writes appended immediately
+        LOG_DATA_RELOCATED   = 4,  // Live data moved by garbage collection
+    };
+
+    // Open zones reserved for the checkpoint and random zone, remaining open
+    // zones are available to log streams.
+    static constexpr uint32_t LOG_RESERVED_OPEN = 2;
+
     enum snapshot_store_type {
         SNAP_FILE = 1,
         SNAP_READ_STREAM = 2,
@@ -121,6 +156,28 @@ namespace qemucsd::fuse_lfs {
     // 128k is the max without DIRECT_IO, with just shy of 1M.
     static constexpr uint64_t CSD_READ_STRIDE = 524288; //1048528; // 131072;
 
+    // Initial and maximum size of the read ahead window of sequential reads,
+    // the window doubles for every consecutive sequential read.
+    static constexpr uint64_t READ_AHEAD_MIN = 131072;
+    static constexpr uint64_t READ_AHEAD_MAX = 4194304;
+
+    // Maximum number of sectors read at once while loading metadata on mount
+    static constexpr uint64_t MOUNT_READ_SECTORS = 256;
+
+    // Milliseconds in between checks of pending state by the writeback thread
+    static constexpr uint64_t WRITEBACK_INTERVAL = 500;
+
+    // Maximum number of inodes written back while holding the global lock,
+    // FUSE calls can proceed in between these rounds.
+    static constexpr uint64_t WRITEBACK_BATCH = 64;
+
+    // Maximum number of released buffers each thread keeps per slab size.
+    static constexpr uint64_t SLAB_CACHE_LIMIT = 64;
+
+    // Size of the per thread region for request arenas, sufficient for a
+    // maximum sized FUSE write copied out of a pipe and its bounce buffer.
+    static constexpr uint64_t ARENA_SIZE = 4194304;
+
     static constexpr uint32_t SECTOR_SIZE = 4096;
     static constexpr uint64_t MAGIC_COOKIE = 0x10ADEDB00BDEC0DE;
 
@@ -48,7 +48,8 @@ namespace qemucsd::fuse_lfs {
         nvme_csd::NvmeCsd *csd_instance;
 
         void flatten_data_blocks(uint64_t size, uint64_t off,
-            data_map_t *blocks, std::vector<uint64_t> *flat_blocks);
+            data_map_t *blocks, uint64_t zone_size,
+            std::vector<struct flfs_extent> *extents);
 
         virtual void create_csd_context(struct snapshot *snap, size_t size,
             off_t off, enum flfs_operations op, void *&call,
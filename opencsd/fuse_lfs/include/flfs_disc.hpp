@@ -54,6 +54,14 @@ namespace qemucsd::fuse_lfs {
      * static location write zone on drive.
      */
 
+    /**
+     * Version of the on drive format, increment upon incompatible changes to
+     * any of the on drive datastructures.
+     * 1: inode_block with header and sorted inode index
+     * 2: checkpoint_block with random_ptr, log zone and NAT summary
+     */
+    static constexpr uint64_t DISC_FORMAT_VERSION = 2;
+
     /**
      * One time write, read only information. Always stored at zone 0, sector 0.
      */
@@ -63,7 +71,8 @@ namespace qemucsd::fuse_lfs {
         uint64_t zones;         // Verifies given partition matches expectations
         uint64_t sectors;       // Verifies given partition matches expectations
         uint64_t sector_size;   // Verifies given partition matches expectations
-        uint8_t  padding[SECTOR_SIZE-32];  // Pad out the rest
+        uint64_t version;       // On drive format, see DISC_FORMAT_VERSION
+        uint8_t  padding[SECTOR_SIZE-40];  // Pad out the rest
     };
     static_assert(sizeof(super_block) == SECTOR_SIZE);
     static_assert(std::is_trivially_copyable<super_block>::value);
@@ -87,11 +96,25 @@ namespace qemucsd::fuse_lfs {
       * The last checkpoint that can be read starting from zone 2 sector 0
       * is valid. Reading should not continue after holes in the rare case zone
       * 3 is not reset yet after writing zone 2 sector 0 again.
+      *
+      * log_heads holds the lba of the first sector in the zone currently
+      * claimed by each head of every log_stream or zero if it has no zone.
+      *
+      * The remaining fields allow mounting without scanning the drive, state
+      * written after the checkpoint is recovered by rolling forward from them.
+      * randz_ptr holds the lba of random_ptr or zero if the random zone was
+      * full. NAT blocks are only found between randz_lba and randz_ptr while
+      * ino_ptr is the lowest inode number that was never handed out.
       */
      struct checkpoint_block {
          uint64_t randz_lba;
          uint64_t logz_lba;
-         uint8_t  padding[SECTOR_SIZE-16];  // Pad out the rest
+         uint64_t randz_ptr;
+         uint64_t log_zone_next;  // First log zone not claimed by any head
+         uint64_t ino_ptr;
+         uint64_t log_heads[N_LOG_STREAMS][N_LOG_HEADS];
+         uint8_t  padding[SECTOR_SIZE - 40 -
+                          (N_LOG_STREAMS * N_LOG_HEADS * 8)];  // Pad out rest
      };
     static_assert(sizeof(checkpoint_block) == SECTOR_SIZE);
     static_assert(std::is_trivially_copyable<checkpoint_block>::value);
@@ -169,9 +192,12 @@ namespace qemucsd::fuse_lfs {
     /**
      * inode block on drive layout, remaining space is zero filled no partial
      * entries written across sector boundaries. names must be null terminated.
+     * The index holds one inode_block_index per entry sorted by inode so an
+     * inode can be found with a binary search and the inodes in a block can be
+     * determined without parsing any names.
      *
-     *     33 bytes     x bytes           33 bytes     y bytes
-     * | inode_entry | file/dir name | inode entry | file/dir name | ...
+     *    2 bytes      count * 10 bytes    33 bytes     x bytes
+     * | header | inode_block_index ... | inode_entry | file/dir name | ...
      */
 
     struct __attribute__((packed)) inode_block {
@@ -182,6 +208,19 @@ namespace qemucsd::fuse_lfs {
 
     static constexpr size_t INODE_BLOCK_SIZE = sizeof(inode_block);
 
+    struct __attribute__((packed)) inode_block_header {
+        uint16_t count;    // Number of inode entries in the block
+    };
+
+    struct __attribute__((packed)) inode_block_index {
+        uint64_t inode;    // Inode of the entry
+        uint16_t offset;   // Offset of the inode_entry from the block start
+    };
+
+    static constexpr size_t INODE_BLOCK_HEADER_SIZE =
+        sizeof(inode_block_header);
+    static constexpr size_t INODE_BLOCK_INDEX_SIZE = sizeof(inode_block_index);
+
     struct __attribute__((packed)) inode_entry {
         uint64_t parent;   // Parent inode, can be 1 for root. only root has 0
                            // but root inode is never stored on drive.
@@ -193,10 +232,14 @@ namespace qemucsd::fuse_lfs {
     };
 
     static constexpr size_t INODE_ENTRY_SIZE = sizeof(inode_entry);
-    static constexpr size_t INO_BLK_READ_LIM =
-        INODE_BLOCK_SIZE - INODE_ENTRY_SIZE;
 
-    static constexpr size_t MAX_NAME_SIZE = SECTOR_SIZE - INODE_ENTRY_SIZE;
+    // Size occupied by an entry in an inode_block excluding its name
+    static constexpr size_t INODE_BLOCK_ENTRY_SIZE =
+        INODE_BLOCK_INDEX_SIZE + INODE_ENTRY_SIZE;
+
+    // Longest name that still fits in an inode_block, excluding null byte
+    static constexpr size_t MAX_NAME_SIZE =
+        INODE_BLOCK_SIZE - INODE_BLOCK_HEADER_SIZE - INODE_BLOCK_ENTRY_SIZE - 1;
 
     static constexpr size_t DATA_BLK_LBA_NUM = (SECTOR_SIZE-8)/8;
 
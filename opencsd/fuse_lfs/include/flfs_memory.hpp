@@ -26,9 +26,16 @@
 #define QEMU_CSD_FLFS_MEMORY_HPP
 
 #include <atomic>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <shared_mutex>
+#include <vector>
 
 extern "C" {
     #include <fuse3/fuse_lowlevel.h>
@@ -52,6 +59,18 @@ namespace qemucsd::fuse_lfs {
     };
 
 
+    /**
+     * Sequential read detection state of a file handle. _next_offset_ is the
+     * offset a sequential read would start at, data up to _ahead_ has already
+     * been requested ahead of time using a window of _window_ bytes. A window
+     * of 0 indicates no sequential stream has been detected.
+     */
+    struct read_ahead {
+        uint64_t next_offset;
+        uint64_t window;
+        uint64_t ahead;
+    };
+
     /**
      * Keep track of open files and their state, including CSD state such as
      * if kernels are enabled and which ones.
@@ -65,12 +84,14 @@ namespace qemucsd::fuse_lfs {
         fuse_ino_t write_stream_kernel;
         fuse_ino_t read_event_kernel;
         fuse_ino_t write_event_kernel;
+        struct read_ahead ra;
     };
 
     struct lba_inode {
         uint64_t parent;
         uint64_t lba;
-        std::shared_ptr<std::mutex> l;
+        // Shared by readers, exclusive for operations modifying the inode
+        std::shared_ptr<std::shared_mutex> l;
     };
 
     // Keep track of the number of nlookups per inode.
@@ -120,6 +141,80 @@ namespace qemucsd::fuse_lfs {
     // A map of data_blocks that must be flushed to drive
     typedef std::map<fuse_ino_t, data_map_t*> data_blocks_t;
 
+    // Least recently used order of inodes in the block_index_map_t, most
+    // recently used at the front.
+    typedef std::list<fuse_ino_t> block_index_lru_t;
+
+    /**
+     * LBAs of all data_blocks of an inode on drive in order of their block
+     * number. Only valid as long as the first data_block of the inode is
+     * still located at data_lba.
+     */
+    struct block_index {
+        uint64_t data_lba;
+        std::vector<uint64_t> block_lbas;
+        block_index_lru_t::iterator lru;
+    };
+
+    // Map inodes to the index of their data_blocks on drive
+    typedef std::map<fuse_ino_t, struct block_index> block_index_map_t;
+
+    // Least recently used order of inodes in the inode_cache_map_t, most
+    // recently used at the front.
+    typedef std::list<fuse_ino_t> inode_cache_lru_t;
+
+    /**
+     * Decoded inode_entry_t of an inode on drive. Only valid as long as the
+     * inode_block holding the inode is still located at lba.
+     */
+    struct inode_cache {
+        uint64_t lba;
+        inode_entry_t entry;
+        inode_cache_lru_t::iterator lru;
+    };
+
+    // Map inodes to their decoded inode_entry_t on drive
+    typedef std::map<fuse_ino_t, struct inode_cache> inode_cache_map_t;
+
+    /**
+     * Sector of an inode written to but not yet appended to the log. Only the
+     * bytes from start up to end have been written, the remainder must be
+     * completed with the data already on drive unless the range covers the
+     * entire sector.
+     */
+    struct write_buffer_sector {
+        uint8_t *data;
+        uint32_t start;
+        uint32_t end;
+    };
+
+    // Buffered sectors of an inode by sector number within the file
+    typedef std::map<uint64_t, struct write_buffer_sector>
+        write_buffer_sectors_t;
+
+    /**
+     * Pending writes of an inode. Sectors beyond size have not been written to
+     * the log since buffering started and have no data on drive.
+     */
+    struct write_buffer {
+        write_buffer_sectors_t sectors;
+        uint64_t size;
+        std::chrono::steady_clock::time_point created;
+    };
+
+    // Map inodes to their buffered writes
+    typedef std::map<fuse_ino_t, struct write_buffer> write_buffer_map_t;
+
+    // Write pointer of a single head of a log stream, l must be held to reserve
+    struct log_head {
+        std::mutex l;
+        struct data_position ptr;
+    };
+
+    // Decide the log_stream for data of the given type belonging to an inode
+    typedef std::function<enum log_stream(enum log_data_type, fuse_ino_t)>
+        log_classifier_t;
+
     /**
      * Datastructures for in-memory snapshots
      */
@@ -34,6 +34,7 @@ namespace qemucsd::fuse_lfs {
      */
     class FuseLFSSuperBlock {
     public:
+        virtual int find_superblock() = 0;
         virtual int verify_superblock() = 0;
         virtual int write_superblock() = 0;
     };
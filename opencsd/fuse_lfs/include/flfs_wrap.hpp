@@ -83,6 +83,9 @@ namespace qemucsd::fuse_lfs {
                          struct fuse_file_info *fi);
         static void write(fuse_req_t req, fuse_ino_t ino, const char *buf,
                           size_t size, off_t off, struct fuse_file_info *fi);
+        static void write_buf(fuse_req_t req, fuse_ino_t ino,
+                              struct fuse_bufvec *bufv, off_t off,
+                              struct fuse_file_info *fi);
         static void statfs(fuse_req_t req, fuse_ino_t ino);
         static void fsync(fuse_req_t req, fuse_ino_t ino, int datasync,
                           struct fuse_file_info *fi);
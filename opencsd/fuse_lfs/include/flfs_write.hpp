@@ -47,6 +47,9 @@ namespace qemucsd::fuse_lfs {
      */
     class FuseLFSWrite {
     public:
+        virtual int prepare_sector(size_t size, off_t offset, uint64_t cur_lba,
+            const char *data, uint8_t *buffer) = 0;
+
         virtual int write_sector(size_t size, off_t offset, uint64_t cur_lba,
             const char *data, uint64_t &result_lba) = 0;
 
@@ -54,6 +57,10 @@ namespace qemucsd::fuse_lfs {
             const char *buf, size_t size, off_t off,
             struct write_context *wr_context, struct fuse_file_info *fi) = 0;
 
+        virtual void write_buffered(fuse_req_t req, fuse_ino_t ino,
+            const char *buf, size_t size, off_t off,
+            inode_entry_t *entry) = 0;
+
         // Implemented but not used, commented out to remove clutter
 //        virtual void write_snapshot(fuse_req_t req, csd_unique_t *context,
 //            const char *buf, size_t size, off_t off,
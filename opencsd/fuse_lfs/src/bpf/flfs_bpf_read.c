@@ -33,15 +33,15 @@ int main() {
     struct flfs_call *call = 0;
     bpf_get_call_info((void**)&call);
 
-    uint64_t *cur_data_lba = (uint64_t*)call;
-    find_data_lba((uint64_t**)&cur_data_lba, false);
+    struct flfs_extent *cur_extent = (struct flfs_extent*)call;
+    find_data_extent(&cur_extent, false);
 
     uint64_t zone_capacity = bpf_get_zone_capacity();
     uint64_t zone_size = bpf_get_zone_size();
     uint64_t sector_size = bpf_get_sector_size();
 
     if(call == 0) return -1;
-    if(*cur_data_lba == 0) return -2;
+    if(cur_extent->lba == 0) return -2;
 
     // Ensure the read kernel is being used for a read operation
     if(call->op != FLFS_READ_STREAM) return -3;
@@ -53,14 +53,25 @@ int main() {
     uint64_t data_limit = call->dims.size < call->ino.size ?
         call->dims.size : call->ino.size;
     uint64_t buffer_offset = 0;
-    uint64_t zone, sector;
-    while(buffer_offset < data_limit) {
-        lba_to_position(*cur_data_lba, zone_size, &zone, &sector);
-        bpf_read(zone, sector, 0, sector_size, buffer + buffer_offset);
-        buffer_offset = buffer_offset + sector_size;
-        next_data_lba(&cur_data_lba);
+    uint64_t zone, sector, size, remaining;
+    while(buffer_offset < data_limit && cur_extent->length != 0) {
+        // Read the entire extent at once but never beyond the data limit
+        size = cur_extent->length * sector_size;
+        remaining = (data_limit - buffer_offset + sector_size - 1) /
+            sector_size * sector_size;
+        if(size > remaining) size = remaining;
+
+        lba_to_position(cur_extent->lba, zone_size, &zone, &sector);
+        if(bpf_submit_read(zone, sector, 0, size,
+                           buffer + buffer_offset) < 0)
+            return -4;
+        buffer_offset = buffer_offset + size;
+        next_data_extent(&cur_extent);
     }
 
+    // All reads are in flight, wait for them to complete
+    if(bpf_wait() < 0) return -4;
+
     bpf_return_data(buffer, data_limit);
 
     return 0;
@@ -35,15 +35,15 @@ int main() {
     struct flfs_call *call = 0;
     bpf_get_call_info((void**)&call);
 
-    uint64_t *cur_data_lba = (uint64_t*)call;
-    find_data_lba((uint64_t**)&cur_data_lba, false);
+    struct flfs_extent *cur_extent = (struct flfs_extent*)call;
+    find_data_extent(&cur_extent, false);
 
     uint64_t zone_capacity = bpf_get_zone_capacity();
     uint64_t zone_size = bpf_get_zone_size();
     uint64_t sector_size = bpf_get_sector_size();
 
     if(call == 0) return -1;
-    if(*cur_data_lba == 0) return -2;
+    if(cur_extent->lba == 0) return -2;
 
     // Ensure the read kernel is being used for a read operation
     if(call->op != FLFS_READ_STREAM) return -3;
@@ -56,16 +56,30 @@ int main() {
         call->dims.size : call->ino.size;
     uint64_t buffer_offset = 0;
     uint64_t zone, sector, count = 0;
-    uint64_t ints_per_it = sector_size / sizeof(uint32_t);
+    uint64_t ints_per_sector = sector_size / sizeof(uint32_t);
     uint32_t *int_buf = (uint32_t*)buffer;
-    while(buffer_offset < data_limit) {
-        lba_to_position(*cur_data_lba, zone_size, &zone, &sector);
-        bpf_read(zone, sector, 0, sector_size, buffer);
-        for(uint64_t j = 0; j < ints_per_it; j++) {
+
+    // Read as many sectors of an extent as fit in the buffer at once
+    uint64_t max_sectors = buffer_size / sector_size;
+    if(max_sectors == 0) return -4;
+
+    uint64_t done = 0, sectors;
+    while(buffer_offset < data_limit && cur_extent->length != 0) {
+        sectors = cur_extent->length - done < max_sectors ?
+            cur_extent->length - done : max_sectors;
+
+        lba_to_position(cur_extent->lba, zone_size, &zone, &sector);
+        bpf_read(zone, sector + done, 0, sectors * sector_size, buffer);
+        for(uint64_t j = 0; j < sectors * ints_per_sector; j++) {
             if(*(int_buf + j) > RAND_MAX / 2) count++;
         }
-        buffer_offset = buffer_offset + sector_size;
-        next_data_lba(&cur_data_lba);
+        buffer_offset = buffer_offset + sectors * sector_size;
+
+        done = done + sectors;
+        if(done == cur_extent->length) {
+            done = 0;
+            next_data_extent(&cur_extent);
+        }
     }
 
     bpf_return_data(&count, sizeof(uint64_t));
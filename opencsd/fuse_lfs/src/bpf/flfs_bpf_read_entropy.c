@@ -115,15 +115,15 @@ int main() {
     struct flfs_call *call = 0;
     bpf_get_call_info((void**)&call);
 
-    uint64_t *cur_data_lba = (uint64_t*)call;
-    find_data_lba((uint64_t**)&cur_data_lba, false);
+    struct flfs_extent *cur_extent = (struct flfs_extent*)call;
+    find_data_extent(&cur_extent, false);
 
     uint64_t zone_capacity = bpf_get_zone_capacity();
     uint64_t zone_size = bpf_get_zone_size();
     uint64_t sector_size = bpf_get_sector_size();
 
     if(call == 0) return -1;
-    if(*cur_data_lba == 0) return -2;
+    if(cur_extent->lba == 0) return -2;
 
     // Ensure the read kernel is being used for a read operation
     if(call->op != FLFS_READ_STREAM) return -3;
@@ -136,24 +136,39 @@ int main() {
         call->dims.size : call->ino.size;
     uint64_t buffer_offset = 0;
     uint64_t zone, sector = 0;
-    uint64_t bytes_per_it = sector_size / sizeof(uint8_t);
-    uint8_t *byte_buf = (uint8_t*)buffer;
+    uint64_t bytes_per_sector = sector_size / sizeof(uint8_t);
 
-    uint32_t *bins = (uint32_t*)(byte_buf + sector_size);
+    // Bins are kept at the start of the buffer followed by the read data
+    uint32_t *bins = (uint32_t*)buffer;
     for(uint16_t i = 0; i < 256; i++) {
         bins[i] = 0;
     }
+    uint8_t *byte_buf = (uint8_t*)buffer + sizeof(uint32_t) * 256;
 
-    while(buffer_offset < data_limit) {
-        lba_to_position(*cur_data_lba, zone_size, &zone, &sector);
-        bpf_read(zone, sector, 0, sector_size, buffer);
+    // Read as many sectors of an extent as fit in the buffer at once
+    uint64_t max_sectors = (buffer_size - sizeof(uint32_t) * 256) /
+        sector_size;
+    if(max_sectors == 0) return -4;
 
-        for(uint64_t j = 0; j < bytes_per_it; j++) {
+    uint64_t done = 0, sectors;
+    while(buffer_offset < data_limit && cur_extent->length != 0) {
+        sectors = cur_extent->length - done < max_sectors ?
+            cur_extent->length - done : max_sectors;
+
+        lba_to_position(cur_extent->lba, zone_size, &zone, &sector);
+        bpf_read(zone, sector + done, 0, sectors * sector_size, byte_buf);
+
+        for(uint64_t j = 0; j < sectors * bytes_per_sector; j++) {
             bins[*(byte_buf + j)] += 1;
         }
 
-        buffer_offset = buffer_offset + sector_size;
-        next_data_lba(&cur_data_lba);
+        buffer_offset = buffer_offset + sectors * sector_size;
+
+        done = done + sectors;
+        if(done == cur_extent->length) {
+            done = 0;
+            next_data_extent(&cur_extent);
+        }
     }
 
     bpf_return_data(bins, sizeof(uint32_t) * 256);
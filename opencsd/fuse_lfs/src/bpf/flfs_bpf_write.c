@@ -33,16 +33,16 @@ int main() {
     struct flfs_call *call = 0;
     bpf_get_call_info((void**)&call);
 
-    uint64_t *cur_data_lba = (uint64_t*)call;
-    // Set find_data_lba write=true
-    find_data_lba((uint64_t**)&cur_data_lba, true);
+    struct flfs_extent *cur_extent = (struct flfs_extent*)call;
+    // Set find_data_extent write=true
+    find_data_extent(&cur_extent, true);
 
     uint64_t zone_capacity = bpf_get_zone_capacity();
     uint64_t zone_size = bpf_get_zone_size();
     uint64_t sector_size = bpf_get_sector_size();
 
     if(call == 0) return -1;
-    if(*cur_data_lba == 0) return -2;
+    if(cur_extent->lba == 0) return -2;
 
     // Ensure the write kernel is being used for a read operation
     if(call->op != FLFS_WRITE_EVENT) return -3;
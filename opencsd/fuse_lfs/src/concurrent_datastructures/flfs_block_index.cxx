@@ -0,0 +1,148 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Dantali0n
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "flfs.hpp"
+
+namespace qemucsd::fuse_lfs {
+
+    FuseLFSBlockIndex::FuseLFSBlockIndex(uint64_t limit) {
+        block_index_lbas = 0;
+        block_index_limit = limit;
+
+        rwlock_init(&block_index_lck, &block_index_attr, "block_index_map");
+    }
+
+    FuseLFSBlockIndex::~FuseLFSBlockIndex() {
+        rwlock_destroy(&block_index_lck, &block_index_attr, "block_index_map");
+    }
+
+    /**
+     * @threadsafety: thread safe
+     * @return number of data_block LBAs currently indexed across all inodes
+     */
+    uint64_t FuseLFSBlockIndex::block_index_size() {
+        lock_guard<pthread_rwlock_t> guard(block_index_lck);
+        return block_index_lbas;
+    }
+
+    /**
+     * Get the LBA of the data_block with block_num for the given inode. The
+     * index is ignored if it was built for a different data_lba as the chain
+     * of data_blocks has been rewritten since.
+     * @threadsafety: thread safe
+     * @param block_num zero indexed data_block block number
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ENOENT if the inode is not
+     *         indexed and FLFS_RET_ERR if block_num is beyond the last
+     *         data_block
+     */
+    int FuseLFSBlockIndex::get_block_index_lba(fuse_ino_t ino,
+        uint64_t data_lba, uint64_t block_num, uint64_t &lba)
+    {
+        // Write lock as the lookup moves the inode to the front of the lru
+        lock_guard<pthread_rwlock_t> guard(block_index_lck, true);
+
+        auto it = block_index_map.find(ino);
+        if(it == block_index_map.end() || it->second.data_lba != data_lba)
+            return FLFS_RET_ENOENT;
+
+        if(block_num >= it->second.block_lbas.size())
+            return FLFS_RET_ERR;
+
+        block_index_lru.splice(block_index_lru.begin(), block_index_lru,
+                               it->second.lru);
+
+        lba = it->second.block_lbas.at(block_num);
+        return FLFS_RET_NONE;
+    }
+
+    /**
+     * Insert or replace the index for the given inode and evict the least
+     * recently used inodes if the limit is exceeded. The inode being updated
+     * is never evicted, even if it exceeds the limit on its own.
+     * @threadsafety: thread safe
+     */
+    void FuseLFSBlockIndex::update_block_index(fuse_ino_t ino,
+        uint64_t data_lba, std::vector<uint64_t> &&block_lbas)
+    {
+        lock_guard<pthread_rwlock_t> guard(block_index_lck, true);
+
+        auto it = block_index_map.find(ino);
+        if(it == block_index_map.end()) {
+            block_index_lru.push_front(ino);
+            it = block_index_map.insert(std::make_pair(ino,
+                block_index{0, {}, block_index_lru.begin()})).first;
+        }
+        else {
+            block_index_lbas -= it->second.block_lbas.size();
+            block_index_lru.splice(block_index_lru.begin(), block_index_lru,
+                                   it->second.lru);
+        }
+
+        it->second.data_lba = data_lba;
+        it->second.block_lbas = std::move(block_lbas);
+        block_index_lbas += it->second.block_lbas.size();
+
+        while(block_index_lbas > block_index_limit &&
+              block_index_lru.back() != ino)
+        {
+            auto victim = block_index_map.find(block_index_lru.back());
+            block_index_lbas -= victim->second.block_lbas.size();
+            block_index_map.erase(victim);
+            block_index_lru.pop_back();
+        }
+    }
+
+    /**
+     * Remove the index of the given inode, does nothing if not indexed.
+     * @threadsafety: thread safe
+     */
+    void FuseLFSBlockIndex::remove_block_index(fuse_ino_t ino) {
+        lock_guard<pthread_rwlock_t> guard(block_index_lck, true);
+
+        auto it = block_index_map.find(ino);
+        if(it == block_index_map.end())
+            return;
+
+        block_index_lbas -= it->second.block_lbas.size();
+        block_index_lru.erase(it->second.lru);
+        block_index_map.erase(it);
+    }
+
+    /**
+     * Evict least recently used inodes until at most limit data_block LBAs
+     * remain indexed. Use a limit of zero to drop the entire index.
+     * @threadsafety: thread safe
+     */
+    void FuseLFSBlockIndex::evict_block_index(uint64_t limit) {
+        lock_guard<pthread_rwlock_t> guard(block_index_lck, true);
+
+        while(block_index_lbas > limit && !block_index_lru.empty()) {
+            auto victim = block_index_map.find(block_index_lru.back());
+            block_index_lbas -= victim->second.block_lbas.size();
+            block_index_map.erase(victim);
+            block_index_lru.pop_back();
+        }
+    }
+}
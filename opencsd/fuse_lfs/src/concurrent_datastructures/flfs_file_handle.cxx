@@ -192,6 +192,51 @@ namespace qemucsd::fuse_lfs {
         return it == open_inode_vect.end() ? 0 : 1;
     }
 
+    /**
+     * Detect sequential reads on the file handle and determine the range that
+     * should be read ahead of time. The window doubles for every read that
+     * continues where the previous one ended and collapses upon any other
+     * read. A new range is only requested once less than half of the window
+     * remains ahead of the current read.
+     * @param start offset of the range to read ahead
+     * @param length size of the range to read ahead, 0 if nothing should be
+     *               read ahead
+     * @threadsafety: thread safe
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ENOENT if not found
+     */
+    int FuseLFSFileHandle::read_ahead_window(uint64_t fh, uint64_t offset,
+        uint64_t size, uint64_t &start, uint64_t &length)
+    {
+        lock_guard<pthread_rwlock_t> guard(open_inode_lck, true);
+
+        open_inode_vect_t::iterator it;
+        find_file_handle_unsafe(fh, &it);
+        if(it == open_inode_vect.end())
+            return FLFS_RET_ENOENT;
+
+        struct read_ahead &ra = it->ra;
+        uint64_t end = offset + size;
+        length = 0;
+
+        if(offset != ra.next_offset) {
+            ra = {end, 0, 0};
+            return FLFS_RET_NONE;
+        }
+
+        ra.next_offset = end;
+        ra.window = ra.window == 0 ? READ_AHEAD_MIN :
+            flfs_min(ra.window * 2, READ_AHEAD_MAX);
+
+        start = ra.ahead > end ? ra.ahead : end;
+        if(end + ra.window - start < ra.window / 2)
+            return FLFS_RET_NONE;
+
+        length = end + ra.window - start;
+        ra.ahead = end + ra.window;
+
+        return FLFS_RET_NONE;
+    }
+
     /**
      * Called be release to remove the session for a file handle
      * @threadsafety: thread safe
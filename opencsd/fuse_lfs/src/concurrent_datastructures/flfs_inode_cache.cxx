@@ -0,0 +1,135 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Dantali0n
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "flfs.hpp"
+
+namespace qemucsd::fuse_lfs {
+
+    FuseLFSInodeCache::FuseLFSInodeCache(uint64_t limit) {
+        inode_cache_limit = limit;
+
+        rwlock_init(&inode_cache_lck, &inode_cache_attr, "inode_cache_map");
+    }
+
+    FuseLFSInodeCache::~FuseLFSInodeCache() {
+        rwlock_destroy(&inode_cache_lck, &inode_cache_attr, "inode_cache_map");
+    }
+
+    /**
+     * @threadsafety: thread safe
+     * @return number of inodes currently cached
+     */
+    uint64_t FuseLFSInodeCache::inode_cache_size() {
+        lock_guard<pthread_rwlock_t> guard(inode_cache_lck);
+        return inode_cache_map.size();
+    }
+
+    /**
+     * Get the decoded inode_entry_t of the given inode. The cached entry is
+     * ignored if it was decoded from an inode_block at a different lba as the
+     * inode has been flushed or relocated since.
+     * @threadsafety: thread safe
+     * @param lba the current location of the inode_block holding the inode
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ENOENT if the inode is not
+     *         cached for the given lba
+     */
+    int FuseLFSInodeCache::get_inode_cache(fuse_ino_t ino, uint64_t lba,
+        inode_entry_t *entry)
+    {
+        // Write lock as the lookup moves the inode to the front of the lru
+        lock_guard<pthread_rwlock_t> guard(inode_cache_lck, true);
+
+        auto it = inode_cache_map.find(ino);
+        if(it == inode_cache_map.end() || it->second.lba != lba)
+            return FLFS_RET_ENOENT;
+
+        inode_cache_lru.splice(inode_cache_lru.begin(), inode_cache_lru,
+                               it->second.lru);
+
+        *entry = it->second.entry;
+        return FLFS_RET_NONE;
+    }
+
+    /**
+     * Insert or replace the cached entry for the given inode and evict the
+     * least recently used inodes if the limit is exceeded.
+     * @threadsafety: thread safe
+     */
+    void FuseLFSInodeCache::update_inode_cache(fuse_ino_t ino, uint64_t lba,
+        const inode_entry_t &entry)
+    {
+        lock_guard<pthread_rwlock_t> guard(inode_cache_lck, true);
+
+        auto it = inode_cache_map.find(ino);
+        if(it == inode_cache_map.end()) {
+            inode_cache_lru.push_front(ino);
+            it = inode_cache_map.insert(std::make_pair(ino,
+                inode_cache{0, {}, inode_cache_lru.begin()})).first;
+        }
+        else {
+            inode_cache_lru.splice(inode_cache_lru.begin(), inode_cache_lru,
+                                   it->second.lru);
+        }
+
+        it->second.lba = lba;
+        it->second.entry = entry;
+
+        while(inode_cache_map.size() > inode_cache_limit &&
+              inode_cache_lru.back() != ino)
+        {
+            inode_cache_map.erase(inode_cache_lru.back());
+            inode_cache_lru.pop_back();
+        }
+    }
+
+    /**
+     * Remove the cached entry of the given inode, does nothing if not cached.
+     * @threadsafety: thread safe
+     */
+    void FuseLFSInodeCache::remove_inode_cache(fuse_ino_t ino) {
+        lock_guard<pthread_rwlock_t> guard(inode_cache_lck, true);
+
+        auto it = inode_cache_map.find(ino);
+        if(it == inode_cache_map.end())
+            return;
+
+        inode_cache_lru.erase(it->second.lru);
+        inode_cache_map.erase(it);
+    }
+
+    /**
+     * Evict least recently used inodes until at most limit inodes remain
+     * cached. Use a limit of zero to drop the entire cache.
+     * @threadsafety: thread safe
+     */
+    void FuseLFSInodeCache::evict_inode_cache(uint64_t limit) {
+        lock_guard<pthread_rwlock_t> guard(inode_cache_lck, true);
+
+        while(inode_cache_map.size() > limit && !inode_cache_lru.empty()) {
+            inode_cache_map.erase(inode_cache_lru.back());
+            inode_cache_lru.pop_back();
+        }
+    }
+}
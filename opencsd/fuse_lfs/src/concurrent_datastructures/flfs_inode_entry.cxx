@@ -34,6 +34,15 @@ namespace qemucsd::fuse_lfs {
         rwlock_destroy(&inode_entries_lck, &inode_entries_attr, "inode_entries");
     }
 
+    /**
+     * @threadsafety: thread safe
+     * @return number of unflushed inodes in inode_entries
+     */
+    uint64_t FuseLFSInodeEntry::inode_entries_size() {
+        lock_guard<pthread_rwlock_t> guard(inode_entries_lck);
+        return inode_entries.size();
+    }
+
     /**
      * Retrieve any inode if present in the inode_entries datastructure
      * @threadsafety: thread safe
@@ -81,56 +90,146 @@ namespace qemucsd::fuse_lfs {
     }
 
     /**
-     * Fill an inode_block for entries and remove every entry added to block
+     * Fill an inode_block for entries and remove every entry added to block.
+     * The index of the block is sorted by inode as inode_entries is ordered.
      * @threadsafety: thread safe, the read lock should not be necessary as this
      *                function is only called from GC / Fsync.
      * TODO(Dantali0n): Verify read lock is redundant
+     * @param ino_remove cleared and filled with the inodes added to the block
+     * @param only if not nullptr only entries of these inodes are added
      * @return FLFS_RET_NONE if block not full, FLFS_RET_INO_BLK_FULL if the
      *         entire block is filled.
      */
     int FuseLFSInodeEntry::fill_inode_block(
-        std::vector<fuse_ino_t> *ino_remove, struct inode_block *blk)
+        std::vector<fuse_ino_t> *ino_remove, struct inode_block *blk,
+        const std::vector<fuse_ino_t> *only)
     {
         lock_guard<pthread_rwlock_t> guard(inode_entries_lck);
 
-        ino_remove->reserve(INODE_BLOCK_SIZE / INODE_ENTRY_SIZE);
+        ino_remove->clear();
 
-        // Keep track of the occupied size by the current inode_entries
-        uint32_t occupied_size = 0;
+        // Determine how many entries fit, each entry occupies an index slot,
+        // its inode_entry and null terminated name.
+        bool full = false;
+        uint64_t occupied_size = INODE_BLOCK_HEADER_SIZE;
+        for(auto &entry : inode_entries) {
+            if(only != nullptr && std::find(only->begin(), only->end(),
+               entry.first) == only->end())
+                continue;
+
+            uint64_t entry_size =
+                INODE_BLOCK_ENTRY_SIZE + entry.second.second.size() + 1;
+            if(occupied_size + entry_size > INODE_BLOCK_SIZE) {
+                full = true;
+                break;
+            }
+
+            occupied_size += entry_size;
+            ino_remove->push_back(entry.first);
+        }
 
-        // Store inode_entries and names in temporary larger buffer incase of
-        // overshoot.
-        auto *buffer = (uint8_t*) malloc(INODE_BLOCK_SIZE * 2);
+        memset(blk, 0, INODE_BLOCK_SIZE);
 
-        for(auto &entry : inode_entries) {
-            // If no more space return that the block is full
-            if(entry.second.second.size() + 1 + occupied_size +
-               INODE_ENTRY_SIZE > INODE_BLOCK_SIZE)
-                goto compute_inode_block_full;
+        auto *header = (struct inode_block_header *) blk->data;
+        header->count = ino_remove->size();
 
-            memcpy(buffer + occupied_size,
-               &entry.second.first, INODE_ENTRY_SIZE);
-            occupied_size += INODE_ENTRY_SIZE;
+        // Entries directly follow the index
+        auto *index = (struct inode_block_index *)
+            (blk->data + INODE_BLOCK_HEADER_SIZE);
+        uint64_t offset = INODE_BLOCK_HEADER_SIZE +
+            header->count * INODE_BLOCK_INDEX_SIZE;
 
-            memcpy(buffer + occupied_size,
-               entry.second.second.c_str(), entry.second.second.size() + 1);
-            occupied_size += entry.second.second.size() + 1;
+        for(uint16_t i = 0; i < header->count; i++) {
+            auto it = inode_entries.find(ino_remove->at(i));
+            index[i].inode = it->first;
+            index[i].offset = offset;
 
-            ino_remove->push_back(entry.first);
+            memcpy(blk->data + offset, &it->second.first, INODE_ENTRY_SIZE);
+            offset += INODE_ENTRY_SIZE;
+
+            memcpy(blk->data + offset, it->second.second.c_str(),
+               it->second.second.size() + 1);
+            offset += it->second.second.size() + 1;
+        }
+
+        // Full if not even an entry with an empty name fits anymore
+        if(full || occupied_size + INODE_BLOCK_ENTRY_SIZE + 1 > INODE_BLOCK_SIZE)
+            return FLFS_RET_INO_BLK_FULL;
+
+        return FLFS_RET_NONE;
+    }
+
+    /**
+     * Find the inode_entry_t of ino in the inode_block using a binary search
+     * over the index of the block.
+     * @threadsafety: thread safe
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ENOENT if ino is not in the
+     *         block and FLFS_RET_ERR if the block is malformed
+     */
+    int FuseLFSInodeEntry::find_inode_block_entry(
+        const struct inode_block *blk, fuse_ino_t ino, inode_entry_t *entry)
+    {
+        auto *header = (const struct inode_block_header *) blk->data;
+        if(INODE_BLOCK_HEADER_SIZE + header->count * INODE_BLOCK_INDEX_SIZE >
+           INODE_BLOCK_SIZE)
+            return FLFS_RET_ERR;
+
+        auto *index = (const struct inode_block_index *)
+            (blk->data + INODE_BLOCK_HEADER_SIZE);
+
+        uint64_t low = 0;
+        uint64_t high = header->count;
+        while(low < high) {
+            uint64_t mid = low + (high - low) / 2;
+            if(index[mid].inode < ino)
+                low = mid + 1;
+            else
+                high = mid;
         }
 
-        // If remaining space insufficient return full
-        if(occupied_size > INODE_BLOCK_SIZE - INODE_ENTRY_SIZE)
-            goto compute_inode_block_full;
+        if(low == header->count || index[low].inode != ino)
+            return FLFS_RET_ENOENT;
+
+        uint64_t offset = index[low].offset;
+        if(offset + INODE_ENTRY_SIZE >= INODE_BLOCK_SIZE)
+            return FLFS_RET_ERR;
+
+        // Names must be null terminated within the block
+        auto *name = (const char *) blk->data + offset + INODE_ENTRY_SIZE;
+        uint64_t name_size = strnlen(name,
+            INODE_BLOCK_SIZE - offset - INODE_ENTRY_SIZE);
+        if(offset + INODE_ENTRY_SIZE + name_size == INODE_BLOCK_SIZE)
+            return FLFS_RET_ERR;
+
+        memcpy(&entry->first, blk->data + offset, INODE_ENTRY_SIZE);
+        entry->second = std::string(name, name_size);
 
-        // Block is not full so return none
-        free(buffer);
         return FLFS_RET_NONE;
+    }
 
-        compute_inode_block_full:
-        memcpy(blk, buffer, INODE_BLOCK_SIZE);
-        free(buffer);
-        return FLFS_RET_INO_BLK_FULL;
+    /**
+     * Determine the inodes stored in the inode_block from its index alone
+     * without parsing any of the entries or names.
+     * @threadsafety: thread safe
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR if the block is
+     *         malformed
+     */
+    int FuseLFSInodeEntry::get_inode_block_inodes(
+        const struct inode_block *blk, std::vector<fuse_ino_t> *inodes)
+    {
+        auto *header = (const struct inode_block_header *) blk->data;
+        if(INODE_BLOCK_HEADER_SIZE + header->count * INODE_BLOCK_INDEX_SIZE >
+           INODE_BLOCK_SIZE)
+            return FLFS_RET_ERR;
+
+        auto *index = (const struct inode_block_index *)
+            (blk->data + INODE_BLOCK_HEADER_SIZE);
+
+        inodes->reserve(inodes->size() + header->count);
+        for(uint16_t i = 0; i < header->count; i++)
+            inodes->push_back(index[i].inode);
+
+        return FLFS_RET_NONE;
     }
 
-}
\ No newline at end of file
+}
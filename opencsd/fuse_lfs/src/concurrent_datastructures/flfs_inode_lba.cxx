@@ -65,30 +65,39 @@ namespace qemucsd::fuse_lfs {
     }
 
     /**
-     * Lock a given inode
+     * Lock a given inode, multiple readers can hold the lock concurrently
+     * while writers require exclusive access.
+     * @param write lock exclusively if true, shared otherwise
      * @threadsafety: thread safe
      * @return FLFS_RET_NONE upon success, FLFS_RET_ENOENT if not found
      */
-    int FuseLFSInodeLba::lock_inode(fuse_ino_t ino) {
+    int FuseLFSInodeLba::lock_inode(fuse_ino_t ino, bool write) {
         struct lba_inode cur_lba;
         if(get_inode_lba(ino, &cur_lba) != FLFS_RET_NONE)
             return FLFS_RET_ENOENT;
 
-        cur_lba.l->lock();
+        if(write)
+            cur_lba.l->lock();
+        else
+            cur_lba.l->lock_shared();
         return FLFS_RET_NONE;
     }
 
     /**
      * Unlock a given inode
+     * @param write must match the mode the inode was locked with
      * @threadsafety: thread safe
      * @return FLFS_RET_NONE upon success, FLFS_RET_ENOENT if not found
      */
-    int FuseLFSInodeLba::unlock_inode(fuse_ino_t ino) {
+    int FuseLFSInodeLba::unlock_inode(fuse_ino_t ino, bool write) {
         struct lba_inode cur_lba;
         if(get_inode_lba(ino, &cur_lba) != FLFS_RET_NONE)
             return FLFS_RET_ENOENT;
 
-        cur_lba.l->unlock();
+        if(write)
+            cur_lba.l->unlock();
+        else
+            cur_lba.l->unlock_shared();
         return FLFS_RET_NONE;
     }
 
@@ -100,7 +109,7 @@ namespace qemucsd::fuse_lfs {
     void FuseLFSInodeLba::update_inode_lba(fuse_ino_t ino,
         struct lba_inode *data)
     {
-        // Caller might expect std::mutex to be valid lock object after
+        // Caller might expect std::shared_mutex to be valid lock object after
         // insertion
         struct lba_inode cur_lba = {0, 0, data->l};
 
@@ -143,7 +152,7 @@ namespace qemucsd::fuse_lfs {
 
             // It is absolutely critical that the mutex be constructed inside
             // the loop. Otherwise, multiple inodes would share the same mutex!
-            struct lba_inode cur_lba = {0, 0, std::make_shared<std::mutex>()};
+            struct lba_inode cur_lba = {0, 0, std::make_shared<std::shared_mutex>()};
 
             auto it = inode_lba_map.find(ino);
             if(it != inode_lba_map.end())
@@ -110,8 +110,14 @@ namespace qemucsd::fuse_lfs {
             pthread_rwlock_unlock(&inode_nlookup_lck);
             pthread_rwlock_wrlock(&inode_nlookup_lck);
 
-            if(it->second == 0)
+            if(it->second == 0) {
                 inode_nlookup_map.erase(it);
+
+                // Kernel no longer references the inode, its block index and
+                // decoded entry are unlikely to be needed soon.
+                remove_block_index(ino);
+                remove_inode_cache(ino);
+            }
         }
 
         pthread_rwlock_unlock(&inode_nlookup_lck);
@@ -135,6 +135,10 @@ namespace qemucsd::fuse_lfs {
      * @return FLFS_RET_NONE
      */
     int FuseLFS::create_snapshot(fuse_ino_t ino, struct snapshot *snap) {
+        // Snapshot must include buffered writes
+        if(flush_write_buffers({ino}) != FLFS_RET_NONE)
+            return FLFS_RET_ERR;
+
         if(get_inode(ino, &snap->inode_data) != FLFS_RET_NONE)
             return FLFS_RET_ERR;
 
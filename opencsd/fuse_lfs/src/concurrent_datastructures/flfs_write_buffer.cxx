@@ -0,0 +1,300 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Dantali0n
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "flfs.hpp"
+
+namespace qemucsd::fuse_lfs {
+
+    FuseLFSWriteBuffer::FuseLFSWriteBuffer(uint64_t limit,
+        uint64_t inode_limit)
+    {
+        write_buffer_sectors = 0;
+        write_buffer_limit = limit;
+        write_buffer_inode_limit = inode_limit;
+
+        rwlock_init(&write_buffer_lck, &write_buffer_attr, "write_buffer_map");
+    }
+
+    FuseLFSWriteBuffer::~FuseLFSWriteBuffer() {
+        for(auto &buffer : write_buffer_map) {
+            for(auto &sector : buffer.second.sectors)
+                sector_slab::release(sector.second.data);
+        }
+
+        rwlock_destroy(&write_buffer_lck, &write_buffer_attr,
+                       "write_buffer_map");
+    }
+
+    /**
+     * @threadsafety: thread safe
+     * @return number of sectors currently buffered across all inodes
+     */
+    uint64_t FuseLFSWriteBuffer::write_buffer_size() {
+        lock_guard<pthread_rwlock_t> guard(write_buffer_lck);
+        return write_buffer_sectors;
+    }
+
+    /**
+     * @threadsafety: thread safe
+     * @return true if the inode has buffered sectors, false otherwise
+     */
+    bool FuseLFSWriteBuffer::has_write_buffer(fuse_ino_t ino) {
+        lock_guard<pthread_rwlock_t> guard(write_buffer_lck);
+        return write_buffer_map.find(ino) != write_buffer_map.end();
+    }
+
+    /**
+     * @threadsafety: thread safe
+     * @return true if buffering the given number of sectors would exceed the
+     *         total limit across all inodes
+     */
+    bool FuseLFSWriteBuffer::write_buffer_full(uint64_t sectors) {
+        lock_guard<pthread_rwlock_t> guard(write_buffer_lck);
+        return write_buffer_sectors + sectors > write_buffer_limit;
+    }
+
+    /**
+     * Determine if the buffered writes of the inode should be flushed before
+     * buffering another write covering the given number of sectors. This is
+     * the case if either the total or the inode limit would be exceeded or if
+     * the oldest buffered write of the inode has been pending for too long.
+     * The total limit applies even if the inode has no buffered writes yet.
+     * @threadsafety: thread safe
+     */
+    bool FuseLFSWriteBuffer::write_buffer_flush_due(fuse_ino_t ino,
+        uint64_t sectors)
+    {
+        lock_guard<pthread_rwlock_t> guard(write_buffer_lck);
+
+        if(write_buffer_sectors + sectors > write_buffer_limit)
+            return true;
+
+        auto it = write_buffer_map.find(ino);
+        if(it == write_buffer_map.end())
+            return false;
+
+        if(it->second.sectors.size() + sectors > write_buffer_inode_limit)
+            return true;
+
+        return std::chrono::steady_clock::now() - it->second.created >
+            std::chrono::milliseconds(WRITE_BUFFER_MAX_AGE);
+    }
+
+    /**
+     * Copy length bytes of data to offset within the buffered sector. Writes
+     * to the same sector are coalesced as long as the written bytes remain a
+     * single range, the sector must be completed using fill_write_buffer
+     * otherwise.
+     * @threadsafety: thread safe, the inode must be locked by the caller
+     * @param size size of the inode, only used if the inode has no buffered
+     *        writes yet
+     * @return FLFS_RET_NONE upon success, FLFS_RET_WRBUF_FILL if the write is
+     *         disjoint from the bytes already buffered for the sector and
+     *         FLFS_RET_ERR upon failure
+     */
+    int FuseLFSWriteBuffer::buffer_write(fuse_ino_t ino, uint64_t size,
+        uint64_t sector, const char *data, uint32_t offset, uint32_t length)
+    {
+        if(length == 0 || offset + length > SECTOR_SIZE)
+            return FLFS_RET_ERR;
+
+        lock_guard<pthread_rwlock_t> guard(write_buffer_lck, true);
+
+        auto it = write_buffer_map.find(ino);
+        if(it == write_buffer_map.end()) {
+            it = write_buffer_map.insert(std::make_pair(ino, write_buffer{
+                write_buffer_sectors_t(), size,
+                std::chrono::steady_clock::now()})).first;
+        }
+
+        auto sec = it->second.sectors.find(sector);
+        if(sec == it->second.sectors.end()) {
+            auto *buffer = (uint8_t*) sector_slab::alloc();
+            if(buffer == nullptr) {
+                if(it->second.sectors.empty())
+                    write_buffer_map.erase(it);
+                return FLFS_RET_ERR;
+            }
+
+            // Bytes never written read as zero if there is no data on drive
+            memset(buffer, 0, SECTOR_SIZE);
+            sec = it->second.sectors.insert(std::make_pair(sector,
+                write_buffer_sector{buffer, offset, offset + length})).first;
+            write_buffer_sectors += 1;
+        }
+        else if(offset > sec->second.end ||
+                offset + length < sec->second.start)
+        {
+            return FLFS_RET_WRBUF_FILL;
+        }
+        else {
+            sec->second.start = flfs_min(sec->second.start, offset);
+            sec->second.end = sec->second.end > offset + length ?
+                sec->second.end : offset + length;
+        }
+
+        memcpy(sec->second.data + offset, data, length);
+
+        return FLFS_RET_NONE;
+    }
+
+    /**
+     * Complete the buffered sector with data outside the range of bytes
+     * written to it so far, afterwards any write to the sector can be
+     * coalesced.
+     * @threadsafety: thread safe, the inode must be locked by the caller
+     * @param data the current contents of the entire sector
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ENOENT if the sector is not
+     *         buffered
+     */
+    int FuseLFSWriteBuffer::fill_write_buffer(fuse_ino_t ino, uint64_t sector,
+        const uint8_t *data)
+    {
+        lock_guard<pthread_rwlock_t> guard(write_buffer_lck, true);
+
+        auto it = write_buffer_map.find(ino);
+        if(it == write_buffer_map.end())
+            return FLFS_RET_ENOENT;
+
+        auto sec = it->second.sectors.find(sector);
+        if(sec == it->second.sectors.end())
+            return FLFS_RET_ENOENT;
+
+        memcpy(sec->second.data, data, sec->second.start);
+        memcpy(sec->second.data + sec->second.end, data + sec->second.end,
+               SECTOR_SIZE - sec->second.end);
+        sec->second.start = 0;
+        sec->second.end = SECTOR_SIZE;
+
+        return FLFS_RET_NONE;
+    }
+
+    /**
+     * Get the buffered writes of the inode, the sector data is shared with
+     * the write buffer and remains valid until the writes are removed.
+     * @threadsafety: thread safe, the inode must be locked by the caller
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ENOENT if the inode has no
+     *         buffered writes
+     */
+    int FuseLFSWriteBuffer::get_write_buffer(fuse_ino_t ino,
+        struct write_buffer *buffer)
+    {
+        lock_guard<pthread_rwlock_t> guard(write_buffer_lck);
+
+        auto it = write_buffer_map.find(ino);
+        if(it == write_buffer_map.end())
+            return FLFS_RET_ENOENT;
+
+        *buffer = it->second;
+        return FLFS_RET_NONE;
+    }
+
+    /**
+     * Get the size of the inode on drive from before its writes were buffered
+     * @threadsafety: thread safe
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ENOENT if the inode has no
+     *         buffered writes
+     */
+    int FuseLFSWriteBuffer::get_write_buffer_size(fuse_ino_t ino,
+        uint64_t &size)
+    {
+        lock_guard<pthread_rwlock_t> guard(write_buffer_lck);
+
+        auto it = write_buffer_map.find(ino);
+        if(it == write_buffer_map.end())
+            return FLFS_RET_ENOENT;
+
+        size = it->second.size;
+        return FLFS_RET_NONE;
+    }
+
+    /**
+     * Append every inode with buffered writes to inodes
+     * @threadsafety: thread safe
+     */
+    void FuseLFSWriteBuffer::get_write_buffer_inodes(
+        std::vector<fuse_ino_t> *inodes)
+    {
+        lock_guard<pthread_rwlock_t> guard(write_buffer_lck);
+
+        inodes->reserve(inodes->size() + write_buffer_map.size());
+        for(auto &buffer : write_buffer_map)
+            inodes->push_back(buffer.first);
+    }
+
+    /**
+     * Discard buffered writes beyond size, the remainder of a partially
+     * truncated sector is zeroed.
+     * @threadsafety: thread safe, the inode must be locked by the caller
+     */
+    void FuseLFSWriteBuffer::truncate_write_buffer(fuse_ino_t ino,
+        uint64_t size)
+    {
+        lock_guard<pthread_rwlock_t> guard(write_buffer_lck, true);
+
+        auto it = write_buffer_map.find(ino);
+        if(it == write_buffer_map.end())
+            return;
+
+        it->second.size = flfs_min(it->second.size, size);
+
+        auto &sectors = it->second.sectors;
+        auto sec = sectors.lower_bound(size / SECTOR_SIZE);
+        while(sec != sectors.end()) {
+            uint32_t tail = sec->first == size / SECTOR_SIZE ?
+                size % SECTOR_SIZE : 0;
+            if(tail > sec->second.start) {
+                memset(sec->second.data + tail, 0, SECTOR_SIZE - tail);
+                sec->second.end = flfs_min(sec->second.end, tail);
+                sec++;
+                continue;
+            }
+
+            sector_slab::release(sec->second.data);
+            sec = sectors.erase(sec);
+            write_buffer_sectors -= 1;
+        }
+
+        if(sectors.empty())
+            write_buffer_map.erase(it);
+    }
+
+    /**
+     * Remove all buffered writes of the inode, does nothing if there are none.
+     * @threadsafety: thread safe, the inode must be locked by the caller
+     */
+    void FuseLFSWriteBuffer::remove_write_buffer(fuse_ino_t ino) {
+        lock_guard<pthread_rwlock_t> guard(write_buffer_lck, true);
+
+        auto it = write_buffer_map.find(ino);
+        if(it == write_buffer_map.end())
+            return;
+
+        for(auto &sector : it->second.sectors)
+            sector_slab::release(sector.second.data);
+
+        write_buffer_sectors -= it->second.sectors.size();
+        write_buffer_map.erase(it);
+    }
+}
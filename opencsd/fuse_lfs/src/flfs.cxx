@@ -30,7 +30,15 @@ namespace qemucsd::fuse_lfs {
     FuseLFS::FuseLFS(arguments::options *options,
         nvme_zns::NvmeZnsBackend *nvme) : FuseLFSCSD(options, nvme),
         nvme_info({0}), cblock_pos({0, 0, 0, 0}), random_pos({0, 0, 0, 0}),
-        random_ptr({0, 0, 0, 0}), log_pos({0, 0, 0, 0}), log_ptr({0, 0, 0, 0})
+        random_ptr({0, 0, 0, 0}), log_pos({0, 0, 0, 0}), log_heads(),
+        log_head_lbas(), log_zone_next(LOGZ_POS.zone),
+        log_streams(N_LOG_STREAMS), log_heads_active(1),
+        log_classifier(default_log_classifier), data_blocks_dirty(0),
+        writeback_dirty_bytes(options->flfs_dirty_bytes),
+        writeback_dirty_inodes(options->flfs_dirty_inodes),
+        writeback_dirty_expire(options->flfs_dirty_expire),
+        writeback_running(false), writeback_failed(false),
+        writeback_cursor(0), dirty_since(0)
     {
         this->options = options;
 
@@ -42,6 +50,7 @@ namespace qemucsd::fuse_lfs {
         this->ino_ptr = 0;
 
         rwlock_init(&gl, &gl_attr, "global");
+        rwlock_init(&cblock_lck, &cblock_attr, "checkpoint");
 
         this->path_inode_map = new path_inode_map_t();
 
@@ -51,7 +60,9 @@ namespace qemucsd::fuse_lfs {
     }
 
     FuseLFS::~FuseLFS() {
+        stop_writeback();
 
+        rwlock_destroy(&cblock_lck, &cblock_attr, "checkpoint");
         rwlock_destroy(&gl, &gl_attr, "global");
 
         delete this->data_blocks;
@@ -248,7 +259,8 @@ namespace qemucsd::fuse_lfs {
         position_to_lba(LOGZ_POS, logz_lba);
 
         uint64_t res_sector;
-        struct checkpoint_block cblock = {randz_lba, logz_lba};
+        struct checkpoint_block cblock = {randz_lba, logz_lba, randz_lba,
+                                          LOGZ_POS.zone, 2};
         if(nvme->append(CBLOCK_POS.zone, res_sector, CBLOCK_POS.offset,
                         &cblock, sizeof(cblock)) != 0) {
             output.error("Failed to write checkpoint block, check",
@@ -272,10 +284,12 @@ namespace qemucsd::fuse_lfs {
 
     /**
      * Write the new start of the random zone and log zone to the new
-     * checkpoint block
+     * checkpoint block together with the current random_ptr, log heads and
+     * ino_ptr so mounting can roll forward from them.
      * @return 0 upon success, < 0 upon failure
      */
     int FuseLFS::update_checkpointblock(uint64_t randz_lba, uint64_t logz_lba) {
+        const lock_guard<pthread_rwlock_t> lock(cblock_lck, true);
         struct data_position tmp_cblock_pos = cblock_pos;
 
         // cblock_pos not set yet, somehow update is called before mkfs() or
@@ -301,6 +315,15 @@ namespace qemucsd::fuse_lfs {
 
         uint64_t res_sector;
         struct checkpoint_block cblock = {randz_lba, logz_lba};
+        if(random_ptr.valid())
+            position_to_lba(random_ptr, cblock.randz_ptr);
+        cblock.log_zone_next = log_zone_next;
+        cblock.ino_ptr = ino_ptr;
+        for(uint32_t i = 0; i < N_LOG_STREAMS; i++) {
+            for(uint32_t j = 0; j < N_LOG_HEADS; j++)
+                cblock.log_heads[i][j] = log_head_lbas[i][j].load();
+        }
+
         if(nvme->append(tmp_cblock_pos.zone, res_sector, tmp_cblock_pos.offset,
                         &cblock, tmp_cblock_pos.size) != 0)
             return FLFS_RET_ERR;
@@ -350,6 +373,32 @@ namespace qemucsd::fuse_lfs {
         // Random zone could never start at absolute index limit of drive.
         tmp_cblock.randz_lba = UINT64_MAX;
 
+        // The write pointers identify the last checkpoint without scanning,
+        // a second zone that is written while the first is full indicates
+        // power loss before the first zone was reset.
+        std::vector<uint64_t> write_pointers;
+        if(fetch_write_pointers(write_pointers) == FLFS_RET_NONE) {
+            uint64_t first = write_pointers[CBLOCK_POS.zone];
+            uint64_t second = write_pointers[CBLOCK_POS.zone + 1];
+            if(first != 0 && (first < nvme_info.zone_capacity || second == 0))
+                tmp_cblock_pos = {CBLOCK_POS.zone, first - 1, 0,
+                                  CBLOCK_POS.size};
+            else if(second != 0)
+                tmp_cblock_pos = {CBLOCK_POS.zone + 1,
+                                  first != 0 ? 0 : second - 1, 0,
+                                  CBLOCK_POS.size};
+            else
+                return FLFS_RET_ERR;
+
+            if(nvme->read(tmp_cblock_pos.zone, tmp_cblock_pos.sector,
+                          CBLOCK_POS.offset, &tmp_cblock, sizeof(cblock)) != 0)
+                return FLFS_RET_ERR;
+
+            cblock_pos = tmp_cblock_pos;
+            cblock = tmp_cblock;
+            return FLFS_RET_NONE;
+        }
+
         // Checkpoints on first zone
         if(nvme->read(CBLOCK_POS.zone, CBLOCK_POS.sector, CBLOCK_POS.offset,
                       &tmp_cblock, sizeof(cblock)) == 0)
@@ -399,6 +448,29 @@ namespace qemucsd::fuse_lfs {
         return FLFS_RET_NONE;
     }
 
+    /**
+     * Retrieve the write pointer of every zone with a single zone report
+     * instead of probing each sector of the drive.
+     * @threadsafety: single thread, only called during initialization
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR if the backend does not
+     *         support reporting zones
+     */
+    int FuseLFS::fetch_write_pointers(std::vector<uint64_t> &write_pointers) {
+        std::vector<nvme_zns::nvme_zns_zone_desc> descs(nvme_info.num_zones);
+        uint64_t count = nvme_info.num_zones;
+
+        if(nvme->report_zones(0, descs.data(), count) != 0 ||
+           count != nvme_info.num_zones)
+            return FLFS_RET_ERR;
+
+        write_pointers.resize(count);
+        for(uint64_t i = 0; i < count; i++) {
+            write_pointers[i] = descs[i].write_pointer;
+        }
+
+        return FLFS_RET_NONE;
+    }
+
     /**
      * Add an inode to the nat_set to be processed on next flush
      */
@@ -417,6 +489,19 @@ namespace qemucsd::fuse_lfs {
      *         FLFS_RET_RANDZ_FULL if the random zone is full
      */
     int FuseLFS::determine_random_ptr() {
+        return determine_random_ptr(0);
+    }
+
+    /**
+     * Find and set random_ptr rolling forward from from_lba, the random_ptr
+     * recorded in the last checkpoint block. Only the sectors written after
+     * the checkpoint are probed. Starts from random_pos if from_lba is zero
+     * or does not follow written sectors.
+     * @threadsafety: single thread, only called during initialization
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure and
+     *         FLFS_RET_RANDZ_FULL if the random zone is full
+     */
+    int FuseLFS::determine_random_ptr(uint64_t from_lba) {
         struct data_position end_pos = random_pos;
         struct data_position current_pos = random_pos;
 
@@ -435,9 +520,39 @@ namespace qemucsd::fuse_lfs {
             end_pos.sector = nvme_info.zone_capacity -1;
         }
 
+        // Fall back to probing sectors if write pointers can not be reported
+        std::vector<uint64_t> write_pointers;
+        bool reported = fetch_write_pointers(write_pointers) == FLFS_RET_NONE;
+
         std::array<uint8_t, sizeof(none_block)> data{0};
+
+        // Sectors before the recorded random_ptr were written at checkpoint
+        // time, verify this still holds for the directly preceding sector.
+        struct data_position from_pos = random_pos;
+        lba_to_position(from_lba, from_pos);
+        if(from_lba != 0 && from_pos.zone >= RANDZ_POS.zone &&
+           from_pos.zone < RANDZ_BUFF_POS.zone && from_pos != random_pos)
+        {
+            struct data_position prev_pos = from_pos;
+            if(prev_pos.sector != 0)
+                prev_pos.sector -= 1;
+            else {
+                prev_pos.zone = prev_pos.zone == RANDZ_POS.zone ?
+                    RANDZ_BUFF_POS.zone - 1 : prev_pos.zone - 1;
+                prev_pos.sector = nvme_info.zone_capacity - 1;
+            }
+
+            if(nvme->read(prev_pos.zone, prev_pos.sector, 0, data.data(),
+                          sizeof(none_block)) == 0)
+                current_pos = from_pos;
+        }
+
         while(current_pos != end_pos) {
-            if(nvme->read(current_pos.zone, current_pos.sector,
+            if(reported) {
+                if(current_pos.sector >= write_pointers[current_pos.zone])
+                    break;
+            }
+            else if(nvme->read(current_pos.zone, current_pos.sector,
                        current_pos.offset, data.data(),
                        sizeof(none_block)) != 0)
                 break;
@@ -481,46 +596,93 @@ namespace qemucsd::fuse_lfs {
     }
 
     /**
-     * Read the entire random zone and reconstruct the inode_lba map. Can only
-     * be called after random_pos has been restored from checkpoint blocks.
-     * This function is only performed during initialization.
-     * @threadsafety: single threaded
-     * TODO(Dantali0n): Process and reconstruct SIT map.
+     * Read the random zone blocks at lbas MOUNT_READ_SECTORS at a time and
+     * apply the NAT blocks among them to the inode_map in order. Every
+     * encountered inode is added to found unless it is a nullptr.
+     * @threadsafety: single threaded, only called during initialization
+     * @param partial stop at the first unwritten sector instead of failing
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure
      */
-    void FuseLFS::read_random_zone(inode_lba_map_t *inode_map) {
-        auto current_pos = random_pos;
-        struct none_block nt_blk = {0};
+    int FuseLFS::read_nat_blocks(const std::vector<uint64_t> &lbas,
+        inode_lba_map_t *inode_map, nat_update_set_t *found, bool partial)
+    {
+        std::vector<struct none_block> blocks(
+            flfs_min(lbas.size(), MOUNT_READ_SECTORS));
 
-        // Go through all positions in the random zone
-        do {
-            // Stop reading after first unreadable sector
-            if(nvme->read(current_pos.zone, current_pos.sector,
-                          current_pos.offset, &nt_blk, sizeof(nt_blk)) != 0)
-                break;
+        for(uint64_t i = 0; i < lbas.size(); i += MOUNT_READ_SECTORS) {
+            std::vector<uint64_t> chunk(lbas.begin() + i, lbas.begin() +
+                flfs_min(i + MOUNT_READ_SECTORS, lbas.size()));
 
-            // Type is nat_block
-            if(nt_blk.type == RANDZ_NAT_BLK) {
-                auto nat_blk = reinterpret_cast<nat_block *>(&nt_blk);
+            // Fall back to single sectors to find the end of written data
+            uint64_t count = chunk.size();
+            if(read_sectors(chunk, blocks.data()) != FLFS_RET_NONE) {
+                if(!partial)
+                    return FLFS_RET_ERR;
 
-                for(uint32_t i = 0; i < NAT_BLK_INO_LBA_NUM; i++) {
-                    if(nat_blk->inode[i] == 0)
+                for(count = 0; count < chunk.size(); count++) {
+                    if(read_sectors({chunk.at(count)}, &blocks.at(count)) !=
+                       FLFS_RET_NONE)
                         break;
+                }
+            }
 
-                    uint64_t inode = nat_blk->inode[i];
+            for(uint64_t j = 0; j < count; j++) {
+                if(blocks.at(j).type != RANDZ_NAT_BLK)
+                    continue;
+
+                auto nat_blk = reinterpret_cast<nat_block *>(&blocks.at(j));
+                for(uint32_t k = 0; k < NAT_BLK_INO_LBA_NUM; k++) {
+                    if(nat_blk->inode[k] == 0)
+                        break;
 
-                    struct lba_inode cur_lba;
+                    uint64_t inode = nat_blk->inode[k];
+
+                    // Every inode requires its own lock object
+                    struct lba_inode cur_lba =
+                        {0, 0, std::make_shared<std::shared_mutex>()};
 
                     auto it = inode_map->find(inode);
                     if(it != inode_map->end())
                         cur_lba = it->second;
 
-                    cur_lba.lba = nat_blk->lba[i];
+                    cur_lba.lba = nat_blk->lba[k];
 
                     inode_map->insert_or_assign(inode, cur_lba);
+                    if(found != nullptr)
+                        found->insert(inode);
                 }
             }
             // TODO(Dantali0n): Process SIT blocks.
 
+            if(count != chunk.size())
+                break;
+        }
+
+        return FLFS_RET_NONE;
+    }
+
+    /**
+     * Read the random zone from random_pos up to random_ptr and reconstruct
+     * the inode_lba map. Can only be called after random_pos and random_ptr
+     * have been restored. The entire random zone is read if it is full.
+     * This function is only performed during initialization.
+     * @threadsafety: single threaded
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure
+     * TODO(Dantali0n): Process and reconstruct SIT map.
+     */
+    int FuseLFS::read_random_zone(inode_lba_map_t *inode_map) {
+        auto current_pos = random_pos;
+        std::vector<uint64_t> lbas;
+
+        // Go through all written positions in the random zone
+        do {
+            if(random_ptr.valid() && current_pos == random_ptr)
+                break;
+
+            uint64_t lba;
+            position_to_lba(current_pos, lba);
+            lbas.push_back(lba);
+
             current_pos.sector += 1;
 
             // Reached end of sectors in current zone, advance zone
@@ -534,6 +696,61 @@ namespace qemucsd::fuse_lfs {
                 current_pos.zone = RANDZ_POS.zone;
 
         } while(current_pos != random_pos);
+
+        return read_nat_blocks(lbas, inode_map, nullptr, !random_ptr.valid());
+    }
+
+    /**
+     * Recover from a random zone rewrite interrupted by power loss. NAT
+     * blocks left in the random buffer are applied to the inode_lba_map
+     * before the random zone is read so newer entries take precedence. Their
+     * inodes are added to nat_set to be appended to the random zone again
+     * after which the buffer is erased. If the zones at random_pos were
+     * already reset random_pos is advanced past them as the rewrite would
+     * have.
+     * @threadsafety: single threaded, only called during initialization
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure
+     */
+    int FuseLFS::recover_random_buffer(nat_update_set_t *nat_set) {
+        struct none_block nt_blk = {0};
+        if(nvme->read(RANDZ_BUFF_POS.zone, 0, 0, &nt_blk,
+                      sizeof(none_block)) != 0)
+            return FLFS_RET_NONE;
+
+        output.warning("Random zone rewrite interrupted, restoring random ",
+                       "buffer..");
+
+        std::vector<uint64_t> lbas;
+        struct data_position pos = RANDZ_BUFF_POS;
+        for(uint32_t i = 0; i < N_RAND_BUFF_ZONES; i++) {
+            for(uint64_t j = 0; j < nvme_info.zone_capacity; j++) {
+                uint64_t lba;
+                pos.zone = RANDZ_BUFF_POS.zone + i;
+                pos.sector = j;
+                position_to_lba(pos, lba);
+                lbas.push_back(lba);
+            }
+        }
+
+        if(read_nat_blocks(lbas, &inode_lba_map, nat_set, true) !=
+           FLFS_RET_NONE)
+            return FLFS_RET_ERR;
+
+        // The buffered zones are reset before the checkpoint is updated
+        if(nvme->read(random_pos.zone, 0, 0, &nt_blk,
+                      sizeof(none_block)) != 0)
+        {
+            if(nvme->reset(random_pos.zone + 1) != 0)
+                return FLFS_RET_ERR;
+
+            random_pos.zone += 2;
+            if(random_pos.zone > RANDZ_BUFF_POS.zone)
+                random_pos.zone = RANDZ_POS.zone + 1;
+            else if(random_pos.zone == RANDZ_BUFF_POS.zone)
+                random_pos.zone = RANDZ_POS.zone;
+        }
+
+        return erase_random_buffer();
     }
 
     /**
@@ -571,18 +788,50 @@ namespace qemucsd::fuse_lfs {
         }
     }
 
+    /**
+     * Reserve a sector at random_ptr for a random zone block and advance the
+     * random_ptr. The block must be appended to zone but the device decides
+     * the sector, random zone blocks are found by reading the random zone
+     * linearly so only the amount of reserved space matters. random_pos is
+     * taken into account to identify if we are out of random zone space.
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR if no space is left,
+     *         FLFS_RET_RANDZ_FULL when this reserved the last sector.
+     */
+    int FuseLFS::reserve_random_block(uint64_t &zone) {
+        if(!random_ptr.valid())
+            return FLFS_RET_ERR;
+
+        zone = random_ptr.zone;
+        random_ptr.sector += 1;
+
+        // Current zone full, find next zone
+        if(random_ptr.sector == nvme_info.zone_capacity) {
+            random_ptr.zone += 1;
+            random_ptr.sector = 0;
+
+            // If reached RAND_BUFF_POS overflow to RANDZ_POS
+            if(random_ptr.zone == RANDZ_BUFF_POS.zone)
+                random_ptr.zone = RANDZ_POS.zone;
+
+            // Out of random zone space!
+            if(random_ptr.zone == random_pos.zone) {
+                // Invalidate the random_ptr
+                random_ptr.size = 0;
+                return FLFS_RET_RANDZ_FULL;
+            }
+        }
+
+        return FLFS_RET_NONE;
+    }
+
     /**
      * Take whatever random zone block was given and append it to the random
-     * zone. The location depends on random_ptr which is advanced after a
-     * successful append. random_pos is taken into account to identify if we
-     * are out of random zone space.
+     * zone. The space is reserved through reserve_random_block.
      *
      * @return FLFS_RET_NONE upon success, < FLFS_RET_ERR upon failure,
      *         FLFS_RET_RANDZ_FULL when random zone full.
      */
     int FuseLFS::append_random_block(struct rand_block_base &block) {
-        struct data_position tmp_random_ptr = random_ptr;
-
         #ifdef QEMUCSD_DEBUG
         // Should always be valid after initialization, set by
         // determine_random_ptr
@@ -599,40 +848,16 @@ namespace qemucsd::fuse_lfs {
         if(block.type == RANDZ_NON_BLK)
             return FLFS_RET_ERR;
 
-        uint64_t res_sector;
-        if(nvme->append(tmp_random_ptr.zone, res_sector, tmp_random_ptr.offset,
-                        &block,sizeof(none_block)) != 0)
-            return FLFS_RET_ERR;
+        uint64_t zone;
+        int result = reserve_random_block(zone);
+        if(result < FLFS_RET_NONE)
+            return result;
 
-        // Check that the append was written to the right location
-        if(res_sector != tmp_random_ptr.sector)
+        uint64_t res_sector;
+        if(nvme->append(zone, res_sector, 0, &block, sizeof(none_block)) != 0)
             return FLFS_RET_ERR;
 
-        // Advance the sector
-        tmp_random_ptr.sector += 1;
-
-        // Current zone full, find next zone
-        if(res_sector + 1 == nvme_info.zone_capacity) {
-            tmp_random_ptr.zone += 1;
-            tmp_random_ptr.sector = 0;
-
-            // If reached RAND_BUFF_POS overflow to RANDZ_POS
-            if (tmp_random_ptr.zone == RANDZ_BUFF_POS.zone)
-                tmp_random_ptr.zone = RANDZ_POS.zone;
-
-            // Out of random zone space!
-            if (tmp_random_ptr.zone == random_pos.zone) {
-                //if(rewrite_random_blocks() != FLFS_RET_NONE)
-
-                // Invalidate the random_ptr
-                random_ptr.size = 0;
-                return FLFS_RET_RANDZ_FULL;
-            }
-        }
-
-        random_ptr = tmp_random_ptr;
-
-        return FLFS_RET_NONE;
+        return result;
     }
 
     /**
@@ -655,28 +880,49 @@ namespace qemucsd::fuse_lfs {
      *         FLFS_RET_RANDZ_FULL when random zone full.
      */
     int FuseLFS::update_nat_blocks(nat_update_set_t *nat_set) {
-        int ret = 0;
+        int ret = FLFS_RET_NONE;
+
+        uint64_t num_blocks;
+        compute_nat_blocks(nat_set, num_blocks);
+        std::vector<struct nat_block> blocks(num_blocks);
 
-        // Create an instance of each random zone block type
-        struct nat_block nt_blk = {0};
+        // Every inode is in a single block so blocks may complete in any order
+        // and are all appended simultaneously.
+        struct nvme_zns::nvme_zns_batch batch;
+        for(auto &nt_blk : blocks) {
+            if(nat_set->empty() || ret != FLFS_RET_NONE) break;
+
+            if(!random_ptr.valid()) {
+                ret = FLFS_RET_RANDZ_FULL;
+                break;
+            }
 
-        while(!nat_set->empty()) {
             nt_blk.type = RANDZ_NAT_BLK;
             fill_nat_block(nat_set, nt_blk);
             if(nt_blk.inode[0] == 0) break;
 
-            // Error code of append random block might signal lack of space
-            ret = append_random_block(nt_blk);
-            if(ret != FLFS_RET_NONE) return ret;
+            // Error code of reserve random block might signal lack of space
+            uint64_t zone;
+            ret = reserve_random_block(zone);
+            if(ret < FLFS_RET_NONE) break;
 
-            memset(&nt_blk, 0, sizeof(nat_block));
+            if(nvme->submit_append(zone, 0, &nt_blk, sizeof(nat_block),
+                                   batch.track()) != 0)
+            {
+                batch.fail();
+                break;
+            }
         }
 
-        return FLFS_RET_NONE;
+        if(nvme->wait(&batch) != 0)
+            return FLFS_RET_ERR;
+
+        return ret;
     }
 
     /**
-     * Buffer the two zones into the random buffer
+     * Buffer the two zones into the random buffer, the data is copied on the
+     * device and never transferred to the host.
      * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure
      */
     int FuseLFS::buffer_random_blocks(
@@ -688,32 +934,27 @@ namespace qemucsd::fuse_lfs {
         if(zones[1] >= RANDZ_BUFF_POS.zone || zones[1] < RANDZ_POS.zone)
             return FLFS_RET_ERR;
 
-        uint64_t res_sector;
-        uint64_t sector_size = nvme_info.sector_size;
-        auto data = (uint8_t*) malloc(sector_size);
-
         for(uint64_t j = 0; j < 2; j++) {
-            uint64_t zone = zones[j];
-            for (uint64_t i = 0; i < nvme_info.zone_capacity; i++) {
-                if(limit.meets_limit(zone, i))
-                    goto buff_rand_blk_none;
-                if (nvme->read(zone, i, 0, data, sector_size) != 0)
-                    goto buff_rand_blk_err;
-                if (nvme->append(RANDZ_BUFF_POS.zone + j, res_sector, 0,
-                                 data, sector_size) != 0)
-                    goto buff_rand_blk_err;
-                if(res_sector != i)
-                    goto buff_rand_blk_err;
+            struct nvme_zns::nvme_zns_copy_range range = {zones[j], 0, 0};
+            while(range.sectors < nvme_info.zone_capacity &&
+                  !limit.meets_limit(zones[j], range.sectors))
+                range.sectors += 1;
+
+            if(range.sectors != 0) {
+                uint64_t res_sector;
+                if(nvme->copy(&range, 1, RANDZ_BUFF_POS.zone + j, res_sector)
+                   != 0)
+                    return FLFS_RET_ERR;
+                if(res_sector != 0)
+                    return FLFS_RET_ERR;
             }
+
+            // Nothing beyond the limit is buffered
+            if(range.sectors != nvme_info.zone_capacity)
+                break;
         }
 
-        buff_rand_blk_none:
-        free(data);
         return FLFS_RET_NONE;
-
-        buff_rand_blk_err:
-        free(data);
-        return FLFS_RET_ERR;
     }
 
     /**
@@ -893,7 +1134,7 @@ namespace qemucsd::fuse_lfs {
             // TODO(Dantali0n): SIT blocks
 
             // Worst case, Zones must be entirely rewritten no extra free space
-            // claimed. This will cause append_random_block to return
+            // claimed. This will cause reserve_random_block to return
             // FLFS_RET_RANDZ_FULL which is propagated by update_nat_blocks.
             // This in turn changes what return code we should consider as
             // error.
@@ -921,80 +1162,558 @@ namespace qemucsd::fuse_lfs {
     }
 
     /**
-     * Increment the log zone pointer and detect when the log zone is full
-     * TODO(Dantali0n): Respect N_LOG_BUFF_ZONES
-     * @return FLFS_RET_NONE upon success, FLFS_RET_LOGZ_FULL if log zone full
+     * Default placement of appended data. Metadata is rewritten on every
+     * change and small buffered writes are likely to be overwritten soon
+     * while large writes are expected to remain valid for longer.
+     */
+    enum log_stream FuseLFS::default_log_classifier(enum log_data_type type,
+        fuse_ino_t ino)
+    {
+        switch(type) {
+            case LOG_DATA_INODE_BLOCK:
+            case LOG_DATA_DATA_BLOCK:
+                return LOG_STREAM_HOT_META;
+            case LOG_DATA_BUFFERED:
+                return LOG_STREAM_HOT_DATA;
+            case LOG_DATA_DIRECT:
+                return LOG_STREAM_COLD_DATA;
+            case LOG_DATA_RELOCATED:
+                return LOG_STREAM_GC;
+        }
+
+        return LOG_STREAM_HOT_META;
+    }
+
+    /**
+     * Replace the classifier that decides the log stream of appended data.
+     * @threadsafety: single threaded
+     */
+    void FuseLFS::set_log_classifier(log_classifier_t classifier) {
+        log_classifier = std::move(classifier);
+    }
+
+    /**
+     * Determine the log stream for data of the given type, invalid streams
+     * returned by the classifier are placed in the hot metadata stream.
      */
-    int FuseLFS::advance_log_ptr(struct data_position *log_ptr) const {
-        log_ptr->sector += 1;
-        if(log_ptr->sector == nvme_info.zone_capacity) {
-            log_ptr->sector = 0;
-            log_ptr->zone += 1;
+    enum log_stream FuseLFS::classify_log(enum log_data_type type,
+        fuse_ino_t ino)
+    {
+        auto stream = log_classifier(type, ino);
+        if(stream >= N_LOG_STREAMS)
+            return LOG_STREAM_HOT_META;
+
+        return stream;
+    }
+
+    /**
+     * Index of the head the calling thread appends through, threads are
+     * assigned a head round robin the first time they append.
+     * @threadsafety: thread safe
+     */
+    uint32_t FuseLFS::log_head_index() const {
+        static std::atomic<uint32_t> next_index(0);
+        thread_local uint32_t index = next_index.fetch_add(1);
+        return index % log_heads_active;
+    }
+
+    /**
+     * Lock the head of the calling thread for the stream and ensure it has a
+     * zone. Streams are mapped onto the streams that can be open
+     * simultaneously. Once no unclaimed log zones remain any head with space
+     * left is used instead. Release the head with release_log_head.
+     * @threadsafety: thread safe
+     * @return FLFS_RET_NONE upon success with the head locked, FLFS_RET_ERR
+     *         upon failure and FLFS_RET_LOGZ_FULL if no head has space left.
+     */
+    int FuseLFS::acquire_log_head(enum log_stream &stream, uint32_t &head) {
+        if(stream >= log_streams)
+            stream = (enum log_stream) (log_streams - 1);
+        head = log_head_index();
+
+        log_heads[stream][head].l.lock();
+        if(log_heads[stream][head].ptr.valid())
+            return FLFS_RET_NONE;
+
+        int result = claim_log_zone(stream, head);
+        if(result == FLFS_RET_NONE)
+            return result;
+
+        log_heads[stream][head].l.unlock();
+        if(result != FLFS_RET_LOGZ_FULL)
+            return result;
+
+        for(uint32_t i = 0; i < log_streams; i++) {
+            for(uint32_t j = 0; j < log_heads_active; j++) {
+                log_heads[i][j].l.lock();
+                if(log_heads[i][j].ptr.valid()) {
+                    stream = (enum log_stream) i;
+                    head = j;
+                    return FLFS_RET_NONE;
+                }
+                log_heads[i][j].l.unlock();
+            }
         }
 
+        return FLFS_RET_LOGZ_FULL;
+    }
+
+    void FuseLFS::release_log_head(enum log_stream stream, uint32_t head) {
+        log_heads[stream][head].l.unlock();
+    }
+
+    /**
+     * Claim the next unclaimed log zone for the head and persist it in the
+     * checkpoint block so the write pointer survives a remount. Zones are
+     * handed out without locking so heads claim zones independently.
+     * TODO(Dantali0n): Respect N_LOG_BUFF_ZONES
+     * @threadsafety: Ensure the head is locked by the caller
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure and
+     *         FLFS_RET_LOGZ_FULL if no unclaimed log zone remains.
+     */
+    int FuseLFS::claim_log_zone(enum log_stream stream, uint32_t head) {
+        struct data_position &ptr = log_heads[stream][head].ptr;
+
         // Log zone full, invalidate the log pointer
-        if(log_ptr->zone == nvme_info.num_zones) {
-            log_ptr->size = 0;
+        uint64_t zone = log_zone_next.fetch_add(1);
+        if(zone >= nvme_info.num_zones) {
+            ptr.size = 0;
+            log_head_lbas[stream][head] = 0;
             return FLFS_RET_LOGZ_FULL;
         }
 
+        ptr = {zone, 0, 0, SECTOR_SIZE};
+
+        uint64_t head_lba;
+        position_to_lba(ptr, head_lba);
+        log_head_lbas[stream][head] = head_lba;
+
+        uint64_t randz_lba;
+        uint64_t logz_lba;
+        position_to_lba(random_pos, randz_lba);
+        position_to_lba(log_pos, logz_lba);
+        if(update_checkpointblock(randz_lba, logz_lba) != FLFS_RET_NONE) {
+            ptr.size = 0;
+            return FLFS_RET_ERR;
+        }
+
+        return FLFS_RET_NONE;
+    }
+
+    /**
+     * Reserve sectors in the zone of the head by incrementing its write
+     * pointer and claim a new zone once the current one is fully reserved.
+     * The number of sectors must fit in the remainder of the zone.
+     * @threadsafety: Ensure the head is locked by the caller
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure and
+     *         FLFS_RET_LOGZ_FULL if log zone full
+     */
+    int FuseLFS::advance_log_ptr(enum log_stream stream, uint32_t head,
+        uint64_t sectors)
+    {
+        struct data_position &ptr = log_heads[stream][head].ptr;
+        ptr.sector += sectors;
+        if(ptr.sector < nvme_info.zone_capacity)
+            return FLFS_RET_NONE;
+
+        return claim_log_zone(stream, head);
+    }
+
+    /**
+     * Find the write pointer of the zone by reading sectors, written sectors
+     * always form a prefix of the zone so a binary search suffices.
+     * @threadsafety: thread safe
+     * @param buffer sector sized buffer to read into
+     * @return number of written sectors in the zone
+     */
+    uint64_t FuseLFS::probe_write_pointer(uint64_t zone, void *buffer) {
+        if(nvme->read(zone, 0, 0, buffer, SECTOR_SIZE) != 0)
+            return 0;
+
+        uint64_t low = 1;
+        uint64_t high = nvme_info.zone_capacity;
+        while(low < high) {
+            uint64_t mid = low + (high - low) / 2;
+            if(nvme->read(zone, mid, 0, buffer, SECTOR_SIZE) == 0)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+
+        return low;
+    }
+
+    /**
+     * Restore the write pointer of every log head from the checkpoint block.
+     * Heads whose zone is full, or that never claimed a zone, claim a new zone
+     * upon their first append. Without zone reports only the zones of heads
+     * and those claimed after the checkpoint are probed.
+     * @threadsafety: single threaded
+     */
+    void FuseLFS::determine_log_ptr() {
+        // Leave room for the checkpoint and random zone, streams beyond the
+        // open zone limit share the zone of a lower stream. Remaining open
+        // zones are divided into heads, no more than there are cores.
+        uint32_t open_zones = UINT32_MAX;
+        if(nvme_info.max_open != 0) {
+            open_zones = 1;
+            if(nvme_info.max_open > LOG_RESERVED_OPEN)
+                open_zones = nvme_info.max_open - LOG_RESERVED_OPEN;
+        }
+
+        log_streams = flfs_min(N_LOG_STREAMS, open_zones);
+        log_heads_active = flfs_min(N_LOG_HEADS,
+            std::thread::hardware_concurrency());
+        log_heads_active = flfs_min(log_heads_active, open_zones / log_streams);
+        if(log_heads_active == 0)
+            log_heads_active = 1;
+
+        struct checkpoint_block cblock = {0};
+        get_checkpointblock(cblock);
+
+        // Zones claimed before the checkpoint can not be claimed again
+        uint64_t zone_next = flfs_min(cblock.log_zone_next,
+            nvme_info.num_zones);
+        if(zone_next < LOGZ_POS.zone)
+            zone_next = LOGZ_POS.zone;
+
+        std::vector<uint64_t> write_pointers;
+        if(fetch_write_pointers(write_pointers) != FLFS_RET_NONE) {
+            write_pointers.assign(nvme_info.num_zones, 0);
+
+            void* buff = sector_slab::alloc();
+            for(uint32_t i = 0; i < N_LOG_STREAMS; i++) {
+                for(uint32_t j = 0; j < N_LOG_HEADS; j++) {
+                    struct data_position head = LOGZ_POS;
+                    lba_to_position(cblock.log_heads[i][j], head);
+                    if(cblock.log_heads[i][j] != 0 &&
+                       head.zone >= LOGZ_POS.zone &&
+                       head.zone < nvme_info.num_zones)
+                        write_pointers[head.zone] =
+                            probe_write_pointer(head.zone, buff);
+                }
+            }
+
+            // Roll forward over zones claimed after the checkpoint
+            for(uint64_t i = zone_next; i < nvme_info.num_zones; i++) {
+                write_pointers[i] = probe_write_pointer(i, buff);
+                if(write_pointers[i] == 0)
+                    break;
+            }
+            sector_slab::release(buff);
+        }
+
+        // Zones that were written or claimed can not be claimed again
+        log_zone_next = zone_next;
+        for(uint64_t i = zone_next; i < nvme_info.num_zones; i++) {
+            if(write_pointers[i] != 0)
+                log_zone_next = i + 1;
+        }
+
+        for(uint32_t i = 0; i < N_LOG_STREAMS; i++) {
+            for(uint32_t j = 0; j < N_LOG_HEADS; j++) {
+                log_heads[i][j].ptr = {0, 0, 0, 0};
+                log_head_lbas[i][j] = 0;
+                if(cblock.log_heads[i][j] == 0) continue;
+
+                struct data_position head = {0};
+                lba_to_position(cblock.log_heads[i][j], head);
+                if(head.zone < LOGZ_POS.zone ||
+                   head.zone >= nvme_info.num_zones)
+                    continue;
+
+                if(head.zone >= log_zone_next)
+                    log_zone_next = head.zone + 1;
+
+                if(i >= log_streams || j >= log_heads_active ||
+                   write_pointers[head.zone] >= nvme_info.zone_capacity)
+                    continue;
+
+                log_heads[i][j].ptr = {head.zone, write_pointers[head.zone],
+                    0, SECTOR_SIZE};
+                log_head_lbas[i][j] = cblock.log_heads[i][j];
+            }
+        }
+    }
+
+    /**
+     * Read the inode_blocks referenced by the inode_lba_map and construct the
+     * path_inode_map as well as the parent of every inode. Blocks are read in
+     * order of their lba MOUNT_READ_SECTORS at a time so consecutive blocks
+     * are coalesced into a single read.
+     * @threadsafety: single threaded, only called during initialization
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure
+     */
+    int FuseLFS::build_path_inode_map() {
+        // Inodes grouped by the lba of the inode_block holding their entry
+        std::map<uint64_t, std::vector<fuse_ino_t>> block_inodes;
+        for(auto &ino : inode_lba_map) {
+            if(ino.second.lba != 0)
+                block_inodes[ino.second.lba].push_back(ino.first);
+        }
+
+        std::vector<struct inode_block> blocks(
+            flfs_min(block_inodes.size(), MOUNT_READ_SECTORS));
+        std::vector<uint64_t> lbas;
+
+        auto it = block_inodes.begin();
+        while(it != block_inodes.end()) {
+            auto first = it;
+            lbas.clear();
+            for(; it != block_inodes.end() &&
+                  lbas.size() < MOUNT_READ_SECTORS; it++)
+                lbas.push_back(it->first);
+
+            if(read_sectors(lbas, blocks.data()) != FLFS_RET_NONE) {
+                output.error("Failed to read ", lbas.size(), " inode blocks");
+                return FLFS_RET_ERR;
+            }
+
+            uint64_t i = 0;
+            for(auto block = first; block != it; block++, i++) {
+                for(auto &ino : block->second) {
+                    inode_entry_t entry;
+                    if(find_inode_block_entry(&blocks.at(i), ino, &entry) !=
+                       FLFS_RET_NONE)
+                    {
+                        output.error("Inode ", ino, " missing from inode ",
+                                     "block at lba ", block->first);
+                        return FLFS_RET_ERR;
+                    }
+
+                    fuse_ino_t parent_ino = entry.first.parent;
+                    inode_lba_map.at(ino).parent = parent_ino;
+
+                    auto parent = path_inode_map->find(parent_ino);
+                    if(parent == path_inode_map->end())
+                        parent = path_inode_map->insert(std::make_pair(
+                            parent_ino, new path_map_t())).first;
+                    parent->second->insert(std::make_pair(entry.second, ino));
+
+                    if(entry.first.type == INO_T_DIR &&
+                       path_inode_map->find(ino) == path_inode_map->end())
+                        path_inode_map->insert(std::make_pair(ino,
+                                                              new path_map_t()));
+                }
+            }
+        }
+
+        return FLFS_RET_NONE;
+    }
+
+    /**
+     * Flush a single sector of data to drive in the zone of the log stream
+     * and return the lba of the data. The sector is reserved in the zone of
+     * the head but the device decides its location, the lba is bound upon
+     * completion.
+     * @threadsafety: thread safe
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure and
+     *         FLFS_RET_LOGZ_FULL if the log zone is full.
+     */
+    int FuseLFS::log_append(void *data, size_t size, uint64_t &lba,
+        enum log_stream stream)
+    {
+        if(size != SECTOR_SIZE)
+            return FLFS_RET_ERR;
+
+        uint32_t head;
+        int result = acquire_log_head(stream, head);
+        if(result != FLFS_RET_NONE)
+            return result;
+
+        uint64_t zone = log_heads[stream][head].ptr.zone;
+        result = advance_log_ptr(stream, head);
+        release_log_head(stream, head);
+
+        uint64_t res_sector;
+        if(nvme->append(zone, res_sector, 0, data, size) != 0)
+            return FLFS_RET_ERR;
+
+        // Update caller lba to indicate location chosen by the device
+        position_to_lba({zone, res_sector, 0, SECTOR_SIZE}, lba);
+
+        return result;
+    }
+
+    /**
+     * Flush multiple sectors of data to drive in the zone of the log stream
+     * and return the lba of every sector. Space is reserved in the zone of the
+     * head after which the head is released. A single append is submitted per
+     * log zone the data spans and all appends are in flight simultaneously,
+     * also with those of other threads sharing the head. The lbas are bound
+     * to the sectors returned upon completion.
+     * @threadsafety: thread safe
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure and
+     *         FLFS_RET_LOGZ_FULL if the log zone is full.
+     */
+    int FuseLFS::log_append(void *data, size_t size,
+        std::vector<uint64_t> &lbas, enum log_stream stream)
+    {
+        if(size == 0 || size % SECTOR_SIZE != 0)
+            return FLFS_RET_ERR;
+
+        uint32_t head;
+        int result = acquire_log_head(stream, head);
+        if(result != FLFS_RET_NONE)
+            return result;
+
+        // Zone, number of sectors and resulting sector of every append
+        struct log_range {
+            uint64_t zone;
+            uint64_t count;
+            uint64_t sector;
+        };
+        std::vector<struct log_range> ranges;
+
+        struct data_position &log_ptr = log_heads[stream][head].ptr;
+        uint64_t num_sectors = size / SECTOR_SIZE;
+        uint64_t done = 0;
+        while(done < num_sectors) {
+            // Log zone filled up before all sectors were reserved
+            if(!log_ptr.valid())
+                break;
+
+            // Reserve as many sectors as fit in the current zone
+            uint64_t count = flfs_min(num_sectors - done,
+                nvme_info.zone_capacity - log_ptr.sector);
+            ranges.push_back({log_ptr.zone, count, 0});
+            result = advance_log_ptr(stream, head, count);
+
+            done += count;
+        }
+
+        release_log_head(stream, head);
+
+        struct nvme_zns::nvme_zns_batch batch;
+        uint8_t *ptr = (uint8_t*) data;
+        for(auto &range : ranges) {
+            auto callback = batch.track();
+            if(nvme->submit_append(range.zone, 0, ptr,
+                range.count * SECTOR_SIZE,
+                [callback, &range](int res, uint64_t sector) {
+                    range.sector = sector;
+                    callback(res, sector);
+                }) != 0)
+            {
+                batch.fail();
+                break;
+            }
+
+            ptr += range.count * SECTOR_SIZE;
+        }
+
+        if(nvme->wait(&batch) != 0)
+            return FLFS_RET_ERR;
+
+        // Update caller lbas to indicate locations chosen by the device
+        for(auto &range : ranges) {
+            for(uint64_t i = 0; i < range.count; i++) {
+                uint64_t lba;
+                position_to_lba({range.zone, range.sector + i, 0, SECTOR_SIZE},
+                    lba);
+                lbas.push_back(lba);
+            }
+        }
+
+        return result;
+    }
+
+    /**
+     * Convert the lbas into ranges that are read linearly into buffer,
+     * consecutive lbas are coalesced into a single range.
+     */
+    void FuseLFS::lbas_to_iovec(const std::vector<uint64_t> &lbas,
+        void *buffer, std::vector<nvme_zns::nvme_zns_iovec> &iov)
+    {
+        struct data_position pos = {0};
+        for(uint64_t i = 0; i < lbas.size(); i++) {
+            lba_to_position(lbas.at(i), pos);
+
+            // Extend the previous range if this sector directly follows it
+            if(!iov.empty() && iov.back().zone == pos.zone &&
+               iov.back().sector + iov.back().size / SECTOR_SIZE == pos.sector)
+            {
+                iov.back().size += SECTOR_SIZE;
+                continue;
+            }
+
+            iov.push_back({pos.zone, pos.sector,
+                (uint8_t*) buffer + (i * SECTOR_SIZE), SECTOR_SIZE});
+        }
+    }
+
+    /**
+     * Read the sectors at the given lbas linearly into buffer. Consecutive
+     * lbas are coalesced and every resulting range is submitted as a separate
+     * read so they can be served concurrently.
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure
+     */
+    int FuseLFS::read_sectors(const std::vector<uint64_t> &lbas, void *buffer)
+    {
+        std::vector<nvme_zns::nvme_zns_iovec> iov;
+        lbas_to_iovec(lbas, buffer, iov);
+
+        if(iov.empty()) return FLFS_RET_NONE;
+
+        struct nvme_zns::nvme_zns_batch batch;
+        for(auto &range : iov) {
+            if(nvme->submit_readv(&range, 1, batch.track()) != 0)
+                batch.fail();
+        }
+
+        if(nvme->wait(&batch) != 0)
+            return FLFS_RET_ERR;
+
         return FLFS_RET_NONE;
     }
 
     /**
-     * Find the location of the current log write pointer and adjust log_ptr
-     * accordingly.
+     * Asynchronously read the sectors of the inode covering size bytes at
+     * offset without waiting for completion. The data itself is discarded,
+     * read ahead relies on the sector cache in front of the device to serve
+     * subsequent reads. Completions are reaped by any later poll or wait on
+     * the device. Best effort, the range is silently truncated upon reaching
+     * the end of the file or a missing data_block.
+     * @threadsafety: Ensure the inode is locked while collecting the lbas.
      */
-    void FuseLFS::determine_log_ptr() {
-        struct data_position drive_end =
-            {nvme_info.num_zones, 0, 0, SECTOR_SIZE};
-        void* buff = malloc(SECTOR_SIZE);
-        log_ptr = LOGZ_POS;
-
-        do {
-            if(nvme->read(log_ptr.zone, log_ptr.sector, log_ptr.offset, buff,
-                          SECTOR_SIZE) != 0)
-                break;
-
-            advance_log_ptr(&log_ptr);
-        } while(log_ptr != drive_end);
+    void FuseLFS::read_ahead(struct inode_entry entry, uint64_t offset,
+        uint64_t size)
+    {
+        if(offset >= entry.size || size == 0) return;
+        size = flfs_min(size, entry.size - offset);
 
-        free(buff);
-    }
+        uint64_t sector = offset / SECTOR_SIZE;
+        uint64_t end = (offset + size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+        uint64_t db_block_num = sector / DATA_BLK_LBA_NUM;
 
-    /**
-     * Read the entire drive its log zone and construct the path_inode_map.
-     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure
-     */
-//    int FuseLFS::build_path_inode_map() {
-//
-//    }
+        std::vector<uint64_t> lbas;
+        auto blk = std::make_unique<struct data_block>();
+        if(get_data_block(entry, db_block_num, blk.get()) != FLFS_RET_NONE)
+            return;
 
-    /**
-     * Flush data to drive and return start lba of data. All data will be
-     * flushed linearly starting from lba.
-     * TODO(Dantali0n): Make nvme_zns backend support multi sector linear
-     *                  writes.
-     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure and
-     *         FLFS_RET_LOGZ_FULL if the log zone is full.
-     */
-    int FuseLFS::log_append(void *data, size_t size, uint64_t &lba) {
-        if(size != SECTOR_SIZE)
-            return FLFS_RET_ERR;
+        for(; sector < end; sector++) {
+            if(sector / DATA_BLK_LBA_NUM != db_block_num) {
+                db_block_num = sector / DATA_BLK_LBA_NUM;
+                if(get_data_block(entry, db_block_num, blk.get()) !=
+                   FLFS_RET_NONE)
+                    break;
+            }
 
-        uint64_t res_sector;
-        if(nvme->append(log_ptr.zone, res_sector, log_ptr.offset, data, size)
-           != 0)
-            return FLFS_RET_ERR;
+            uint64_t lba = blk->data_lbas[sector % DATA_BLK_LBA_NUM];
+            if(lba == 0) break;
+            lbas.push_back(lba);
+        }
 
-        // Verify append was written to expected location
-        if(log_ptr.sector != res_sector)
-            return FLFS_RET_ERR;
+        if(lbas.empty()) return;
 
-        // Update caller lba to indicate location
-        position_to_lba(log_ptr, lba);
+        // Buffer and ranges must remain valid until the read completes
+        auto buffer = std::shared_ptr<uint8_t[]>(
+            new uint8_t[lbas.size() * SECTOR_SIZE]);
+        auto iov = std::make_shared<std::vector<nvme_zns::nvme_zns_iovec>>();
+        lbas_to_iovec(lbas, buffer.get(), *iov);
 
-        return advance_log_ptr(&log_ptr);
+        nvme->submit_readv(iov->data(), iov->size(),
+            [buffer, iov](int result, uint64_t sector) {});
     }
 
     /**
@@ -1032,12 +1751,18 @@ namespace qemucsd::fuse_lfs {
         // Get the data_map from the data_blocks
         auto data_block_map = data_blocks->find(ino)->second;
 
-        // Now insert the new block ready for flush to drive
-        data_block_map->insert_or_assign(block_num, *blk);
+        // Now insert the new block ready for flush to drive. The block index
+        // remains valid as pending data_blocks take precedence over it and a
+        // rewritten chain on drive changes the data_lba it is keyed on.
+        if(data_block_map->insert_or_assign(block_num, *blk).second)
+            data_blocks_dirty += 1;
     }
 
     /**
-     * Get the data block for the given inode
+     * Get the data block for the given inode. Pending data_blocks in memory
+     * take precedence over those on drive. Data blocks on drive are located
+     * through the block index which is built with a single pass over the
+     * chain of data_blocks the first time it is required.
      * @param block_num zero indexed data_block block number
      * @return FLFS_RET_NONE upon success and FLFS_RET_ERR upon failure
      */
@@ -1046,9 +1771,6 @@ namespace qemucsd::fuse_lfs {
     {
         auto lookup = data_blocks->find(entry.inode);
 
-        if(lookup == data_blocks->end())
-            return FLFS_RET_ERR;
-
         // Found data blocks in synchronization data structure
         if(lookup != data_blocks->end()) {
             // Lookup if block_num is in data_blocks for the given inode
@@ -1061,16 +1783,53 @@ namespace qemucsd::fuse_lfs {
         }
 
         // Data blocks information not in memory must be retrieved from drive
+        uint64_t lba;
+        if(get_data_block_lba(entry, block_num, lba) != FLFS_RET_NONE)
+            return FLFS_RET_ERR;
+
         struct data_position pos = {0};
-        lba_to_position(entry.data_lba, pos);
+        lba_to_position(lba, pos);
+        return get_data_block_immediate(pos, blk);
+    }
 
-        // It might be faster just to call get_data_block_linked due to
-        // the pipeline stalls from branch mis predictions. Then again tight
-        // loop optimizations likely don't really apply to event based systems
-        // such as filesystems. Suppose we could do a couple of benchmarks with
-        // one or the other and see if it influences the results
-        if(block_num == 0) return get_data_block_immediate(pos, blk);
-        else return get_data_block_linked(pos, block_num, blk);
+    /**
+     * Get the lba of the data block on drive for the given inode, pending
+     * data_blocks in memory are not considered.
+     * @param block_num zero indexed data_block block number
+     * @return FLFS_RET_NONE upon success and FLFS_RET_ERR upon failure
+     */
+    int FuseLFS::get_data_block_lba(inode_entry entry, uint64_t block_num,
+        uint64_t &lba)
+    {
+        // Inode has no data blocks on drive
+        if(entry.data_lba == 0)
+            return FLFS_RET_ERR;
+
+        // First data block does not require the index
+        if(block_num == 0) {
+            lba = entry.data_lba;
+            return FLFS_RET_NONE;
+        }
+
+        int result = get_block_index_lba(entry.inode, entry.data_lba,
+                                         block_num, lba);
+        if(result == FLFS_RET_ENOENT) {
+            std::vector<uint64_t> block_lbas;
+            if(read_data_block_chain(entry.data_lba, block_lbas) !=
+               FLFS_RET_NONE)
+                return FLFS_RET_ERR;
+
+            if(block_num >= block_lbas.size())
+                return FLFS_RET_ERR;
+
+            lba = block_lbas.at(block_num);
+            update_block_index(entry.inode, entry.data_lba,
+                               std::move(block_lbas));
+        }
+        else if(result != FLFS_RET_NONE)
+            return FLFS_RET_ERR;
+
+        return FLFS_RET_NONE;
     }
 
     /**
@@ -1088,32 +1847,45 @@ namespace qemucsd::fuse_lfs {
     }
 
     /**
-     * Iterate through the chain of linked data_blocks until the requested one
-     * is found. When found fill blk buffer with the data by calling
-     * get_data_block_immediate
-     * @param block_num is zero indexed
-     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure
+     * Iterate through the entire chain of linked data_blocks starting at
+     * data_lba and collect the LBA of every data_block in order.
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure or if the
+     *         chain is longer than the device could hold
      */
-    int FuseLFS::get_data_block_linked(
-        struct data_position pos, uint64_t block_num, struct data_block *blk)
+    int FuseLFS::read_data_block_chain(
+        uint64_t data_lba, std::vector<uint64_t> &block_lbas)
     {
-        auto buffer = (struct data_block *) malloc(sizeof(data_block));
-        for(uint64_t i = 0; i < block_num; i ++) {
-            if(nvme->read(pos.zone, pos.sector, pos.offset, buffer,
-                          sizeof(data_block)) != 0)
+        uint64_t max_blocks = nvme_info.num_zones * nvme_info.zone_capacity;
+        struct data_position pos = {0};
+        auto buffer = (struct data_block *) sector_slab::alloc();
+
+        block_lbas.clear();
+        while(data_lba != 0) {
+            if(block_lbas.size() >= max_blocks) {
+                output.error("Chain of data_blocks exceeds device size");
+                sector_slab::release(buffer);
+                return FLFS_RET_ERR;
+            }
+
+            block_lbas.push_back(data_lba);
+
+            lba_to_position(data_lba, pos);
+            if(get_data_block_immediate(pos, buffer) != FLFS_RET_NONE) {
+                sector_slab::release(buffer);
                 return FLFS_RET_ERR;
-            // Update the pos with the next block
-            lba_to_position(buffer->next_block, pos);
+            }
+
+            data_lba = buffer->next_block;
         }
-        free(buffer);
+        sector_slab::release(buffer);
 
-        return get_data_block_immediate(pos, blk);
+        return FLFS_RET_NONE;
     }
 
     /**
      * Find and fill the stbuf information for the given inode. Every FUSE call
      * that needs to determine if an inode exists should use this method.
-     * TODO(Dantali0n): Cache these lookups as much as possible.
+     * Flushed inodes are served from the inode cache when possible.
      * @threadsafety: thread safe
      * @return FLFS_RET_NONE upon success, FLFS_RET_ENOENT upon not found
      */
@@ -1173,7 +1945,8 @@ namespace qemucsd::fuse_lfs {
     /**
      * Find and populate the inode_entry_t (inode entry + name) for a given
      * inode. This function will not return data for hardcoded inodes such as 0
-     * or root (1).
+     * or root (1). Inodes on drive are decoded once and kept in the inode
+     * cache for as long as their inode_block remains at the same lba.
      * @threadsafety: thread safe
      * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon error or
      *         FLFS_RET_ENOENT if the inode_entry could not be found
@@ -1191,39 +1964,25 @@ namespace qemucsd::fuse_lfs {
         if(get_inode_entry(ino, entry) == FLFS_RET_NONE)
             return FLFS_RET_NONE;
 
+        if(get_inode_cache(ino, cur_lba.lba, entry) == FLFS_RET_NONE)
+            return FLFS_RET_NONE;
+
         // Read the inode_block from the drive
-        auto *ino_blk_ptr = (uint8_t*) malloc(sizeof(inode_block));
+        auto *ino_blk = (struct inode_block *) sector_slab::alloc();
         lba_to_position(cur_lba.lba, ino_pos);
-        if(nvme->read(ino_pos.zone, ino_pos.sector, ino_pos.offset, ino_blk_ptr,
+        if(nvme->read(ino_pos.zone, ino_pos.sector, ino_pos.offset, ino_blk,
                       sizeof(inode_block)) != 0) {
-            free(ino_blk_ptr);
+            sector_slab::release(ino_blk);
             return FLFS_RET_ERR;
         }
 
-        uint64_t offset = 0;
-        struct inode_entry *ino_entry;
-        // Iterate over each inode_entry_t (inode_entry + its name)
-        while(offset < INO_BLK_READ_LIM) {
-            ino_entry = (struct inode_entry *) (ino_blk_ptr + offset);
-            if(ino_entry->inode == ino)
-                break;
-
-            offset += INODE_ENTRY_SIZE;
-            offset += strlen((const char *)ino_blk_ptr + offset) + 1;
-        }
-
         // Inode was not found while it should have been on this lba
-        if(ino_entry->inode != ino) {
-            free(ino_blk_ptr);
+        int result = find_inode_block_entry(ino_blk, ino, entry);
+        sector_slab::release(ino_blk);
+        if(result != FLFS_RET_NONE)
             return FLFS_RET_ERR;
-        }
-
-        // Populate entry to reflect the found inode_entry_t data
-        entry->first = *ino_entry;
-        entry->second = std::string((const char *)ino_blk_ptr + offset +
-                                    INODE_ENTRY_SIZE);
 
-        free(ino_blk_ptr);
+        update_inode_cache(ino, cur_lba.lba, *entry);
 
         return FLFS_RET_NONE;
     }
@@ -1264,7 +2023,7 @@ namespace qemucsd::fuse_lfs {
 
         uint64_t entry_inode = entry.inode;
         struct lba_inode cur_lba =
-            {entry.parent, 0, std::make_shared<std::mutex>()};
+            {entry.parent, 0, std::make_shared<std::shared_mutex>()};
         update_inode_lba(entry.inode, &cur_lba);
 
         // Newly created inodes are added to path_inode_map. Normally this is
@@ -1309,14 +2068,18 @@ namespace qemucsd::fuse_lfs {
         int result;
 
         if(fill_inode_block(&inodes, &blk) == FLFS_RET_INO_BLK_FULL) {
-            result = log_append(&blk, sizeof(inode_block), res_lba);
+            res_lba = 0;
+            result = log_append(&blk, sizeof(inode_block), res_lba,
+                classify_log(LOG_DATA_INODE_BLOCK, 0));
 
-            if (result == FLFS_RET_NONE) {
-                erase_inode_entries(&inodes);
-                update_inode_lba_map(&inodes, res_lba);
-                add_nat_update_set_entries(&inodes);
-            }
-            else return result;
+            // The log zone can fill up with the appended inode_block
+            if(result != FLFS_RET_NONE &&
+               (result != FLFS_RET_LOGZ_FULL || res_lba == 0))
+                return result;
+
+            erase_inode_entries(&inodes);
+            update_inode_lba_map(&inodes, res_lba);
+            add_nat_update_set_entries(&inodes);
         }
 
         return FLFS_RET_NONE;
@@ -1326,43 +2089,331 @@ namespace qemucsd::fuse_lfs {
      * Flush one or more inode_blocks to the drive with the first regardless
      * of how full it is.
      * @threadsafety: single threaded
+     * @param only if not nullptr only the entries of these inodes are flushed
      * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon error and
      *         FLFS_RET_LOGZ_FULL if log zone full.
      */
-    int FuseLFS::flush_inodes_always() {
+    int FuseLFS::flush_inodes_always(const std::vector<fuse_ino_t> *only) {
         struct inode_block blk = {0};
         std::vector<fuse_ino_t> inodes;
         uint64_t res_lba;
         int result = 0;
 
-        fill_inode_block(&inodes, &blk);
+        // Keep filling blocks until the last partially filled one is written
+        int filled;
         do {
-            result = log_append(&blk, sizeof(inode_block), res_lba);
-            if(result == FLFS_RET_NONE) {
-                erase_inode_entries(&inodes);
-                update_inode_lba_map(&inodes, res_lba);
-                add_nat_update_set_entries(&inodes);
+            filled = fill_inode_block(&inodes, &blk, only);
+            if(inodes.empty()) break;
+
+            res_lba = 0;
+            result = log_append(&blk, sizeof(inode_block), res_lba,
+                classify_log(LOG_DATA_INODE_BLOCK, 0));
+
+            // The log zone can fill up with the appended inode_block
+            if(result != FLFS_RET_NONE &&
+               (result != FLFS_RET_LOGZ_FULL || res_lba == 0))
+                return result;
+
+            erase_inode_entries(&inodes);
+            update_inode_lba_map(&inodes, res_lba);
+            add_nat_update_set_entries(&inodes);
+        } while(filled == FLFS_RET_INO_BLK_FULL);
+
+        return FLFS_RET_NONE;
+    }
+
+    /**
+     * Flush all pending data_blocks to drive and update the data_lba of their
+     * inodes. Every data_block holds the lba of its successor so chains are
+     * written back to front, starting at the highest pending data_block. The
+     * remainder of the chain on drive is unchanged and linked to as is. The
+     * n-th data_block from the back of every inode is appended in the same
+     * round, making every round a single multi-sector append.
+     * @threadsafety: single threaded
+     * @param inodes inodes to flush the pending data_blocks of, each at most
+     *        once
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure and
+     *         FLFS_RET_LOGZ_FULL if log zone full. Pending data_blocks are
+     *         kept upon failure.
+     */
+    int FuseLFS::flush_data_blocks(const std::vector<fuse_ino_t> &inodes) {
+        // Part of the chain of data_blocks of an inode that must be rewritten
+        struct data_chain {
+            fuse_ino_t ino;
+            bool found;
+            inode_entry_t entry;
+            std::vector<struct data_block> blocks;
+            // lba of the data_block following the last one not yet appended
+            uint64_t next_block;
+        };
+        std::vector<struct data_chain> chains;
+        uint64_t rounds = 0;
+
+        for(auto &ino : inodes) {
+            auto pending = data_blocks->find(ino);
+            if(pending == data_blocks->end())
+                continue;
+
+            chains.push_back({ino, true, {}, {}, 0});
+            struct data_chain &chain = chains.back();
+
+            // Inode removed, pending data_blocks are discarded
+            if(get_inode(chain.ino, &chain.entry) != FLFS_RET_NONE) {
+                chain.found = false;
+                continue;
+            }
+
+            uint64_t num_lbas = chain.entry.first.size / SECTOR_SIZE;
+            num_lbas += chain.entry.first.size % SECTOR_SIZE != 0 ? 1 : 0;
+            uint64_t num_blocks;
+            compute_data_block_num(num_lbas, num_blocks);
+
+            // Pending data_blocks beyond the end of file are discarded
+            if(num_blocks == 0 || pending->second->empty())
+                continue;
+
+            uint64_t last = flfs_min(pending->second->rbegin()->first,
+                num_blocks - 1);
+
+            // Predecessors of pending data_blocks must be rewritten as well
+            chain.blocks.resize(last + 1);
+            for(uint64_t i = 0; i <= last; i++) {
+                if(get_data_block(chain.entry.first, i, &chain.blocks.at(i)) ==
+                   FLFS_RET_NONE)
+                    continue;
+
+                // Gaps can only be filled if there is no chain on drive
+                if(chain.entry.first.data_lba != 0)
+                    return FLFS_RET_ERR;
+                memset(&chain.blocks.at(i), 0, sizeof(data_block));
+            }
+
+            if(last + 1 < num_blocks && chain.entry.first.data_lba != 0 &&
+               get_data_block_lba(chain.entry.first, last + 1,
+                                  chain.next_block) != FLFS_RET_NONE)
+                return FLFS_RET_ERR;
+
+            if(chain.blocks.size() > rounds)
+                rounds = chain.blocks.size();
+        }
+
+        std::vector<struct data_block> batch;
+        std::vector<struct data_chain*> owners;
+        std::vector<uint64_t> lbas;
+        for(uint64_t round = 0; round < rounds; round++) {
+            batch.clear();
+            owners.clear();
+            lbas.clear();
+
+            for(auto &chain : chains) {
+                if(chain.blocks.size() <= round)
+                    continue;
+
+                struct data_block &blk =
+                    chain.blocks.at(chain.blocks.size() - 1 - round);
+                blk.next_block = chain.next_block;
+                batch.push_back(blk);
+                owners.push_back(&chain);
             }
-            else return result;
-        } while(fill_inode_block(&inodes, &blk) == FLFS_RET_INO_BLK_FULL);
+
+            int result = log_append(batch.data(),
+                batch.size() * sizeof(data_block), lbas,
+                classify_log(LOG_DATA_DATA_BLOCK, 0));
+
+            // The log zone can fill up with the final sectors of the append
+            if(lbas.size() != batch.size())
+                return result == FLFS_RET_NONE ? FLFS_RET_ERR : result;
+
+            for(uint64_t i = 0; i < owners.size(); i++)
+                owners.at(i)->next_block = lbas.at(i);
+        }
+
+        // All data_blocks are on drive, point inodes to their new chains
+        for(auto &chain : chains) {
+            auto pending = data_blocks->find(chain.ino);
+            data_blocks_dirty -= pending->second->size();
+            delete pending->second;
+            data_blocks->erase(pending);
+
+            if(!chain.found)
+                continue;
+
+            // Without data_blocks the chain is empty and next_block is zero
+            if(!chain.blocks.empty() || chain.entry.first.size == 0)
+                chain.entry.first.data_lba = chain.next_block;
+
+            remove_block_index(chain.ino);
+            update_inode_entry(&chain.entry);
+        }
 
         return FLFS_RET_NONE;
     }
 
     /**
-     * Flush all data_blocks to drive in the correct order
+     * Flush the pending data_blocks of all inodes
      * @threadsafety: single threaded
-     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure and
+     *         FLFS_RET_LOGZ_FULL if log zone full.
      */
     int FuseLFS::flush_data_blocks() {
-        // These inodes will need to be updates
         std::vector<fuse_ino_t> inodes;
+        for(auto &pending : *data_blocks)
+            inodes.push_back(pending.first);
+
+        return flush_data_blocks(inodes);
+    }
+
+    /**
+     * Collect the inodes with buffered writes or pending data_blocks in
+     * ascending order without duplicates.
+     * @threadsafety: single threaded
+     */
+    void FuseLFS::get_pending_inodes(std::vector<fuse_ino_t> *inodes) {
+        std::vector<fuse_ino_t> buffered;
+        get_write_buffer_inodes(&buffered);
+
+        std::vector<fuse_ino_t> blocks;
+        for(auto &pending : *data_blocks)
+            blocks.push_back(pending.first);
+
+        std::set_union(buffered.begin(), buffered.end(), blocks.begin(),
+            blocks.end(), std::back_inserter(*inodes));
+    }
+
+    /**
+     * Flush the data of the given inodes and all other pending state to drive
+     * in dependency order. Buffered data sectors come first, followed by
+     * data_blocks containing the data LBAs, inode_blocks containing the
+     * data_block LBAs, NAT blocks containing the inode LBAs and finally the
+     * checkpoint. Log stages are retried once after garbage collection if the
+     * log zone is full.
+     * @threadsafety: single threaded, must have acquired flfs_wrap global lock
+     * @param inodes inodes to flush buffered writes and data_blocks of, each
+     *        at most once
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure
+     */
+    int FuseLFS::flush_pending(const std::vector<fuse_ino_t> &inodes) {
+        int result;
+
+        /** 0. Append buffered writes to the log */
+        result = flush_write_buffers(inodes);
+        if(result == FLFS_RET_LOGZ_FULL &&
+           log_garbage_collect() == FLFS_RET_NONE)
+            result = flush_write_buffers(inodes);
+        if(result != FLFS_RET_NONE)
+            return FLFS_RET_ERR;
+
+        /** 1. Update the data blocks */
+        result = flush_data_blocks(inodes);
+        if(result == FLFS_RET_LOGZ_FULL &&
+           log_garbage_collect() == FLFS_RET_NONE)
+            result = flush_data_blocks(inodes);
+        if(result != FLFS_RET_NONE)
+            return FLFS_RET_ERR;
+
+        /** 2. Update the inode blocks */
+        result = flush_inodes_always();
+        if(result == FLFS_RET_LOGZ_FULL &&
+           log_garbage_collect() == FLFS_RET_NONE)
+            result = flush_inodes_always();
+        if(result != FLFS_RET_NONE)
+            return FLFS_RET_ERR;
+
+        /** 3. Update NAT Blocks */
+        result = update_nat_blocks(nat_update_set);
+        if(result == FLFS_RET_RANDZ_FULL &&
+           rewrite_random_blocks() == FLFS_RET_NONE)
+            result = update_nat_blocks(nat_update_set);
+        if(result != FLFS_RET_NONE)
+            return FLFS_RET_ERR;
+
+        /** 4. Persist the checkpoint including the log heads */
+        uint64_t randz_lba;
+        uint64_t logz_lba;
+        position_to_lba(random_pos, randz_lba);
+        position_to_lba(log_pos, logz_lba);
+        return update_checkpointblock(randz_lba, logz_lba);
+    }
+
+    /**
+     * Flush all pending state to drive, see flush_pending.
+     * @threadsafety: single threaded, must have acquired flfs_wrap global lock
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure
+     */
+    int FuseLFS::flush_pending() {
+        std::vector<fuse_ino_t> inodes;
+        get_pending_inodes(&inodes);
+        return flush_pending(inodes);
+    }
+
+    /**
+     * Flush the data of a single inode followed by only the metadata required
+     * to locate it after a remount. This is the inode_block entry and NAT
+     * entry of the inode as well as those of its parent directories not yet
+     * on drive. The pending state of other inodes is left to writeback and
+     * fsync.
+     * @threadsafety: single threaded, must have acquired flfs_wrap global lock
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure
+     */
+    int FuseLFS::flush_pending_inode(fuse_ino_t ino) {
+        int result;
+
+        /** 0. Append buffered writes to the log */
+        result = flush_write_buffers({ino});
+        if(result == FLFS_RET_LOGZ_FULL &&
+           log_garbage_collect() == FLFS_RET_NONE)
+            result = flush_write_buffers({ino});
+        if(result != FLFS_RET_NONE)
+            return FLFS_RET_ERR;
+
+        /** 1. Update the data blocks */
+        result = flush_data_blocks({ino});
+        if(result == FLFS_RET_LOGZ_FULL &&
+           log_garbage_collect() == FLFS_RET_NONE)
+            result = flush_data_blocks({ino});
+        if(result != FLFS_RET_NONE)
+            return FLFS_RET_ERR;
+
+        /** 2. Update the inode blocks of the inode and its new parents */
+        std::vector<fuse_ino_t> inodes;
+        inode_entry_t entry;
+        fuse_ino_t cur = ino;
+        while(std::find(inodes.begin(), inodes.end(), cur) == inodes.end() &&
+              get_inode_entry(cur, &entry) == FLFS_RET_NONE)
+        {
+            inodes.push_back(cur);
+            cur = entry.first.parent;
+        }
+
+        result = flush_inodes_always(&inodes);
+        if(result == FLFS_RET_LOGZ_FULL &&
+           log_garbage_collect() == FLFS_RET_NONE)
+            result = flush_inodes_always(&inodes);
+        if(result != FLFS_RET_NONE)
+            return FLFS_RET_ERR;
 
-        for(auto &block : *data_blocks) {
-            inodes.push_back(block.first);
+        /** 3. Update NAT Blocks of the flushed inodes */
+        nat_update_set_t nat_set;
+        for(auto &nat_ino : inodes) {
+            if(nat_update_set->erase(nat_ino) != 0)
+                nat_set.insert(nat_ino);
         }
 
-        return FLFS_RET_NONE;
+        result = update_nat_blocks(&nat_set);
+        if(result == FLFS_RET_RANDZ_FULL &&
+           rewrite_random_blocks() == FLFS_RET_NONE)
+            result = update_nat_blocks(&nat_set);
+        if(result != FLFS_RET_NONE) {
+            nat_update_set->insert(nat_set.begin(), nat_set.end());
+            return FLFS_RET_ERR;
+        }
+
+        /** 4. Persist the checkpoint including the log heads */
+        uint64_t randz_lba;
+        uint64_t logz_lba;
+        position_to_lba(random_pos, randz_lba);
+        position_to_lba(log_pos, logz_lba);
+        return update_checkpointblock(randz_lba, logz_lba);
     }
 
     /**
@@ -1450,19 +2501,26 @@ namespace qemucsd::fuse_lfs {
         else if(entry.first.size < size) {
             struct data_block empty_db_blk = {0};
 
-            // Check how many data blocks already exist
-            uint64_t cur_block_nums = (entry.first.size / SECTOR_SIZE) /
-                DATA_BLK_LBA_NUM;
+            // Check how many data blocks already exist, the last one can be
+            // partially filled and must be preserved.
+            uint64_t cur_lbas = entry.first.size / SECTOR_SIZE;
+            cur_lbas += entry.first.size % SECTOR_SIZE != 0 ? 1 : 0;
+            uint64_t cur_block_nums;
+            compute_data_block_num(cur_lbas, cur_block_nums);
 
             // Create all non-existing empty data blocks
-            uint64_t new_block_nums = (size / SECTOR_SIZE) / DATA_BLK_LBA_NUM;
-            new_block_nums += (size / SECTOR_SIZE) % DATA_BLK_LBA_NUM != 0 ? 1 : 0;
-            uint64_t block_nums = new_block_nums - cur_block_nums;
-            for(uint64_t i = 0; i < block_nums; i++) {
-                assign_data_block(ino, i + cur_block_nums, &empty_db_blk);
+            uint64_t new_lbas = size / SECTOR_SIZE;
+            new_lbas += size % SECTOR_SIZE != 0 ? 1 : 0;
+            uint64_t new_block_nums;
+            compute_data_block_num(new_lbas, new_block_nums);
+            for(uint64_t i = cur_block_nums; i < new_block_nums; i++) {
+                assign_data_block(ino, i, &empty_db_blk);
             }
         }
 
+        // Buffered writes beyond the new size are discarded
+        truncate_write_buffer(ino, size);
+
         // Update inode size
         entry.first.size = size;
 
@@ -1757,20 +2815,22 @@ namespace qemucsd::fuse_lfs {
         conn->want &= ~(FUSE_CAP_PARALLEL_DIROPS);
         conn->want &= ~(FUSE_CAP_HANDLE_KILLPRIV);
 
-//        if(conn->capable & FUSE_CAP_SPLICE_READ) {
-//            output.info("Enabling splice read");
-//            conn->want |= FUSE_CAP_SPLICE_READ;
-//        }
-//
-//        if(conn->capable & FUSE_CAP_SPLICE_MOVE) {
-//            output.info("Enabling splice move");
-//            conn->want |= FUSE_CAP_SPLICE_MOVE;
-//        }
-//
-//        if(conn->capable & FUSE_CAP_SPLICE_WRITE) {
-//            output.info("Enabling splice write");
-//            conn->want |= FUSE_CAP_SPLICE_WRITE;
-//        }
+        // Splice read hands write data to write_buf through a pipe, splice
+        // write and move let fuse_reply_data pass replies on through a pipe.
+        if(conn->capable & FUSE_CAP_SPLICE_READ) {
+            output.info("Enabling splice read");
+            conn->want |= FUSE_CAP_SPLICE_READ;
+        }
+
+        if(conn->capable & FUSE_CAP_SPLICE_MOVE) {
+            output.info("Enabling splice move");
+            conn->want |= FUSE_CAP_SPLICE_MOVE;
+        }
+
+        if(conn->capable & FUSE_CAP_SPLICE_WRITE) {
+            output.info("Enabling splice write");
+            conn->want |= FUSE_CAP_SPLICE_WRITE;
+        }
 
         if(conn->capable & FUSE_CAP_AUTO_INVAL_DATA)
             conn->want |= FUSE_CAP_AUTO_INVAL_DATA;
@@ -1782,6 +2842,9 @@ namespace qemucsd::fuse_lfs {
         // https://github.com/libfuse/libfuse/commit/4f8f034a8969a48f210bf00be78a67cfb6964c72
         // https://elixir.bootlin.com/linux/latest/source/fs/fuse/fuse_i.h#L36
         conn->max_read = UINT32_MAX >> 1;
+
+        // Flush pending state in the background once it exceeds its limits
+        start_writeback();
     }
 
     /**
@@ -1793,7 +2856,12 @@ namespace qemucsd::fuse_lfs {
     void FuseLFS::destroy(void *userdata) {
         output.info("Tearing down filesystem");
 
-        // TODO(Dantali0n): flush all pending datastructures to drive.
+        stop_writeback();
+
+        bool flushed = flush_pending() == FLFS_RET_NONE;
+        if(!flushed)
+            output.error("Failed to flush pending data to drive");
+
         // TODO(Dantali0n): remove these
         for(auto &entry : *path_inode_map) {
             delete entry.second;
@@ -1802,6 +2870,10 @@ namespace qemucsd::fuse_lfs {
         for(auto &entry : *data_blocks) {
             delete entry.second;
         }
+        data_blocks_dirty = 0;
+
+        // Keep the dirty block so the next mount recovers from the checkpoint
+        if(!flushed) return;
 
         if(remove_dirtyblock() != FLFS_RET_NONE) {
             output.error("Failed to remove dirty block from drive",
@@ -2033,6 +3105,13 @@ namespace qemucsd::fuse_lfs {
         // Delete snapshot content if it exists
         delete_snapshot(&context);
 
+        // Persist the data of the last handle to the file, close does not
+        // wait for this reply so errors can only be reported in the log.
+        if((has_write_buffer(ino) ||
+            data_blocks->find(ino) != data_blocks->end()) &&
+           flush_pending_inode(ino) != FLFS_RET_NONE)
+            output.error("Failed to flush inode ", ino, " upon release");
+
         fuse_reply_err(req, 0);
     }
 
@@ -2183,15 +3262,30 @@ namespace qemucsd::fuse_lfs {
             return;
         }
 
-        // Lock the inode
-        if(lock_inode(ino) != FLFS_RET_NONE) {
+        // Buffered writes must reach the log before they can be read
+        if(has_write_buffer(ino)) {
+            if(lock_inode(ino) != FLFS_RET_NONE) {
+                fuse_reply_err(req, ENOENT);
+                return;
+            }
+
+            int result = flush_write_buffers({ino});
+            unlock_inode(ino);
+            if(result != FLFS_RET_NONE) {
+                fuse_reply_err(req, EIO);
+                return;
+            }
+        }
+
+        // Lock the inode shared, concurrent reads of the same inode are safe
+        if(lock_inode(ino, false) != FLFS_RET_NONE) {
             fuse_reply_err(req, ENOENT);
             return;
         }
 
         read_regular(req, &e.attr, size, offset, fi);
 
-        unlock_inode(ino);
+        unlock_inode(ino, false);
     }
 
     /**
@@ -2201,6 +3295,22 @@ namespace qemucsd::fuse_lfs {
     void FuseLFS::write(fuse_req_t req, fuse_ino_t ino, const char *buffer,
         size_t size, off_t off, struct fuse_file_info *fi)
     {
+        // Wait for writeback while pending state exceeds its limits, this
+        // must happen before acquiring the global lock writeback requires.
+        writeback_throttle();
+
+        // Flushing the buffered writes of all inodes requires every inode to
+        // be locked, only do so when the total limit would be exceeded.
+        uint64_t sectors =
+            ((off % SECTOR_SIZE) + size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+        if(size < WRITE_BUFFER_BYPASS && write_buffer_full(sectors)) {
+            const lock_guard<pthread_rwlock_t> lock(gl, true);
+            if(flush_write_buffers_if_full(sectors) != FLFS_RET_NONE) {
+                fuse_reply_err(req, EIO);
+                return;
+            }
+        }
+
         struct fuse_entry_param e = {0};
         const fuse_ctx* context = fuse_req_ctx(req);
         const lock_guard<pthread_rwlock_t> lock(gl);
@@ -2258,10 +3368,10 @@ namespace qemucsd::fuse_lfs {
 
         struct write_context wr_context = {0};
 
-        // Number of sectors total write will cover
-        wr_context.num_sectors = size / SECTOR_SIZE;
-        if((size + off) % SECTOR_SIZE != 0) wr_context.num_sectors += 1;
-        if(off % (SECTOR_SIZE + size) > SECTOR_SIZE) wr_context.num_sectors += 1;
+        // Number of sectors total write will cover, including partial first
+        // and last sectors
+        wr_context.num_sectors =
+            ((off % SECTOR_SIZE) + size + SECTOR_SIZE - 1) / SECTOR_SIZE;
 
         // Compute initial data_block and index
         wr_context.cur_db_blk_num = (off / SECTOR_SIZE) / DATA_BLK_LBA_NUM;
@@ -2277,6 +3387,40 @@ namespace qemucsd::fuse_lfs {
         unlock_inode(ino);
     }
 
+    /**
+     * Writes already in memory are passed on as is. Writes spliced into a
+     * pipe by the kernel are copied out of the pipe once, directly into a
+     * buffer that is used for the remainder of the write.
+     * @threadsafety: thread safe, weakly synchronized with other FUSE calls
+     */
+    void FuseLFS::write_buf(fuse_req_t req, fuse_ino_t ino,
+        struct fuse_bufvec *bufv, off_t off, struct fuse_file_info *fi)
+    {
+        size_t size = fuse_buf_size(bufv);
+        if(bufv->count == 1 && bufv->off == 0 &&
+           !(bufv->buf[0].flags & FUSE_BUF_IS_FD))
+        {
+            write(req, ino, (const char*) bufv->buf[0].mem, size, off, fi);
+            return;
+        }
+
+        arena request;
+        struct fuse_bufvec dst = FUSE_BUFVEC_INIT(size);
+        dst.buf[0].mem = request.alloc(size);
+        if(dst.buf[0].mem == nullptr) {
+            fuse_reply_err(req, ENOMEM);
+            return;
+        }
+
+        ssize_t result = fuse_buf_copy(&dst, bufv, FUSE_BUF_SPLICE_MOVE);
+        if(result < 0) {
+            fuse_reply_err(req, -result);
+            return;
+        }
+
+        write(req, ino, (const char*) dst.buf[0].mem, result, off, fi);
+    }
+
     /**
      *
      * @threadsafety: thread safe
@@ -2287,8 +3431,19 @@ namespace qemucsd::fuse_lfs {
         statbuf.f_frsize = SECTOR_SIZE;
 
         // TODO(Dantali0n): Use rollover from log_pos to compute
-        statbuf.f_bfree = ((nvme_info.num_zones - N_LOG_BUFF_ZONES -
-            log_ptr.zone) * nvme_info.zone_capacity) - log_ptr.sector;
+        // Unclaimed log zones and the remainder of the zone of every head
+        uint64_t log_end = nvme_info.num_zones - N_LOG_BUFF_ZONES;
+        uint64_t zone_next = log_zone_next.load();
+        if(zone_next < log_end)
+            statbuf.f_bfree = (log_end - zone_next) * nvme_info.zone_capacity;
+        for(auto &stream_heads : log_heads) {
+            for(auto &head : stream_heads) {
+                const std::lock_guard<std::mutex> head_lock(head.l);
+                if(head.ptr.valid())
+                    statbuf.f_bfree += nvme_info.zone_capacity -
+                        head.ptr.sector;
+            }
+        }
 
         // TODO(Dantali0n): Compute based on occupation from SIT blocks
         statbuf.f_bavail = statbuf.f_bfree;
@@ -2305,16 +3460,16 @@ namespace qemucsd::fuse_lfs {
     }
 
     /**
-     * Flush data to drive. Flush order is always 1. data_blocks
-     * 2. inode_blocks. 3. NAT blocks. data blocks contain raw data LBAs,
-     * inode_blocks contain data_blocks LBAs and NAT blocks contain inode LBAs.
+     * Flush data to drive. Flush order is always 0. buffered writes
+     * 1. data_blocks 2. inode_blocks. 3. NAT blocks 4. checkpoint. data blocks
+     * contain raw data LBAs, inode_blocks contain data_blocks LBAs and NAT
+     * blocks contain inode LBAs. See flush_pending.
      * @threadsafety: thread safe, strongly synchronized with other FUSE calls
      */
     void FuseLFS::fsync(fuse_req_t req, fuse_ino_t ino, int datasync,
         struct fuse_file_info *fi)
     {
         const lock_guard<pthread_rwlock_t> lock(gl, true);
-        int result = 0;
 
         #ifdef FLFS_DBG_FI
         output_fi("fsync", fi);
@@ -2327,50 +3482,12 @@ namespace qemucsd::fuse_lfs {
             return;
         }
 
-        /** 1. Update the data blocks */
-        result = flush_data_blocks();
-        if(result == FLFS_RET_LOGZ_FULL) {
-            if(log_garbage_collect() != FLFS_RET_NONE) {
-                fuse_reply_err(req, EIO);
-                return;
-            }
-
-            if(flush_data_blocks() != FLFS_RET_NONE) {
-                fuse_reply_err(req, EIO);
-                return;
-            }
-        }
-
-        /** 2. Update the inode blocks */
-        result = flush_inodes();
-        if(result == FLFS_RET_LOGZ_FULL) {
-            if(log_garbage_collect() != FLFS_RET_NONE) {
-                fuse_reply_err(req, EIO);
-                return;
-            }
-
-            if(flush_inodes() != FLFS_RET_NONE) {
-                fuse_reply_err(req, EIO);
-                return;
-            }
-        }
-        else if (result != FLFS_RET_NONE) {
+        if(flush_pending() != FLFS_RET_NONE) {
             fuse_reply_err(req, EIO);
             return;
         }
 
-        /** 3. Update NAT Blocks */
-        result = update_nat_blocks(nat_update_set);
-        if(result == FLFS_RET_RANDZ_FULL) {
-            if(rewrite_random_blocks() != FLFS_RET_NONE) {
-                fuse_reply_err(req, EIO);
-                return;
-            }
-            if(update_nat_blocks(nat_update_set) != FLFS_RET_NONE) {
-                fuse_reply_err(req, EIO);
-                return;
-            }
-        }
+        fuse_reply_err(req, 0);
     }
 
     /**
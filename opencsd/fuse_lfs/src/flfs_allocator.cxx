@@ -0,0 +1,70 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Dantali0n
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "flfs.hpp"
+
+namespace qemucsd::fuse_lfs {
+
+    arena::region::~region() {
+        std::free(base);
+    }
+
+    arena::region &arena::local() {
+        thread_local region r;
+        return r;
+    }
+
+    arena::arena() {
+        mark = local().used;
+    }
+
+    arena::~arena() {
+        for(auto &ptr : overflow) std::free(ptr);
+        local().used = mark;
+    }
+
+    /**
+     * Allocate size bytes that remain valid until the arena is destroyed.
+     * @return buffer of size bytes or nullptr if allocation failed
+     */
+    void *arena::alloc(size_t size) {
+        size = sector_align(size);
+        region &r = local();
+
+        // Region is only allocated upon first use by each thread
+        if(r.base == nullptr)
+            r.base = (uint8_t*) std::aligned_alloc(SECTOR_SIZE, ARENA_SIZE);
+
+        if(r.base == nullptr || size > ARENA_SIZE - r.used) {
+            void *ptr = std::aligned_alloc(SECTOR_SIZE, size);
+            if(ptr != nullptr) overflow.push_back(ptr);
+            return ptr;
+        }
+
+        void *ptr = r.base + r.used;
+        r.used += size;
+        return ptr;
+    }
+}
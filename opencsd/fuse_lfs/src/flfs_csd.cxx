@@ -53,14 +53,15 @@ namespace qemucsd::fuse_lfs {
 
     /**
      * Determine the selection data blocks that need to be passed to the CSD
-     * kernel. These are flattened one after another and only include the exact
-     * blocks required for the kernel to run.
+     * kernel. Only the exact sectors required for the kernel to run are
+     * included, runs of consecutive lbas within a zone are flattened into a
+     * single extent. The extents are terminated by an extent of length zero.
      *
-     * Kernels can include bpf_helpers_flfs.h to operate on these flattened
-     * blocks.
+     * Kernels can include bpf_helpers_flfs.h to operate on these extents.
      */
     void FuseLFSCSD::flatten_data_blocks(uint64_t size, uint64_t off,
-        data_map_t *blocks, std::vector<uint64_t> *flat_blocks)
+        data_map_t *blocks, uint64_t zone_size,
+        std::vector<struct flfs_extent> *extents)
     {
         uint64_t start_lba = off / SECTOR_SIZE;
         uint64_t end_lba = (size + off) / SECTOR_SIZE;
@@ -68,16 +69,24 @@ namespace qemucsd::fuse_lfs {
 
         uint64_t start_block = start_lba / DATA_BLK_LBA_NUM;
 
-        flat_blocks->reserve(end_lba - start_lba);
         struct data_block *cur_blk = &blocks->at(start_block);
         for(uint64_t i = start_lba; i < end_lba; i++) {
-            flat_blocks->push_back(cur_blk->data_lbas[i % DATA_BLK_LBA_NUM]);
+            uint64_t lba = cur_blk->data_lbas[i % DATA_BLK_LBA_NUM];
 
-            if((i + 1) % DATA_BLK_LBA_NUM == 0) {
+            // Extend the previous extent unless lba starts a new zone
+            if(!extents->empty() && lba % zone_size != 0 &&
+               extents->back().lba + extents->back().length == lba)
+                extents->back().length += 1;
+            else
+                extents->push_back({lba, 1});
+
+            if((i + 1) % DATA_BLK_LBA_NUM == 0 && i + 1 < end_lba) {
                 start_block += 1;
                 cur_blk = &blocks->at(start_block);
             }
         }
+
+        extents->push_back({0, 0});
     }
 
     /**
@@ -116,17 +125,17 @@ namespace qemucsd::fuse_lfs {
             }
         }
 
-        // Provide flattened data blocks to kernel.
-        std::vector<uint64_t> flat_blocks;
+        // Provide extents of the data to kernel.
+        std::vector<struct flfs_extent> extents;
         flatten_data_blocks(size, off, &snap->data_blocks,
-                            &flat_blocks);
+                            nvme_info.zone_size, &extents);
 
-        uint64_t lbas_size = flat_blocks.size() * sizeof(uint64_t);
+        uint64_t extents_size = extents.size() * sizeof(struct flfs_extent);
 
-        call_size = lbas_size + fcall_size;
+        call_size = extents_size + fcall_size;
         call = malloc(call_size);
         memcpy(call, &context, fcall_size);
-        memcpy((uint8_t*)call + fcall_size, flat_blocks.data(), lbas_size);
+        memcpy((uint8_t*)call + fcall_size, extents.data(), extents_size);
     }
 
     void FuseLFS::lookup_csd(fuse_req_t req, csd_unique_t *context) {
@@ -176,7 +185,8 @@ namespace qemucsd::fuse_lfs {
         }
 
         /** Allocate a buffer sufficient for the contents of the read kernel */
-        void *kernel_data = malloc(kernel_snap.inode_data.first.size);
+        arena request;
+        void *kernel_data = request.alloc(kernel_snap.inode_data.first.size);
         if(!kernel_data) {
             fuse_reply_err(req, ENOMEM);
             return;
@@ -224,7 +234,6 @@ namespace qemucsd::fuse_lfs {
         /** Launch the uBPF vm with the read kernel and filesystem context */
         int64_t result_size = csd_instance->nvm_cmd_bpf_run_fs(kernel_data,
             kernel_snap.inode_data.first.size, call, call_size);
-        free(kernel_data);
         free(call);
 
         /** Use results of less than 0 for errors */
@@ -234,9 +243,10 @@ namespace qemucsd::fuse_lfs {
             return;
         }
 
-        /** Fetch the result data from the kernel */
-        void *result_data = malloc(result_size);
-        csd_instance->nvm_cmd_bpf_result(result_data);
+        /** Take the result data from the kernel without copying it */
+        void *result_data = nullptr;
+        csd_instance->nvm_cmd_bpf_result_move(&result_data);
+        if(result_data == nullptr) result_size = 0;
 
         fuse_reply_buf(req, (const char*)result_data, flfs_min(result_size, size));
         free(result_data);
@@ -259,7 +269,8 @@ namespace qemucsd::fuse_lfs {
             return;
         }
 
-        void *kernel_data = malloc(snap.inode_data.first.size);
+        arena request;
+        void *kernel_data = request.alloc(snap.inode_data.first.size);
         if(!kernel_data) {
             fuse_reply_err(req, ENOMEM);
             return;
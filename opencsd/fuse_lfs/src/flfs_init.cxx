@@ -39,26 +39,30 @@ namespace qemucsd::fuse_lfs {
             return FLFS_RET_ERR;
         }
 
-        // TODO(Dantali0n): Only create filesystem when a certain command line
-        //                  argument is supplied. See fuse hello_ll for example.
-        output.info("Creating filesystem..");
-        if(mkfs() != FLFS_RET_NONE) {
-            return FLFS_RET_ERR;
-        }
-
         output.info("Checking super block..");
         if(verify_superblock() != FLFS_RET_NONE) {
-            output.error("Failed to verify super block, are you ",
-                         "sure the partition does not contain another filesystem?");
-            return FLFS_RET_ERR;
+            // Only drives without any super block are formatted
+            if(find_superblock() == FLFS_RET_NONE) {
+                output.error("Failed to verify super block, are you ",
+                             "sure the partition does not contain another filesystem?");
+                return FLFS_RET_ERR;
+            }
+
+            output.info("Creating filesystem..");
+            if(mkfs() != FLFS_RET_NONE) {
+                return FLFS_RET_ERR;
+            }
         }
 
-        // TODO(Dantali0n): Filesystem cleanup / recovery from dirty state
         output.info("Checking dirty block..");
-        if(verify_dirtyblock() != FLFS_RET_NONE) {
-            output.error("Filesystem dirty, no recovery methods yet",
-                         " unable to continue :(");
-            return FLFS_RET_ERR;
+        bool dirty = verify_dirtyblock() != FLFS_RET_NONE;
+        if(dirty) {
+            output.warning("Filesystem was not unmounted cleanly, rolling ",
+                           "forward from last checkpoint..");
+            if(remove_dirtyblock() != FLFS_RET_NONE) {
+                output.error("Unable to remove dirty block from drive");
+                return FLFS_RET_ERR;
+            }
         }
 
         output.info("Writing dirty block..");
@@ -69,12 +73,46 @@ namespace qemucsd::fuse_lfs {
         }
 
         /** Set the random_pos and log_pos to the correct position */
-        get_checkpointblock(cblock);
+        if(get_checkpointblock(cblock) != FLFS_RET_NONE) {
+            output.error("Unable to locate checkpoint block");
+            return FLFS_RET_ERR;
+        }
+        // lba_to_position only sets zone and sector, start from valid positions
+        random_pos = RANDZ_POS;
+        log_pos = LOGZ_POS;
         lba_to_position(cblock.randz_lba, random_pos);
         lba_to_position(cblock.logz_lba, log_pos);
 
-        /** Determine random_ptr now that random_pos is known */
-        if(determine_random_ptr() == FLFS_RET_RANDZ_FULL) {
+        /** Determine the log write pointer */
+        determine_log_ptr();
+
+        /** Restore NAT blocks left in the random buffer, may move random_pos */
+        nat_update_set_t buffered_nat;
+        if(recover_random_buffer(&buffered_nat) != FLFS_RET_NONE) {
+            return FLFS_RET_ERR;
+        }
+
+        /** Roll forward from the random_ptr recorded in the checkpoint */
+        int randz_result = determine_random_ptr(
+            buffered_nat.empty() ? cblock.randz_ptr : 0);
+        if(randz_result == FLFS_RET_ERR) {
+            return FLFS_RET_ERR;
+        }
+
+        /** Now that random_pos is known reconstruct inode lba map */
+        // TODO(Dantali0n): Make this also reconstruct SIT blocks
+        if(read_random_zone(&inode_lba_map) != FLFS_RET_NONE) {
+            output.error("Failed to read random zone");
+            return FLFS_RET_ERR;
+        }
+
+        /** Find highest free inode number and keep track */
+        ino_ptr = cblock.ino_ptr > 2 ? cblock.ino_ptr : 2;
+        for(auto &ino : inode_lba_map) {
+            if(ino.first >= ino_ptr) ino_ptr = ino.first + 1;
+        }
+
+        if(randz_result == FLFS_RET_RANDZ_FULL) {
             output.warning("Filesystem initialized while random zone still ",
                            "full, unclean shutdown attempting recovery..");
             if(rewrite_random_blocks() != FLFS_RET_NONE) {
@@ -86,29 +124,38 @@ namespace qemucsd::fuse_lfs {
             }
         }
 
+        /** Append the NAT entries restored from the random buffer again */
+        while(!buffered_nat.empty()) {
+            int result = update_nat_blocks(&buffered_nat);
+            if(result < FLFS_RET_NONE) {
+                return FLFS_RET_ERR;
+            }
+
+            if(result == FLFS_RET_RANDZ_FULL &&
+               rewrite_random_blocks() != FLFS_RET_NONE) {
+                return FLFS_RET_ERR;
+            }
+        }
+
         // Root inode
         output.info("Creating root inode..");
         path_inode_map->insert(std::make_pair(1, new path_map_t()));
 
-        /** Now that random_pos is known reconstruct inode lba map */
-        // TODO(Dantali0n): Make this also reconstruct SIT blocks
-        read_random_zone(&inode_lba_map);
-
-        /** Find highest free inode number and keep track */
-        ino_ptr = 2;
-        for(auto &ino : inode_lba_map) {
-            if(ino.first > ino_ptr) ino_ptr = ino.first + 1;
+        /** With inodes available build path_inode_map now */
+        if(build_path_inode_map() != FLFS_RET_NONE) {
+            return FLFS_RET_ERR;
         }
 
-        /** Determine the log write pointer */
-        determine_log_ptr();
-
-        /** With inodes available build path_inode_map now */
-        // TODO(Dantali0n): Build path_inode_map
-//        if(build_path_inode_map() != FLFS_RET_NONE) {
-//            ret = 1;
-//            goto err_out1;
-//        }
+        /** Record the recovered state so the next mount starts from it */
+        if(dirty) {
+            uint64_t randz_lba;
+            uint64_t logz_lba;
+            position_to_lba(random_pos, randz_lba);
+            position_to_lba(log_pos, logz_lba);
+            if(update_checkpointblock(randz_lba, logz_lba) != FLFS_RET_NONE) {
+                return FLFS_RET_ERR;
+            }
+        }
 
         return FLFS_RET_NONE;
     }
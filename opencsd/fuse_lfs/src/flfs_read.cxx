@@ -65,6 +65,9 @@ namespace qemucsd::fuse_lfs {
     {
         measurements::measure_guard msr_guard(msr_reg[MSRI_REG_READ]);
 
+        // Reap completed read ahead so its sectors are cached before reading
+        nvme->poll();
+
         // Actual read starts here
         inode_entry_t entry;
         get_inode(stbuf->st_ino, &entry);
@@ -80,12 +83,12 @@ namespace qemucsd::fuse_lfs {
         db_block_num = db_num_lbas / DATA_BLK_LBA_NUM;
 //        compute_data_block_num(db_num_lbas, db_block_num);
 
-        auto *blk = (struct data_block *) malloc(sizeof(data_block));
+        auto *blk = (struct data_block *) sector_slab::alloc();
         if(get_data_block(entry.first, db_block_num, blk) != FLFS_RET_NONE) {
             uint64_t error_lba = entry.first.data_lba;
             output.error("Failed to get data_block at lba ", error_lba,
                 " for inode ", stbuf->st_ino, " in read");
-            free(blk);
+            sector_slab::release(blk);
             return;
         }
 
@@ -94,15 +97,10 @@ namespace qemucsd::fuse_lfs {
         // Initial lba index in the data_block
         uint64_t db_lba_index = db_num_lbas % DATA_BLK_LBA_NUM;
 
-        // Round buffer size to account for offset of first and last sector
-        // as well as sector alignment
-        auto buffer = (uint8_t*) malloc(
-            data_limit + (offset % SECTOR_SIZE) + (size % SECTOR_SIZE)
-            + (SECTOR_SIZE-1) & (-SECTOR_SIZE));
-
-        // Loop through the data until the buffer is filled to the required size
+        // Loop through the data_blocks until the lbas of all sectors required
+        // to fill the buffer are known.
         uint64_t buffer_offset = 0;
-        struct data_position data_pos = {0};
+        std::vector<uint64_t> lbas;
 
         // Read limit to account for first sector offset.
         uint64_t  read_limit = data_limit + (offset % SECTOR_SIZE);
@@ -118,8 +116,7 @@ namespace qemucsd::fuse_lfs {
                     output.error(
                         "Failed to get data_block at lba ", error_lba,
                         " for inode ", stbuf->st_ino, " in read");
-                    free(buffer);
-                    free(blk);
+                    sector_slab::release(blk);
                     return;
                 }
             }
@@ -131,33 +128,94 @@ namespace qemucsd::fuse_lfs {
                 break;
             }
 
-            // Convert the data_block lba at the current index to a position
-            lba_to_position(blk->data_lbas[db_lba_index], data_pos);
-
-            // Read the data from this position into the buffer given the
-            // currently accumulated offset
-            if(nvme->read(data_pos.zone, data_pos.sector, data_pos.offset,
-                buffer + buffer_offset, SECTOR_SIZE) != 0)
-            {
-                uint64_t data_lba = blk->data_lbas[db_lba_index];
-                output.error("Failed to retrieve data at at data_block index ",
-                    db_lba_index, " with lba ", data_lba, " for inode ",
-                    stbuf->st_ino);
-                fuse_reply_err(req, EIO);
-                free(buffer);
-                free(blk);
-                return;
-            }
+            lbas.push_back(blk->data_lbas[db_lba_index]);
 
             buffer_offset += SECTOR_SIZE;
             db_lba_index += 1;
         }
 
+        sector_slab::release(blk);
+
+        // Reply straight from device memory if all data is present and the
+        // backend supports it, skipping the bounce buffer entirely. Such data
+        // is already in host memory so there is no need to read ahead.
+        if(buffer_offset >= read_limit && reply_sectors_mapped(req, lbas,
+           offset % SECTOR_SIZE, flfs_min(data_limit, size)) == FLFS_RET_NONE)
+            return;
+
+        // Round buffer size to account for offset of first and last sector
+        // as well as sector alignment
+        arena request;
+        auto buffer = (uint8_t*) request.alloc(
+            data_limit + (offset % SECTOR_SIZE) + (size % SECTOR_SIZE));
+        if(buffer == nullptr) {
+            fuse_reply_err(req, ENOMEM);
+            return;
+        }
+
+        // Read all sectors into the buffer in as few operations as possible
+        if(read_sectors(lbas, buffer) != FLFS_RET_NONE) {
+            output.error("Failed to retrieve data of ", lbas.size(),
+                " sectors for inode ", stbuf->st_ino);
+            fuse_reply_err(req, EIO);
+            return;
+        }
+
         fuse_reply_buf(req, (const char*)buffer + (offset % SECTOR_SIZE),
             flfs_min(data_limit, size));
 
-        free(buffer);
-        free(blk);
+        // Prefetch beyond this read if the file handle reads sequentially
+        uint64_t ra_offset;
+        uint64_t ra_size;
+        if(read_ahead_window(fi->fh, offset, size, ra_offset, ra_size) ==
+           FLFS_RET_NONE && ra_size != 0)
+            read_ahead(entry.first, ra_offset, ra_size);
+    }
+
+    /**
+     * Reply with size bytes starting at offset in the first of the sectors at
+     * lbas using a fuse_bufvec pointing directly at device memory. Ranges of
+     * consecutive lbas become a single buffer, a reply consisting of a single
+     * range is sent to the kernel without any copy in user space.
+     * @return FLFS_RET_NONE if the reply was sent, FLFS_RET_ERR if the backend
+     *         can not map the sectors in which case no reply was sent.
+     */
+    int FuseLFS::reply_sectors_mapped(fuse_req_t req,
+        const std::vector<uint64_t> &lbas, uint64_t offset, uint64_t size)
+    {
+        std::vector<nvme_zns::nvme_zns_iovec> iov;
+        lbas_to_iovec(lbas, nullptr, iov);
+        if(iov.empty()) return FLFS_RET_ERR;
+
+        auto bufv = (struct fuse_bufvec *) calloc(1,
+            sizeof(fuse_bufvec) + (iov.size() - 1) * sizeof(fuse_buf));
+        bufv->count = iov.size();
+
+        uint64_t remaining = size + offset;
+        for(uint64_t i = 0; i < iov.size(); i++) {
+            const void *data;
+            uint64_t range_size = flfs_min(iov.at(i).size, remaining);
+            if(nvme->map(iov.at(i).zone, iov.at(i).sector, range_size,
+                         &data) != 0)
+            {
+                free(bufv);
+                return FLFS_RET_ERR;
+            }
+
+            bufv->buf[i].mem = (void*) data;
+            bufv->buf[i].size = range_size;
+            remaining -= range_size;
+        }
+
+        // Skip the offset in the first sector by adjusting the buffer instead
+        // of the bufvec offset, libfuse only avoids copies without offset.
+        bufv->buf[0].mem = (uint8_t*) bufv->buf[0].mem + offset;
+        bufv->buf[0].size -= offset;
+
+        fuse_reply_data(req, bufv, FUSE_BUF_SPLICE_MOVE);
+        free(bufv);
+
+        return FLFS_RET_NONE;
     }
 
     /**
@@ -184,12 +242,13 @@ namespace qemucsd::fuse_lfs {
         uint64_t db_lba_index = db_num_lbas % DATA_BLK_LBA_NUM;
 
         // Round buffer size to nearest higher multiple of SECTOR_SIZE
-        auto internal_buffer = (uint8_t*) malloc(
-            data_limit + (SECTOR_SIZE-1) & (-SECTOR_SIZE));
+        arena request;
+        auto internal_buffer = (uint8_t*) request.alloc(data_limit);
 
-        // Loop through the data until the buffer is filled to the required size
+        // Loop through the data_blocks until the lbas of all sectors required
+        // to fill the buffer are known.
         uint64_t buffer_offset = 0;
-        struct data_position data_pos = {0};
+        std::vector<uint64_t> lbas;
         while(buffer_offset < data_limit) {
 
             // Detect db_lba_index overflow and fetch next data_block
@@ -199,30 +258,21 @@ namespace qemucsd::fuse_lfs {
                 blk = &snap->data_blocks.at(db_block_num);
             }
 
-            // Convert the data_block lba at the current index to a position
-            lba_to_position(blk->data_lbas[db_lba_index], data_pos);
-
-            // Read the data from this position into the buffer given the
-            // currently accumulated offset
-            if(nvme->read(data_pos.zone, data_pos.sector, data_pos.offset,
-                internal_buffer + buffer_offset, SECTOR_SIZE) != 0)
-            {
-                fuse_ino_t inode = snap->inode_data.first.inode;
-                uint64_t data_lba = blk->data_lbas[db_lba_index];
-                output.error("Failed to retrieve data at at data_block index ",
-                    db_lba_index, " with lba ", data_lba, " for inode ",
-                    inode);
-                free(buffer);
-                free(blk);
-                return FLFS_RET_ERR;
-            }
+            lbas.push_back(blk->data_lbas[db_lba_index]);
 
             buffer_offset += SECTOR_SIZE;
             db_lba_index += 1;
         }
 
+        // Read all sectors into the buffer in as few operations as possible
+        if(read_sectors(lbas, internal_buffer) != FLFS_RET_NONE) {
+            fuse_ino_t inode = snap->inode_data.first.inode;
+            output.error("Failed to retrieve data of ", lbas.size(),
+                " sectors for inode ", inode);
+            return FLFS_RET_ERR;
+        }
+
         memcpy(buffer, internal_buffer, flfs_min(data_limit, size));
-        free(internal_buffer);
 
         return FLFS_RET_NONE;
     }
@@ -26,6 +26,21 @@
 
 namespace qemucsd::fuse_lfs {
 
+    /**
+     * Determine if a super block has been written without verifying its
+     * contents. Drives without any super block can safely be formatted.
+     * @threadsafety: single threaded, only called during initialization
+     * @return FLFS_RET_NONE if written, FLFS_RET_ENOENT otherwise
+     */
+    int FuseLFS::find_superblock() {
+        struct super_block sblock;
+        if(nvme->read(SBLOCK_POS.zone, SBLOCK_POS.sector, SBLOCK_POS.offset,
+                      &sblock, sizeof(super_block)) != 0)
+            return FLFS_RET_ENOENT;
+
+        return FLFS_RET_NONE;
+    }
+
     /**
      * Read the super block for the filesystem and verify the parameters to
      * prevent overwritten a drive configured for other filesystems.
@@ -45,6 +60,11 @@ namespace qemucsd::fuse_lfs {
             return FLFS_RET_ERR;
         if(sblock.sector_size != nvme_info.sector_size)
             return FLFS_RET_ERR;
+        if(sblock.version != DISC_FORMAT_VERSION) {
+            output.error("Unsupported on drive format version ",
+                         sblock.version, " expected ", DISC_FORMAT_VERSION);
+            return FLFS_RET_ERR;
+        }
 
         return FLFS_RET_NONE;
     }
@@ -56,11 +76,12 @@ namespace qemucsd::fuse_lfs {
      * @return FLFS_RET_NONE upon success, < FLFS_RET_ERR upon failure
      */
     int FuseLFS::write_superblock() {
-        struct super_block sblock;
+        struct super_block sblock = {0};
         sblock.magic_cookie = MAGIC_COOKIE;
         sblock.zones = nvme_info.num_zones;
         sblock.sectors = nvme_info.zone_size;
         sblock.sector_size = nvme_info.sector_size;
+        sblock.version = DISC_FORMAT_VERSION;
 
         uint64_t sector;
         if(nvme->append(SBLOCK_POS.zone, sector, SBLOCK_POS.offset, &sblock,
@@ -39,7 +39,7 @@ namespace qemucsd::fuse_lfs {
         .read        = FuseLFSWrapper::read,
         .write       = FuseLFSWrapper::write,
         .release     = FuseLFSWrapper::release,
-        //        .fsync      = FuseLFSFuse::fsync,
+        .fsync       = FuseLFSWrapper::fsync,
         .readdir     = FuseLFSWrapper::readdir,
         .statfs      = FuseLFSWrapper::statfs,
         .setxattr    = FuseLFSWrapper::setxattr,
@@ -47,6 +47,7 @@ namespace qemucsd::fuse_lfs {
         .listxattr   = FuseLFSWrapper::listxattr,
         .removexattr = FuseLFSWrapper::removexattr,
         .create      = FuseLFSWrapper::create,
+        .write_buf   = FuseLFSWrapper::write_buf,
     };
 
     FuseLFS* FuseLFSWrapper::flfs_w = nullptr;
@@ -175,6 +176,13 @@ namespace qemucsd::fuse_lfs {
         flfs_w->write(req, ino, buf, size, off, fi);
     }
 
+    void FuseLFSWrapper::write_buf(fuse_req_t req, fuse_ino_t ino,
+        struct fuse_bufvec *bufv, off_t off, struct fuse_file_info *fi)
+    {
+        measurements::measure_guard msr_guard(msr[MSRI_WRITE]);
+        flfs_w->write_buf(req, ino, bufv, off, fi);
+    }
+
     void FuseLFSWrapper::statfs(fuse_req_t req, fuse_ino_t ino) {
         measurements::measure_guard msr_guard(msr[MSRI_STATFS]);
         flfs_w->statfs(req, ino);
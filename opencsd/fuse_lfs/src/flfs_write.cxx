@@ -27,43 +27,69 @@
 namespace qemucsd::fuse_lfs {
 
     /**
-     * Write a single sector of data taking into account any pre-existing data
-     * if it exists.
-     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure and
-     *         FLFS_RET_LOGZ_FULL if the log zone is full.
+     * Prepare a single sector of data in buffer taking into account any
+     * pre-existing data if it exists.
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure
      */
-    int FuseLFS::write_sector(size_t size, off_t offset, uint64_t cur_lba,
-        const char *data, uint64_t &result_lba)
+    int FuseLFS::prepare_sector(size_t size, off_t offset, uint64_t cur_lba,
+        const char *data, uint8_t *buffer)
     {
         if(offset + size > SECTOR_SIZE) return FLFS_RET_ERR;
-        auto buffer = (uint8_t*) malloc(SECTOR_SIZE);
 
         // Fetch current sector data if it exists and sector won't be completely
         // rewritten
-        if(cur_lba != 0 && (size != SECTOR_SIZE && offset != 0)) {
+        if(cur_lba != 0 && size != SECTOR_SIZE) {
             struct data_position cur_data_pos = {0};
             lba_to_position(cur_lba, cur_data_pos);
             if(nvme->read(cur_data_pos.zone, cur_data_pos.sector,
                           cur_data_pos.offset, buffer, SECTOR_SIZE) != 0) {
-                free(buffer);
                 return FLFS_RET_ERR;
             }
         }
         #ifdef QEMUCSD_DEBUG
         else if(offset != 0) {
-            output.warning("[write_sector] No pre-existing data but offset ",
+            output.warning("[prepare_sector] No pre-existing data but offset ",
                             "is non zero. In debug this buffer will be zerod...");
             memset(buffer, 0, offset);
         }
         #endif
 
         memcpy(buffer + offset, data, size);
-        int result = log_append(buffer, SECTOR_SIZE, result_lba);
 
-        free(buffer);
+        return FLFS_RET_NONE;
+    }
+
+    /**
+     * Write a single sector of data taking into account any pre-existing data
+     * if it exists.
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure and
+     *         FLFS_RET_LOGZ_FULL if the log zone is full.
+     */
+    int FuseLFS::write_sector(size_t size, off_t offset, uint64_t cur_lba,
+        const char *data, uint64_t &result_lba)
+    {
+        auto buffer = (uint8_t*) sector_slab::alloc();
+
+        result_lba = 0;
+        int result = prepare_sector(size, offset, cur_lba, data, buffer);
+        if(result == FLFS_RET_NONE)
+            result = log_append(buffer, SECTOR_SIZE, result_lba,
+                classify_log(LOG_DATA_DIRECT, 0));
+
+        // The log zone can fill up with the appended sector
+        if(result == FLFS_RET_LOGZ_FULL && result_lba != 0)
+            result = FLFS_RET_NONE;
+
+        sector_slab::release(buffer);
         return result;
     }
 
+    /**
+     * Prepare all sectors covered by the write in a single buffer and append
+     * them to the log at once. The data_blocks are updated afterwards with the
+     * resulting locations. Small writes are absorbed by the write buffer
+     * instead.
+     */
     void FuseLFS::write_regular(fuse_req_t req, fuse_ino_t ino,
         const char *buffer, size_t size, off_t off,
         struct write_context *wr_context, struct fuse_file_info *fi)
@@ -75,6 +101,19 @@ namespace qemucsd::fuse_lfs {
             return;
         }
 
+        if(size < WRITE_BUFFER_BYPASS) {
+            write_buffered(req, ino, buffer, size, off, &entry);
+            return;
+        }
+
+        // Buffered writes precede this write and must reach the log first
+        if(has_write_buffer(ino) && flush_write_buffers({ino}) !=
+           FLFS_RET_NONE)
+        {
+            fuse_reply_err(req, EIO);
+            return;
+        }
+
         // Create data_block and fetch existing data_block info if it exists
         struct data_block cur_db_blk = {0};
         if(entry.first.size > 0 && get_data_block(entry.first,
@@ -86,29 +125,41 @@ namespace qemucsd::fuse_lfs {
             return;
         }
 
-        uint64_t write_res_lba;
+        // All data_blocks modified by this write
+        data_map_t blocks;
+        // The data_block number and index of every sector in the buffer
+        std::vector<std::pair<uint64_t, uint64_t>> sector_indices;
+
+        // Sector aligned writes replace entire sectors and are appended
+        // straight from the FUSE buffer without a bounce buffer.
+        arena request;
+        bool aligned = off % SECTOR_SIZE == 0 && size % SECTOR_SIZE == 0;
+        auto sectors = aligned ? (uint8_t*) buffer :
+            (uint8_t*) request.alloc(wr_context->num_sectors * SECTOR_SIZE);
+
         uint64_t b_off = 0;
         uint64_t s_size = size;
         uint64_t s_off = off % SECTOR_SIZE;
         for(uint64_t i = 0; i < wr_context->num_sectors; i++) {
-            if(write_sector(
+            if(!aligned && prepare_sector(
                 s_size + s_off > SECTOR_SIZE ? SECTOR_SIZE - s_off : s_size,
                 s_off, cur_db_blk.data_lbas[wr_context->cur_db_lba_index],
-                buffer + b_off, write_res_lba) != FLFS_RET_NONE)
+                buffer + b_off, sectors + (i * SECTOR_SIZE)) != FLFS_RET_NONE)
             {
                 fuse_reply_err(req, EIO);
                 return;
             }
 
-            // Update location of data for current sector
-            cur_db_blk.data_lbas[wr_context->cur_db_lba_index] = write_res_lba;
+            // Remember location in data_block for current sector
+            sector_indices.emplace_back(
+                wr_context->cur_db_blk_num, wr_context->cur_db_lba_index);
 
             // Increment data index in current data_block
             wr_context->cur_db_lba_index += 1;
 
             // Handle overflow to next data block
             if(wr_context->cur_db_lba_index >= DATA_BLK_LBA_NUM) {
-                assign_data_block(ino, wr_context->cur_db_blk_num, &cur_db_blk);
+                blocks.insert_or_assign(wr_context->cur_db_blk_num, cur_db_blk);
 
                 wr_context->cur_db_lba_index = 0;
                 wr_context->cur_db_blk_num += 1;
@@ -139,13 +190,270 @@ namespace qemucsd::fuse_lfs {
             if(i == 0) s_off = 0;
         }
 
-        assign_data_block(ino, wr_context->cur_db_blk_num, &cur_db_blk);
+        blocks.insert_or_assign(wr_context->cur_db_blk_num, cur_db_blk);
+
+        // Append all sectors to the log at once
+        std::vector<uint64_t> lbas;
+        log_append(sectors, wr_context->num_sectors * SECTOR_SIZE, lbas,
+            classify_log(LOG_DATA_DIRECT, ino));
+
+        // The log zone can fill up with the final sectors of the append
+        if(lbas.size() != wr_context->num_sectors) {
+            fuse_reply_err(req, EIO);
+            return;
+        }
+
+        // Update location of data for every sector
+        for(uint64_t i = 0; i < lbas.size(); i++) {
+            auto &index = sector_indices.at(i);
+            blocks.at(index.first).data_lbas[index.second] = lbas.at(i);
+        }
+
+        assign_data_blocks(ino, &blocks);
         entry.first.size = entry.first.size > off + size ?
             entry.first.size : off + size;
         update_inode_entry(&entry);
         fuse_reply_write(req, size);
     }
 
+    /**
+     * Copy the write into the write buffer of the inode without any I/O,
+     * unless the buffered writes are due to be flushed first or a sector has
+     * to be completed from drive as the write is disjoint from the bytes
+     * already buffered for it.
+     */
+    void FuseLFS::write_buffered(fuse_req_t req, fuse_ino_t ino,
+        const char *buffer, size_t size, off_t off, inode_entry_t *entry)
+    {
+        uint64_t num_sectors =
+            ((off % SECTOR_SIZE) + size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+        if(write_buffer_flush_due(ino, num_sectors) &&
+           flush_write_buffers({ino}) != FLFS_RET_NONE)
+        {
+            fuse_reply_err(req, EIO);
+            return;
+        }
+
+        uint64_t sector = off / SECTOR_SIZE;
+        uint64_t s_off = off % SECTOR_SIZE;
+        uint64_t b_off = 0;
+        while(b_off < size) {
+            uint64_t length = flfs_min(SECTOR_SIZE - s_off, size - b_off);
+
+            int result = buffer_write(ino, entry->first.size, sector,
+                                      buffer + b_off, s_off, length);
+            if(result == FLFS_RET_WRBUF_FILL &&
+               fill_write_buffer_sector(entry->first, sector) == FLFS_RET_NONE)
+            {
+                result = buffer_write(ino, entry->first.size, sector,
+                                      buffer + b_off, s_off, length);
+            }
+
+            if(result != FLFS_RET_NONE) {
+                fuse_reply_err(req, EIO);
+                return;
+            }
+
+            b_off += length;
+            s_off = 0;
+            sector += 1;
+        }
+
+        entry->first.size = entry->first.size > off + size ?
+            entry->first.size : off + size;
+        update_inode_entry(entry);
+        fuse_reply_write(req, size);
+    }
+
+    /**
+     * Complete a buffered sector with its current contents on drive. Sectors
+     * beyond the size of the inode before buffering have no data on drive and
+     * are completed with zeros.
+     * @threadsafety: Ensure the inode is locked by the caller
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure
+     */
+    int FuseLFS::fill_write_buffer_sector(struct inode_entry entry,
+        uint64_t sector)
+    {
+        uint64_t size;
+        if(get_write_buffer_size(entry.inode, size) != FLFS_RET_NONE)
+            return FLFS_RET_ERR;
+
+        auto *buffer = (uint8_t*) sector_slab::alloc();
+        memset(buffer, 0, SECTOR_SIZE);
+
+        int result = FLFS_RET_NONE;
+        auto *blk = (struct data_block *) sector_slab::alloc();
+        if(sector * SECTOR_SIZE < size)
+            result = get_data_block(entry, sector / DATA_BLK_LBA_NUM, blk);
+
+        uint64_t lba = result == FLFS_RET_NONE && sector * SECTOR_SIZE < size ?
+            blk->data_lbas[sector % DATA_BLK_LBA_NUM] : 0;
+        if(lba != 0) {
+            struct data_position pos = {0};
+            lba_to_position(lba, pos);
+            if(nvme->read(pos.zone, pos.sector, pos.offset, buffer,
+                          SECTOR_SIZE) != 0)
+                result = FLFS_RET_ERR;
+        }
+
+        if(result == FLFS_RET_NONE)
+            result = fill_write_buffer(entry.inode, sector, buffer);
+
+        sector_slab::release(blk);
+        sector_slab::release(buffer);
+        return result;
+    }
+
+    /**
+     * Append the buffered writes of all inodes to the log with a single group
+     * commit per log stream and update their data_blocks with the resulting
+     * locations.
+     * Partially written sectors are completed with the data already on drive.
+     * The buffered writes are only removed once appended successfully.
+     * @threadsafety: Ensure all inodes are locked by the caller
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure and
+     *         FLFS_RET_LOGZ_FULL if the log zone is full.
+     */
+    int FuseLFS::flush_write_buffers(const std::vector<fuse_ino_t> &inodes) {
+        std::vector<enum log_stream> streams;
+        for(auto &ino : inodes)
+            streams.push_back(classify_log(LOG_DATA_BUFFERED, ino));
+
+        // Order the buffers by log stream so each stream is a single append
+        std::vector<std::pair<fuse_ino_t, struct write_buffer>> buffers;
+        uint64_t stream_sectors[N_LOG_STREAMS] = {0};
+        uint64_t num_sectors = 0;
+        for(uint32_t s = 0; s < N_LOG_STREAMS; s++) {
+            for(uint64_t i = 0; i < inodes.size(); i++) {
+                struct write_buffer buffer;
+                if(streams.at(i) != s ||
+                   get_write_buffer(inodes.at(i), &buffer) != FLFS_RET_NONE)
+                    continue;
+
+                stream_sectors[s] += buffer.sectors.size();
+                num_sectors += buffer.sectors.size();
+                buffers.emplace_back(inodes.at(i), std::move(buffer));
+            }
+        }
+
+        if(num_sectors == 0)
+            return FLFS_RET_NONE;
+
+        arena request;
+        auto sectors = (uint8_t*) request.alloc(num_sectors * SECTOR_SIZE);
+        if(sectors == nullptr)
+            return FLFS_RET_ERR;
+
+        // All data_blocks modified per inode
+        std::vector<data_map_t> blocks(buffers.size());
+        // The data_block number and index of every sector in the buffer
+        std::vector<std::pair<uint64_t, uint64_t>> sector_indices;
+
+        uint8_t *ptr = sectors;
+        for(uint64_t i = 0; i < buffers.size(); i++) {
+            inode_entry_t entry;
+            if(get_inode(buffers.at(i).first, &entry) != FLFS_RET_NONE)
+                return FLFS_RET_ERR;
+
+            auto &buffer = buffers.at(i).second;
+            for(auto &sector : buffer.sectors) {
+                uint64_t blk_num = sector.first / DATA_BLK_LBA_NUM;
+                uint64_t index = sector.first % DATA_BLK_LBA_NUM;
+
+                // Data_blocks covering the inode before buffering must exist
+                auto blk = blocks.at(i).find(blk_num);
+                if(blk == blocks.at(i).end()) {
+                    struct data_block db_blk = {0};
+                    if(get_data_block(entry.first, blk_num, &db_blk) !=
+                       FLFS_RET_NONE)
+                    {
+                        if(blk_num * DATA_BLK_LBA_NUM * SECTOR_SIZE <
+                           buffer.size)
+                            return FLFS_RET_ERR;
+                        memset(&db_blk, 0, sizeof(data_block));
+                    }
+                    blk = blocks.at(i).insert(
+                        std::make_pair(blk_num, db_blk)).first;
+                }
+
+                memcpy(ptr, sector.second.data, SECTOR_SIZE);
+
+                uint64_t cur_lba = sector.first * SECTOR_SIZE < buffer.size ?
+                    blk->second.data_lbas[index] : 0;
+                uint32_t length = sector.second.end - sector.second.start;
+                if(length != SECTOR_SIZE && prepare_sector(length,
+                   sector.second.start, cur_lba, (const char*)
+                   sector.second.data + sector.second.start, ptr) !=
+                   FLFS_RET_NONE)
+                    return FLFS_RET_ERR;
+
+                sector_indices.emplace_back(blk_num, index);
+                ptr += SECTOR_SIZE;
+            }
+        }
+
+        std::vector<uint64_t> lbas;
+        uint64_t submitted = 0;
+        ptr = sectors;
+        for(uint32_t s = 0; s < N_LOG_STREAMS; s++) {
+            if(stream_sectors[s] == 0) continue;
+
+            int result = log_append(ptr, stream_sectors[s] * SECTOR_SIZE,
+                lbas, (enum log_stream) s);
+            submitted += stream_sectors[s];
+
+            // The log zone can fill up with the final sectors of the append
+            if(lbas.size() != submitted)
+                return result == FLFS_RET_NONE ? FLFS_RET_ERR : result;
+
+            ptr += stream_sectors[s] * SECTOR_SIZE;
+        }
+
+        // Update location of data for every sector
+        uint64_t s = 0;
+        for(uint64_t i = 0; i < buffers.size(); i++) {
+            for(uint64_t j = 0; j < buffers.at(i).second.sectors.size(); j++) {
+                auto &index = sector_indices.at(s);
+                blocks.at(i).at(index.first).data_lbas[index.second] =
+                    lbas.at(s);
+                s += 1;
+            }
+
+            assign_data_blocks(buffers.at(i).first, &blocks.at(i));
+            remove_write_buffer(buffers.at(i).first);
+        }
+
+        return FLFS_RET_NONE;
+    }
+
+    /**
+     * Flush the buffered writes of every inode, see flush_write_buffers.
+     * @threadsafety: single threaded
+     */
+    int FuseLFS::flush_write_buffers() {
+        std::vector<fuse_ino_t> inodes;
+        get_write_buffer_inodes(&inodes);
+        return flush_write_buffers(inodes);
+    }
+
+    /**
+     * Flush the buffered writes of every inode if buffering the given number
+     * of sectors would exceed the total limit. Flushing only the inode being
+     * written would barely reduce the total if many inodes have small writes
+     * buffered.
+     * @threadsafety: single threaded
+     * @return FLFS_RET_NONE upon success or if the limit is not reached,
+     *         FLFS_RET_ERR upon failure and FLFS_RET_LOGZ_FULL if the log zone
+     *         is full.
+     */
+    int FuseLFS::flush_write_buffers_if_full(uint64_t sectors) {
+        if(!write_buffer_full(sectors))
+            return FLFS_RET_NONE;
+
+        return flush_write_buffers();
+    }
+
     /**
      * Make changes to an existing snapshot by writing buffer for size at off.
      * Updates the snapshot afterwards.
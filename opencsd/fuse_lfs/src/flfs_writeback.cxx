@@ -0,0 +1,212 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Dantali0n
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "flfs.hpp"
+
+namespace qemucsd::fuse_lfs {
+
+    /**
+     * @threadsafety: thread safe
+     * @return bytes of buffered writes and pending data_blocks
+     */
+    uint64_t FuseLFS::dirty_bytes() {
+        return (write_buffer_size() + data_blocks_dirty) * SECTOR_SIZE;
+    }
+
+    /**
+     * Record the time state first became pending, leaves the time unchanged
+     * if state was already pending.
+     * @threadsafety: thread safe
+     */
+    void FuseLFS::mark_dirty() {
+        int64_t clean = 0;
+        dirty_since.compare_exchange_strong(clean,
+            std::chrono::steady_clock::now().time_since_epoch().count());
+    }
+
+    /**
+     * Determine if pending state exceeds a fraction of the configured limits.
+     * @threadsafety: thread safe
+     * @param divisor divide each limit by this value before comparing
+     * @return true if any enabled limit is exceeded
+     */
+    bool FuseLFS::writeback_over_limit(uint64_t divisor) {
+        if(writeback_dirty_bytes != 0 &&
+           dirty_bytes() >= writeback_dirty_bytes / divisor)
+            return true;
+
+        if(writeback_dirty_inodes != 0 &&
+           inode_entries_size() >= writeback_dirty_inodes / divisor)
+            return true;
+
+        return false;
+    }
+
+    /**
+     * @threadsafety: thread safe
+     * @return true if state has been pending longer than the expire limit
+     */
+    bool FuseLFS::writeback_expired() {
+        int64_t since = dirty_since;
+        if(writeback_dirty_expire == 0 || since == 0)
+            return false;
+
+        auto age = std::chrono::steady_clock::now().time_since_epoch() -
+            std::chrono::steady_clock::duration(since);
+        return age >= std::chrono::milliseconds(writeback_dirty_expire);
+    }
+
+    /**
+     * Flush the pending state of at most WRITEBACK_BATCH inodes starting after
+     * the inode last written back, followed by all metadata. Holding the
+     * global lock only per round allows FUSE calls to proceed in between.
+     * @threadsafety: thread safe, acquires flfs_wrap global lock
+     * @param pending number of inodes with pending data before this round
+     * @return FLFS_RET_NONE upon success, FLFS_RET_ERR upon failure
+     */
+    int FuseLFS::writeback_round(uint64_t &pending) {
+        const lock_guard<pthread_rwlock_t> lock(gl, true);
+
+        std::vector<fuse_ino_t> inodes;
+        get_pending_inodes(&inodes);
+        pending = inodes.size();
+
+        // Continue after the last inode so every inode gets written back
+        std::rotate(inodes.begin(), std::upper_bound(inodes.begin(),
+            inodes.end(), writeback_cursor), inodes.end());
+        if(inodes.size() > WRITEBACK_BATCH)
+            inodes.resize(WRITEBACK_BATCH);
+        if(!inodes.empty())
+            writeback_cursor = inodes.back();
+
+        if(flush_pending(inodes) != FLFS_RET_NONE)
+            return FLFS_RET_ERR;
+
+        if(write_buffer_size() == 0 && data_blocks->empty() &&
+           inode_entries_size() == 0)
+            dirty_since = 0;
+
+        return FLFS_RET_NONE;
+    }
+
+    /**
+     * Body of the writeback thread, periodically flushes pending state once
+     * it expires or exceeds half of any of its limits. Writers throttled by
+     * writeback_throttle wake this thread early.
+     * @threadsafety: single threaded, only run by writeback_thread
+     */
+    void FuseLFS::writeback_run() {
+        std::unique_lock<std::mutex> lock(writeback_lck);
+        while(writeback_running) {
+            writeback_cv.wait_for(lock,
+                std::chrono::milliseconds(WRITEBACK_INTERVAL));
+
+            // Metadata only changes such as create do not pass the throttle
+            if(inode_entries_size() != 0)
+                mark_dirty();
+
+            // Expired state is written back in full, spread over rounds
+            bool expired = writeback_expired();
+            uint64_t rounds = 0;
+            uint64_t pending = 1;
+            while(writeback_running && ((expired &&
+                  rounds * WRITEBACK_BATCH < pending) ||
+                  writeback_over_limit(2)))
+            {
+                lock.unlock();
+                int result = writeback_round(pending);
+                lock.lock();
+                rounds += 1;
+
+                writeback_failed = result != FLFS_RET_NONE;
+                writeback_done_cv.notify_all();
+                if(writeback_failed) {
+                    output.error("Failed to write back pending state");
+                    break;
+                }
+            }
+
+            // Restart expiry for state written after the pass started
+            if(expired && dirty_since != 0)
+                dirty_since = std::chrono::steady_clock::now().
+                    time_since_epoch().count();
+        }
+
+        writeback_done_cv.notify_all();
+    }
+
+    /**
+     * Start the writeback thread unless all limits are disabled.
+     * @threadsafety: single threaded
+     */
+    void FuseLFS::start_writeback() {
+        if(writeback_dirty_bytes == 0 && writeback_dirty_inodes == 0 &&
+           writeback_dirty_expire == 0)
+            return;
+
+        std::lock_guard<std::mutex> lock(writeback_lck);
+        if(writeback_running) return;
+
+        writeback_running = true;
+        writeback_failed = false;
+        writeback_thread = std::thread(&FuseLFS::writeback_run, this);
+    }
+
+    /**
+     * Stop the writeback thread and wake any throttled writers, pending state
+     * is left for the caller to flush.
+     * @threadsafety: thread safe, must not hold flfs_wrap global lock
+     */
+    void FuseLFS::stop_writeback() {
+        {
+            std::lock_guard<std::mutex> lock(writeback_lck);
+            writeback_running = false;
+        }
+        writeback_cv.notify_all();
+        writeback_done_cv.notify_all();
+
+        if(writeback_thread.joinable())
+            writeback_thread.join();
+    }
+
+    /**
+     * Block the calling writer while pending state exceeds any of its limits
+     * until the writeback thread brings it back below them.
+     * @threadsafety: thread safe, must not hold flfs_wrap global lock
+     */
+    void FuseLFS::writeback_throttle() {
+        mark_dirty();
+        if(!writeback_over_limit(1))
+            return;
+
+        std::unique_lock<std::mutex> lock(writeback_lck);
+        while(writeback_running && !writeback_failed &&
+              writeback_over_limit(1))
+        {
+            writeback_cv.notify_one();
+            writeback_done_cv.wait(lock);
+        }
+    }
+}
@@ -125,6 +125,14 @@ namespace qemucsd::nvme_csd {
 		 */
 		void nvm_cmd_bpf_result(void *data);
 
+        /**
+         * Emulated NVMe command to retrieve BPF return data without copying
+         * it. Ownership of the buffer passes to the caller which must free it.
+         * @param data set to the buffer holding the data, nullptr if there is
+         *             no return data.
+         */
+        void nvm_cmd_bpf_result_move(void **data);
+
         /**
 		 * Emulated NVMe command to retrieve statistics of read / written device
          * areas.
@@ -149,6 +157,11 @@ namespace qemucsd::nvme_csd {
 		static int bpf_read(uint64_t zone, uint64_t sector, uint64_t offset,
             uint64_t size, void *data);
 
+        static int bpf_submit_read(uint64_t zone, uint64_t sector,
+            uint64_t offset, uint64_t size, void *data);
+
+        static int bpf_wait(void);
+
         static int bpf_write(uint64_t zone, uint64_t *sector, uint64_t offset,
             uint64_t size, void *data);
 
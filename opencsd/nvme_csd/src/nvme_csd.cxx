@@ -28,6 +28,10 @@ static qemucsd::nvme_csd::NvmeCsd *nvme_instance = nullptr;
 static uint64_t fs_call_size = 0;
 static void *return_data = nullptr;
 static int64_t return_size = 0;
+// Allocated size of return_data, retained between kernel invocations
+static uint64_t return_capacity = 0;
+// Reads submitted by the running BPF kernel that have not been waited on
+static qemucsd::nvme_zns::nvme_zns_batch bpf_batch;
 
 namespace qemucsd::nvme_csd {
 
@@ -79,7 +83,10 @@ namespace qemucsd::nvme_csd {
 
         /** uBPF Initialization */
         this->vm = ubpf_create();
-        this->vm_mem = malloc(this->vm_mem_size);
+
+        // VM memory is retained across kernel invocations
+        if(this->vm_mem == nullptr)
+            this->vm_mem = malloc(this->vm_mem_size);
 
         ubpf_register(vm, 1, "bpf_return_data", (void*)bpf_return_data);
         ubpf_register(vm, 2, "bpf_read", (void*)bpf_read);
@@ -89,16 +96,19 @@ namespace qemucsd::nvme_csd {
         ubpf_register(vm, 6, "bpf_get_zone_size", (void*)bpf_get_zone_size);
         ubpf_register(vm, 7, "bpf_get_mem_info", (void*)bpf_get_mem_info);
         ubpf_register(vm, 8, "bpf_get_call_info", (void*)bpf_get_call_info);
+        ubpf_register(vm, 10, "bpf_submit_read", (void*)bpf_submit_read);
+        ubpf_register(vm, 11, "bpf_wait", (void*)bpf_wait);
     }
 
     void NvmeCsd::vm_destroy() {
         measurements::measure_guard msr_guard(msr[MSRI_VM_DESTROY]);
 
+        // Kernels are not required to wait, reads can not outlive its memory
+        bpf_wait();
+
         ubpf_destroy(this->vm);
-        free(vm_mem);
 
         this->vm = nullptr;
-        this->vm_mem = nullptr;
     }
 
     int64_t NvmeCsd::_nvm_cmd_bpf_run(void *bpf_elf, uint64_t bpf_elf_size) {
@@ -158,8 +168,11 @@ namespace qemucsd::nvme_csd {
 
         // Copy call data into memory context accessible by uBPF vm.
         fs_call_size = call_size;
-        if(call_size > vm_mem_size)
+        if(call_size > vm_mem_size) {
+            fs_call_size = 0;
+            vm_destroy();
             return -ENOMEM;
+        }
         memcpy(vm_mem, call, call_size);
 
         int64_t result = _nvm_cmd_bpf_run(bpf_elf, bpf_elf_size);
@@ -174,15 +187,29 @@ namespace qemucsd::nvme_csd {
 	void NvmeCsd::nvm_cmd_bpf_result(void *data) {
         measurements::measure_guard msr_guard(msr[MSRI_BPF_RESULT]);
 
-		if(return_data == nullptr) return;
+		if(return_size == 0) return;
 
 		memcpy(data, return_data, return_size);
 
-		free(return_data);
-		return_data = nullptr;
+		// Keep the buffer for the next kernel to return data
 		return_size = 0;
 	}
 
+    void NvmeCsd::nvm_cmd_bpf_result_move(void **data) {
+        measurements::measure_guard msr_guard(msr[MSRI_BPF_RESULT]);
+
+        if(return_size == 0) {
+            *data = nullptr;
+            return;
+        }
+
+        *data = return_data;
+
+        return_data = nullptr;
+        return_size = 0;
+        return_capacity = 0;
+    }
+
     /**
      * Stats reports the lbas of read and written sectors as executed by the
      * BPF kernel. The VM is in complete control over these operations so the
@@ -196,9 +223,13 @@ namespace qemucsd::nvme_csd {
 	void NvmeCsd::bpf_return_data(void *data, uint64_t size) {
         measurements::measure_guard msr_guard(msr[MSRI_BPF_RETURN_DATA]);
 
-		if(return_data != nullptr) free(return_data);
+		// Only grow the buffer if the previous one is insufficient
+		if(return_capacity < size) {
+			free(return_data);
+			return_data = malloc(size);
+			return_capacity = size;
+		}
 
-		return_data = malloc(size);
 		memcpy(return_data, data, size);
 		return_size = size;
 	}
@@ -209,6 +240,33 @@ namespace qemucsd::nvme_csd {
         return nvme_instance->nvme->read(zone, sector, offset, data, size);
 	}
 
+    /**
+     * Submit a read without waiting for it to complete, allowing the kernel to
+     * keep many reads in flight. The data is only valid after bpf_wait.
+     */
+    int NvmeCsd::bpf_submit_read(uint64_t zone, uint64_t sector,
+        uint64_t offset, uint64_t size, void *data)
+    {
+        if(nvme_instance->nvme->submit_read(zone, sector, offset, data, size,
+                                            bpf_batch.track()) != 0)
+        {
+            bpf_batch.fail();
+            return -1;
+        }
+
+        return 0;
+    }
+
+    /**
+     * Wait for all reads submitted by the kernel.
+     * @return 0 if all reads succeeded, < 0 otherwise
+     */
+    int NvmeCsd::bpf_wait() {
+        int result = nvme_instance->nvme->wait(&bpf_batch);
+        bpf_batch.result.store(0);
+        return result;
+    }
+
     int NvmeCsd::bpf_write(uint64_t zone, uint64_t *sector, uint64_t offset,
         uint64_t size, void *data)
     {
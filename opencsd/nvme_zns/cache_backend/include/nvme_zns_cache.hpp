@@ -0,0 +1,202 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Dantali0n
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef QEMU_CSD_NVME_ZNS_CACHE_HPP
+#define QEMU_CSD_NVME_ZNS_CACHE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "measurements.hpp"
+#include "nvme_zns_backend.hpp"
+
+namespace qemucsd::nvme_zns {
+
+    /**
+     * Cached sector within a shard, _slot_ indexes the shard its data.
+     */
+    struct nvme_zns_cache_entry {
+        uint64_t slot;
+        // Whether the sector has been accessed more than once (Am) or not yet
+        // (A1in)
+        bool frequent;
+        std::list<uint64_t>::iterator position;
+    };
+
+    /**
+     * Independently locked part of the sector cache managed with the 2Q
+     * replacement policy. Sectors enter the A1in FIFO and are only promoted
+     * to the Am LRU if they are accessed again after being evicted from A1in
+     * while their address is still remembered in A1out. Sequential scans thus
+     * only cycle through A1in and do not evict frequently used sectors.
+     */
+    struct nvme_zns_cache_shard {
+        std::mutex lock;
+
+        // Sector LBAs, most recent at the front
+        std::list<uint64_t> a1in;
+        std::list<uint64_t> am;
+        std::list<uint64_t> a1out;
+
+        std::unordered_map<uint64_t, struct nvme_zns_cache_entry> entries;
+        std::unordered_map<uint64_t, std::list<uint64_t>::iterator> ghosts;
+
+        std::vector<uint8_t> data;
+        std::vector<uint64_t> free_slots;
+    };
+
+    /**
+     * Decorator caching sectors read from any other backend in memory. The
+     * cache is split into shards by LBA, each with its own lock and 2Q
+     * replacement policy.
+     *
+     * Data is never written through the cache, appends, copies, finishes and
+     * resets invalidate the affected sectors instead. Every zone carries an
+     * epoch that is incremented before invalidating, sectors read before an
+     * invalidation are not inserted once it started.
+     */
+    class NvmeZnsCacheBackend : public NvmeZnsBackend {
+    protected:
+        /** Measurement Instrumentation */
+        static size_t msr_hit_identifier;
+        static size_t msr_miss_identifier;
+
+        NvmeZnsBackend *backend;
+
+        // Maximum number of sectors per shard, 0 disables the cache
+        uint64_t shard_capacity;
+        // Maximum size of A1in and A1out per shard
+        uint64_t a1in_capacity;
+        uint64_t a1out_capacity;
+
+        std::vector<std::unique_ptr<struct nvme_zns_cache_shard>> shards;
+
+        std::vector<std::atomic<uint64_t>> zone_epochs;
+
+        static struct nvme_zns_info query_info(NvmeZnsBackend *backend);
+
+        NvmeZnsCacheBackend(NvmeZnsBackend *backend, uint64_t cache_size,
+            uint64_t num_shards, struct nvme_zns_info info);
+
+        struct nvme_zns_cache_shard *shard(uint64_t lba);
+
+        /**
+         * Copy _size_ bytes at _offset_ of the sector at _lba_ into _buffer_.
+         * @return 0 upon hit, -1 upon miss
+         */
+        int lookup(uint64_t lba, uint64_t offset, void *buffer, uint64_t size);
+
+        /**
+         * Insert the sector at _lba_ unless _zone_ was invalidated after
+         * _epoch_ was taken.
+         */
+        void insert(uint64_t lba, uint64_t zone, uint64_t epoch,
+            const void *buffer);
+
+        /**
+         * Copy the range from the cache into _buffer_.
+         * @return 0 if every sector was cached, -1 otherwise
+         */
+        int lookup_range(uint64_t zone, uint64_t sector, uint64_t offset,
+            void *buffer, uint64_t size);
+
+        void invalidate(uint64_t zone, uint64_t sector, uint64_t sectors);
+
+        bool cacheable(uint64_t zone, uint64_t sector, uint64_t offset,
+            uint64_t size);
+
+        /**
+         * Insert every whole sector of _iov_ read from the device.
+         */
+        void insert_iovec(struct nvme_zns_iovec *iov, uint64_t epoch);
+
+    public:
+        /**
+         * @param backend the decorated backend, must outlive the decorator.
+         * @param cache_size size of the cache in bytes, rounded down to whole
+         *                   sectors per shard.
+         */
+        NvmeZnsCacheBackend(NvmeZnsBackend *backend, uint64_t cache_size,
+            uint64_t num_shards = 16);
+
+        // Virtual required to enforce destructor is called in super classes
+        virtual ~NvmeZnsCacheBackend() = default;
+
+        void get_nvme_zns_info(struct nvme_zns_info* info) override;
+
+        int read(uint64_t zone, uint64_t sector, uint64_t offset, void* buffer,
+                 uint64_t size) override;
+
+        int append(uint64_t zone, uint64_t& sector, uint64_t offset,
+                   void* buffer, uint64_t size) override;
+
+        int reset(uint64_t zone) override;
+
+        int readv(struct nvme_zns_iovec *iov, uint64_t iovcnt) override;
+
+        int appendv(uint64_t zone, uint64_t& sector,
+                    struct nvme_zns_iovec *iov, uint64_t iovcnt) override;
+
+        int copy(struct nvme_zns_copy_range *ranges, uint64_t nranges,
+                 uint64_t zone, uint64_t &sector) override;
+
+        int map(uint64_t zone, uint64_t sector, uint64_t size,
+                const void **buffer) override;
+
+        int report_zones(uint64_t zone, struct nvme_zns_zone_desc *descs,
+                         uint64_t &count) override;
+
+        int finish(uint64_t zone) override;
+
+        int open(uint64_t zone) override;
+
+        int close(uint64_t zone) override;
+
+        int submit_read(uint64_t zone, uint64_t sector, uint64_t offset,
+                        void *buffer, uint64_t size,
+                        nvme_zns_callback_t callback) override;
+
+        int submit_readv(struct nvme_zns_iovec *iov, uint64_t iovcnt,
+                         nvme_zns_callback_t callback) override;
+
+        int submit_append(uint64_t zone, uint64_t offset, void *buffer,
+                          uint64_t size, nvme_zns_callback_t callback) override;
+
+        int submit_reset(uint64_t zone, nvme_zns_callback_t callback) override;
+
+        uint64_t poll() override;
+
+        int wait(struct nvme_zns_batch *batch) override;
+    };
+
+}
+
+#endif // QEMU_CSD_NVME_ZNS_CACHE_HPP
@@ -0,0 +1,571 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Dantali0n
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "nvme_zns_cache.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace qemucsd::nvme_zns {
+
+    size_t NvmeZnsCacheBackend::msr_hit_identifier = 0;
+    size_t NvmeZnsCacheBackend::msr_miss_identifier = 0;
+
+    NvmeZnsCacheBackend::NvmeZnsCacheBackend(NvmeZnsBackend *backend,
+        uint64_t cache_size, uint64_t num_shards) :
+        NvmeZnsCacheBackend(backend, cache_size, num_shards,
+                            query_info(backend))
+    {
+
+    }
+
+    NvmeZnsCacheBackend::NvmeZnsCacheBackend(NvmeZnsBackend *backend,
+        uint64_t cache_size, uint64_t num_shards, struct nvme_zns_info info) :
+        NvmeZnsBackend(info.num_zones, info.zone_size, info.zone_capacity,
+                       info.sector_size, info.max_open, info.max_active),
+        backend(backend), zone_epochs(info.num_zones)
+    {
+        measurements::register_namespace(
+            "NVME_ZNS_CACHE][hit", msr_hit_identifier);
+        measurements::register_namespace(
+            "NVME_ZNS_CACHE][miss", msr_miss_identifier);
+
+        if(num_shards == 0) num_shards = 1;
+        shard_capacity = cache_size / info.sector_size / num_shards;
+
+        // Recommended sizes of the 2Q paper, A1in holds a quarter of the
+        // sectors and A1out remembers half as many addresses as fit in the
+        // cache.
+        a1in_capacity = std::max<uint64_t>(shard_capacity / 4, 1);
+        a1out_capacity = std::max<uint64_t>(shard_capacity / 2, 1);
+
+        for(uint64_t i = 0; i < num_shards && shard_capacity != 0; i++) {
+            auto cache_shard = std::make_unique<nvme_zns_cache_shard>();
+            cache_shard->data.resize(shard_capacity * info.sector_size);
+            cache_shard->free_slots.reserve(shard_capacity);
+            for(uint64_t slot = shard_capacity; slot > 0; slot--) {
+                cache_shard->free_slots.push_back(slot - 1);
+            }
+            shards.emplace_back(std::move(cache_shard));
+        }
+    }
+
+    struct nvme_zns_info NvmeZnsCacheBackend::query_info(
+        NvmeZnsBackend *backend)
+    {
+        struct nvme_zns_info info = {0};
+        backend->get_nvme_zns_info(&info);
+        return info;
+    }
+
+    void NvmeZnsCacheBackend::get_nvme_zns_info(struct nvme_zns_info* info) {
+        NvmeZnsBackend::get_nvme_zns_info(info);
+    }
+
+    struct nvme_zns_cache_shard *NvmeZnsCacheBackend::shard(uint64_t lba) {
+        return shards.at(lba % shards.size()).get();
+    }
+
+    /**
+     * Sectors in A1in are not reordered upon access, that only happens once
+     * they are promoted to Am.
+     * @threadsafety: thread safe
+     */
+    int NvmeZnsCacheBackend::lookup(uint64_t lba, uint64_t offset,
+        void *buffer, uint64_t size)
+    {
+        auto cache_shard = shard(lba);
+        std::lock_guard<std::mutex> guard(cache_shard->lock);
+
+        auto it = cache_shard->entries.find(lba);
+        if(it == cache_shard->entries.end())
+            return -1;
+
+        if(it->second.frequent)
+            cache_shard->am.splice(cache_shard->am.begin(), cache_shard->am,
+                                   it->second.position);
+
+        memcpy(buffer, cache_shard->data.data() +
+               it->second.slot * info.sector_size + offset, size);
+        return 0;
+    }
+
+    /**
+     * @threadsafety: thread safe
+     */
+    void NvmeZnsCacheBackend::insert(uint64_t lba, uint64_t zone,
+        uint64_t epoch, const void *buffer)
+    {
+        auto cache_shard = shard(lba);
+        std::lock_guard<std::mutex> guard(cache_shard->lock);
+
+        if(zone_epochs.at(zone).load() != epoch)
+            return;
+
+        // Concurrent readers might have inserted the sector already
+        auto it = cache_shard->entries.find(lba);
+        if(it != cache_shard->entries.end()) {
+            memcpy(cache_shard->data.data() +
+                   it->second.slot * info.sector_size, buffer,
+                   info.sector_size);
+            return;
+        }
+
+        // Reclaim a slot, evicting from A1in only while it exceeds its share
+        // and remembering the evicted address in A1out.
+        if(cache_shard->free_slots.empty()) {
+            bool from_a1in = cache_shard->a1in.size() > a1in_capacity ||
+                cache_shard->am.empty();
+            auto &victims = from_a1in ? cache_shard->a1in : cache_shard->am;
+            uint64_t victim = victims.back();
+            victims.pop_back();
+
+            auto victim_it = cache_shard->entries.find(victim);
+            cache_shard->free_slots.push_back(victim_it->second.slot);
+            cache_shard->entries.erase(victim_it);
+
+            if(from_a1in) {
+                cache_shard->a1out.push_front(victim);
+                cache_shard->ghosts.insert_or_assign(victim,
+                    cache_shard->a1out.begin());
+                if(cache_shard->a1out.size() > a1out_capacity) {
+                    cache_shard->ghosts.erase(cache_shard->a1out.back());
+                    cache_shard->a1out.pop_back();
+                }
+            }
+        }
+
+        struct nvme_zns_cache_entry entry = {
+            cache_shard->free_slots.back(), false, {}
+        };
+        cache_shard->free_slots.pop_back();
+
+        // Recently evicted from A1in so accessed repeatedly, promote to Am
+        auto ghost = cache_shard->ghosts.find(lba);
+        if(ghost != cache_shard->ghosts.end()) {
+            cache_shard->a1out.erase(ghost->second);
+            cache_shard->ghosts.erase(ghost);
+            cache_shard->am.push_front(lba);
+            entry.frequent = true;
+            entry.position = cache_shard->am.begin();
+        }
+        else {
+            cache_shard->a1in.push_front(lba);
+            entry.position = cache_shard->a1in.begin();
+        }
+
+        memcpy(cache_shard->data.data() + entry.slot * info.sector_size,
+               buffer, info.sector_size);
+        cache_shard->entries.insert(std::make_pair(lba, entry));
+    }
+
+    /**
+     * Remove _sectors_ sectors starting at _sector_ of _zone_ from the cache.
+     * The epoch is incremented first so reads that are still in flight can
+     * not insert stale data afterwards.
+     * @threadsafety: thread safe
+     */
+    void NvmeZnsCacheBackend::invalidate(uint64_t zone, uint64_t sector,
+        uint64_t sectors)
+    {
+        if(zone >= info.num_zones) return;
+        zone_epochs.at(zone).fetch_add(1);
+
+        uint64_t lba;
+        position_to_lba(zone, sector, lba);
+        uint64_t end = lba + sectors;
+
+        uint64_t num_shards = shards.size();
+        for(uint64_t index = 0; index < num_shards; index++) {
+            auto &cache_shard = shards.at(index);
+            std::lock_guard<std::mutex> guard(cache_shard->lock);
+
+            // Scan the shard if that is cheaper than looking up every sector
+            if(cache_shard->entries.size() < sectors / num_shards) {
+                for(auto it = cache_shard->entries.begin();
+                    it != cache_shard->entries.end();)
+                {
+                    if(it->first < lba || it->first >= end) {
+                        it++;
+                        continue;
+                    }
+
+                    auto &queue = it->second.frequent ?
+                        cache_shard->am : cache_shard->a1in;
+                    queue.erase(it->second.position);
+                    cache_shard->free_slots.push_back(it->second.slot);
+                    it = cache_shard->entries.erase(it);
+                }
+                continue;
+            }
+
+            // First LBA in range belonging to this shard
+            uint64_t first = lba + (index + num_shards - lba % num_shards) %
+                num_shards;
+            for(uint64_t i = first; i < end; i += num_shards) {
+                auto it = cache_shard->entries.find(i);
+                if(it == cache_shard->entries.end()) continue;
+
+                auto &queue = it->second.frequent ?
+                    cache_shard->am : cache_shard->a1in;
+                queue.erase(it->second.position);
+                cache_shard->free_slots.push_back(it->second.slot);
+                cache_shard->entries.erase(it);
+            }
+        }
+    }
+
+    void NvmeZnsCacheBackend::insert_iovec(struct nvme_zns_iovec *iov,
+        uint64_t epoch)
+    {
+        uint64_t lba;
+        position_to_lba(iov->zone, iov->sector, lba);
+        for(uint64_t i = 0; (i + 1) * info.sector_size <= iov->size; i++) {
+            insert(lba + i, iov->zone, epoch,
+                   (uint8_t *) iov->buffer + i * info.sector_size);
+        }
+    }
+
+    /**
+     * Requests crossing zone boundaries or the device limits are passed to the
+     * decorated backend as is.
+     */
+    bool NvmeZnsCacheBackend::cacheable(uint64_t zone, uint64_t sector,
+        uint64_t offset, uint64_t size)
+    {
+        uint64_t sectors = (offset + size + info.sector_size - 1) /
+            info.sector_size;
+        return !shards.empty() && in_range(zone, sector, offset, size) == 0 &&
+            sector + sectors <= info.zone_capacity;
+    }
+
+    int NvmeZnsCacheBackend::lookup_range(uint64_t zone, uint64_t sector,
+        uint64_t offset, void *buffer, uint64_t size)
+    {
+        uint64_t lba;
+        position_to_lba(zone, sector, lba);
+
+        uint64_t done = 0;
+        for(uint64_t i = 0; done < size; i++) {
+            uint64_t start = i == 0 ? offset : 0;
+            uint64_t length = std::min(info.sector_size - start, size - done);
+            if(lookup(lba + i, start, (uint8_t *) buffer + done, length) != 0)
+                return -1;
+            done += length;
+        }
+
+        return 0;
+    }
+
+    /**
+     * Requests are served from the cache only if every sector they touch is
+     * cached. Otherwise all of them are read from the decorated backend with
+     * a single read and inserted.
+     */
+    int NvmeZnsCacheBackend::read(uint64_t zone, uint64_t sector,
+        uint64_t offset, void* buffer, uint64_t size)
+    {
+        if(!cacheable(zone, sector, offset, size))
+            return backend->read(zone, sector, offset, buffer, size);
+
+        uint64_t epoch = zone_epochs.at(zone).load();
+        if(lookup_range(zone, sector, offset, buffer, size) == 0) {
+            measurements::measure_guard msr_guard(msr_hit_identifier);
+            return 0;
+        }
+
+        measurements::measure_guard msr_guard(msr_miss_identifier);
+
+        uint64_t sectors = (offset + size + info.sector_size - 1) /
+            info.sector_size;
+        uint64_t lba;
+        position_to_lba(zone, sector, lba);
+
+        // Sector aligned requests do not require an intermediate buffer
+        bool aligned = offset == 0 && size % info.sector_size == 0;
+        std::vector<uint8_t> staging;
+        if(!aligned) staging.resize(sectors * info.sector_size);
+        auto *data = aligned ? (uint8_t *) buffer : staging.data();
+
+        if(backend->read(zone, sector, 0, data,
+                         sectors * info.sector_size) != 0)
+            return backend->read(zone, sector, offset, buffer, size);
+
+        for(uint64_t i = 0; i < sectors; i++) {
+            insert(lba + i, zone, epoch, data + i * info.sector_size);
+        }
+
+        if(!aligned) memcpy(buffer, data + offset, size);
+
+        return 0;
+    }
+
+    /**
+     * Only vectors not entirely cached are passed to the decorated backend,
+     * together in a single readv.
+     */
+    int NvmeZnsCacheBackend::readv(struct nvme_zns_iovec *iov,
+        uint64_t iovcnt)
+    {
+        if(shards.empty()) return backend->readv(iov, iovcnt);
+
+        std::vector<struct nvme_zns_iovec> missing;
+        std::vector<uint64_t> epochs;
+        for(uint64_t i = 0; i < iovcnt; i++) {
+            if(!cacheable(iov[i].zone, iov[i].sector, 0, iov[i].size)) {
+                missing.push_back(iov[i]);
+                epochs.push_back(UINT64_MAX);
+                continue;
+            }
+
+            uint64_t epoch = zone_epochs.at(iov[i].zone).load();
+            if(lookup_range(iov[i].zone, iov[i].sector, 0, iov[i].buffer,
+                            iov[i].size) != 0)
+            {
+                missing.push_back(iov[i]);
+                epochs.push_back(epoch);
+            }
+        }
+
+        if(missing.empty()) {
+            measurements::measure_guard msr_guard(msr_hit_identifier);
+            return 0;
+        }
+
+        measurements::measure_guard msr_guard(msr_miss_identifier);
+        if(backend->readv(missing.data(), missing.size()) != 0)
+            return -1;
+
+        for(uint64_t i = 0; i < missing.size(); i++) {
+            if(epochs.at(i) != UINT64_MAX)
+                insert_iovec(&missing.at(i), epochs.at(i));
+        }
+
+        return 0;
+    }
+
+    int NvmeZnsCacheBackend::append(uint64_t zone, uint64_t& sector,
+        uint64_t offset, void* buffer, uint64_t size)
+    {
+        int result = backend->append(zone, sector, offset, buffer, size);
+        if(result == 0)
+            invalidate(zone, sector, (offset + size + info.sector_size - 1) /
+                       info.sector_size);
+        return result;
+    }
+
+    int NvmeZnsCacheBackend::appendv(uint64_t zone, uint64_t& sector,
+        struct nvme_zns_iovec *iov, uint64_t iovcnt)
+    {
+        uint64_t size = 0;
+        for(uint64_t i = 0; i < iovcnt; i++) {
+            size += iov[i].size;
+        }
+
+        int result = backend->appendv(zone, sector, iov, iovcnt);
+        if(result == 0)
+            invalidate(zone, sector, (size + info.sector_size - 1) /
+                       info.sector_size);
+        return result;
+    }
+
+    /**
+     * The entire zone is invalidated even if the reset fails as its state is
+     * unknown afterwards.
+     */
+    int NvmeZnsCacheBackend::reset(uint64_t zone) {
+        int result = backend->reset(zone);
+        invalidate(zone, 0, info.zone_capacity);
+        return result;
+    }
+
+    int NvmeZnsCacheBackend::copy(struct nvme_zns_copy_range *ranges,
+        uint64_t nranges, uint64_t zone, uint64_t &sector)
+    {
+        uint64_t sectors = 0;
+        for(uint64_t i = 0; i < nranges; i++) {
+            sectors += ranges[i].sectors;
+        }
+
+        int result = backend->copy(ranges, nranges, zone, sector);
+        if(result == 0)
+            invalidate(zone, sector, sectors);
+        return result;
+    }
+
+    /**
+     * Data that can be mapped already resides in host memory so caching it
+     * would only add a copy, mapping bypasses the cache entirely.
+     */
+    int NvmeZnsCacheBackend::map(uint64_t zone, uint64_t sector,
+        uint64_t size, const void **buffer)
+    {
+        return backend->map(zone, sector, size, buffer);
+    }
+
+    int NvmeZnsCacheBackend::report_zones(uint64_t zone,
+        struct nvme_zns_zone_desc *descs, uint64_t &count)
+    {
+        return backend->report_zones(zone, descs, count);
+    }
+
+    /**
+     * Finishing a zone fills the remainder of the zone, invalidated just like
+     * a reset.
+     */
+    int NvmeZnsCacheBackend::finish(uint64_t zone) {
+        int result = backend->finish(zone);
+        invalidate(zone, 0, info.zone_capacity);
+        return result;
+    }
+
+    int NvmeZnsCacheBackend::open(uint64_t zone) {
+        return backend->open(zone);
+    }
+
+    int NvmeZnsCacheBackend::close(uint64_t zone) {
+        return backend->close(zone);
+    }
+
+    /**
+     * Requests entirely in the cache complete upon the next poll without
+     * involving the decorated backend.
+     */
+    int NvmeZnsCacheBackend::submit_read(uint64_t zone, uint64_t sector,
+        uint64_t offset, void *buffer, uint64_t size,
+        nvme_zns_callback_t callback)
+    {
+        if(!cacheable(zone, sector, offset, size))
+            return backend->submit_read(zone, sector, offset, buffer, size,
+                                        std::move(callback));
+
+        uint64_t epoch = zone_epochs.at(zone).load();
+        if(lookup_range(zone, sector, offset, buffer, size) == 0) {
+            measurements::measure_guard msr_guard(msr_hit_identifier);
+            complete(callback, 0, sector);
+            return 0;
+        }
+
+        measurements::measure_guard msr_guard(msr_miss_identifier);
+
+        // Only whole sectors in the callers buffer can be inserted
+        if(offset != 0)
+            return backend->submit_read(zone, sector, offset, buffer, size,
+                                        std::move(callback));
+
+        return backend->submit_read(zone, sector, offset, buffer, size,
+            [this, zone, sector, buffer, size, epoch, callback](
+                int result, uint64_t res_sector)
+            {
+                if(result == 0) {
+                    struct nvme_zns_iovec iov = {zone, sector, buffer, size};
+                    insert_iovec(&iov, epoch);
+                }
+                callback(result, res_sector);
+            });
+    }
+
+    int NvmeZnsCacheBackend::submit_readv(struct nvme_zns_iovec *iov,
+        uint64_t iovcnt, nvme_zns_callback_t callback)
+    {
+        if(shards.empty())
+            return backend->submit_readv(iov, iovcnt, std::move(callback));
+
+        // Epochs are taken before the lookup so they precede submission
+        std::vector<uint64_t> epochs(iovcnt, UINT64_MAX);
+        bool hit = true;
+        for(uint64_t i = 0; i < iovcnt; i++) {
+            if(!cacheable(iov[i].zone, iov[i].sector, 0, iov[i].size)) {
+                hit = false;
+                continue;
+            }
+
+            epochs.at(i) = zone_epochs.at(iov[i].zone).load();
+            if(hit && lookup_range(iov[i].zone, iov[i].sector, 0,
+                                   iov[i].buffer, iov[i].size) != 0)
+                hit = false;
+        }
+
+        if(hit) {
+            measurements::measure_guard msr_guard(msr_hit_identifier);
+            complete(callback, 0, 0);
+            return 0;
+        }
+
+        measurements::measure_guard msr_guard(msr_miss_identifier);
+
+        return backend->submit_readv(iov, iovcnt,
+            [this, iov, iovcnt, epochs, callback](
+                int result, uint64_t sector)
+            {
+                for(uint64_t i = 0; i < iovcnt && result == 0; i++) {
+                    if(epochs.at(i) != UINT64_MAX)
+                        insert_iovec(&iov[i], epochs.at(i));
+                }
+                callback(result, sector);
+            });
+    }
+
+    int NvmeZnsCacheBackend::submit_append(uint64_t zone, uint64_t offset,
+        void *buffer, uint64_t size, nvme_zns_callback_t callback)
+    {
+        return backend->submit_append(zone, offset, buffer, size,
+            [this, zone, offset, size, callback](int result, uint64_t sector)
+            {
+                if(result == 0)
+                    invalidate(zone, sector, (offset + size +
+                        info.sector_size - 1) / info.sector_size);
+                callback(result, sector);
+            });
+    }
+
+    int NvmeZnsCacheBackend::submit_reset(uint64_t zone,
+        nvme_zns_callback_t callback)
+    {
+        return backend->submit_reset(zone,
+            [this, zone, callback](int result, uint64_t sector) {
+                invalidate(zone, 0, info.zone_capacity);
+                callback(result, sector);
+            });
+    }
+
+    /**
+     * Reap both cache hits and completions of the decorated backend.
+     * @threadsafety: thread safe
+     */
+    uint64_t NvmeZnsCacheBackend::poll() {
+        return NvmeZnsBackend::poll() + backend->poll();
+    }
+
+    /**
+     * Cache hits are queued upon submission so after reaping them only
+     * operations of the decorated backend can remain in the batch.
+     * @threadsafety: thread safe
+     */
+    int NvmeZnsCacheBackend::wait(struct nvme_zns_batch *batch) {
+        NvmeZnsBackend::poll();
+        return backend->wait(batch);
+    }
+}
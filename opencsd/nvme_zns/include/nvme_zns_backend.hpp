@@ -25,13 +25,106 @@
 #ifndef QEMU_CSD_NVME_ZNS_BACKEND_HPP
 #define QEMU_CSD_NVME_ZNS_BACKEND_HPP
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
 
 #include "nvme_zns_info.hpp"
 
 namespace qemucsd::nvme_zns {
 
+    /**
+     * Single element of a scatter / gather request. Describes a linear range
+     * of _size_ bytes starting at _zone_ and _sector_, the range may span
+     * multiple sectors but never multiple zones.
+     */
+    struct nvme_zns_iovec {
+        uint64_t zone;
+        uint64_t sector;
+        void *buffer;
+        uint64_t size;
+    };
+
+    /**
+     * Source range of a copy, _sectors_ consecutive sectors starting at _zone_
+     * and _sector_. Like iovecs ranges never span multiple zones.
+     */
+    struct nvme_zns_copy_range {
+        uint64_t zone;
+        uint64_t sector;
+        uint64_t sectors;
+    };
+
+    /**
+     * Zone states as defined by the NVMe ZNS command set. Open and closed zones
+     * are active, the number of active and open zones can be limited by the
+     * device.
+     */
+    enum nvme_zns_zone_state {
+        ZONE_STATE_EMPTY,
+        ZONE_STATE_IMPLICIT_OPEN,
+        ZONE_STATE_EXPLICIT_OPEN,
+        ZONE_STATE_CLOSED,
+        ZONE_STATE_FULL,
+        ZONE_STATE_READ_ONLY,
+        ZONE_STATE_OFFLINE,
+    };
+
+    /**
+     * Description of a single zone as returned by report_zones, the write
+     * pointer is in sectors relative to the start of the zone.
+     */
+    struct nvme_zns_zone_desc {
+        uint64_t zone;
+        enum nvme_zns_zone_state state;
+        uint64_t write_pointer;
+        uint64_t capacity;
+    };
+
+    /**
+     * Completion callback for asynchronous operations. _result_ is 0 upon
+     * success and < 0 upon failure. For appends _sector_ indicates the start
+     * location of the written data.
+     */
+    typedef std::function<void(int result, uint64_t sector)>
+        nvme_zns_callback_t;
+
+    /**
+     * Group of asynchronous operations submitted by a single caller. Allows the
+     * caller to wait for just its own operations while others remain in flight.
+     */
+    struct nvme_zns_batch {
+        std::atomic<uint64_t> pending{0};
+        std::atomic<int> result{0};
+
+        /**
+         * Register an operation with the batch, the returned callback must be
+         * used to submit it.
+         */
+        nvme_zns_callback_t track() {
+            pending.fetch_add(1);
+            return [this](int res, uint64_t sector) {
+                if(res != 0) result.store(res);
+                pending.fetch_sub(1);
+            };
+        }
+
+        /**
+         * Unregister an operation of which the submission failed, its callback
+         * will never be called.
+         */
+        void fail() {
+            result.store(-1);
+            pending.fetch_sub(1);
+        }
+    };
+
     class NvmeZnsBackend {
     protected:
         uint64_t device_byte_size;
@@ -39,6 +132,19 @@ namespace qemucsd::nvme_zns {
 
         struct nvme_zns_info info;
 
+        // Callbacks of finished asynchronous operations waiting for poll
+        std::deque<std::function<void()>> completions;
+        std::mutex completion_lock;
+        std::condition_variable completion_cv;
+
+        /**
+         * Queue the callback of a finished asynchronous operation such that it
+         * is called upon the next poll.
+         * @threadsafety: thread safe
+         */
+        void complete(const nvme_zns_callback_t &callback, int result,
+            uint64_t sector);
+
         /**
          * Check that each of the individual params does not exceed the
          * underlying device hierarchy. In addition check that the combination
@@ -55,7 +161,8 @@ namespace qemucsd::nvme_zns {
          * _device_byte_size_ and _zone_byte_size_
          */
         NvmeZnsBackend(uint64_t num_zones,  uint64_t zone_size,
-            uint64_t zone_capacity, uint64_t sector_size, uint64_t max_open);
+            uint64_t zone_capacity, uint64_t sector_size, uint64_t max_open,
+            uint64_t max_active = 0);
 
         /**
          * Convert zone and requested sector to a Logical Block Address (LBA).
@@ -97,6 +204,123 @@ namespace qemucsd::nvme_zns {
          * @return  0 upon success, < 0 upon failure
          */
         virtual int reset(uint64_t zone) = 0;
+
+        /**
+         * Perform a scatter read of _iovcnt_ ranges described by _iov_. Each
+         * range is read into its own buffer. Backends should override this
+         * to service the entire request with as few device operations as
+         * possible, the default implementation falls back to a read per
+         * sector.
+         * @return 0 upon success, < 0 upon failure
+         */
+        virtual int readv(struct nvme_zns_iovec *iov, uint64_t iovcnt);
+
+        /**
+         * Perform a gather append of the _iovcnt_ buffers in _iov_ to the
+         * requested zone. The buffers are written linearly, every buffer but
+         * the last must be a multiple of the sector size. Update _sector_ to
+         * indicate start location of written data and set the zone and sector
+         * of every iovec to the location of its data. The request is refused
+         * as a whole if it does not fit in the remaining zone capacity.
+         * Backends should override this, the default implementation falls
+         * back to an append per sector. It can not refuse requests as a whole
+         * and is not atomic with respect to concurrent appends to the zone.
+         * @return 0 upon success, < 0 upon failure
+         */
+        virtual int appendv(uint64_t zone, uint64_t &sector,
+            struct nvme_zns_iovec *iov, uint64_t iovcnt);
+
+        /**
+         * Copy the _nranges_ source ranges linearly to the write pointer of
+         * _zone_ without transferring the data to the host, modelled after the
+         * NVMe simple copy command. Update _sector_ to indicate the start
+         * location of the copied data. Backends should override this, the
+         * default implementation reads and appends each sector through a host
+         * buffer.
+         * @return 0 upon success, < 0 upon failure
+         */
+        virtual int copy(struct nvme_zns_copy_range *ranges, uint64_t nranges,
+            uint64_t zone, uint64_t &sector);
+
+        /**
+         * Provide a pointer to _size_ bytes of written data starting at
+         * _sector_ of _zone_ in _buffer_ without copying it. Only backends
+         * that keep the device in host memory can support this, the data
+         * remains valid until the zone is reset. The default implementation is
+         * not supported and always fails, callers must fall back to read.
+         * @return 0 upon success, < 0 upon failure
+         */
+        virtual int map(uint64_t zone, uint64_t sector, uint64_t size,
+            const void **buffer);
+
+        /**
+         * Describe up to _count_ zones starting from _zone_ in _descs_, _count_
+         * is updated to the number of described zones. Allows determining all
+         * write pointers without probing the device. The default
+         * implementation is not supported and always fails.
+         * @return 0 upon success, < 0 upon failure
+         */
+        virtual int report_zones(uint64_t zone,
+            struct nvme_zns_zone_desc *descs, uint64_t &count);
+
+        /**
+         * Transition the zone to full, moving the write pointer to the zone
+         * capacity. Releases its open and active resources. The default
+         * implementation is not supported and always fails.
+         * @return 0 upon success, < 0 upon failure
+         */
+        virtual int finish(uint64_t zone);
+
+        /**
+         * Explicitly open the zone so it keeps its open resources until closed
+         * or full. The default implementation is not supported and always
+         * fails.
+         * @return 0 upon success, < 0 upon failure
+         */
+        virtual int open(uint64_t zone);
+
+        /**
+         * Close an open zone releasing its open but not its active resources.
+         * The default implementation is not supported and always fails.
+         * @return 0 upon success, < 0 upon failure
+         */
+        virtual int close(uint64_t zone);
+
+        /**
+         * Asynchronous variants of read, readv, append and reset. Submit the
+         * operation and return immediately, _callback_ is called once the
+         * operation finished. Callbacks are only ever called from within poll
+         * or wait so callers control on which thread they run. If submission
+         * fails the callback is never called. The default implementations
+         * complete the operation synchronously before returning. Buffers must
+         * remain valid until the callback is called.
+         * @return 0 upon successful submission, < 0 upon failure
+         */
+        virtual int submit_read(uint64_t zone, uint64_t sector,
+            uint64_t offset, void *buffer, uint64_t size,
+            nvme_zns_callback_t callback);
+
+        virtual int submit_readv(struct nvme_zns_iovec *iov, uint64_t iovcnt,
+            nvme_zns_callback_t callback);
+
+        virtual int submit_append(uint64_t zone, uint64_t offset,
+            void *buffer, uint64_t size, nvme_zns_callback_t callback);
+
+        virtual int submit_reset(uint64_t zone, nvme_zns_callback_t callback);
+
+        /**
+         * Reap finished asynchronous operations and call their callbacks
+         * without blocking.
+         * @return number of completed operations
+         */
+        virtual uint64_t poll();
+
+        /**
+         * Block until all operations in _batch_ have completed, completions
+         * of operations outside the batch are processed in the meantime.
+         * @return 0 if all operations succeeded, < 0 otherwise
+         */
+        virtual int wait(struct nvme_zns_batch *batch);
     };
 
 }
@@ -34,8 +34,10 @@ namespace qemucsd::nvme_zns {
     struct nvme_zns_info {
         // Number of zones
         uint64_t num_zones;
-        // Number of maximum open zones
+        // Number of maximum open zones, 0 if unlimited
         uint32_t max_open;
+        // Number of maximum active (open or closed) zones, 0 if unlimited
+        uint32_t max_active;
 
         // In bytes
         uint64_t sector_size;
@@ -25,11 +25,19 @@
 #ifndef QEMU_CSD_NVME_ZNS_MEMORY_HPP
 #define QEMU_CSD_NVME_ZNS_MEMORY_HPP
 
+#include <atomic>
+#include <condition_variable>
 #include <cstddef>
 #include <cstring>
+#include <deque>
+#include <functional>
 #include <iostream>
 #include <vector>
 #include <mutex>
+#include <thread>
+
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include "output.hpp"
 #include "measurements.hpp"
@@ -43,25 +51,91 @@ namespace qemucsd::nvme_zns {
     class NvmeZnsMemoryBackend : public NvmeZnsBackend {
     protected:
 
-        std::vector<uint64_t> write_pointers;
+        // Sectors below the write pointer are fully written, published with
+        // release semantics so readers only need to acquire the pointer.
+        std::atomic<uint64_t> *write_pointers;
+
+        // Serialize appends and resets per zone, reads never lock
+        std::vector<std::mutex> zone_locks;
 
-        std::mutex gl;
+        // Zone states and open / active resources, limits of 0 are unlimited.
+        // Always acquired after the zone lock.
+        std::vector<enum nvme_zns_zone_state> zone_states;
+        uint64_t num_open;
+        uint64_t num_active;
+        std::mutex state_lock;
 
         uintptr_t memory_limit;
 
         unsigned char* data;
 
+        // Data and write pointers are allocated by this class
+        bool owns_memory;
+
+        // Worker pool executing asynchronous operations, started lazily
+        uint64_t num_workers;
+        pid_t worker_pid;
+        bool workers_stop;
+        std::vector<std::thread> workers;
+        std::deque<std::function<void()>> jobs;
+        std::mutex job_lock;
+        std::condition_variable job_cv;
+
         // Measurement variables
         static size_t msr_read_identifier;
         static size_t msr_append_identifier;
         static size_t msr_reset_identifier;
+        static size_t msr_readv_identifier;
+        static size_t msr_appendv_identifier;
+        static size_t msr_copy_identifier;
 
         int compute_address(uint64_t zone, uint64_t sector, uint64_t offset,
                             uint64_t size, uintptr_t& address);
 
+        void set_zone_state(uint64_t zone, enum nvme_zns_zone_state state);
+
+        int open_zone(uint64_t zone, bool implicit);
+
+        void written_zone(uint64_t zone, uint64_t write_pointer);
+
+        void worker();
+
+        int submit_job(std::function<void()> job);
+
+        /**
+         * Stop and join the worker pool after completing all queued jobs,
+         * subclasses must call this before releasing the memory.
+         */
+        void stop_workers();
+
+        /**
+         * Zero the range of data starting at _address_ as part of a reset.
+         */
+        virtual void erase(uintptr_t address, uint64_t size);
+
+        /**
+         * Use the provided memory for data and write pointers instead of
+         * allocating it, if either is nullptr both are allocated. Zone states
+         * are derived from the write pointers.
+         */
+        NvmeZnsMemoryBackend(
+            uint64_t num_zones, uint64_t zone_size, uint64_t zone_capacity,
+            uint64_t sector_size, uint64_t num_workers, unsigned char *data,
+            std::atomic<uint64_t> *write_pointers, uint64_t max_open = 0,
+            uint64_t max_active = 0);
+
     public:
+        /**
+         * @param num_workers number of threads executing asynchronous
+         *        operations, 0 executes them synchronously upon submission.
+         * @param max_open maximum number of open zones, 0 if unlimited
+         * @param max_active maximum number of open or closed zones, 0 if
+         *        unlimited
+         */
         NvmeZnsMemoryBackend(
-            uint64_t num_zones,  uint64_t zone_size, uint64_t sector_size);
+            uint64_t num_zones,  uint64_t zone_size, uint64_t sector_size,
+            uint64_t num_workers = 4, uint64_t max_open = 0,
+            uint64_t max_active = 0);
 
         // Virtual required to enforce destructor is called in super classes
         virtual ~NvmeZnsMemoryBackend();
@@ -75,6 +149,38 @@ namespace qemucsd::nvme_zns {
                    void* buffer, uint64_t size) override;
 
         int reset(uint64_t zone) override;
+
+        int readv(struct nvme_zns_iovec *iov, uint64_t iovcnt) override;
+
+        int appendv(uint64_t zone, uint64_t& sector,
+                    struct nvme_zns_iovec *iov, uint64_t iovcnt) override;
+
+        int copy(struct nvme_zns_copy_range *ranges, uint64_t nranges,
+                 uint64_t zone, uint64_t &sector) override;
+
+        int map(uint64_t zone, uint64_t sector, uint64_t size,
+                const void **buffer) override;
+
+        int report_zones(uint64_t zone, struct nvme_zns_zone_desc *descs,
+                         uint64_t &count) override;
+
+        int finish(uint64_t zone) override;
+
+        int open(uint64_t zone) override;
+
+        int close(uint64_t zone) override;
+
+        int submit_read(uint64_t zone, uint64_t sector, uint64_t offset,
+                        void *buffer, uint64_t size,
+                        nvme_zns_callback_t callback) override;
+
+        int submit_readv(struct nvme_zns_iovec *iov, uint64_t iovcnt,
+                         nvme_zns_callback_t callback) override;
+
+        int submit_append(uint64_t zone, uint64_t offset, void *buffer,
+                          uint64_t size, nvme_zns_callback_t callback) override;
+
+        int submit_reset(uint64_t zone, nvme_zns_callback_t callback) override;
     };
 
 }
@@ -29,11 +29,30 @@ namespace qemucsd::nvme_zns {
     size_t NvmeZnsMemoryBackend::msr_read_identifier = 0;
     size_t NvmeZnsMemoryBackend::msr_append_identifier = 0;
     size_t NvmeZnsMemoryBackend::msr_reset_identifier = 0;
+    size_t NvmeZnsMemoryBackend::msr_readv_identifier = 0;
+    size_t NvmeZnsMemoryBackend::msr_appendv_identifier = 0;
+    size_t NvmeZnsMemoryBackend::msr_copy_identifier = 0;
 
     NvmeZnsMemoryBackend::NvmeZnsMemoryBackend(
-        uint64_t num_zones, uint64_t zone_size, uint64_t sector_size) :
-        // TODO(Dantali0n): Remove halving of zone capacity
-        NvmeZnsBackend(num_zones, zone_size, zone_size / 2, sector_size, 0)
+        uint64_t num_zones, uint64_t zone_size, uint64_t sector_size,
+        uint64_t num_workers, uint64_t max_open, uint64_t max_active) :
+        NvmeZnsMemoryBackend(num_zones, zone_size, zone_size, sector_size,
+                             num_workers, nullptr, nullptr, max_open,
+                             max_active)
+    {
+
+    }
+
+    NvmeZnsMemoryBackend::NvmeZnsMemoryBackend(
+        uint64_t num_zones, uint64_t zone_size, uint64_t zone_capacity,
+        uint64_t sector_size, uint64_t num_workers, unsigned char *data,
+        std::atomic<uint64_t> *write_pointers, uint64_t max_open,
+        uint64_t max_active) :
+        NvmeZnsBackend(num_zones, zone_size, zone_capacity, sector_size,
+                       max_open, max_active),
+        zone_locks(num_zones), zone_states(num_zones, ZONE_STATE_EMPTY),
+        num_open(0), num_active(0), num_workers(num_workers), worker_pid(0),
+        workers_stop(false)
     {
 
         measurements::register_namespace(
@@ -42,29 +61,160 @@ namespace qemucsd::nvme_zns {
             "NVME_ZNS_MEMORY][append", msr_append_identifier);
         measurements::register_namespace(
             "NVME_ZNS_MEMORY][reset", msr_reset_identifier);
-
-        info.max_open = 0;
+        measurements::register_namespace(
+            "NVME_ZNS_MEMORY][readv", msr_readv_identifier);
+        measurements::register_namespace(
+            "NVME_ZNS_MEMORY][appendv", msr_appendv_identifier);
+        measurements::register_namespace(
+            "NVME_ZNS_MEMORY][copy", msr_copy_identifier);
 
         uint64_t size = num_zones * info.zone_capacity * sector_size * sizeof(*data);
-        data = (unsigned char*) malloc(size);
+        zone_byte_size = info.zone_capacity * info.sector_size;
+
+        owns_memory = data == nullptr || write_pointers == nullptr;
+        if(!owns_memory) {
+            this->data = data;
+            this->write_pointers = write_pointers;
+            memory_limit = (uintptr_t) (void*)data + size;
+
+            // Partially written zones are closed as if the device was power
+            // cycled, these still count towards the active limit.
+            for(uint64_t i = 0; i < num_zones; i++) {
+                uint64_t write_pointer = write_pointers[i].load();
+                if(write_pointer >= info.zone_capacity)
+                    set_zone_state(i, ZONE_STATE_FULL);
+                else if(write_pointer != 0)
+                    set_zone_state(i, ZONE_STATE_CLOSED);
+            }
+            return;
+        }
+
+        // Only reserve address space, pages are materialized upon their first
+        // write so the size of the emulated device is not limited by memory.
+        void *map = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
 
-        if(!data) {
+        if(map == MAP_FAILED) {
             output(std::cerr, "nvm_zns_memory_backend memory allocation for ",
                 "size: ", size, " failed.");
             exit(1);
         }
 
-        zone_byte_size = info.zone_capacity * info.sector_size;
-        memory_limit = (uintptr_t) (void*)data + size;
+        this->data = (unsigned char*) map;
+
+        memory_limit = (uintptr_t) (void*)this->data + size;
 
-        write_pointers.resize(num_zones);
-        for(auto& write_pointer : write_pointers) {
-            write_pointer = 0;
+        this->write_pointers = new std::atomic<uint64_t>[num_zones];
+        for(uint64_t i = 0; i < num_zones; i++) {
+            this->write_pointers[i].store(0);
         }
     }
 
     NvmeZnsMemoryBackend::~NvmeZnsMemoryBackend() {
-        free(data);
+        stop_workers();
+
+        if(owns_memory) {
+            munmap(data, memory_limit - (uintptr_t) data);
+            delete[] write_pointers;
+        }
+    }
+
+    void NvmeZnsMemoryBackend::stop_workers() {
+        {
+            std::lock_guard<std::mutex> guard(job_lock);
+            workers_stop = true;
+        }
+        job_cv.notify_all();
+
+        // Threads of a parent process do not exist after fork
+        if(worker_pid == getpid()) {
+            for(auto &thread : workers) thread.join();
+        }
+        else {
+            for(auto &thread : workers) thread.detach();
+        }
+
+        workers.clear();
+    }
+
+    /**
+     * Release all whole pages in the range back to the system, these read as
+     * zeroes afterwards. Only partial pages at the edges are zeroed. Memory
+     * not allocated by this class is zeroed entirely as MADV_DONTNEED does
+     * not zero shared mappings.
+     */
+    void NvmeZnsMemoryBackend::erase(uintptr_t address, uint64_t size) {
+        static const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+
+        if(!owns_memory) {
+            memset(data + address, 0, size);
+            return;
+        }
+
+        uintptr_t start = (address + page_size - 1) / page_size * page_size;
+        uintptr_t end = (address + size) / page_size * page_size;
+        if(start >= end ||
+           madvise(data + start, end - start, MADV_DONTNEED) != 0)
+        {
+            memset(data + address, 0, size);
+            return;
+        }
+
+        memset(data + address, 0, start - address);
+        memset(data + end, 0, address + size - end);
+    }
+
+    /**
+     * Execute queued asynchronous operations until the backend is destroyed,
+     * pending operations are completed before stopping.
+     */
+    void NvmeZnsMemoryBackend::worker() {
+        while(true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(job_lock);
+                job_cv.wait(lock, [this]() {
+                    return workers_stop || !jobs.empty();
+                });
+                if(jobs.empty()) return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+
+    /**
+     * Queue the job for the worker pool. Workers are only started upon the
+     * first submission as threads do not survive the fork performed when
+     * daemonizing, pools from a parent process are restarted for the same
+     * reason.
+     * @threadsafety: thread safe
+     * @return 0 upon success, < 0 upon failure
+     */
+    int NvmeZnsMemoryBackend::submit_job(std::function<void()> job) {
+        if(num_workers == 0) {
+            job();
+            return 0;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(job_lock);
+            if(workers_stop) return -1;
+
+            if(worker_pid != getpid()) {
+                for(auto &thread : workers) thread.detach();
+                workers.clear();
+                worker_pid = getpid();
+                for(uint64_t i = 0; i < num_workers; i++)
+                    workers.emplace_back(&NvmeZnsMemoryBackend::worker, this);
+            }
+
+            jobs.emplace_back(std::move(job));
+        }
+        job_cv.notify_one();
+
+        return 0;
     }
 
     /**
@@ -83,24 +233,103 @@ namespace qemucsd::nvme_zns {
         return 0;
     }
 
+    /**
+     * Transition the zone to the new state while accounting for the open and
+     * active resources it holds, does not enforce any limits.
+     * @threadsafety: requires state_lock to be held
+     */
+    void NvmeZnsMemoryBackend::set_zone_state(uint64_t zone,
+        enum nvme_zns_zone_state state)
+    {
+        auto is_open = [](enum nvme_zns_zone_state s) {
+            return s == ZONE_STATE_IMPLICIT_OPEN ||
+                   s == ZONE_STATE_EXPLICIT_OPEN;
+        };
+        auto is_active = [&is_open](enum nvme_zns_zone_state s) {
+            return is_open(s) || s == ZONE_STATE_CLOSED;
+        };
+
+        enum nvme_zns_zone_state current = zone_states.at(zone);
+        num_open += is_open(state) - is_open(current);
+        num_active += is_active(state) - is_active(current);
+        zone_states.at(zone) = state;
+    }
+
+    /**
+     * Open the zone explicitly or implicitly as part of a write. Reaching the
+     * open limit closes an implicitly opened zone, just like a device would.
+     * @threadsafety: requires the zone lock to be held
+     * @return 0 upon success, < 0 if the zone is full or limits are exceeded
+     */
+    int NvmeZnsMemoryBackend::open_zone(uint64_t zone, bool implicit) {
+        std::lock_guard<std::mutex> guard(state_lock);
+
+        enum nvme_zns_zone_state state = zone_states.at(zone);
+        enum nvme_zns_zone_state target = implicit ?
+            ZONE_STATE_IMPLICIT_OPEN : ZONE_STATE_EXPLICIT_OPEN;
+
+        if(state == ZONE_STATE_EXPLICIT_OPEN) return 0;
+        if(state == ZONE_STATE_IMPLICIT_OPEN) {
+            set_zone_state(zone, implicit ? state : target);
+            return 0;
+        }
+        if(state != ZONE_STATE_EMPTY && state != ZONE_STATE_CLOSED)
+            return -1;
+
+        if(state == ZONE_STATE_EMPTY && info.max_active != 0 &&
+           num_active >= info.max_active)
+            return -1;
+
+        if(info.max_open != 0 && num_open >= info.max_open) {
+            uint64_t i = 0;
+            for(; i < info.num_zones; i++) {
+                if(zone_states[i] == ZONE_STATE_IMPLICIT_OPEN) break;
+            }
+            if(i == info.num_zones) return -1;
+            set_zone_state(i, ZONE_STATE_CLOSED);
+        }
+
+        set_zone_state(zone, target);
+        return 0;
+    }
+
+    /**
+     * Zones release their resources once the write pointer reaches capacity.
+     * @threadsafety: requires the zone lock to be held
+     */
+    void NvmeZnsMemoryBackend::written_zone(uint64_t zone,
+        uint64_t write_pointer)
+    {
+        if(write_pointer < info.zone_capacity) return;
+
+        std::lock_guard<std::mutex> guard(state_lock);
+        set_zone_state(zone, ZONE_STATE_FULL);
+    }
+
     void NvmeZnsMemoryBackend::get_nvme_zns_info(struct nvme_zns_info* info) {
         NvmeZnsBackend::get_nvme_zns_info(info);
     }
 
+    /**
+     * Lock free, sectors below the acquired write pointer are guaranteed to be
+     * fully written.
+     * @threadsafety: thread safe
+     */
     int NvmeZnsMemoryBackend::read(
         uint64_t zone, uint64_t sector, uint64_t offset, void* buffer,
         uint64_t size)
     {
         measurements::measure_guard msr_guard(msr_read_identifier);
-        std::lock_guard<std::mutex> guard(gl);
 
         uintptr_t address;
         // Determine address offset and verify in range
         if(compute_address(zone, sector, offset, size, address) != 0)
             return -1;
 
-        // Refuse to read unwritten sectors
-        if(write_pointers.at(zone) <= sector) return -1;
+        // Refuse to read unwritten sectors, including those beyond the first
+        if(write_pointers[zone].load(std::memory_order_acquire) <
+           sector + (offset + size + info.sector_size - 1) / info.sector_size)
+            return -1;
 
         output(std::cout, output::DEBUG,"read: [", zone, "][", sector, "][",
                offset, "][", size, "]");
@@ -110,22 +339,32 @@ namespace qemucsd::nvme_zns {
         return 0;
     }
 
+    /**
+     * Appends are serialized per zone, the write pointer is only advanced
+     * after the data has been written.
+     * @threadsafety: thread safe
+     */
     int NvmeZnsMemoryBackend::append(
         uint64_t zone, uint64_t& sector, uint64_t offset, void* buffer,
         uint64_t size)
     {
         measurements::measure_guard msr_guard(msr_append_identifier);
-        std::lock_guard<std::mutex> guard(gl);
+
+        if(zone >= info.num_zones) return -1;
+        std::lock_guard<std::mutex> guard(zone_locks.at(zone));
+
+        // Only appends modify the write pointer and they hold the zone lock
+        uint64_t write_pointer =
+            write_pointers[zone].load(std::memory_order_relaxed);
 
         uint64_t remainder = (offset + size) % info.sector_size;
         uintptr_t address;
         // Determine address offset and verify in range
-        if(compute_address(zone, write_pointers.at(zone), offset, size,
-                           address) != 0)
+        if(compute_address(zone, write_pointer, offset, size, address) != 0)
             return -1;
 
         // Write pointer advancements
-        uint64_t temp_write_pointer = write_pointers.at(zone);
+        uint64_t temp_write_pointer = write_pointer;
         temp_write_pointer += (offset + size) / info.sector_size;
         if(remainder != 0) temp_write_pointer += 1;
 
@@ -133,13 +372,12 @@ namespace qemucsd::nvme_zns {
         if(temp_write_pointer > info.zone_capacity) return -1;
 
         // Only modify external variable after guaranteeing success
-        sector = write_pointers.at(zone);
+        sector = write_pointer;
 
         output(std::cout, output::DEBUG, "append: [", zone, "][", sector,
                "][", offset, "][", size, "]");
 
-        // All is well, update the write pointer
-        write_pointers.at(zone) = temp_write_pointer;
+        if(open_zone(zone, true) != 0) return -1;
 
         // Zero offset into the sector if the offset is non zeros
         if(offset != 0) memset(data + address - offset, 0, offset);
@@ -147,25 +385,340 @@ namespace qemucsd::nvme_zns {
         memcpy(data + address, buffer, size);
 
         // Zero remainder of last sector
-        if(remainder != 0) memset(data + address + size, 0, remainder);
+        if(remainder != 0)
+            memset(data + address + size, 0, info.sector_size - remainder);
+
+        // All is well, publish the written sectors to readers
+        write_pointers[zone].store(temp_write_pointer,
+                                      std::memory_order_release);
+        written_zone(zone, temp_write_pointer);
 
         return 0;
     }
 
     int NvmeZnsMemoryBackend::reset(uint64_t zone) {
         measurements::measure_guard msr_guard(msr_reset_identifier);
-        std::lock_guard<std::mutex> guard(gl);
 
         uintptr_t address = zone * info.zone_capacity * info.sector_size;
-        if(memory_limit < (uintptr_t) data + address + zone_byte_size)
+        if(zone >= info.num_zones ||
+           memory_limit < (uintptr_t) data + address + zone_byte_size)
             return -1;
 
+        std::lock_guard<std::mutex> guard(zone_locks.at(zone));
+
         output(std::cout, output::DEBUG, "reset: [", zone, "]");
 
-        write_pointers.at(zone) = 0;
+        // Readers that acquired the old write pointer may observe the zeroing,
+        // callers must not reset zones that are still being read.
+        write_pointers[zone].store(0, std::memory_order_release);
 
-        memset(data + address, 0, zone_byte_size);
+        erase(address, zone_byte_size);
+
+        std::lock_guard<std::mutex> state_guard(state_lock);
+        set_zone_state(zone, ZONE_STATE_EMPTY);
 
         return 0;
     };
-}
\ No newline at end of file
+
+    /**
+     * Scatter read all ranges, like read this never acquires a lock.
+     * @threadsafety: thread safe
+     */
+    int NvmeZnsMemoryBackend::readv(
+        struct nvme_zns_iovec *iov, uint64_t iovcnt)
+    {
+        measurements::measure_guard msr_guard(msr_readv_identifier);
+
+        for(uint64_t i = 0; i < iovcnt; i++) {
+            uintptr_t address;
+            // Determine address offset and verify in range
+            if(compute_address(iov[i].zone, iov[i].sector, 0, iov[i].size,
+                               address) != 0)
+                return -1;
+
+            // Refuse to read unwritten sectors or ranges spanning zones
+            uint64_t end = iov[i].sector +
+                (iov[i].size + info.sector_size - 1) / info.sector_size;
+            if(write_pointers[iov[i].zone].load(std::memory_order_acquire)
+               < end)
+                return -1;
+
+            memcpy(iov[i].buffer, data + address, iov[i].size);
+        }
+
+        output(std::cout, output::DEBUG, "readv: [", iovcnt, "]");
+
+        return 0;
+    }
+
+    /**
+     * Gather append all buffers linearly into the zone, the request as a whole
+     * is verified before any data is written.
+     * @threadsafety: thread safe
+     */
+    int NvmeZnsMemoryBackend::appendv(uint64_t zone, uint64_t& sector,
+        struct nvme_zns_iovec *iov, uint64_t iovcnt)
+    {
+        measurements::measure_guard msr_guard(msr_appendv_identifier);
+
+        if(iovcnt == 0 || zone >= info.num_zones) return -1;
+        std::lock_guard<std::mutex> guard(zone_locks.at(zone));
+
+        uint64_t write_pointer =
+            write_pointers[zone].load(std::memory_order_relaxed);
+
+        // Only the last buffer is allowed to partially fill a sector
+        uint64_t size = 0;
+        for(uint64_t i = 0; i < iovcnt; i++) {
+            if(i != iovcnt - 1 && iov[i].size % info.sector_size != 0)
+                return -1;
+            size += iov[i].size;
+        }
+
+        uintptr_t address;
+        // Determine address offset and verify in range
+        if(compute_address(zone, write_pointer, 0, size, address) != 0)
+            return -1;
+
+        // Write pointer should never advance into next zone
+        uint64_t temp_write_pointer = write_pointer +
+            (size + info.sector_size - 1) / info.sector_size;
+        if(temp_write_pointer > info.zone_capacity) return -1;
+
+        sector = write_pointer;
+
+        if(open_zone(zone, true) != 0) return -1;
+
+        output(std::cout, output::DEBUG, "appendv: [", zone, "][", sector,
+               "][", iovcnt, "][", size, "]");
+
+        for(uint64_t i = 0; i < iovcnt; i++) {
+            iov[i].zone = zone;
+            iov[i].sector = write_pointer;
+
+            memcpy(data + address, iov[i].buffer, iov[i].size);
+            address += iov[i].size;
+            write_pointer +=
+                (iov[i].size + info.sector_size - 1) / info.sector_size;
+        }
+
+        // Zero remainder of last sector
+        uint64_t remainder = size % info.sector_size;
+        if(remainder != 0)
+            memset(data + address, 0, info.sector_size - remainder);
+
+        // Publish all written sectors to readers at once
+        write_pointers[zone].store(temp_write_pointer,
+                                      std::memory_order_release);
+        written_zone(zone, temp_write_pointer);
+
+        return 0;
+    }
+
+    /**
+     * Copy all ranges within device memory, the request as a whole is verified
+     * before any data is written. Source ranges must be fully written, ranges
+     * in the destination zone itself are allowed.
+     * @threadsafety: thread safe
+     */
+    int NvmeZnsMemoryBackend::copy(struct nvme_zns_copy_range *ranges,
+        uint64_t nranges, uint64_t zone, uint64_t &sector)
+    {
+        measurements::measure_guard msr_guard(msr_copy_identifier);
+
+        if(nranges == 0 || zone >= info.num_zones) return -1;
+        std::lock_guard<std::mutex> guard(zone_locks.at(zone));
+
+        uint64_t write_pointer =
+            write_pointers[zone].load(std::memory_order_relaxed);
+
+        uint64_t sectors = 0;
+        for(uint64_t i = 0; i < nranges; i++) {
+            uintptr_t address;
+            if(compute_address(ranges[i].zone, ranges[i].sector, 0,
+                               ranges[i].sectors * info.sector_size,
+                               address) != 0)
+                return -1;
+
+            // Refuse to copy unwritten sectors or ranges spanning zones
+            if(write_pointers[ranges[i].zone].load(std::memory_order_acquire)
+               < ranges[i].sector + ranges[i].sectors)
+                return -1;
+
+            sectors += ranges[i].sectors;
+        }
+
+        uintptr_t address;
+        // Determine address offset and verify in range
+        if(compute_address(zone, write_pointer, 0, sectors * info.sector_size,
+                           address) != 0)
+            return -1;
+
+        // Write pointer should never advance into next zone
+        if(write_pointer + sectors > info.zone_capacity) return -1;
+
+        if(open_zone(zone, true) != 0) return -1;
+
+        sector = write_pointer;
+
+        output(std::cout, output::DEBUG, "copy: [", zone, "][", sector,
+               "][", nranges, "][", sectors, "]");
+
+        // Sources are below their write pointer and never overlap the
+        // unwritten destination.
+        for(uint64_t i = 0; i < nranges; i++) {
+            uintptr_t source;
+            compute_address(ranges[i].zone, ranges[i].sector, 0,
+                            ranges[i].sectors * info.sector_size, source);
+
+            memcpy(data + address, data + source,
+                   ranges[i].sectors * info.sector_size);
+            address += ranges[i].sectors * info.sector_size;
+        }
+
+        write_pointers[zone].store(write_pointer + sectors,
+                                   std::memory_order_release);
+        written_zone(zone, write_pointer + sectors);
+
+        return 0;
+    }
+
+    /**
+     * Device memory is never unmapped during the lifetime of the backend,
+     * subject to the same write pointer check as read.
+     * @threadsafety: thread safe
+     */
+    int NvmeZnsMemoryBackend::map(uint64_t zone, uint64_t sector,
+        uint64_t size, const void **buffer)
+    {
+        uintptr_t address;
+        if(compute_address(zone, sector, 0, size, address) != 0)
+            return -1;
+
+        if(write_pointers[zone].load(std::memory_order_acquire) <
+           sector + (size + info.sector_size - 1) / info.sector_size)
+            return -1;
+
+        *buffer = data + address;
+
+        return 0;
+    }
+
+    /**
+     * @threadsafety: thread safe
+     */
+    int NvmeZnsMemoryBackend::report_zones(uint64_t zone,
+        struct nvme_zns_zone_desc *descs, uint64_t &count)
+    {
+        if(zone >= info.num_zones) return -1;
+        if(count > info.num_zones - zone) count = info.num_zones - zone;
+
+        std::lock_guard<std::mutex> guard(state_lock);
+        for(uint64_t i = 0; i < count; i++) {
+            descs[i].zone = zone + i;
+            descs[i].state = zone_states[zone + i];
+            descs[i].write_pointer =
+                write_pointers[zone + i].load(std::memory_order_acquire);
+            descs[i].capacity = info.zone_capacity;
+        }
+
+        return 0;
+    }
+
+    /**
+     * Unwritten sectors of the zone become readable as zeros.
+     * @threadsafety: thread safe
+     */
+    int NvmeZnsMemoryBackend::finish(uint64_t zone) {
+        if(zone >= info.num_zones) return -1;
+        std::lock_guard<std::mutex> guard(zone_locks.at(zone));
+
+        uint64_t write_pointer =
+            write_pointers[zone].load(std::memory_order_relaxed);
+
+        output(std::cout, output::DEBUG, "finish: [", zone, "]");
+
+        if(write_pointer < info.zone_capacity) {
+            erase(zone * zone_byte_size + write_pointer * info.sector_size,
+                  (info.zone_capacity - write_pointer) * info.sector_size);
+            write_pointers[zone].store(info.zone_capacity,
+                                       std::memory_order_release);
+        }
+
+        written_zone(zone, info.zone_capacity);
+
+        return 0;
+    }
+
+    /**
+     * @threadsafety: thread safe
+     */
+    int NvmeZnsMemoryBackend::open(uint64_t zone) {
+        if(zone >= info.num_zones) return -1;
+        std::lock_guard<std::mutex> guard(zone_locks.at(zone));
+
+        return open_zone(zone, false);
+    }
+
+    /**
+     * Closed zones keep their active resources unless nothing was written.
+     * @threadsafety: thread safe
+     */
+    int NvmeZnsMemoryBackend::close(uint64_t zone) {
+        if(zone >= info.num_zones) return -1;
+        std::lock_guard<std::mutex> guard(zone_locks.at(zone));
+        std::lock_guard<std::mutex> state_guard(state_lock);
+
+        enum nvme_zns_zone_state state = zone_states[zone];
+        if(state == ZONE_STATE_CLOSED) return 0;
+        if(state != ZONE_STATE_IMPLICIT_OPEN &&
+           state != ZONE_STATE_EXPLICIT_OPEN)
+            return -1;
+
+        set_zone_state(zone, write_pointers[zone].load() == 0 ?
+            ZONE_STATE_EMPTY : ZONE_STATE_CLOSED);
+
+        return 0;
+    }
+
+    int NvmeZnsMemoryBackend::submit_read(uint64_t zone, uint64_t sector,
+        uint64_t offset, void *buffer, uint64_t size,
+        nvme_zns_callback_t callback)
+    {
+        return submit_job([=]() {
+            complete(callback, read(zone, sector, offset, buffer, size),
+                     sector);
+        });
+    }
+
+    int NvmeZnsMemoryBackend::submit_readv(struct nvme_zns_iovec *iov,
+        uint64_t iovcnt, nvme_zns_callback_t callback)
+    {
+        return submit_job([=]() {
+            complete(callback, readv(iov, iovcnt), 0);
+        });
+    }
+
+    /**
+     * The location of the data is only known once the job is executed, jobs
+     * for the same zone may be executed out of submission order.
+     * @threadsafety: thread safe
+     */
+    int NvmeZnsMemoryBackend::submit_append(uint64_t zone, uint64_t offset,
+        void *buffer, uint64_t size, nvme_zns_callback_t callback)
+    {
+        return submit_job([=]() {
+            uint64_t sector = 0;
+            int result = append(zone, sector, offset, buffer, size);
+            complete(callback, result, sector);
+        });
+    }
+
+    int NvmeZnsMemoryBackend::submit_reset(uint64_t zone,
+        nvme_zns_callback_t callback)
+    {
+        return submit_job([=]() {
+            complete(callback, reset(zone), 0);
+        });
+    }
+}
@@ -0,0 +1,111 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Dantali0n
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef QEMU_CSD_NVME_ZNS_MMAP_HPP
+#define QEMU_CSD_NVME_ZNS_MMAP_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "nvme_zns_memory.hpp"
+
+namespace qemucsd::nvme_zns {
+
+    // "OCSDMMAP" in little endian
+    static constexpr uint64_t NVME_ZNS_MMAP_MAGIC = 0x50414d4d4453434f;
+    static constexpr uint64_t NVME_ZNS_MMAP_VERSION = 1;
+
+    /**
+     * Header at the start of the image, followed by the write pointer of every
+     * zone. The data of the zones starts at the first page after the header.
+     */
+    struct nvme_zns_mmap_header {
+        uint64_t magic;
+        uint64_t version;
+        uint64_t num_zones;
+        uint64_t zone_size;
+        uint64_t zone_capacity;
+        uint64_t sector_size;
+    };
+
+    /**
+     * Description of a mapped image used during construction.
+     */
+    struct nvme_zns_mmap_image {
+        int fd;
+        void *map;
+        uint64_t map_size;
+        uint64_t header_size;
+    };
+
+    /**
+     * Persistent variant of the memory backend. The device is stored in a
+     * sparse file that is mapped using MAP_SHARED so only written sectors
+     * occupy space and images of any size open instantly. Write pointers live
+     * inside the mapping and thus survive restarts together with the data.
+     * Reset zones are punched out of the file to release their space.
+     *
+     * Persistence relies on the page cache of the host, data is only
+     * guaranteed to reach the disk upon destruction.
+     */
+    class NvmeZnsMmapBackend : public NvmeZnsMemoryBackend {
+    protected:
+        struct nvme_zns_mmap_image image;
+
+        static struct nvme_zns_mmap_image open_image(const std::string &path,
+            uint64_t num_zones, uint64_t zone_size, uint64_t sector_size);
+
+        static std::atomic<uint64_t> *image_write_pointers(
+            struct nvme_zns_mmap_image &image);
+
+        NvmeZnsMmapBackend(struct nvme_zns_mmap_image image,
+            uint64_t num_zones, uint64_t zone_size, uint64_t sector_size,
+            uint64_t num_workers, uint64_t max_open, uint64_t max_active);
+
+        void erase(uintptr_t address, uint64_t size) override;
+
+    public:
+        /**
+         * Open the image at _path_ or create it if it does not exist or is
+         * empty. Existing images must match the requested geometry.
+         * @param num_workers number of threads executing asynchronous
+         *        operations, 0 executes them synchronously upon submission.
+         * @param max_open maximum number of open zones, 0 if unlimited
+         * @param max_active maximum number of open or closed zones, 0 if
+         *        unlimited
+         */
+        NvmeZnsMmapBackend(const std::string &path, uint64_t num_zones,
+            uint64_t zone_size, uint64_t sector_size,
+            uint64_t num_workers = 4, uint64_t max_open = 0,
+            uint64_t max_active = 0);
+
+        // Virtual required to enforce destructor is called in super classes
+        virtual ~NvmeZnsMmapBackend();
+    };
+
+}
+
+#endif // QEMU_CSD_NVME_ZNS_MMAP_HPP
@@ -0,0 +1,162 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Dantali0n
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "nvme_zns_mmap.hpp"
+
+extern "C" {
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+}
+
+namespace qemucsd::nvme_zns {
+
+    static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t),
+        "Write pointers are stored in the image as plain integers");
+
+    NvmeZnsMmapBackend::NvmeZnsMmapBackend(const std::string &path,
+        uint64_t num_zones, uint64_t zone_size, uint64_t sector_size,
+        uint64_t num_workers, uint64_t max_open, uint64_t max_active) :
+        NvmeZnsMmapBackend(open_image(path, num_zones, zone_size, sector_size),
+                           num_zones, zone_size, sector_size, num_workers,
+                           max_open, max_active)
+    {
+
+    }
+
+    NvmeZnsMmapBackend::NvmeZnsMmapBackend(struct nvme_zns_mmap_image image,
+        uint64_t num_zones, uint64_t zone_size, uint64_t sector_size,
+        uint64_t num_workers, uint64_t max_open, uint64_t max_active) :
+        NvmeZnsMemoryBackend(num_zones, zone_size, zone_size, sector_size,
+            num_workers, (unsigned char*) image.map + image.header_size,
+            image_write_pointers(image), max_open, max_active),
+        image(image)
+    {
+
+    }
+
+    NvmeZnsMmapBackend::~NvmeZnsMmapBackend() {
+        // Workers must not access the mapping after it is released
+        stop_workers();
+
+        msync(image.map, image.map_size, MS_SYNC);
+        munmap(image.map, image.map_size);
+        ::close(image.fd);
+    }
+
+    /**
+     * Open or create the image and map it entirely, exits upon failure as the
+     * backend can not be constructed without it.
+     */
+    struct nvme_zns_mmap_image NvmeZnsMmapBackend::open_image(
+        const std::string &path, uint64_t num_zones, uint64_t zone_size,
+        uint64_t sector_size)
+    {
+        struct nvme_zns_mmap_image image = {0};
+
+        // Data starts at the first page following the header
+        uint64_t page_size = sysconf(_SC_PAGESIZE);
+        image.header_size = sizeof(struct nvme_zns_mmap_header) +
+            num_zones * sizeof(uint64_t);
+        image.header_size = (image.header_size + page_size - 1) / page_size *
+            page_size;
+        image.map_size = image.header_size +
+            num_zones * zone_size * sector_size;
+
+        image.fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if(image.fd < 0) {
+            output(std::cerr, "nvme_zns_mmap_backend failed to open ", path);
+            exit(1);
+        }
+
+        struct stat st = {0};
+        if(fstat(image.fd, &st) != 0) {
+            output(std::cerr, "nvme_zns_mmap_backend failed to stat ", path);
+            exit(1);
+        }
+
+        // Sparse allocation, no space is used until sectors are written
+        bool create = st.st_size == 0;
+        if(create && ftruncate(image.fd, image.map_size) != 0) {
+            output(std::cerr, "nvme_zns_mmap_backend failed to allocate ",
+                image.map_size, " bytes for ", path);
+            exit(1);
+        }
+        else if(!create && (uint64_t) st.st_size != image.map_size) {
+            output(std::cerr, "nvme_zns_mmap_backend image ", path, " size ",
+                st.st_size, " does not match geometry of ", image.map_size,
+                " bytes");
+            exit(1);
+        }
+
+        image.map = mmap(nullptr, image.map_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, image.fd, 0);
+        if(image.map == MAP_FAILED) {
+            output(std::cerr, "nvme_zns_mmap_backend failed to map ", path);
+            exit(1);
+        }
+
+        auto *header = (struct nvme_zns_mmap_header*) image.map;
+        if(create) {
+            // Write pointers are already zero due to ftruncate
+            *header = {NVME_ZNS_MMAP_MAGIC, NVME_ZNS_MMAP_VERSION, num_zones,
+                zone_size, zone_size, sector_size};
+            return image;
+        }
+
+        if(header->magic != NVME_ZNS_MMAP_MAGIC ||
+           header->version != NVME_ZNS_MMAP_VERSION ||
+           header->num_zones != num_zones || header->zone_size != zone_size ||
+           header->zone_capacity != zone_size ||
+           header->sector_size != sector_size)
+        {
+            output(std::cerr, "nvme_zns_mmap_backend image ", path,
+                " is not a compatible image");
+            exit(1);
+        }
+
+        return image;
+    }
+
+    std::atomic<uint64_t> *NvmeZnsMmapBackend::image_write_pointers(
+        struct nvme_zns_mmap_image &image)
+    {
+        return (std::atomic<uint64_t>*) ((uint8_t*) image.map +
+            sizeof(struct nvme_zns_mmap_header));
+    }
+
+    /**
+     * Release the space of the range by punching a hole in the image, only
+     * falls back to zeroing if the filesystem does not support this.
+     */
+    void NvmeZnsMmapBackend::erase(uintptr_t address, uint64_t size) {
+        if(fallocate(image.fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+            image.header_size + address, size) == 0)
+            return;
+
+        // Pages of a shared file mapping are not zeroed by MADV_DONTNEED
+        memset(data + address, 0, size);
+    }
+}
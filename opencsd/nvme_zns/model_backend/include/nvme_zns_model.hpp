@@ -0,0 +1,157 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Dantali0n
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef QEMU_CSD_NVME_ZNS_MODEL_HPP
+#define QEMU_CSD_NVME_ZNS_MODEL_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "nvme_zns_backend.hpp"
+
+namespace qemucsd::nvme_zns {
+
+    /**
+     * Performance characteristics of the modelled device.
+     */
+    struct nvme_zns_model {
+        // Fixed latency per operation in microseconds
+        uint64_t read_latency;
+        uint64_t append_latency;
+        uint64_t reset_latency;
+        // Bandwidth of the entire device in bytes per second, 0 is unlimited
+        uint64_t read_bandwidth;
+        uint64_t append_bandwidth;
+        // Number of channels / dies operating in parallel
+        uint64_t num_channels;
+    };
+
+    typedef std::chrono::steady_clock::time_point nvme_zns_model_time_t;
+
+    /**
+     * Decorator adding the latency and bandwidth of a modelled device to
+     * operations of any other backend. Zones are striped across channels,
+     * each channel serves one operation at a time for the duration of its
+     * latency plus transfer time at the channel's share of the bandwidth.
+     * Operations on busy channels are queued so parallelism is limited to the
+     * number of channels.
+     *
+     * Synchronous operations return once the modelled completion time has
+     * passed. Asynchronous operations are submitted to the decorated backend
+     * immediately but their callbacks are held back until that time.
+     */
+    class NvmeZnsModelBackend : public NvmeZnsBackend {
+    protected:
+        NvmeZnsBackend *backend;
+
+        struct nvme_zns_model model;
+
+        // Time at which each channel finishes its queued operations
+        std::vector<nvme_zns_model_time_t> channels;
+        std::mutex channel_lock;
+
+        // Completed asynchronous operations waiting for their modelled time
+        std::multimap<nvme_zns_model_time_t, std::function<void()>> delayed;
+        std::mutex delayed_lock;
+
+        static struct nvme_zns_info query_info(NvmeZnsBackend *backend);
+
+        NvmeZnsModelBackend(NvmeZnsBackend *backend,
+            const struct nvme_zns_model &model, struct nvme_zns_info info);
+
+        /**
+         * Queue an operation on the channel of _zone_.
+         * @return modelled completion time of the operation
+         */
+        nvme_zns_model_time_t reserve(uint64_t zone, uint64_t latency,
+            uint64_t bandwidth, uint64_t size);
+
+        /**
+         * Wrap _callback_ so it is only called by poll after _finish_.
+         */
+        nvme_zns_callback_t delay(nvme_zns_model_time_t finish,
+            nvme_zns_callback_t callback);
+
+    public:
+        /**
+         * @param backend the decorated backend, must outlive the decorator.
+         */
+        NvmeZnsModelBackend(NvmeZnsBackend *backend,
+            const struct nvme_zns_model &model);
+
+        // Virtual required to enforce destructor is called in super classes
+        virtual ~NvmeZnsModelBackend() = default;
+
+        void get_nvme_zns_info(struct nvme_zns_info* info) override;
+
+        int read(uint64_t zone, uint64_t sector, uint64_t offset, void* buffer,
+                 uint64_t size) override;
+
+        int append(uint64_t zone, uint64_t& sector, uint64_t offset,
+                   void* buffer, uint64_t size) override;
+
+        int reset(uint64_t zone) override;
+
+        int readv(struct nvme_zns_iovec *iov, uint64_t iovcnt) override;
+
+        int appendv(uint64_t zone, uint64_t& sector,
+                    struct nvme_zns_iovec *iov, uint64_t iovcnt) override;
+
+        int copy(struct nvme_zns_copy_range *ranges, uint64_t nranges,
+                 uint64_t zone, uint64_t &sector) override;
+
+        int report_zones(uint64_t zone, struct nvme_zns_zone_desc *descs,
+                         uint64_t &count) override;
+
+        int finish(uint64_t zone) override;
+
+        int open(uint64_t zone) override;
+
+        int close(uint64_t zone) override;
+
+        int submit_read(uint64_t zone, uint64_t sector, uint64_t offset,
+                        void *buffer, uint64_t size,
+                        nvme_zns_callback_t callback) override;
+
+        int submit_readv(struct nvme_zns_iovec *iov, uint64_t iovcnt,
+                         nvme_zns_callback_t callback) override;
+
+        int submit_append(uint64_t zone, uint64_t offset, void *buffer,
+                          uint64_t size, nvme_zns_callback_t callback) override;
+
+        int submit_reset(uint64_t zone, nvme_zns_callback_t callback) override;
+
+        uint64_t poll() override;
+
+        int wait(struct nvme_zns_batch *batch) override;
+    };
+
+}
+
+#endif // QEMU_CSD_NVME_ZNS_MODEL_HPP
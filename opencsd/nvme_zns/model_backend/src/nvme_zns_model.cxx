@@ -0,0 +1,291 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Dantali0n
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "nvme_zns_model.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace qemucsd::nvme_zns {
+
+    NvmeZnsModelBackend::NvmeZnsModelBackend(NvmeZnsBackend *backend,
+        const struct nvme_zns_model &model) :
+        NvmeZnsModelBackend(backend, model, query_info(backend))
+    {
+
+    }
+
+    NvmeZnsModelBackend::NvmeZnsModelBackend(NvmeZnsBackend *backend,
+        const struct nvme_zns_model &model, struct nvme_zns_info info) :
+        NvmeZnsBackend(info.num_zones, info.zone_size, info.zone_capacity,
+                       info.sector_size, info.max_open, info.max_active),
+        backend(backend), model(model)
+    {
+        if(this->model.num_channels == 0) this->model.num_channels = 1;
+
+        channels.resize(this->model.num_channels,
+                        std::chrono::steady_clock::now());
+    }
+
+    struct nvme_zns_info NvmeZnsModelBackend::query_info(
+        NvmeZnsBackend *backend)
+    {
+        struct nvme_zns_info info = {0};
+        backend->get_nvme_zns_info(&info);
+        return info;
+    }
+
+    void NvmeZnsModelBackend::get_nvme_zns_info(struct nvme_zns_info* info) {
+        NvmeZnsBackend::get_nvme_zns_info(info);
+    }
+
+    /**
+     * Every channel gets an equal share of the device bandwidth.
+     * @threadsafety: thread safe
+     */
+    nvme_zns_model_time_t NvmeZnsModelBackend::reserve(uint64_t zone,
+        uint64_t latency, uint64_t bandwidth, uint64_t size)
+    {
+        std::chrono::nanoseconds cost = std::chrono::microseconds(latency);
+        if(bandwidth != 0)
+            cost += std::chrono::nanoseconds(
+                size * model.num_channels * 1000000000 / bandwidth);
+
+        auto now = std::chrono::steady_clock::now();
+
+        std::lock_guard<std::mutex> guard(channel_lock);
+        auto &channel = channels.at(zone % model.num_channels);
+        channel = std::max(now, channel) + cost;
+
+        return channel;
+    }
+
+    nvme_zns_callback_t NvmeZnsModelBackend::delay(
+        nvme_zns_model_time_t finish, nvme_zns_callback_t callback)
+    {
+        return [this, finish, callback](int result, uint64_t sector) {
+            std::lock_guard<std::mutex> guard(delayed_lock);
+            delayed.emplace(finish, [callback, result, sector]() {
+                callback(result, sector);
+            });
+        };
+    }
+
+    int NvmeZnsModelBackend::read(uint64_t zone, uint64_t sector,
+        uint64_t offset, void* buffer, uint64_t size)
+    {
+        auto finish = reserve(zone, model.read_latency, model.read_bandwidth,
+                              size);
+        int result = backend->read(zone, sector, offset, buffer, size);
+        std::this_thread::sleep_until(finish);
+        return result;
+    }
+
+    int NvmeZnsModelBackend::append(uint64_t zone, uint64_t& sector,
+        uint64_t offset, void* buffer, uint64_t size)
+    {
+        auto finish = reserve(zone, model.append_latency,
+                              model.append_bandwidth, size);
+        int result = backend->append(zone, sector, offset, buffer, size);
+        std::this_thread::sleep_until(finish);
+        return result;
+    }
+
+    int NvmeZnsModelBackend::reset(uint64_t zone) {
+        auto finish = reserve(zone, model.reset_latency, 0, 0);
+        int result = backend->reset(zone);
+        std::this_thread::sleep_until(finish);
+        return result;
+    }
+
+    /**
+     * Ranges on different channels are served in parallel, completes when the
+     * slowest channel finishes.
+     */
+    int NvmeZnsModelBackend::readv(struct nvme_zns_iovec *iov, uint64_t iovcnt)
+    {
+        auto finish = std::chrono::steady_clock::now();
+        for(uint64_t i = 0; i < iovcnt; i++) {
+            finish = std::max(finish, reserve(iov[i].zone, model.read_latency,
+                model.read_bandwidth, iov[i].size));
+        }
+
+        int result = backend->readv(iov, iovcnt);
+        std::this_thread::sleep_until(finish);
+        return result;
+    }
+
+    int NvmeZnsModelBackend::appendv(uint64_t zone, uint64_t& sector,
+        struct nvme_zns_iovec *iov, uint64_t iovcnt)
+    {
+        uint64_t size = 0;
+        for(uint64_t i = 0; i < iovcnt; i++) {
+            size += iov[i].size;
+        }
+
+        auto finish = reserve(zone, model.append_latency,
+                              model.append_bandwidth, size);
+        int result = backend->appendv(zone, sector, iov, iovcnt);
+        std::this_thread::sleep_until(finish);
+        return result;
+    }
+
+    /**
+     * Copies occupy the channels of the source ranges for reading and the
+     * channel of the destination zone for writing, no host transfer is
+     * modelled.
+     */
+    int NvmeZnsModelBackend::copy(struct nvme_zns_copy_range *ranges,
+        uint64_t nranges, uint64_t zone, uint64_t &sector)
+    {
+        uint64_t size = 0;
+        auto finish = std::chrono::steady_clock::now();
+        for(uint64_t i = 0; i < nranges; i++) {
+            finish = std::max(finish, reserve(ranges[i].zone,
+                model.read_latency, model.read_bandwidth,
+                ranges[i].sectors * info.sector_size));
+            size += ranges[i].sectors * info.sector_size;
+        }
+
+        finish = std::max(finish, reserve(zone, model.append_latency,
+                                          model.append_bandwidth, size));
+        int result = backend->copy(ranges, nranges, zone, sector);
+        std::this_thread::sleep_until(finish);
+        return result;
+    }
+
+    /**
+     * Zone management commands other than finish and reset only update device
+     * state and are not modelled.
+     */
+    int NvmeZnsModelBackend::report_zones(uint64_t zone,
+        struct nvme_zns_zone_desc *descs, uint64_t &count)
+    {
+        return backend->report_zones(zone, descs, count);
+    }
+
+    /**
+     * Finishing a zone is modelled like a reset as both affect the entire zone.
+     */
+    int NvmeZnsModelBackend::finish(uint64_t zone) {
+        auto finish = reserve(zone, model.reset_latency, 0, 0);
+        int result = backend->finish(zone);
+        std::this_thread::sleep_until(finish);
+        return result;
+    }
+
+    int NvmeZnsModelBackend::open(uint64_t zone) {
+        return backend->open(zone);
+    }
+
+    int NvmeZnsModelBackend::close(uint64_t zone) {
+        return backend->close(zone);
+    }
+
+    int NvmeZnsModelBackend::submit_read(uint64_t zone, uint64_t sector,
+        uint64_t offset, void *buffer, uint64_t size,
+        nvme_zns_callback_t callback)
+    {
+        auto finish = reserve(zone, model.read_latency, model.read_bandwidth,
+                              size);
+        return backend->submit_read(zone, sector, offset, buffer, size,
+                                    delay(finish, std::move(callback)));
+    }
+
+    int NvmeZnsModelBackend::submit_readv(struct nvme_zns_iovec *iov,
+        uint64_t iovcnt, nvme_zns_callback_t callback)
+    {
+        auto finish = std::chrono::steady_clock::now();
+        for(uint64_t i = 0; i < iovcnt; i++) {
+            finish = std::max(finish, reserve(iov[i].zone, model.read_latency,
+                model.read_bandwidth, iov[i].size));
+        }
+
+        return backend->submit_readv(iov, iovcnt,
+                                     delay(finish, std::move(callback)));
+    }
+
+    int NvmeZnsModelBackend::submit_append(uint64_t zone, uint64_t offset,
+        void *buffer, uint64_t size, nvme_zns_callback_t callback)
+    {
+        auto finish = reserve(zone, model.append_latency,
+                              model.append_bandwidth, size);
+        return backend->submit_append(zone, offset, buffer, size,
+                                      delay(finish, std::move(callback)));
+    }
+
+    int NvmeZnsModelBackend::submit_reset(uint64_t zone,
+        nvme_zns_callback_t callback)
+    {
+        auto finish = reserve(zone, model.reset_latency, 0, 0);
+        return backend->submit_reset(zone, delay(finish, std::move(callback)));
+    }
+
+    /**
+     * Poll the decorated backend and call the callbacks of operations whose
+     * modelled completion time has passed.
+     * @threadsafety: thread safe
+     */
+    uint64_t NvmeZnsModelBackend::poll() {
+        backend->poll();
+
+        std::vector<std::function<void()>> finished;
+        {
+            std::lock_guard<std::mutex> guard(delayed_lock);
+            auto end = delayed.upper_bound(std::chrono::steady_clock::now());
+            for(auto it = delayed.begin(); it != end; it++) {
+                finished.emplace_back(std::move(it->second));
+            }
+            delayed.erase(delayed.begin(), end);
+        }
+
+        for(auto &callback : finished) {
+            callback();
+        }
+
+        return finished.size();
+    }
+
+    /**
+     * Sleep until the earliest held back completion while nothing can be
+     * completed yet.
+     * @threadsafety: thread safe
+     */
+    int NvmeZnsModelBackend::wait(struct nvme_zns_batch *batch) {
+        while(batch->pending.load() != 0) {
+            if(poll() != 0) continue;
+
+            auto until = std::chrono::steady_clock::now() +
+                std::chrono::microseconds(100);
+            {
+                std::lock_guard<std::mutex> guard(delayed_lock);
+                if(!delayed.empty())
+                    until = std::min(until, delayed.begin()->first);
+            }
+            std::this_thread::sleep_until(until);
+        }
+
+        return batch->result.load();
+    }
+}
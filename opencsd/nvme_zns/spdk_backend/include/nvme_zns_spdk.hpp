@@ -25,9 +25,14 @@
 #ifndef QEMU_CSD_NVME_ZNS_SPDK_HPP
 #define QEMU_CSD_NVME_ZNS_SPDK_HPP
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <memory>
 #include <mutex>
+#include <set>
+#include <vector>
 
 #include "measurements.hpp"
 #include "nvme_zns_backend.hpp"
@@ -41,6 +46,32 @@ namespace qemucsd::nvme_zns {
     static output::Output output = output::Output(
         "[NVME_ZNS_SPDK] ", output::INFO);
 
+    class NvmeZnsSpdkBackend;
+
+    /**
+     * State of a synchronous command, the submitting thread spins until its
+     * own command has finished as completions of asynchronous commands are
+     * reaped on the same qpair.
+     */
+    struct spdk_sync_cmd {
+        bool done;
+        int result;
+    };
+
+    /**
+     * State of an asynchronous command, owns its DMA buffer so any number of
+     * commands can be in flight.
+     */
+    struct spdk_async_cmd {
+        NvmeZnsSpdkBackend *backend;
+        nvme_zns_callback_t callback;
+        void *dma_buffer;
+        uint64_t zone;
+        uint64_t offset;
+        void *buffer;
+        uint64_t size;
+    };
+
     class NvmeZnsSpdkBackend : public NvmeZnsBackend {
     protected:
         // Write pointers for each zone have to be maintained in memory as it is
@@ -48,14 +79,63 @@ namespace qemucsd::nvme_zns {
         // (see spdk_nvme_zns_report_zones)
         std::vector<uint64_t> write_pointers;
 
+        // Zones of which an append failed, their write pointers were advanced
+        // upon submission and have to be reported again.
+        std::set<uint64_t> stale_zones;
+
         std::mutex gl;
 
         struct ns_entry* entry;
 
+        // DMA capable bounce buffer for multi sector operations, its size in
+        // sectors is limited by the maximum transfer and zone append size.
+        void *dma_buffer;
+        uint64_t dma_sectors;
+
         // Measurement variables
         static size_t msr_read_identifier;
         static size_t msr_append_identifier;
         static size_t msr_reset_identifier;
+        static size_t msr_readv_identifier;
+        static size_t msr_appendv_identifier;
+        static size_t msr_copy_identifier;
+
+        int read_locked(uint64_t zone, uint64_t sector, uint64_t offset,
+            void *buffer, uint64_t size);
+
+        int append_locked(uint64_t zone, uint64_t offset,
+            struct nvme_zns_iovec *iov, uint64_t iovcnt);
+
+        int flush_append(uint64_t zone, uint64_t sectors);
+
+        int copy_locked(
+            std::vector<struct spdk_nvme_scc_source_range> &sources,
+            uint64_t sectors, uint64_t zone);
+
+        void spin_command(struct spdk_sync_cmd *cmd);
+
+        int report_zones_locked(uint64_t zone,
+            struct nvme_zns_zone_desc *descs, uint64_t &count);
+
+        void refresh_write_pointers();
+
+        static enum nvme_zns_zone_state zone_state(uint8_t zs);
+
+        int submit_read_locked(uint64_t zone, uint64_t sector,
+            uint64_t offset, void *buffer, uint64_t size,
+            nvme_zns_callback_t callback);
+
+        static void sync_complete(void *arg,
+            const struct spdk_nvme_cpl *completion);
+
+        static void read_complete(void *arg,
+            const struct spdk_nvme_cpl *completion);
+
+        static void append_complete(void *arg,
+            const struct spdk_nvme_cpl *completion);
+
+        static void reset_complete(void *arg,
+            const struct spdk_nvme_cpl *completion);
     public:
         explicit NvmeZnsSpdkBackend(struct ns_entry* entry);
 
@@ -72,6 +152,39 @@ namespace qemucsd::nvme_zns {
            void *buffer, uint64_t size) override;
 
         int reset(uint64_t zone) override;
+
+        int readv(struct nvme_zns_iovec *iov, uint64_t iovcnt) override;
+
+        int copy(struct nvme_zns_copy_range *ranges, uint64_t nranges,
+                 uint64_t zone, uint64_t &sector) override;
+
+        int report_zones(uint64_t zone, struct nvme_zns_zone_desc *descs,
+                         uint64_t &count) override;
+
+        int finish(uint64_t zone) override;
+
+        int open(uint64_t zone) override;
+
+        int close(uint64_t zone) override;
+
+        int appendv(uint64_t zone, uint64_t &sector,
+            struct nvme_zns_iovec *iov, uint64_t iovcnt) override;
+
+        int submit_read(uint64_t zone, uint64_t sector, uint64_t offset,
+            void *buffer, uint64_t size,
+            nvme_zns_callback_t callback) override;
+
+        int submit_readv(struct nvme_zns_iovec *iov, uint64_t iovcnt,
+            nvme_zns_callback_t callback) override;
+
+        int submit_append(uint64_t zone, uint64_t offset, void *buffer,
+            uint64_t size, nvme_zns_callback_t callback) override;
+
+        int submit_reset(uint64_t zone, nvme_zns_callback_t callback) override;
+
+        uint64_t poll() override;
+
+        int wait(struct nvme_zns_batch *batch) override;
     };
 
 }
@@ -31,10 +31,14 @@ namespace qemucsd::nvme_zns {
     size_t NvmeZnsSpdkBackend::msr_read_identifier = 0;
     size_t NvmeZnsSpdkBackend::msr_append_identifier = 0;
     size_t NvmeZnsSpdkBackend::msr_reset_identifier = 0;
+    size_t NvmeZnsSpdkBackend::msr_readv_identifier = 0;
+    size_t NvmeZnsSpdkBackend::msr_appendv_identifier = 0;
+    size_t NvmeZnsSpdkBackend::msr_copy_identifier = 0;
 
     NvmeZnsSpdkBackend::NvmeZnsSpdkBackend(struct ns_entry* entry) :
         NvmeZnsBackend(entry->device_size, entry->zone_size,
-                       entry->zone_capacity, entry->sector_size, entry->max_open)
+                       entry->zone_capacity, entry->sector_size, entry->max_open,
+                       entry->max_active)
     {
         if(entry->qpair == nullptr || entry->ns == nullptr ||
            entry->ctrlr == nullptr)
@@ -49,9 +53,32 @@ namespace qemucsd::nvme_zns {
             "NVME_ZNS_SPDK][append", msr_append_identifier);
         measurements::register_namespace(
             "NVME_ZNS_SPDK][reset", msr_reset_identifier);
+        measurements::register_namespace(
+            "NVME_ZNS_SPDK][readv", msr_readv_identifier);
+        measurements::register_namespace(
+            "NVME_ZNS_SPDK][appendv", msr_appendv_identifier);
+        measurements::register_namespace(
+            "NVME_ZNS_SPDK][copy", msr_copy_identifier);
 
         this->entry = entry;
 
+        // Size the bounce buffer to the largest possible single command
+        dma_sectors = spdk_nvme_ns_get_max_io_xfer_size(entry->ns) /
+            info.sector_size;
+        uint64_t append_sectors = spdk_nvme_zns_ctrlr_get_max_zone_append_size(
+            entry->ctrlr) / info.sector_size;
+        if(append_sectors != 0 && append_sectors < dma_sectors)
+            dma_sectors = append_sectors;
+        if(dma_sectors == 0) dma_sectors = 1;
+
+        dma_buffer = spdk_zmalloc(dma_sectors * info.sector_size,
+            info.sector_size, nullptr, SPDK_ENV_SOCKET_ID_ANY, SPDK_MALLOC_DMA);
+        if(dma_buffer == nullptr) {
+            output.error("Failed to allocate DMA buffer of ", dma_sectors,
+                " sectors");
+            exit(1);
+        }
+
         write_pointers.resize(info.num_zones);
 
         /**
@@ -90,105 +117,791 @@ namespace qemucsd::nvme_zns {
     NvmeZnsSpdkBackend::~NvmeZnsSpdkBackend() {
         if(entry->ctrlr != nullptr) spdk_nvme_detach(entry->ctrlr);
         if(entry->buffer != nullptr) spdk_free(entry->buffer);
+        if(dma_buffer != nullptr) spdk_free(dma_buffer);
+    }
+
+    /**
+     * Process completions until the synchronous command has finished, caller
+     * must hold the global lock.
+     */
+    void NvmeZnsSpdkBackend::spin_command(struct spdk_sync_cmd *cmd) {
+        while(!cmd->done) {
+            spdk_nvme_qpair_process_completions(entry->qpair, 0);
+        }
+    }
+
+    void NvmeZnsSpdkBackend::sync_complete(void *arg,
+        const struct spdk_nvme_cpl *completion)
+    {
+        auto *cmd = (struct spdk_sync_cmd*) arg;
+
+        if(spdk_nvme_cpl_is_error(completion)) {
+            output.error("I/O error status: ",
+                spdk_nvme_cpl_get_status_string(&completion->status));
+            cmd->result = -1;
+        }
+
+        cmd->done = true;
+    }
+
+    /**
+     * Copy the read data out of the DMA buffer and queue the callback, runs
+     * while the global lock is held by poll.
+     */
+    void NvmeZnsSpdkBackend::read_complete(void *arg,
+        const struct spdk_nvme_cpl *completion)
+    {
+        auto *cmd = (struct spdk_async_cmd*) arg;
+        int result = 0;
+
+        if(spdk_nvme_cpl_is_error(completion)) result = -1;
+        else memcpy(cmd->buffer, (uint8_t*)cmd->dma_buffer + cmd->offset,
+                    cmd->size);
+
+        cmd->backend->complete(cmd->callback, result, 0);
+
+        spdk_free(cmd->dma_buffer);
+        delete cmd;
+    }
+
+    /**
+     * Zone append reports the lba the data was written to in the first two
+     * dwords of the completion. The write pointer was advanced upon
+     * submission so after a failed append the zone is marked to be reported
+     * again, this can not happen here as completions can not be reaped from
+     * within a completion callback.
+     */
+    void NvmeZnsSpdkBackend::append_complete(void *arg,
+        const struct spdk_nvme_cpl *completion)
+    {
+        auto *cmd = (struct spdk_async_cmd*) arg;
+        int result = 0;
+        uint64_t sector = 0;
+
+        if(spdk_nvme_cpl_is_error(completion)) {
+            result = -1;
+            cmd->backend->stale_zones.insert(cmd->zone);
+        }
+        else {
+            uint64_t lba = completion->cdw0 |
+                ((uint64_t) completion->cdw1 << 32);
+            sector = lba - cmd->zone * cmd->backend->info.zone_size;
+        }
+
+        cmd->backend->complete(cmd->callback, result, sector);
+
+        spdk_free(cmd->dma_buffer);
+        delete cmd;
+    }
+
+    void NvmeZnsSpdkBackend::reset_complete(void *arg,
+        const struct spdk_nvme_cpl *completion)
+    {
+        auto *cmd = (struct spdk_async_cmd*) arg;
+        int result = 0;
+
+        if(spdk_nvme_cpl_is_error(completion)) result = -1;
+        else cmd->backend->write_pointers.at(cmd->zone) = 0;
+
+        cmd->backend->complete(cmd->callback, result, 0);
+
+        delete cmd;
     }
 
     void NvmeZnsSpdkBackend::get_nvme_zns_info(struct nvme_zns_info* info) {
         NvmeZnsBackend::get_nvme_zns_info(info);
     }
 
-    int NvmeZnsSpdkBackend::read(
-        uint64_t zone, uint64_t sector, uint64_t offset, void *buffer,
-        uint64_t size)
+    /**
+     * Read any number of sectors into buffer using as few commands as the
+     * bounce buffer allows. Caller must hold the global lock and have verified
+     * the request with in_range.
+     * @return 0 upon success, < 0 upon failure
+     */
+    int NvmeZnsSpdkBackend::read_locked(uint64_t zone, uint64_t sector,
+        uint64_t offset, void *buffer, uint64_t size)
     {
-        std::lock_guard<std::mutex> guard(gl);
-
         uint64_t lba;
         struct ns_entry entry = *this->entry;
 
-        if(in_range(zone, sector, offset, size) != 0)
-            return -1;
+        uint64_t sectors =
+            (offset + size + info.sector_size - 1) / info.sector_size;
+
+        // Refuse to read unwritten sectors or ranges spanning zones
+        if(write_pointers.at(zone) < sector + sectors) return -1;
 
         position_to_lba(zone, sector, lba);
 
-        // Refuse to read unwritten sectors
-        if(write_pointers.at(zone) <= sector) return -1;
+        uint64_t done = 0;
+        while(sectors > 0) {
+            uint64_t count = sectors < dma_sectors ? sectors : dma_sectors;
+
+            struct spdk_sync_cmd cmd = {false, 0};
+            if(spdk_nvme_ns_cmd_read(entry.ns, entry.qpair, dma_buffer, lba,
+                count, sync_complete, &cmd, 0) != 0)
+                return -1;
+            spin_command(&cmd);
+            if(cmd.result != 0) return -1;
+
+            // Only the first command has to account for the offset
+            uint64_t copy = count * info.sector_size - offset;
+            if(copy > size - done) copy = size - done;
+            memcpy((uint8_t*)buffer + done, (uint8_t*)dma_buffer + offset,
+                   copy);
+
+            done += copy;
+            offset = 0;
+            lba += count;
+            sectors -= count;
+        }
+
+        return 0;
+    }
+
+    /**
+     * Submit a zone append for the first _sectors_ of the bounce buffer and
+     * advance the write pointer. Caller must hold the global lock.
+     * @return 0 upon success, < 0 upon failure
+     */
+    int NvmeZnsSpdkBackend::flush_append(uint64_t zone, uint64_t sectors) {
+        uint64_t lba;
+        struct ns_entry entry = *this->entry;
 
-        // Only support reading a single sector for now
-        // TODO(Dantali0n): Allow to read multiple sectors in one call
-        if(offset + size != info.sector_size)
+        position_to_lba(zone, 0, lba);
+
+        struct spdk_sync_cmd cmd = {false, 0};
+        if(spdk_nvme_zns_zone_append(entry.ns, entry.qpair, dma_buffer,
+            lba, sectors, sync_complete, &cmd, 0) != 0)
             return -1;
 
-        spdk_nvme_ns_cmd_read(entry.ns, entry.qpair,
-                              entry.buffer, lba, 1,
-                              spdk_init::error_print, &entry,0);
-        spdk_init::spin_complete(&entry);
+        spin_command(&cmd);
+        if(cmd.result != 0) return -1;
 
-        memcpy(buffer, (uint8_t*)entry.buffer + offset, size);
+        write_pointers.at(zone) = write_pointers.at(zone) + sectors;
 
         return 0;
     }
 
+    /**
+     * Gather the iovecs into the bounce buffer and append them to the zone,
+     * the data of the first iovec starts at _offset_ into the first sector.
+     * Caller must hold the global lock and have verified the request fits in
+     * the zone.
+     * @return 0 upon success, < 0 upon failure
+     */
+    int NvmeZnsSpdkBackend::append_locked(uint64_t zone, uint64_t offset,
+        struct nvme_zns_iovec *iov, uint64_t iovcnt)
+    {
+        uint64_t chunk_size = dma_sectors * info.sector_size;
+
+        // Zero offset into the sector if the offset is non zero
+        uint64_t fill = offset;
+        if(offset != 0) memset(dma_buffer, 0, offset);
+
+        for(uint64_t i = 0; i < iovcnt; i++) {
+            // Indicate location of written data
+            iov[i].zone = zone;
+            iov[i].sector = write_pointers.at(zone) + fill / info.sector_size;
+
+            uint64_t done = 0;
+            while(done < iov[i].size) {
+                uint64_t copy = iov[i].size - done;
+                if(copy > chunk_size - fill) copy = chunk_size - fill;
+
+                memcpy((uint8_t*)dma_buffer + fill,
+                       (uint8_t*)iov[i].buffer + done, copy);
+                fill += copy;
+                done += copy;
+
+                // Bounce buffer full, flush it to the device
+                if(fill == chunk_size) {
+                    if(flush_append(zone, dma_sectors) != 0) return -1;
+                    fill = 0;
+                }
+            }
+        }
+
+        if(fill == 0) return 0;
+
+        // Zero remainder of last sector
+        uint64_t remainder = fill % info.sector_size;
+        if(remainder != 0) {
+            memset((uint8_t*)dma_buffer + fill, 0,
+                   info.sector_size - remainder);
+            fill += info.sector_size - remainder;
+        }
+
+        return flush_append(zone, fill / info.sector_size);
+    }
+
+    int NvmeZnsSpdkBackend::read(
+        uint64_t zone, uint64_t sector, uint64_t offset, void *buffer,
+        uint64_t size)
+    {
+        measurements::measure_guard msr_guard(msr_read_identifier);
+        std::lock_guard<std::mutex> guard(gl);
+
+        if(in_range(zone, sector, offset, size) != 0)
+            return -1;
+
+        return read_locked(zone, sector, offset, buffer, size);
+    }
+
     int NvmeZnsSpdkBackend::append(
         uint64_t zone, uint64_t &sector, uint64_t offset, void *buffer,
         uint64_t size)
     {
+        measurements::measure_guard msr_guard(msr_append_identifier);
+        std::lock_guard<std::mutex> guard(gl);
+
+        if(in_range(zone, 0, offset, size) != 0)
+            return -1;
+
+        // Refuse to append beyond zone capacity
+        uint64_t sectors =
+            (offset + size + info.sector_size - 1) / info.sector_size;
+        if(write_pointers.at(zone) + sectors > info.zone_capacity)
+            return -1;
+
+        struct nvme_zns_iovec iov = {zone, 0, buffer, size};
+        if(append_locked(zone, offset, &iov, 1) != 0)
+            return -1;
+
+        sector = iov.sector;
+
+        return 0;
+    }
+
+    int NvmeZnsSpdkBackend::reset(uint64_t zone) {
         std::lock_guard<std::mutex> guard(gl);
 
         uint64_t lba;
         struct ns_entry entry = *this->entry;
 
-        if(in_range(zone, 0, offset, size) != 0)
+        if(in_range(zone, 0, 0, 0) != 0)
             return -1;
 
         position_to_lba(zone, 0, lba);
 
-        // Refuse to append to full zone
-        if(write_pointers.at(zone) >= info.zone_size)
+        struct spdk_sync_cmd cmd = {false, 0};
+        if(spdk_nvme_zns_reset_zone(entry.ns, entry.qpair, lba, false,
+            sync_complete, &cmd) != 0)
+            return -1;
+
+        spin_command(&cmd);
+        if(cmd.result != 0) return -1;
+
+        write_pointers.at(zone) = 0;
+
+        return 0;
+    }
+
+    /**
+     * Issue a single simple copy command appending the source ranges to the
+     * write pointer of zone. Caller must hold the global lock.
+     * @return 0 upon success, < 0 upon failure
+     */
+    int NvmeZnsSpdkBackend::copy_locked(
+        std::vector<struct spdk_nvme_scc_source_range> &sources,
+        uint64_t sectors, uint64_t zone)
+    {
+        uint64_t dest_lba;
+        position_to_lba(zone, write_pointers.at(zone), dest_lba);
+
+        struct spdk_sync_cmd cmd = {false, 0};
+        if(spdk_nvme_ns_cmd_copy(entry->ns, entry->qpair, sources.data(),
+            sources.size(), dest_lba, sync_complete, &cmd) != 0)
             return -1;
 
-        // Only support appending a single sector for now
-        // TODO(Dantali0n): Allow to append multiple sectors in one call
-        if(offset + size != info.sector_size)
+        spin_command(&cmd);
+        if(cmd.result != 0) return -1;
+
+        write_pointers.at(zone) = write_pointers.at(zone) + sectors;
+        sources.clear();
+
+        return 0;
+    }
+
+    /**
+     * Issue simple copy commands each combining as many source ranges as the
+     * namespace allows (MSRC), ranges are split at the maximum single source
+     * range length (MSSRL) and commands at the maximum copy length (MCL).
+     * Controllers without simple copy support fall back to copying through
+     * the host.
+     */
+    int NvmeZnsSpdkBackend::copy(struct nvme_zns_copy_range *ranges,
+        uint64_t nranges, uint64_t zone, uint64_t &sector)
+    {
+        if(!(spdk_nvme_ctrlr_get_flags(entry->ctrlr) &
+             SPDK_NVME_CTRLR_SCC_SUPPORTED))
+            return NvmeZnsBackend::copy(ranges, nranges, zone, sector);
+
+        measurements::measure_guard msr_guard(msr_copy_identifier);
+        std::lock_guard<std::mutex> guard(gl);
+
+        if(nranges == 0 || in_range(zone, 0, 0, 0) != 0)
             return -1;
 
-        if(offset != 0) memset(entry.buffer, 0, offset);
-        uint64_t remainder = (offset + size) % info.sector_size;
-        if(remainder != 0) memset((uint8_t*)entry.buffer + offset + size, 0,
-                                  remainder);
-        memcpy(entry.buffer, (uint8_t*)buffer + offset, size);
+        uint64_t sectors = 0;
+        for(uint64_t i = 0; i < nranges; i++) {
+            if(in_range(ranges[i].zone, ranges[i].sector, 0, 0) != 0 ||
+               write_pointers.at(ranges[i].zone) <
+               ranges[i].sector + ranges[i].sectors)
+                return -1;
+            sectors += ranges[i].sectors;
+        }
 
-        spdk_nvme_zns_zone_append(entry.ns, entry.qpair, entry.buffer,
-            lba, 1, spdk_init::error_print, &entry, 0);
+        if(write_pointers.at(zone) + sectors > info.zone_capacity)
+            return -1;
 
-        spdk_init::spin_complete(&entry);
+        const struct spdk_nvme_ns_data *data = spdk_nvme_ns_get_data(entry->ns);
+        // Maximum source range count is zero based
+        uint64_t max_ranges = (uint64_t) data->msrc + 1;
+        uint64_t max_range = data->mssrl != 0 ? data->mssrl : 1;
+        uint64_t max_copy = data->mcl != 0 ? data->mcl : UINT64_MAX;
+
+        std::vector<struct spdk_nvme_scc_source_range> sources;
+        uint64_t command_sectors = 0;
 
-        // Indicate location of written data
         sector = write_pointers.at(zone);
+        for(uint64_t i = 0; i < nranges; i++) {
+            uint64_t done = 0;
+            while(done < ranges[i].sectors) {
+                uint64_t count = ranges[i].sectors - done;
+                if(count > max_range) count = max_range;
+                if(count > max_copy - command_sectors)
+                    count = max_copy - command_sectors;
+
+                struct spdk_nvme_scc_source_range range = {0};
+                position_to_lba(ranges[i].zone, ranges[i].sector + done,
+                                range.slba);
+                // Number of logical blocks is zero based
+                range.nlb = count - 1;
+                sources.push_back(range);
+
+                command_sectors += count;
+                done += count;
+
+                if(sources.size() < max_ranges && command_sectors < max_copy)
+                    continue;
+
+                if(copy_locked(sources, command_sectors, zone) != 0)
+                    return -1;
+                command_sectors = 0;
+            }
+        }
 
-        // Advance write pointer by one
-        write_pointers.at(zone) = write_pointers.at(zone) + 1;
+        if(!sources.empty() && copy_locked(sources, command_sectors, zone) != 0)
+            return -1;
 
         return 0;
     }
 
-    int NvmeZnsSpdkBackend::reset(uint64_t zone) {
+    enum nvme_zns_zone_state NvmeZnsSpdkBackend::zone_state(uint8_t zs) {
+        switch(zs) {
+            case SPDK_NVME_ZONE_STATE_EMPTY: return ZONE_STATE_EMPTY;
+            case SPDK_NVME_ZONE_STATE_IOPEN: return ZONE_STATE_IMPLICIT_OPEN;
+            case SPDK_NVME_ZONE_STATE_EOPEN: return ZONE_STATE_EXPLICIT_OPEN;
+            case SPDK_NVME_ZONE_STATE_CLOSED: return ZONE_STATE_CLOSED;
+            case SPDK_NVME_ZONE_STATE_FULL: return ZONE_STATE_FULL;
+            case SPDK_NVME_ZONE_STATE_RONLY: return ZONE_STATE_READ_ONLY;
+            default: return ZONE_STATE_OFFLINE;
+        }
+    }
+
+    /**
+     * Query the device and refresh the in memory write pointers of all
+     * reported zones.
+     */
+    int NvmeZnsSpdkBackend::report_zones(uint64_t zone,
+        struct nvme_zns_zone_desc *descs, uint64_t &count)
+    {
+        std::lock_guard<std::mutex> guard(gl);
+
+        return report_zones_locked(zone, descs, count);
+    }
+
+    /**
+     * Report zones, caller must hold the global lock.
+     * @return 0 upon success, < 0 upon failure
+     */
+    int NvmeZnsSpdkBackend::report_zones_locked(uint64_t zone,
+        struct nvme_zns_zone_desc *descs, uint64_t &count)
+    {
+        if(zone >= info.num_zones) return -1;
+        if(count > info.num_zones - zone) count = info.num_zones - zone;
+
+        uint32_t report_bufsize =
+            spdk_nvme_ns_get_max_io_xfer_size(entry->ns);
+        auto *report_buf = (spdk_nvme_zns_zone_report *)
+            malloc(report_bufsize);
+        if(report_buf == nullptr) return -1;
+
+        uint64_t done = 0;
+        while(done < count) {
+            struct spdk_sync_cmd cmd = {false, 0};
+            if(spdk_nvme_zns_report_zones(entry->ns, entry->qpair, report_buf,
+                report_bufsize, (zone + done) * info.zone_size,
+                SPDK_NVME_ZRA_LIST_ALL, true, sync_complete, &cmd) != 0)
+                break;
+
+            spin_command(&cmd);
+            if(cmd.result != 0 || report_buf->nr_zones == 0) break;
+
+            for(uint64_t i = 0; i < report_buf->nr_zones && done < count; i++) {
+                uint64_t normalized_wp = report_buf->descs[i].wp -
+                    report_buf->descs[i].zslba;
+                if(normalized_wp > report_buf->descs[i].zcap)
+                    normalized_wp = report_buf->descs[i].zcap;
+
+                descs[done].zone = zone + done;
+                descs[done].state = zone_state(report_buf->descs[i].zs);
+                descs[done].write_pointer = normalized_wp;
+                descs[done].capacity = report_buf->descs[i].zcap;
+                write_pointers.at(zone + done) = normalized_wp;
+                done += 1;
+            }
+        }
+
+        free(report_buf);
+
+        if(done != count) return -1;
+
+        return 0;
+    }
+
+    int NvmeZnsSpdkBackend::finish(uint64_t zone) {
         std::lock_guard<std::mutex> guard(gl);
 
         uint64_t lba;
-        struct ns_entry entry = *this->entry;
+        if(in_range(zone, 0, 0, 0) != 0)
+            return -1;
+
+        position_to_lba(zone, 0, lba);
+
+        struct spdk_sync_cmd cmd = {false, 0};
+        if(spdk_nvme_zns_finish_zone(entry->ns, entry->qpair, lba, false,
+            sync_complete, &cmd) != 0)
+            return -1;
+
+        spin_command(&cmd);
+        if(cmd.result != 0) return -1;
+
+        write_pointers.at(zone) = info.zone_capacity;
+
+        return 0;
+    }
+
+    int NvmeZnsSpdkBackend::open(uint64_t zone) {
+        std::lock_guard<std::mutex> guard(gl);
+
+        uint64_t lba;
+        if(in_range(zone, 0, 0, 0) != 0)
+            return -1;
+
+        position_to_lba(zone, 0, lba);
+
+        struct spdk_sync_cmd cmd = {false, 0};
+        if(spdk_nvme_zns_open_zone(entry->ns, entry->qpair, lba, false,
+            sync_complete, &cmd) != 0)
+            return -1;
+
+        spin_command(&cmd);
+        return cmd.result;
+    }
+
+    int NvmeZnsSpdkBackend::close(uint64_t zone) {
+        std::lock_guard<std::mutex> guard(gl);
 
+        uint64_t lba;
         if(in_range(zone, 0, 0, 0) != 0)
             return -1;
 
         position_to_lba(zone, 0, lba);
 
-        spdk_nvme_zns_reset_zone(entry.ns, entry.qpair, lba, false,
-            spdk_init::error_print, &entry);
+        struct spdk_sync_cmd cmd = {false, 0};
+        if(spdk_nvme_zns_close_zone(entry->ns, entry->qpair, lba, false,
+            sync_complete, &cmd) != 0)
+            return -1;
 
-        spdk_init::spin_complete(&entry);
+        spin_command(&cmd);
+        return cmd.result;
+    }
 
-        write_pointers.at(zone) = 0;
+    int NvmeZnsSpdkBackend::readv(struct nvme_zns_iovec *iov, uint64_t iovcnt)
+    {
+        measurements::measure_guard msr_guard(msr_readv_identifier);
+        std::lock_guard<std::mutex> guard(gl);
+
+        for(uint64_t i = 0; i < iovcnt; i++) {
+            if(in_range(iov[i].zone, iov[i].sector, 0, iov[i].size) != 0)
+                return -1;
+
+            if(read_locked(iov[i].zone, iov[i].sector, 0, iov[i].buffer,
+                           iov[i].size) != 0)
+                return -1;
+        }
+
+        return 0;
+    }
+
+    int NvmeZnsSpdkBackend::appendv(uint64_t zone, uint64_t &sector,
+        struct nvme_zns_iovec *iov, uint64_t iovcnt)
+    {
+        measurements::measure_guard msr_guard(msr_appendv_identifier);
+        std::lock_guard<std::mutex> guard(gl);
+
+        if(iovcnt == 0 || in_range(zone, 0, 0, 0) != 0)
+            return -1;
+
+        // Only the last buffer is allowed to partially fill a sector
+        uint64_t sectors = 0;
+        for(uint64_t i = 0; i < iovcnt; i++) {
+            if(i != iovcnt - 1 && iov[i].size % info.sector_size != 0)
+                return -1;
+            sectors += (iov[i].size + info.sector_size - 1) / info.sector_size;
+        }
+
+        // Refuse the entire request if it does not fit in the zone
+        if(write_pointers.at(zone) + sectors > info.zone_capacity)
+            return -1;
+
+        if(append_locked(zone, 0, iov, iovcnt) != 0)
+            return -1;
+
+        sector = iov[0].sector;
+
+        return 0;
+    }
+
+    /**
+     * Submit a single read command of at most dma_sectors, caller must hold the
+     * global lock and have verified the request with in_range.
+     * @return 0 upon success, < 0 upon failure
+     */
+    int NvmeZnsSpdkBackend::submit_read_locked(uint64_t zone, uint64_t sector,
+        uint64_t offset, void *buffer, uint64_t size,
+        nvme_zns_callback_t callback)
+    {
+        uint64_t lba;
+        uint64_t sectors =
+            (offset + size + info.sector_size - 1) / info.sector_size;
+
+        // Refuse to read unwritten sectors or ranges spanning zones
+        if(write_pointers.at(zone) < sector + sectors) return -1;
+
+        position_to_lba(zone, sector, lba);
+
+        auto *cmd = new spdk_async_cmd{this, std::move(callback), nullptr,
+            zone, offset, buffer, size};
+        cmd->dma_buffer = spdk_zmalloc(sectors * info.sector_size,
+            info.sector_size, nullptr, SPDK_ENV_SOCKET_ID_ANY, SPDK_MALLOC_DMA);
+
+        if(cmd->dma_buffer == nullptr ||
+           spdk_nvme_ns_cmd_read(entry->ns, entry->qpair, cmd->dma_buffer,
+               lba, sectors, read_complete, cmd, 0) != 0)
+        {
+            if(cmd->dma_buffer != nullptr) spdk_free(cmd->dma_buffer);
+            delete cmd;
+            return -1;
+        }
+
+        return 0;
+    }
+
+    /**
+     * Requests larger than the maximum transfer size are split into multiple
+     * commands, the callback is called once all of them have finished.
+     * @threadsafety: thread safe
+     */
+    int NvmeZnsSpdkBackend::submit_read(uint64_t zone, uint64_t sector,
+        uint64_t offset, void *buffer, uint64_t size,
+        nvme_zns_callback_t callback)
+    {
+        struct nvme_zns_iovec iov = {zone, sector, buffer, size};
+
+        if(offset == 0) return submit_readv(&iov, 1, std::move(callback));
+
+        std::lock_guard<std::mutex> guard(gl);
+
+        if(in_range(zone, sector, offset, size) != 0)
+            return -1;
+
+        // Only whole sectors are split, offsets are limited to a single command
+        if(offset + size > dma_sectors * info.sector_size)
+            return -1;
+
+        return submit_read_locked(zone, sector, offset, buffer, size,
+                                  std::move(callback));
+    }
+
+    /**
+     * Submit a command for every (part of) iovec, the callback is called once
+     * all of them have finished. Commands submitted before a failure are still
+     * completed but the callback will never be called in that case.
+     * @threadsafety: thread safe
+     */
+    int NvmeZnsSpdkBackend::submit_readv(struct nvme_zns_iovec *iov,
+        uint64_t iovcnt, nvme_zns_callback_t callback)
+    {
+        std::lock_guard<std::mutex> guard(gl);
+
+        auto batch = std::make_shared<nvme_zns_batch>();
+        // Prevent completion before all commands are submitted
+        batch->pending.fetch_add(1);
+
+        auto tracked = [this, batch, callback](int result, uint64_t sector) {
+            if(result != 0) batch->result.store(result);
+            if(batch->pending.fetch_sub(1) == 1)
+                callback(batch->result.load(), 0);
+        };
+
+        uint64_t chunk_size = dma_sectors * info.sector_size;
+        for(uint64_t i = 0; i < iovcnt; i++) {
+            if(in_range(iov[i].zone, iov[i].sector, 0, iov[i].size) != 0)
+                return -1;
+
+            for(uint64_t done = 0; done < iov[i].size; done += chunk_size) {
+                uint64_t size = iov[i].size - done;
+                if(size > chunk_size) size = chunk_size;
+
+                batch->pending.fetch_add(1);
+                if(submit_read_locked(iov[i].zone,
+                    iov[i].sector + done / info.sector_size, 0,
+                    (uint8_t*)iov[i].buffer + done, size, tracked) != 0)
+                    return -1;
+            }
+        }
+
+        // Account for the initial reference, finishing immediately if all
+        // commands already completed.
+        complete(tracked, 0, 0);
 
         return 0;
     }
-}
\ No newline at end of file
+
+    /**
+     * The write pointer is advanced upon submission so subsequent requests can
+     * verify the zone capacity, the actual location of the data is only known
+     * upon completion. Requests exceeding a single command are appended
+     * synchronously as split commands could be placed out of order.
+     * @threadsafety: thread safe
+     */
+    int NvmeZnsSpdkBackend::submit_append(uint64_t zone, uint64_t offset,
+        void *buffer, uint64_t size, nvme_zns_callback_t callback)
+    {
+        uint64_t lba;
+        uint64_t sectors =
+            (offset + size + info.sector_size - 1) / info.sector_size;
+
+        if(sectors > dma_sectors)
+            return NvmeZnsBackend::submit_append(zone, offset, buffer, size,
+                                                 std::move(callback));
+
+        std::lock_guard<std::mutex> guard(gl);
+
+        if(in_range(zone, 0, offset, size) != 0)
+            return -1;
+
+        // Refuse to append beyond zone capacity
+        if(write_pointers.at(zone) + sectors > info.zone_capacity)
+            return -1;
+
+        position_to_lba(zone, 0, lba);
+
+        auto *cmd = new spdk_async_cmd{this, std::move(callback), nullptr,
+            zone, offset, buffer, size};
+        cmd->dma_buffer = spdk_zmalloc(sectors * info.sector_size,
+            info.sector_size, nullptr, SPDK_ENV_SOCKET_ID_ANY, SPDK_MALLOC_DMA);
+        if(cmd->dma_buffer == nullptr) {
+            delete cmd;
+            return -1;
+        }
+
+        // spdk_zmalloc zeroes the offset and the remainder of the last sector
+        memcpy((uint8_t*)cmd->dma_buffer + offset, buffer, size);
+
+        if(spdk_nvme_zns_zone_append(entry->ns, entry->qpair, cmd->dma_buffer,
+            lba, sectors, append_complete, cmd, 0) != 0)
+        {
+            spdk_free(cmd->dma_buffer);
+            delete cmd;
+            return -1;
+        }
+
+        write_pointers.at(zone) = write_pointers.at(zone) + sectors;
+
+        return 0;
+    }
+
+    int NvmeZnsSpdkBackend::submit_reset(uint64_t zone,
+        nvme_zns_callback_t callback)
+    {
+        std::lock_guard<std::mutex> guard(gl);
+
+        uint64_t lba;
+
+        if(in_range(zone, 0, 0, 0) != 0)
+            return -1;
+
+        position_to_lba(zone, 0, lba);
+
+        auto *cmd = new spdk_async_cmd{this, std::move(callback), nullptr,
+            zone, 0, nullptr, 0};
+        if(spdk_nvme_zns_reset_zone(entry->ns, entry->qpair, lba, false,
+            reset_complete, cmd) != 0)
+        {
+            delete cmd;
+            return -1;
+        }
+
+        return 0;
+    }
+
+    /**
+     * Reap completions from the qpair before calling the queued callbacks.
+     * @threadsafety: thread safe
+     */
+    uint64_t NvmeZnsSpdkBackend::poll() {
+        {
+            std::lock_guard<std::mutex> guard(gl);
+            spdk_nvme_qpair_process_completions(entry->qpair, 0);
+            refresh_write_pointers();
+        }
+
+        return NvmeZnsBackend::poll();
+    }
+
+    /**
+     * Report zones with failed appends again so their write pointers no longer
+     * include the sectors reserved upon submission. Zones that can not be
+     * reported remain marked. Caller must hold the global lock.
+     */
+    void NvmeZnsSpdkBackend::refresh_write_pointers() {
+        auto it = stale_zones.begin();
+        while(it != stale_zones.end()) {
+            struct nvme_zns_zone_desc desc = {0};
+            uint64_t count = 1;
+            if(report_zones_locked(*it, &desc, count) != 0) {
+                output.error("Failed to report zone ", *it,
+                    " after failed append");
+                ++it;
+                continue;
+            }
+            it = stale_zones.erase(it);
+        }
+    }
+
+    /**
+     * Completions are only reaped by polling the qpair so busy poll instead of
+     * sleeping.
+     * @threadsafety: thread safe
+     */
+    int NvmeZnsSpdkBackend::wait(struct nvme_zns_batch *batch) {
+        while(batch->pending.load() != 0) {
+            poll();
+        }
+
+        return batch->result.load();
+    }
+}
@@ -33,7 +33,8 @@ namespace qemucsd::nvme_zns {
     }
 
     NvmeZnsBackend::NvmeZnsBackend(uint64_t num_zones, uint64_t zone_size,
-        uint64_t zone_capacity, uint64_t sector_size, uint64_t max_open)
+        uint64_t zone_capacity, uint64_t sector_size, uint64_t max_open,
+        uint64_t max_active)
     {
         info.num_zones = num_zones;
         info.zone_size = zone_size;
@@ -41,6 +42,7 @@ namespace qemucsd::nvme_zns {
         info.sector_size = sector_size;
 
         info.max_open = max_open;
+        info.max_active = max_active;
 
         zone_byte_size = sector_size * zone_capacity;
         device_byte_size = zone_byte_size * num_zones;
@@ -65,7 +67,7 @@ namespace qemucsd::nvme_zns {
         // Verify that desired size does not cause operation to
         // exceed total device size limits
         if((zone_byte_size * zone) + (info.sector_size * sector) +
-            offset + size >= device_byte_size)
+            offset + size > device_byte_size)
             return -1;
 
         return 0;
@@ -81,4 +83,214 @@ namespace qemucsd::nvme_zns {
         *info = this->info;
     }
 
-}
\ No newline at end of file
+
+    /**
+     * Fallback scatter read issuing a read per sector, sufficient for backends
+     * that only support single sector reads.
+     * @threadsafety: thread safe if read is thread safe.
+     */
+    int NvmeZnsBackend::readv(struct nvme_zns_iovec *iov, uint64_t iovcnt) {
+        for(uint64_t i = 0; i < iovcnt; i++) {
+            uint64_t done = 0;
+            uint64_t sector = iov[i].sector;
+            while(done < iov[i].size) {
+                uint64_t size = iov[i].size - done < info.sector_size ?
+                    iov[i].size - done : info.sector_size;
+                if(read(iov[i].zone, sector, 0,
+                        (uint8_t*) iov[i].buffer + done, size) != 0)
+                    return -1;
+
+                done += size;
+                sector += 1;
+            }
+        }
+
+        return 0;
+    }
+
+    /**
+     * Fallback gather append issuing an append per sector, sufficient for
+     * backends that only support single sector appends.
+     * @threadsafety: thread safe if append is thread safe, consecutive
+     *                sectors are only guaranteed when appends to the zone are
+     *                externally serialized.
+     */
+    int NvmeZnsBackend::appendv(uint64_t zone, uint64_t &sector,
+        struct nvme_zns_iovec *iov, uint64_t iovcnt)
+    {
+        for(uint64_t i = 0; i < iovcnt; i++) {
+            uint64_t done = 0;
+            while(done < iov[i].size) {
+                uint64_t res_sector;
+                uint64_t size = iov[i].size - done < info.sector_size ?
+                    iov[i].size - done : info.sector_size;
+                if(append(zone, res_sector, 0,
+                          (uint8_t*) iov[i].buffer + done, size) != 0)
+                    return -1;
+
+                if(done == 0) {
+                    iov[i].zone = zone;
+                    iov[i].sector = res_sector;
+                }
+                if(done == 0 && i == 0) sector = res_sector;
+
+                done += size;
+            }
+        }
+
+        return 0;
+    }
+
+    /**
+     * Fallback copy through a single sector host buffer, sufficient for
+     * backends that only support single sector reads and appends.
+     * @threadsafety: thread safe if read and append are thread safe,
+     *                consecutive sectors are only guaranteed when appends to
+     *                the zone are externally serialized.
+     */
+    int NvmeZnsBackend::copy(struct nvme_zns_copy_range *ranges,
+        uint64_t nranges, uint64_t zone, uint64_t &sector)
+    {
+        std::vector<uint8_t> buffer(info.sector_size);
+        bool first = true;
+
+        for(uint64_t i = 0; i < nranges; i++) {
+            for(uint64_t j = 0; j < ranges[i].sectors; j++) {
+                uint64_t res_sector;
+                if(read(ranges[i].zone, ranges[i].sector + j, 0,
+                        buffer.data(), info.sector_size) != 0)
+                    return -1;
+                if(append(zone, res_sector, 0, buffer.data(),
+                          info.sector_size) != 0)
+                    return -1;
+
+                if(first) sector = res_sector;
+                first = false;
+            }
+        }
+
+        return 0;
+    }
+
+    int NvmeZnsBackend::map(uint64_t zone, uint64_t sector, uint64_t size,
+        const void **buffer)
+    {
+        return -1;
+    }
+
+    int NvmeZnsBackend::report_zones(uint64_t zone,
+        struct nvme_zns_zone_desc *descs, uint64_t &count)
+    {
+        return -1;
+    }
+
+    int NvmeZnsBackend::finish(uint64_t zone) {
+        return -1;
+    }
+
+    int NvmeZnsBackend::open(uint64_t zone) {
+        return -1;
+    }
+
+    int NvmeZnsBackend::close(uint64_t zone) {
+        return -1;
+    }
+
+    /**
+     * @threadsafety: thread safe
+     */
+    void NvmeZnsBackend::complete(const nvme_zns_callback_t &callback,
+        int result, uint64_t sector)
+    {
+        {
+            std::lock_guard<std::mutex> guard(completion_lock);
+            completions.emplace_back([callback, result, sector]() {
+                callback(result, sector);
+            });
+        }
+        completion_cv.notify_all();
+    }
+
+    /**
+     * Synchronous fallback, the operation is finished before returning.
+     * @threadsafety: thread safe if read is thread safe.
+     */
+    int NvmeZnsBackend::submit_read(uint64_t zone, uint64_t sector,
+        uint64_t offset, void *buffer, uint64_t size,
+        nvme_zns_callback_t callback)
+    {
+        complete(callback, read(zone, sector, offset, buffer, size), sector);
+        return 0;
+    }
+
+    /**
+     * Synchronous fallback, the operation is finished before returning.
+     * @threadsafety: thread safe if readv is thread safe.
+     */
+    int NvmeZnsBackend::submit_readv(struct nvme_zns_iovec *iov,
+        uint64_t iovcnt, nvme_zns_callback_t callback)
+    {
+        complete(callback, readv(iov, iovcnt), 0);
+        return 0;
+    }
+
+    /**
+     * Synchronous fallback, the operation is finished before returning.
+     * @threadsafety: thread safe if append is thread safe.
+     */
+    int NvmeZnsBackend::submit_append(uint64_t zone, uint64_t offset,
+        void *buffer, uint64_t size, nvme_zns_callback_t callback)
+    {
+        uint64_t sector = 0;
+        complete(callback, append(zone, sector, offset, buffer, size), sector);
+        return 0;
+    }
+
+    /**
+     * Synchronous fallback, the operation is finished before returning.
+     * @threadsafety: thread safe if reset is thread safe.
+     */
+    int NvmeZnsBackend::submit_reset(uint64_t zone,
+        nvme_zns_callback_t callback)
+    {
+        complete(callback, reset(zone), 0);
+        return 0;
+    }
+
+    /**
+     * Callbacks are called without holding the completion lock so they are
+     * free to submit new operations.
+     * @threadsafety: thread safe
+     */
+    uint64_t NvmeZnsBackend::poll() {
+        std::deque<std::function<void()>> finished;
+        {
+            std::lock_guard<std::mutex> guard(completion_lock);
+            finished.swap(completions);
+        }
+
+        for(auto &callback : finished) {
+            callback();
+        }
+
+        return finished.size();
+    }
+
+    /**
+     * Sleep on the completion queue while there is nothing to poll, backends
+     * that need to actively drive completions should override this.
+     * @threadsafety: thread safe
+     */
+    int NvmeZnsBackend::wait(struct nvme_zns_batch *batch) {
+        while(batch->pending.load() != 0) {
+            if(poll() != 0) continue;
+
+            std::unique_lock<std::mutex> lock(completion_lock);
+            completion_cv.wait_for(lock, std::chrono::milliseconds(1),
+                [this]() { return !completions.empty(); });
+        }
+
+        return batch->result.load();
+    }
+
+}
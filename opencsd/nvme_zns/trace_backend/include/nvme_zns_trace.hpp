@@ -0,0 +1,188 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Dantali0n
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef QEMU_CSD_NVME_ZNS_TRACE_HPP
+#define QEMU_CSD_NVME_ZNS_TRACE_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "nvme_zns_backend.hpp"
+
+namespace qemucsd::nvme_zns {
+
+    // "ZNSTRACE" in little endian
+    static constexpr uint64_t NVME_ZNS_TRACE_MAGIC = 0x4543415254534E5A;
+    static constexpr uint32_t NVME_ZNS_TRACE_VERSION = 1;
+
+    enum nvme_zns_trace_op : uint8_t {
+        TRACE_OP_READ,
+        TRACE_OP_APPEND,
+        TRACE_OP_RESET,
+        TRACE_OP_FINISH,
+        TRACE_OP_OPEN,
+        TRACE_OP_CLOSE,
+        TRACE_OP_COPY,
+    };
+
+    /**
+     * Geometry of the traced device, stored at the start of every trace.
+     */
+    struct nvme_zns_trace_header {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t sector_size;
+        uint64_t num_zones;
+        uint64_t zone_size;
+        uint64_t zone_capacity;
+    };
+    static_assert(sizeof(nvme_zns_trace_header) == 40);
+
+    /**
+     * Single traced operation, vectored operations are recorded per range.
+     * The sector of appends is the location the data was written to. Copies
+     * are recorded per source range with the destination zone in _target_.
+     */
+    struct nvme_zns_trace_record {
+        // Nanoseconds between the start of the trace and the submission
+        uint64_t timestamp;
+        uint32_t zone;
+        uint32_t sector;
+        // Size in bytes
+        uint32_t size;
+        // Nanoseconds until completion, saturates at UINT32_MAX
+        uint32_t latency;
+        uint32_t target;
+        // Sequential identifier of the submitting thread
+        uint16_t thread;
+        enum nvme_zns_trace_op op;
+        int8_t result;
+    };
+    static_assert(sizeof(nvme_zns_trace_record) == 32);
+
+    typedef std::chrono::steady_clock::time_point nvme_zns_trace_time_t;
+
+    /**
+     * Decorator recording every data and zone management operation of any
+     * other backend into a binary trace file, see zcsd-replay to re-issue a
+     * trace. Records are buffered in memory and written once the buffer is
+     * full or the decorator is destroyed.
+     */
+    class NvmeZnsTraceBackend : public NvmeZnsBackend {
+    protected:
+        NvmeZnsBackend *backend;
+
+        FILE *file;
+        nvme_zns_trace_time_t start;
+
+        std::vector<struct nvme_zns_trace_record> records;
+        std::mutex record_lock;
+
+        static struct nvme_zns_info query_info(NvmeZnsBackend *backend);
+
+        NvmeZnsTraceBackend(NvmeZnsBackend *backend, const std::string &path,
+            struct nvme_zns_info info);
+
+        static uint16_t thread_id();
+
+        void record(enum nvme_zns_trace_op op, uint64_t zone, uint64_t sector,
+            uint64_t size, nvme_zns_trace_time_t submitted, uint16_t thread,
+            int result, uint64_t target = 0);
+
+        /**
+         * Wrap _callback_ so the operation is recorded upon completion.
+         */
+        nvme_zns_callback_t traced(enum nvme_zns_trace_op op, uint64_t zone,
+            uint64_t size, nvme_zns_callback_t callback);
+
+        void flush_locked();
+
+    public:
+        /**
+         * Create or truncate the trace at _path_, exits upon failure.
+         * @param backend the decorated backend, must outlive the decorator.
+         */
+        NvmeZnsTraceBackend(NvmeZnsBackend *backend, const std::string &path);
+
+        // Virtual required to enforce destructor is called in super classes
+        virtual ~NvmeZnsTraceBackend();
+
+        /**
+         * Write all buffered records to the trace file.
+         */
+        void flush();
+
+        void get_nvme_zns_info(struct nvme_zns_info* info) override;
+
+        int read(uint64_t zone, uint64_t sector, uint64_t offset, void* buffer,
+                 uint64_t size) override;
+
+        int append(uint64_t zone, uint64_t& sector, uint64_t offset,
+                   void* buffer, uint64_t size) override;
+
+        int reset(uint64_t zone) override;
+
+        int readv(struct nvme_zns_iovec *iov, uint64_t iovcnt) override;
+
+        int appendv(uint64_t zone, uint64_t& sector,
+                    struct nvme_zns_iovec *iov, uint64_t iovcnt) override;
+
+        int copy(struct nvme_zns_copy_range *ranges, uint64_t nranges,
+                 uint64_t zone, uint64_t &sector) override;
+
+        int report_zones(uint64_t zone, struct nvme_zns_zone_desc *descs,
+                         uint64_t &count) override;
+
+        int finish(uint64_t zone) override;
+
+        int open(uint64_t zone) override;
+
+        int close(uint64_t zone) override;
+
+        int submit_read(uint64_t zone, uint64_t sector, uint64_t offset,
+                        void *buffer, uint64_t size,
+                        nvme_zns_callback_t callback) override;
+
+        int submit_readv(struct nvme_zns_iovec *iov, uint64_t iovcnt,
+                         nvme_zns_callback_t callback) override;
+
+        int submit_append(uint64_t zone, uint64_t offset, void *buffer,
+                          uint64_t size, nvme_zns_callback_t callback) override;
+
+        int submit_reset(uint64_t zone, nvme_zns_callback_t callback) override;
+
+        uint64_t poll() override;
+
+        int wait(struct nvme_zns_batch *batch) override;
+    };
+
+}
+
+#endif // QEMU_CSD_NVME_ZNS_TRACE_HPP
@@ -0,0 +1,308 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Dantali0n
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "nvme_zns_trace.hpp"
+
+#include <atomic>
+#include <iostream>
+
+#include "output.hpp"
+
+namespace qemucsd::nvme_zns {
+
+    static output::Output output = output::Output(
+        "[NVME_ZNS_TRACE] ", output::INFO);
+
+    // Number of records buffered before they are written to the trace
+    static constexpr size_t TRACE_BUFFER_RECORDS = 4096;
+
+    NvmeZnsTraceBackend::NvmeZnsTraceBackend(NvmeZnsBackend *backend,
+        const std::string &path) :
+        NvmeZnsTraceBackend(backend, path, query_info(backend))
+    {
+
+    }
+
+    NvmeZnsTraceBackend::NvmeZnsTraceBackend(NvmeZnsBackend *backend,
+        const std::string &path, struct nvme_zns_info info) :
+        NvmeZnsBackend(info.num_zones, info.zone_size, info.zone_capacity,
+                       info.sector_size, info.max_open, info.max_active),
+        backend(backend), start(std::chrono::steady_clock::now())
+    {
+        file = fopen(path.c_str(), "wb");
+        if(file == nullptr) {
+            output(std::cerr, "nvme_zns_trace_backend failed to open ", path);
+            exit(1);
+        }
+
+        struct nvme_zns_trace_header header = {
+            NVME_ZNS_TRACE_MAGIC, NVME_ZNS_TRACE_VERSION,
+            (uint32_t) info.sector_size, info.num_zones, info.zone_size,
+            info.zone_capacity
+        };
+        if(fwrite(&header, sizeof(header), 1, file) != 1) {
+            output(std::cerr, "nvme_zns_trace_backend failed to write ", path);
+            exit(1);
+        }
+
+        records.reserve(TRACE_BUFFER_RECORDS);
+    }
+
+    NvmeZnsTraceBackend::~NvmeZnsTraceBackend() {
+        flush();
+        fclose(file);
+    }
+
+    struct nvme_zns_info NvmeZnsTraceBackend::query_info(
+        NvmeZnsBackend *backend)
+    {
+        struct nvme_zns_info info = {0};
+        backend->get_nvme_zns_info(&info);
+        return info;
+    }
+
+    void NvmeZnsTraceBackend::get_nvme_zns_info(struct nvme_zns_info* info) {
+        NvmeZnsBackend::get_nvme_zns_info(info);
+    }
+
+    /**
+     * Threads are numbered in order of their first traced operation.
+     * @threadsafety: thread safe
+     */
+    uint16_t NvmeZnsTraceBackend::thread_id() {
+        static std::atomic<uint16_t> next_id(0);
+        thread_local uint16_t id = next_id.fetch_add(1);
+        return id;
+    }
+
+    /**
+     * Asynchronous operations complete in whichever thread polls, so the
+     * _thread_ must be determined upon submission.
+     * @threadsafety: thread safe
+     */
+    void NvmeZnsTraceBackend::record(enum nvme_zns_trace_op op, uint64_t zone,
+        uint64_t sector, uint64_t size, nvme_zns_trace_time_t submitted,
+        uint16_t thread, int result, uint64_t target)
+    {
+        auto now = std::chrono::steady_clock::now();
+        uint64_t latency = std::chrono::duration_cast<
+            std::chrono::nanoseconds>(now - submitted).count();
+
+        struct nvme_zns_trace_record entry = {
+            (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+                submitted - start).count(),
+            (uint32_t) zone, (uint32_t) sector, (uint32_t) size,
+            latency > UINT32_MAX ? UINT32_MAX : (uint32_t) latency,
+            (uint32_t) target, thread, op, (int8_t) result
+        };
+
+        std::lock_guard<std::mutex> guard(record_lock);
+        records.push_back(entry);
+        if(records.size() >= TRACE_BUFFER_RECORDS) flush_locked();
+    }
+
+    nvme_zns_callback_t NvmeZnsTraceBackend::traced(
+        enum nvme_zns_trace_op op, uint64_t zone, uint64_t size,
+        nvme_zns_callback_t callback)
+    {
+        auto submitted = std::chrono::steady_clock::now();
+        uint16_t thread = thread_id();
+        return [this, op, zone, size, submitted, thread, callback](
+            int result, uint64_t sector)
+        {
+            record(op, zone, sector, size, submitted, thread, result);
+            callback(result, sector);
+        };
+    }
+
+    /**
+     * @threadsafety: requires record_lock to be held
+     */
+    void NvmeZnsTraceBackend::flush_locked() {
+        if(!records.empty() && fwrite(records.data(),
+            sizeof(nvme_zns_trace_record), records.size(), file) !=
+            records.size())
+            output.error("Failed to write ", records.size(), " records");
+
+        records.clear();
+        fflush(file);
+    }
+
+    /**
+     * @threadsafety: thread safe
+     */
+    void NvmeZnsTraceBackend::flush() {
+        std::lock_guard<std::mutex> guard(record_lock);
+        flush_locked();
+    }
+
+    int NvmeZnsTraceBackend::read(uint64_t zone, uint64_t sector,
+        uint64_t offset, void* buffer, uint64_t size)
+    {
+        auto submitted = std::chrono::steady_clock::now();
+        int result = backend->read(zone, sector, offset, buffer, size);
+        record(TRACE_OP_READ, zone, sector, size, submitted, thread_id(),
+               result);
+        return result;
+    }
+
+    int NvmeZnsTraceBackend::append(uint64_t zone, uint64_t& sector,
+        uint64_t offset, void* buffer, uint64_t size)
+    {
+        auto submitted = std::chrono::steady_clock::now();
+        int result = backend->append(zone, sector, offset, buffer, size);
+        record(TRACE_OP_APPEND, zone, result == 0 ? sector : 0, offset + size,
+               submitted, thread_id(), result);
+        return result;
+    }
+
+    int NvmeZnsTraceBackend::reset(uint64_t zone) {
+        auto submitted = std::chrono::steady_clock::now();
+        int result = backend->reset(zone);
+        record(TRACE_OP_RESET, zone, 0, 0, submitted, thread_id(), result);
+        return result;
+    }
+
+    int NvmeZnsTraceBackend::readv(struct nvme_zns_iovec *iov,
+        uint64_t iovcnt)
+    {
+        auto submitted = std::chrono::steady_clock::now();
+        int result = backend->readv(iov, iovcnt);
+        for(uint64_t i = 0; i < iovcnt; i++) {
+            record(TRACE_OP_READ, iov[i].zone, iov[i].sector, iov[i].size,
+                   submitted, thread_id(), result);
+        }
+        return result;
+    }
+
+    int NvmeZnsTraceBackend::appendv(uint64_t zone, uint64_t& sector,
+        struct nvme_zns_iovec *iov, uint64_t iovcnt)
+    {
+        auto submitted = std::chrono::steady_clock::now();
+        int result = backend->appendv(zone, sector, iov, iovcnt);
+        for(uint64_t i = 0; i < iovcnt; i++) {
+            record(TRACE_OP_APPEND, zone, result == 0 ? iov[i].sector : 0,
+                   iov[i].size, submitted, thread_id(), result);
+        }
+        return result;
+    }
+
+    int NvmeZnsTraceBackend::copy(struct nvme_zns_copy_range *ranges,
+        uint64_t nranges, uint64_t zone, uint64_t &sector)
+    {
+        auto submitted = std::chrono::steady_clock::now();
+        int result = backend->copy(ranges, nranges, zone, sector);
+        for(uint64_t i = 0; i < nranges; i++) {
+            record(TRACE_OP_COPY, ranges[i].zone, ranges[i].sector,
+                   ranges[i].sectors * info.sector_size, submitted,
+                   thread_id(), result, zone);
+        }
+        return result;
+    }
+
+    /**
+     * Reports do not change device state and are not recorded.
+     */
+    int NvmeZnsTraceBackend::report_zones(uint64_t zone,
+        struct nvme_zns_zone_desc *descs, uint64_t &count)
+    {
+        return backend->report_zones(zone, descs, count);
+    }
+
+    int NvmeZnsTraceBackend::finish(uint64_t zone) {
+        auto submitted = std::chrono::steady_clock::now();
+        int result = backend->finish(zone);
+        record(TRACE_OP_FINISH, zone, 0, 0, submitted, thread_id(), result);
+        return result;
+    }
+
+    int NvmeZnsTraceBackend::open(uint64_t zone) {
+        auto submitted = std::chrono::steady_clock::now();
+        int result = backend->open(zone);
+        record(TRACE_OP_OPEN, zone, 0, 0, submitted, thread_id(), result);
+        return result;
+    }
+
+    int NvmeZnsTraceBackend::close(uint64_t zone) {
+        auto submitted = std::chrono::steady_clock::now();
+        int result = backend->close(zone);
+        record(TRACE_OP_CLOSE, zone, 0, 0, submitted, thread_id(), result);
+        return result;
+    }
+
+    int NvmeZnsTraceBackend::submit_read(uint64_t zone, uint64_t sector,
+        uint64_t offset, void *buffer, uint64_t size,
+        nvme_zns_callback_t callback)
+    {
+        return backend->submit_read(zone, sector, offset, buffer, size,
+            traced(TRACE_OP_READ, zone, size, std::move(callback)));
+    }
+
+    /**
+     * Ranges are recorded upon completion, the iovecs are guaranteed to be
+     * valid until then.
+     */
+    int NvmeZnsTraceBackend::submit_readv(struct nvme_zns_iovec *iov,
+        uint64_t iovcnt, nvme_zns_callback_t callback)
+    {
+        auto submitted = std::chrono::steady_clock::now();
+        uint16_t thread = thread_id();
+        return backend->submit_readv(iov, iovcnt,
+            [this, iov, iovcnt, submitted, thread, callback](
+                int result, uint64_t sector)
+            {
+                for(uint64_t i = 0; i < iovcnt; i++) {
+                    record(TRACE_OP_READ, iov[i].zone, iov[i].sector,
+                           iov[i].size, submitted, thread, result);
+                }
+                callback(result, sector);
+            });
+    }
+
+    int NvmeZnsTraceBackend::submit_append(uint64_t zone, uint64_t offset,
+        void *buffer, uint64_t size, nvme_zns_callback_t callback)
+    {
+        return backend->submit_append(zone, offset, buffer, size,
+            traced(TRACE_OP_APPEND, zone, offset + size, std::move(callback)));
+    }
+
+    int NvmeZnsTraceBackend::submit_reset(uint64_t zone,
+        nvme_zns_callback_t callback)
+    {
+        return backend->submit_reset(zone,
+            traced(TRACE_OP_RESET, zone, 0, std::move(callback)));
+    }
+
+    /**
+     * Completions are delivered by the decorated backend.
+     */
+    uint64_t NvmeZnsTraceBackend::poll() {
+        return backend->poll();
+    }
+
+    int NvmeZnsTraceBackend::wait(struct nvme_zns_batch *batch) {
+        return backend->wait(batch);
+    }
+}
@@ -59,6 +59,8 @@ namespace qemucsd::spdk_init {
 
         // Maximum number of open zones
         uint32_t max_open;
+        // Maximum number of open or closed zones
+        uint32_t max_active;
 	};
 
 	/**
@@ -177,6 +177,8 @@ namespace qemucsd::spdk_init {
 
             // Determine maximum number of open zones
             entry->max_open = spdk_nvme_zns_ns_get_max_open_zones(entry->ns);
+            entry->max_active =
+                spdk_nvme_zns_ns_get_max_active_zones(entry->ns);
 
 			// Only want first ZNS supporting namespace
 			break;
@@ -0,0 +1,214 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Dantali0n
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "arguments.hpp"
+#include "nvme_zns_memory.hpp"
+#include "nvme_zns_mmap.hpp"
+#include "nvme_zns_model.hpp"
+#include "nvme_zns_trace.hpp"
+
+using qemucsd::nvme_zns::NvmeZnsBackend;
+using qemucsd::nvme_zns::NvmeZnsMemoryBackend;
+using qemucsd::nvme_zns::NvmeZnsMmapBackend;
+using qemucsd::nvme_zns::NvmeZnsModelBackend;
+using qemucsd::nvme_zns::nvme_zns_trace_header;
+using qemucsd::nvme_zns::nvme_zns_trace_record;
+
+typedef std::vector<struct nvme_zns_trace_record> trace_records_t;
+
+/**
+ * Re-issue a single traced operation, the trace does not contain any data so
+ * appends write the contents of buffer instead.
+ * @return result of the replayed operation
+ */
+int replay_record(NvmeZnsBackend *nvme, const nvme_zns_trace_record &record,
+    std::vector<uint8_t> &buffer, uint64_t sector_size)
+{
+    uint64_t sector;
+    switch(record.op) {
+        case qemucsd::nvme_zns::TRACE_OP_READ:
+            return nvme->read(record.zone, record.sector, 0, buffer.data(),
+                              record.size);
+        case qemucsd::nvme_zns::TRACE_OP_APPEND:
+            return nvme->append(record.zone, sector, 0, buffer.data(),
+                                record.size);
+        case qemucsd::nvme_zns::TRACE_OP_RESET:
+            return nvme->reset(record.zone);
+        case qemucsd::nvme_zns::TRACE_OP_FINISH:
+            return nvme->finish(record.zone);
+        case qemucsd::nvme_zns::TRACE_OP_OPEN:
+            return nvme->open(record.zone);
+        case qemucsd::nvme_zns::TRACE_OP_CLOSE:
+            return nvme->close(record.zone);
+        case qemucsd::nvme_zns::TRACE_OP_COPY: {
+            struct qemucsd::nvme_zns::nvme_zns_copy_range range = {
+                record.zone, record.sector, record.size / sector_size};
+            return nvme->copy(&range, 1, record.target, sector);
+        }
+        default:
+            return -1;
+    }
+}
+
+/**
+ * Replay the records of a single traced thread in order. With the original
+ * timing every operation is delayed until its timestamp relative to start.
+ */
+void replay_thread(NvmeZnsBackend *nvme, const trace_records_t *records,
+    std::chrono::steady_clock::time_point start, bool max_speed,
+    uint64_t sector_size, std::atomic<uint64_t> *divergent)
+{
+    uint32_t max_size = 0;
+    for(auto &record : *records) {
+        max_size = std::max(max_size, record.size);
+    }
+    std::vector<uint8_t> buffer(max_size + sector_size, 0);
+
+    for(auto &record : *records) {
+        if(!max_speed) {
+            std::this_thread::sleep_until(
+                start + std::chrono::nanoseconds(record.timestamp));
+        }
+
+        int result = replay_record(nvme, record, buffer, sector_size);
+        if((result == 0) != (record.result == 0))
+            divergent->fetch_add(1);
+    }
+}
+
+/**
+ * Replay a trace recorded with fuse-entry --trace against any emulated
+ * backend. Every traced thread is replayed by its own thread.
+ */
+int main(int argc, char* argv[]) {
+    qemucsd::arguments::options opts;
+    qemucsd::arguments::parse_args(argc, argv, &opts);
+
+    if(opts.zns_trace->empty()) {
+        std::cerr << "No trace specified, see --help" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    FILE *file = fopen(opts.zns_trace->c_str(), "rb");
+    if(file == nullptr) {
+        std::cerr << "Failed to open trace " << *opts.zns_trace << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    struct nvme_zns_trace_header header = {0};
+    if(fread(&header, sizeof(header), 1, file) != 1 ||
+       header.magic != qemucsd::nvme_zns::NVME_ZNS_TRACE_MAGIC ||
+       header.version != qemucsd::nvme_zns::NVME_ZNS_TRACE_VERSION)
+    {
+        std::cerr << "Invalid trace " << *opts.zns_trace << std::endl;
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+
+    std::map<uint16_t, trace_records_t> threads;
+    uint64_t num_records = 0;
+    uint64_t duration = 0;
+    struct nvme_zns_trace_record record;
+    while(fread(&record, sizeof(record), 1, file) == 1) {
+        threads[record.thread].push_back(record);
+        duration = std::max(duration, record.timestamp + record.latency);
+        num_records += 1;
+    }
+    fclose(file);
+
+    // Records are written upon completion, replay each thread in the order
+    // its operations were submitted.
+    for(auto &thread : threads) {
+        std::stable_sort(thread.second.begin(), thread.second.end(),
+            [](const nvme_zns_trace_record &a,
+               const nvme_zns_trace_record &b)
+            {
+                return a.timestamp < b.timestamp;
+            });
+    }
+
+    // Recreate the traced device geometry using the requested backend
+    std::unique_ptr<NvmeZnsBackend> nvme;
+    std::unique_ptr<NvmeZnsBackend> nvme_model;
+    if(opts.zns_backend == qemucsd::arguments::ZNS_BACKEND_MMAP) {
+        nvme = std::make_unique<NvmeZnsMmapBackend>(*opts.zns_image,
+            header.num_zones, header.zone_size, header.sector_size, 4,
+            opts.zns_max_open, opts.zns_max_active);
+    }
+    else {
+        nvme = std::make_unique<NvmeZnsMemoryBackend>(header.num_zones,
+            header.zone_size, header.sector_size, 4, opts.zns_max_open,
+            opts.zns_max_active);
+    }
+
+    struct qemucsd::nvme_zns::nvme_zns_info info = {0};
+    nvme->get_nvme_zns_info(&info);
+    if(info.zone_capacity != header.zone_capacity) {
+        std::cerr << "Warning: zone capacity " << info.zone_capacity <<
+            " differs from traced capacity " << header.zone_capacity <<
+            std::endl;
+    }
+
+    if(opts.zns_model) {
+        struct qemucsd::nvme_zns::nvme_zns_model model = {
+            opts.zns_model_read_latency, opts.zns_model_append_latency,
+            opts.zns_model_reset_latency,
+            opts.zns_model_read_bandwidth * 1024 * 1024,
+            opts.zns_model_append_bandwidth * 1024 * 1024,
+            opts.zns_model_channels
+        };
+        nvme_model = std::make_unique<NvmeZnsModelBackend>(nvme.get(), model);
+    }
+    NvmeZnsBackend *device = nvme_model ? nvme_model.get() : nvme.get();
+
+    std::atomic<uint64_t> divergent(0);
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for(auto &thread : threads) {
+        workers.emplace_back(replay_thread, device, &thread.second, start,
+            opts.zns_replay_max_speed, header.sector_size, &divergent);
+    }
+    for(auto &worker : workers) worker.join();
+    auto stop = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        stop - start);
+
+    std::cout << "Replayed " << num_records << " operations from " <<
+        threads.size() << " threads in " << elapsed.count() << "us, traced " <<
+        duration / 1000 << "us." << std::endl;
+    std::cout << "Operations with a different result than traced: " <<
+        divergent.load() << std::endl;
+
+    return EXIT_SUCCESS;
+}
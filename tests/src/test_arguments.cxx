@@ -44,6 +44,32 @@ BOOST_AUTO_TEST_SUITE(Test_Arguments)
         BOOST_CHECK(
             opts.ubpf_mem_size == qemucsd::arguments::DEFAULT_UBPF_MEM_SIZE);
         BOOST_CHECK(opts.ubpf_jit == qemucsd::arguments::DEFAULT_UBPF_JIT);
+        BOOST_CHECK(
+            opts.zns_backend == qemucsd::arguments::DEFAULT_ZNS_BACKEND);
+        BOOST_CHECK(
+            opts.zns_num_zones == qemucsd::arguments::DEFAULT_ZNS_NUM_ZONES);
+        BOOST_CHECK(
+            opts.zns_zone_size == qemucsd::arguments::DEFAULT_ZNS_ZONE_SIZE);
+        BOOST_CHECK(
+            opts.zns_max_open == qemucsd::arguments::DEFAULT_ZNS_MAX_OPEN);
+        BOOST_CHECK(
+            opts.zns_max_active == qemucsd::arguments::DEFAULT_ZNS_MAX_ACTIVE);
+        BOOST_CHECK(
+            opts.zns_cache_size == qemucsd::arguments::DEFAULT_ZNS_CACHE_SIZE);
+        BOOST_CHECK(strcmp(opts.zns_image->c_str(),
+            qemucsd::arguments::DEFAULT_ZNS_IMAGE) == 0);
+        BOOST_CHECK(opts.zns_model == qemucsd::arguments::DEFAULT_ZNS_MODEL);
+        BOOST_CHECK(opts.zns_model_channels ==
+            qemucsd::arguments::DEFAULT_ZNS_MODEL_CHANNELS);
+        BOOST_CHECK(opts.zns_trace->empty());
+        BOOST_CHECK(opts.zns_replay_max_speed ==
+            qemucsd::arguments::DEFAULT_ZNS_REPLAY_MAX_SPEED);
+        BOOST_CHECK(opts.flfs_dirty_bytes ==
+            qemucsd::arguments::DEFAULT_FLFS_DIRTY_BYTES);
+        BOOST_CHECK(opts.flfs_dirty_inodes ==
+            qemucsd::arguments::DEFAULT_FLFS_DIRTY_INODES);
+        BOOST_CHECK(opts.flfs_dirty_expire ==
+            qemucsd::arguments::DEFAULT_FLFS_DIRTY_EXPIRE);
     }
 
 	BOOST_AUTO_TEST_CASE(Test_Arguments_Device_Mode) {
@@ -104,6 +130,68 @@ BOOST_AUTO_TEST_SUITE(Test_Arguments)
         BOOST_CHECK(opts.ubpf_jit == false);
     }
 
+    BOOST_AUTO_TEST_CASE(Test_Arguments_Zns_Backend) {
+        int argc = 9;
+        char *argv[9] = {(char*)"test", (char*)"-b", (char*)"MMAP",
+            (char*)"--image", (char*)"aged.img", (char*)"--zones",
+            (char*)"32", (char*)"--zone-size", (char*)"256"};
+        qemucsd::arguments::options opts;
+        qemucsd::arguments::parse_args(argc, argv, &opts);
+
+        BOOST_CHECK(opts.zns_backend == qemucsd::arguments::ZNS_BACKEND_MMAP);
+        BOOST_CHECK(strcmp(opts.zns_image->c_str(), "aged.img") == 0);
+        BOOST_CHECK(opts.zns_num_zones == 32);
+        BOOST_CHECK(opts.zns_zone_size == 256);
+    }
+
+    BOOST_AUTO_TEST_CASE(Test_Arguments_Zns_Limits) {
+        int argc = 5;
+        char *argv[5] = {(char*)"test", (char*)"--max-open", (char*)"14",
+            (char*)"--max-active", (char*)"16"};
+        qemucsd::arguments::options opts;
+        qemucsd::arguments::parse_args(argc, argv, &opts);
+
+        BOOST_CHECK(opts.zns_max_open == 14);
+        BOOST_CHECK(opts.zns_max_active == 16);
+    }
+
+    BOOST_AUTO_TEST_CASE(Test_Arguments_Zns_Cache) {
+        int argc = 3;
+        char *argv[3] = {(char*)"test", (char*)"--cache-size", (char*)"0"};
+        qemucsd::arguments::options opts;
+        qemucsd::arguments::parse_args(argc, argv, &opts);
+
+        BOOST_CHECK(opts.zns_cache_size == 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(Test_Arguments_Zns_Model) {
+        int argc = 7;
+        char *argv[7] = {(char*)"test", (char*)"--model", (char*)"true",
+            (char*)"--model-read-latency", (char*)"100",
+            (char*)"--model-channels", (char*)"4"};
+        qemucsd::arguments::options opts;
+        qemucsd::arguments::parse_args(argc, argv, &opts);
+
+        BOOST_CHECK(opts.zns_model == true);
+        BOOST_CHECK(opts.zns_model_read_latency == 100);
+        BOOST_CHECK(opts.zns_model_channels == 4);
+        BOOST_CHECK(opts.zns_model_append_latency ==
+            qemucsd::arguments::DEFAULT_ZNS_MODEL_APPEND_LATENCY);
+    }
+
+    BOOST_AUTO_TEST_CASE(Test_Arguments_Flfs_Writeback) {
+        int argc = 5;
+        char *argv[5] = {(char*)"test", (char*)"--dirty-bytes",
+            (char*)"1048576", (char*)"--dirty-expire", (char*)"0"};
+        qemucsd::arguments::options opts;
+        qemucsd::arguments::parse_args(argc, argv, &opts);
+
+        BOOST_CHECK(opts.flfs_dirty_bytes == 1048576);
+        BOOST_CHECK(opts.flfs_dirty_expire == 0);
+        BOOST_CHECK(opts.flfs_dirty_inodes ==
+            qemucsd::arguments::DEFAULT_FLFS_DIRTY_INODES);
+    }
+
     BOOST_AUTO_TEST_CASE(Test_Arguments_auto_strip_first) {
         int argc = 3;
         char *argv[3] = {(char*)"test", (char*)"--jit", (char*)"false"};
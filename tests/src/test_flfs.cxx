@@ -82,6 +82,8 @@ BOOST_AUTO_TEST_SUITE(Test_FuseLfs)
         using FuseLFS::position_to_lba;
 
         using FuseLFS::inode_lba_map;
+
+        using FuseLFS::flatten_data_blocks;
     };
 
     BOOST_AUTO_TEST_CASE(Test_FuseLFS_lba_to_position) {
@@ -131,4 +133,108 @@ BOOST_AUTO_TEST_SUITE(Test_FuseLfs)
         }
     }
 
+    BOOST_AUTO_TEST_CASE(Test_FuseLFS_flatten_data_blocks) {
+        using qemucsd::fuse_lfs::DATA_BLK_LBA_NUM;
+        using qemucsd::fuse_lfs::SECTOR_SIZE;
+
+        TestFuseLFS testfuse;
+
+        // Two consecutive runs separated by holes, the second run crosses
+        // both a zone and a data_block boundary.
+        qemucsd::fuse_lfs::data_map_t blocks;
+        for(uint64_t i = 0; i < 70; i++) {
+            uint64_t lba = 0;
+            if(i < 4) lba = 100 + i;
+            else if(i >= 6) lba = 1020 + (i - 6);
+            blocks[i / DATA_BLK_LBA_NUM].data_lbas[i % DATA_BLK_LBA_NUM] = lba;
+        }
+
+        std::vector<struct flfs_extent> extents;
+        testfuse.flatten_data_blocks(70 * SECTOR_SIZE, 0, &blocks, 1024,
+                                     &extents);
+
+        std::vector<std::pair<uint64_t, uint64_t>> expected =
+            {{100, 4}, {0, 1}, {0, 1}, {1020, 4}, {1024, 60}, {0, 0}};
+        BOOST_REQUIRE(extents.size() == expected.size());
+        for(uint64_t i = 0; i < expected.size(); i++) {
+            BOOST_CHECK(extents.at(i).lba == expected.at(i).first);
+            BOOST_CHECK(extents.at(i).length == expected.at(i).second);
+        }
+
+        // Unaligned offset and size only include the sectors they touch
+        extents.clear();
+        testfuse.flatten_data_blocks(2 * SECTOR_SIZE, 2 * SECTOR_SIZE + 10,
+                                     &blocks, 1024, &extents);
+
+        expected = {{102, 2}, {0, 1}, {0, 0}};
+        BOOST_REQUIRE(extents.size() == expected.size());
+        for(uint64_t i = 0; i < expected.size(); i++) {
+            BOOST_CHECK(extents.at(i).lba == expected.at(i).first);
+            BOOST_CHECK(extents.at(i).length == expected.at(i).second);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE(Test_FuseLFS_sector_slab) {
+        using qemucsd::fuse_lfs::sector_slab;
+        using qemucsd::fuse_lfs::SECTOR_SIZE;
+
+        void *first = sector_slab::alloc();
+        BOOST_REQUIRE(first != nullptr);
+        BOOST_CHECK((uintptr_t) first % SECTOR_SIZE == 0);
+        memset(first, 0xFF, SECTOR_SIZE);
+
+        // Released buffers are reused by the same thread
+        sector_slab::release(first);
+        void *second = sector_slab::alloc();
+        BOOST_CHECK(second == first);
+
+        void *third = sector_slab::alloc();
+        BOOST_CHECK(third != second);
+
+        sector_slab::release(second);
+        sector_slab::release(third);
+        sector_slab::release(nullptr);
+    }
+
+    BOOST_AUTO_TEST_CASE(Test_FuseLFS_arena) {
+        using qemucsd::fuse_lfs::arena;
+        using qemucsd::fuse_lfs::ARENA_SIZE;
+        using qemucsd::fuse_lfs::SECTOR_SIZE;
+
+        void *outer_first;
+        {
+            arena outer;
+            outer_first = outer.alloc(10);
+            BOOST_REQUIRE(outer_first != nullptr);
+            BOOST_CHECK((uintptr_t) outer_first % SECTOR_SIZE == 0);
+
+            // Allocations are rounded to sectors and do not overlap
+            void *outer_second = outer.alloc(SECTOR_SIZE);
+            BOOST_CHECK((uint8_t*) outer_second ==
+                        (uint8_t*) outer_first + SECTOR_SIZE);
+
+            // Nested arena continues after the outer one and returns its space
+            // upon destruction
+            void *inner_first;
+            {
+                arena inner;
+                inner_first = inner.alloc(SECTOR_SIZE);
+                BOOST_CHECK((uint8_t*) inner_first ==
+                            (uint8_t*) outer_second + SECTOR_SIZE);
+
+                // Larger than the region, falls back to system allocator
+                void *large = inner.alloc(ARENA_SIZE + 1);
+                BOOST_REQUIRE(large != nullptr);
+                memset(large, 0xFF, ARENA_SIZE + 1);
+            }
+
+            void *outer_third = outer.alloc(SECTOR_SIZE);
+            BOOST_CHECK(outer_third == inner_first);
+        }
+
+        // Region is empty again once all arenas are destroyed
+        arena request;
+        BOOST_CHECK(request.alloc(SECTOR_SIZE) == outer_first);
+    }
+
 BOOST_AUTO_TEST_SUITE_END()
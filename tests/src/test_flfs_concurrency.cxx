@@ -27,8 +27,11 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <atomic>
+#include <chrono>
 #include <thread>
 #include <future>
+#include <set>
 
 #include "tests.hpp"
 
@@ -64,6 +67,7 @@ BOOST_AUTO_TEST_SUITE(Test_FuseLfsConcurreny)
         }
 
         virtual ~TestFuseLFS() {
+            stop_writeback();
             free_data_structure_heap_memory(this);
         }
 
@@ -76,6 +80,29 @@ BOOST_AUTO_TEST_SUITE(Test_FuseLfsConcurreny)
         using FuseLFS::open_inode_vect;
         using FuseLFS::create_file_handle;
         using FuseLFS::find_file_handle_unsafe;
+        using FuseLFS::read_ahead_window;
+
+        using FuseLFS::nvme;
+        using FuseLFS::lba_to_position;
+        using FuseLFS::get_checkpointblock;
+        using FuseLFS::log_head_lbas;
+        using FuseLFS::log_heads_active;
+        using FuseLFS::log_append;
+
+        using FuseLFS::create_inode;
+        using FuseLFS::get_inode_entry;
+        using FuseLFS::update_inode_entry;
+        using FuseLFS::inode_entries_size;
+        using FuseLFS::buffer_write;
+        using FuseLFS::write_buffer_size;
+
+        using FuseLFS::writeback_dirty_bytes;
+        using FuseLFS::writeback_dirty_expire;
+        using FuseLFS::dirty_bytes;
+        using FuseLFS::mark_dirty;
+        using FuseLFS::start_writeback;
+        using FuseLFS::stop_writeback;
+        using FuseLFS::writeback_throttle;
     };
 
     struct qemucsd::fuse_lfs::data_position NULL_POS = {0};
@@ -289,4 +316,338 @@ BOOST_AUTO_TEST_SUITE(Test_FuseLfsConcurreny)
         BOOST_CHECK(future2.get() == 1);
     }
 
+    /**
+     * The read ahead window grows with every sequential read, collapses upon
+     * a random read and is tracked independently per file handle.
+     */
+    BOOST_AUTO_TEST_CASE(Test_FuseLFS_read_ahead_window,
+        * boost::unit_test::timeout(5))
+    {
+        using qemucsd::fuse_lfs::READ_AHEAD_MIN;
+        using qemucsd::fuse_lfs::READ_AHEAD_MAX;
+
+        qemucsd::nvme_zns::NvmeZnsMemoryBackend nvme_memory(
+            16, 256, qemucsd::fuse_lfs::SECTOR_SIZE);
+        TestFuseLFS test_fuse(&nvme_memory);
+
+        qemucsd::fuse_lfs::csd_unique_t ctx = std::make_pair(1, 23543);
+        struct fuse_file_info fi1 = {0};
+        struct fuse_file_info fi2 = {0};
+        test_fuse.create_file_handle(&ctx, &fi1);
+        test_fuse.create_file_handle(&ctx, &fi2);
+
+        uint64_t start;
+        uint64_t length;
+        uint64_t size = 65536;
+
+        // First read at the start of the file is sequential
+        BOOST_CHECK(test_fuse.read_ahead_window(fi1.fh, 0, size, start,
+            length) == qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(start == size);
+        BOOST_CHECK(length == READ_AHEAD_MIN);
+
+        // Window doubles and only the part not read ahead yet is requested
+        BOOST_CHECK(test_fuse.read_ahead_window(fi1.fh, size, size, start,
+            length) == qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(start == size + READ_AHEAD_MIN);
+        BOOST_CHECK(length == 2 * size + 2 * READ_AHEAD_MIN -
+            (size + READ_AHEAD_MIN));
+
+        // Window is limited to the maximum
+        uint64_t offset = 2 * size;
+        for(uint64_t i = 0; i < 64; i++) {
+            test_fuse.read_ahead_window(fi1.fh, offset, size, start, length);
+            offset += size;
+        }
+        BOOST_CHECK(test_fuse.open_inode_vect.at(0).ra.window ==
+            READ_AHEAD_MAX);
+        BOOST_CHECK(test_fuse.open_inode_vect.at(0).ra.ahead <=
+            offset + READ_AHEAD_MAX);
+
+        // Other file handle is unaffected
+        BOOST_CHECK(test_fuse.open_inode_vect.at(1).ra.window == 0);
+
+        // Random read collapses the window
+        BOOST_CHECK(test_fuse.read_ahead_window(fi1.fh, size, size, start,
+            length) == qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(length == 0);
+        BOOST_CHECK(test_fuse.open_inode_vect.at(0).ra.window == 0);
+
+        // Reading on from the random read is sequential again
+        BOOST_CHECK(test_fuse.read_ahead_window(fi1.fh, 2 * size, size, start,
+            length) == qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(start == 3 * size);
+        BOOST_CHECK(length == READ_AHEAD_MIN);
+
+        BOOST_CHECK(test_fuse.read_ahead_window(UINT64_MAX, 0, size, start,
+            length) == qemucsd::fuse_lfs::FLFS_RET_ENOENT);
+    }
+
+    /**
+     * Fill a zone and repeatedly read it back verifying the contents.
+     * @return number of completed operations, 0 if any data was incorrect
+     */
+    static uint64_t backend_zone_work(
+        qemucsd::nvme_zns::NvmeZnsBackend *nvme, uint64_t zone,
+        uint64_t rounds)
+    {
+        qemucsd::nvme_zns::nvme_zns_info info = {0};
+        nvme->get_nvme_zns_info(&info);
+
+        std::vector<uint8_t> buffer(info.sector_size);
+        uint64_t operations = 0;
+        for(uint64_t i = 0; i < info.zone_capacity; i++) {
+            uint64_t sector;
+            memset(buffer.data(), (zone + i) % UINT8_MAX, info.sector_size);
+            if(nvme->append(zone, sector, 0, buffer.data(), info.sector_size)
+               != 0 || sector != i)
+                return 0;
+            operations++;
+        }
+
+        for(uint64_t r = 0; r < rounds; r++) {
+            for(uint64_t i = 0; i < info.zone_capacity; i++) {
+                if(nvme->read(zone, i, 0, buffer.data(), info.sector_size) != 0
+                   || buffer.at(info.sector_size - 1) != (zone + i) % UINT8_MAX)
+                    return 0;
+                operations++;
+            }
+        }
+
+        return operations;
+    }
+
+    /**
+     * Operations on different zones do not serialize on a single lock so
+     * throughput has to increase with the number of threads.
+     */
+    BOOST_AUTO_TEST_CASE(Test_FuseLFS_backend_scaling,
+        * boost::unit_test::timeout(60))
+    {
+        constexpr uint64_t num_threads = 4;
+        constexpr uint64_t rounds = 500;
+
+        qemucsd::nvme_zns::NvmeZnsMemoryBackend nvme_memory(
+            num_threads + 1, 256, qemucsd::fuse_lfs::SECTOR_SIZE);
+
+        auto start = std::chrono::steady_clock::now();
+        uint64_t single_ops = backend_zone_work(&nvme_memory, 0, rounds);
+        auto single_time = std::chrono::steady_clock::now() - start;
+        BOOST_CHECK(single_ops != 0);
+
+        std::atomic<uint64_t> multi_ops(0);
+        std::atomic<bool> multi_error(false);
+        std::vector<std::thread> threads;
+        start = std::chrono::steady_clock::now();
+        for(uint64_t i = 1; i <= num_threads; i++) {
+            threads.emplace_back([&nvme_memory, &multi_ops, &multi_error, i]() {
+                uint64_t ops = backend_zone_work(&nvme_memory, i, rounds);
+                if(ops == 0) multi_error.store(true);
+                multi_ops.fetch_add(ops);
+            });
+        }
+        for(auto &thread : threads) thread.join();
+        auto multi_time = std::chrono::steady_clock::now() - start;
+        BOOST_CHECK(!multi_error.load());
+
+        double single_throughput = single_ops /
+            std::chrono::duration<double>(single_time).count();
+        double multi_throughput = multi_ops.load() /
+            std::chrono::duration<double>(multi_time).count();
+
+        std::cout << "Backend throughput 1 thread: " << single_throughput <<
+            " ops/s, " << num_threads << " threads: " << multi_throughput <<
+            " ops/s" << std::endl;
+
+        // Only meaningful if the threads can actually run in parallel
+        if(std::thread::hardware_concurrency() >= num_threads)
+            BOOST_CHECK(multi_throughput > single_throughput * 1.5);
+    }
+
+    /**
+     * Append from multiple threads and verify every sector ended up at a
+     * unique location with its data intact.
+     * @return zone of the first append of every thread
+     */
+    static std::set<uint64_t> log_head_work(TestFuseLFS *test_fuse,
+        uint64_t num_threads, uint64_t rounds)
+    {
+        std::vector<std::vector<uint64_t>> lbas(num_threads);
+        std::atomic<bool> append_error(false);
+        std::vector<std::thread> threads;
+        for(uint64_t i = 0; i < num_threads; i++) {
+            threads.emplace_back([test_fuse, &lbas, &append_error, rounds,
+                                  i]()
+            {
+                uint8_t data[qemucsd::fuse_lfs::SECTOR_SIZE * 2];
+                memset(data, i + 1, sizeof(data));
+                for(uint64_t j = 0; j < rounds; j++) {
+                    uint64_t lba;
+                    if(test_fuse->log_append(data,
+                       qemucsd::fuse_lfs::SECTOR_SIZE, lba,
+                       qemucsd::fuse_lfs::LOG_STREAM_HOT_DATA) !=
+                       qemucsd::fuse_lfs::FLFS_RET_NONE)
+                        append_error.store(true);
+                    lbas.at(i).push_back(lba);
+
+                    if(test_fuse->log_append(data, sizeof(data), lbas.at(i),
+                       qemucsd::fuse_lfs::LOG_STREAM_HOT_DATA) !=
+                       qemucsd::fuse_lfs::FLFS_RET_NONE)
+                        append_error.store(true);
+                }
+            });
+        }
+        for(auto &thread : threads) thread.join();
+        BOOST_CHECK(!append_error.load());
+
+        std::set<uint64_t> unique;
+        std::set<uint64_t> zones;
+        uint8_t buffer[qemucsd::fuse_lfs::SECTOR_SIZE];
+        for(uint64_t i = 0; i < num_threads; i++) {
+            BOOST_CHECK(lbas.at(i).size() == rounds * 3);
+            for(auto &lba : lbas.at(i)) {
+                unique.insert(lba);
+
+                qemucsd::fuse_lfs::data_position pos = {0};
+                test_fuse->lba_to_position(lba, pos);
+                BOOST_CHECK(test_fuse->nvme->read(pos.zone, pos.sector, 0,
+                    buffer, sizeof(buffer)) == 0);
+                BOOST_CHECK(buffer[0] == i + 1);
+                BOOST_CHECK(buffer[sizeof(buffer) - 1] == i + 1);
+            }
+
+            qemucsd::fuse_lfs::data_position pos = {0};
+            test_fuse->lba_to_position(lbas.at(i).front(), pos);
+            zones.insert(pos.zone);
+        }
+        BOOST_CHECK(unique.size() == num_threads * rounds * 3);
+
+        return zones;
+    }
+
+    /**
+     * Threads append through their own log head, all heads must be recorded
+     * in the checkpoint block.
+     */
+    BOOST_AUTO_TEST_CASE(Test_FuseLFS_log_heads,
+        * boost::unit_test::timeout(30))
+    {
+        constexpr uint64_t num_threads = 4;
+
+        qemucsd::nvme_zns::NvmeZnsMemoryBackend nvme_memory(
+            64, 16, qemucsd::fuse_lfs::SECTOR_SIZE);
+        TestFuseLFS test_fuse(&nvme_memory);
+        BOOST_CHECK(test_fuse.run_init() == qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        auto zones = log_head_work(&test_fuse, num_threads, 16);
+
+        // Threads are assigned consecutive heads so they start in own zones
+        if(test_fuse.log_heads_active >= num_threads)
+            BOOST_CHECK(zones.size() == num_threads);
+
+        struct qemucsd::fuse_lfs::checkpoint_block cblock = {0};
+        BOOST_CHECK(test_fuse.get_checkpointblock(cblock) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        for(uint32_t i = 0; i < qemucsd::fuse_lfs::N_LOG_STREAMS; i++) {
+            for(uint32_t j = 0; j < qemucsd::fuse_lfs::N_LOG_HEADS; j++)
+                BOOST_CHECK(cblock.log_heads[i][j] ==
+                    test_fuse.log_head_lbas[i][j].load());
+        }
+    }
+
+    /**
+     * Threads sharing a single log head have many appends outstanding to the
+     * same zone, completing in any order. The lbas must be those chosen by
+     * the device.
+     */
+    BOOST_AUTO_TEST_CASE(Test_FuseLFS_log_head_shared,
+        * boost::unit_test::timeout(30))
+    {
+        qemucsd::nvme_zns::NvmeZnsMemoryBackend nvme_memory(
+            16, 512, qemucsd::fuse_lfs::SECTOR_SIZE, 8);
+        TestFuseLFS test_fuse(&nvme_memory);
+        BOOST_CHECK(test_fuse.run_init() == qemucsd::fuse_lfs::FLFS_RET_NONE);
+        test_fuse.log_heads_active = 1;
+
+        auto zones = log_head_work(&test_fuse, 8, 16);
+        BOOST_CHECK(zones.size() == 1);
+    }
+
+    /**
+     * Create a file and buffer the given number of sectors of data for it
+     */
+    fuse_ino_t writeback_work(TestFuseLFS *test_fuse, uint64_t sectors) {
+        fuse_ino_t ino;
+        BOOST_CHECK(test_fuse->create_inode(1, "test",
+            qemucsd::fuse_lfs::INO_T_FILE, ino) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        qemucsd::fuse_lfs::inode_entry_t entry;
+        BOOST_CHECK(test_fuse->get_inode_entry(ino, &entry) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        char data[qemucsd::fuse_lfs::SECTOR_SIZE];
+        memset(data, 'a', qemucsd::fuse_lfs::SECTOR_SIZE);
+        for(uint64_t i = 0; i < sectors; i++) {
+            BOOST_CHECK(test_fuse->buffer_write(ino, entry.first.size, i,
+                data, 0, qemucsd::fuse_lfs::SECTOR_SIZE) ==
+                qemucsd::fuse_lfs::FLFS_RET_NONE);
+            entry.first.size += qemucsd::fuse_lfs::SECTOR_SIZE;
+        }
+        test_fuse->update_inode_entry(&entry);
+        test_fuse->mark_dirty();
+
+        return ino;
+    }
+
+    /**
+     * Writers exceeding the dirty limit are held until the writeback thread
+     * has flushed pending state below it.
+     */
+    BOOST_AUTO_TEST_CASE(Test_FuseLFS_writeback_throttle,
+        * boost::unit_test::timeout(10))
+    {
+        qemucsd::nvme_zns::NvmeZnsMemoryBackend nvme_memory(
+            16, 256, qemucsd::fuse_lfs::SECTOR_SIZE);
+        TestFuseLFS test_fuse(&nvme_memory);
+        BOOST_CHECK(test_fuse.run_init() == qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        test_fuse.writeback_dirty_bytes = qemucsd::fuse_lfs::SECTOR_SIZE * 4;
+        writeback_work(&test_fuse, 8);
+        BOOST_CHECK(test_fuse.dirty_bytes() >=
+            test_fuse.writeback_dirty_bytes);
+
+        test_fuse.start_writeback();
+        test_fuse.writeback_throttle();
+        BOOST_CHECK(test_fuse.dirty_bytes() <
+            test_fuse.writeback_dirty_bytes);
+        BOOST_CHECK(test_fuse.write_buffer_size() == 0);
+
+        test_fuse.stop_writeback();
+    }
+
+    /**
+     * Pending state below the limits is written back once it expires.
+     */
+    BOOST_AUTO_TEST_CASE(Test_FuseLFS_writeback_expire,
+        * boost::unit_test::timeout(10))
+    {
+        qemucsd::nvme_zns::NvmeZnsMemoryBackend nvme_memory(
+            16, 256, qemucsd::fuse_lfs::SECTOR_SIZE);
+        TestFuseLFS test_fuse(&nvme_memory);
+        BOOST_CHECK(test_fuse.run_init() == qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        test_fuse.writeback_dirty_expire = 10;
+        writeback_work(&test_fuse, 2);
+        BOOST_CHECK(test_fuse.inode_entries_size() != 0);
+
+        test_fuse.start_writeback();
+        while(test_fuse.write_buffer_size() != 0 ||
+              test_fuse.inode_entries_size() != 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        test_fuse.stop_writeback();
+        BOOST_CHECK(test_fuse.dirty_bytes() == 0);
+    }
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
@@ -27,6 +27,8 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <algorithm>
+
 #include "tests.hpp"
 
 #include "flfs.hpp"
@@ -80,8 +82,13 @@ BOOST_AUTO_TEST_SUITE(Test_FuseLfsDrive)
 
         using FuseLFS::random_pos;
         using FuseLFS::random_ptr;
+        using FuseLFS::nat_update_set;
 
-        using FuseLFS::log_ptr;
+        using FuseLFS::log_heads;
+        using FuseLFS::log_head_lbas;
+        using FuseLFS::log_zone_next;
+        using FuseLFS::log_streams;
+        using FuseLFS::log_heads_active;
 
         using FuseLFS::ino_ptr;
 
@@ -118,7 +125,12 @@ BOOST_AUTO_TEST_SUITE(Test_FuseLfsDrive)
         using FuseLFS::read_random_zone;
         using FuseLFS::append_random_block;
         using FuseLFS::rewrite_random_blocks;
+        using FuseLFS::buffer_random_blocks;
 
+        using FuseLFS::set_log_classifier;
+        using FuseLFS::classify_log;
+        using FuseLFS::log_head_index;
+        using FuseLFS::claim_log_zone;
         using FuseLFS::determine_log_ptr;
         using FuseLFS::log_append;
 
@@ -126,6 +138,18 @@ BOOST_AUTO_TEST_SUITE(Test_FuseLfsDrive)
         using FuseLFS::create_inode;
 
         using FuseLFS::flush_inodes_always;
+        using FuseLFS::flush_write_buffers;
+        using FuseLFS::flush_write_buffers_if_full;
+        using FuseLFS::write_sector;
+        using FuseLFS::write_buffer_limit;
+        using FuseLFS::flush_data_blocks;
+        using FuseLFS::flush_pending;
+        using FuseLFS::flush_pending_inode;
+
+        using FuseLFS::assign_data_block;
+        using FuseLFS::get_data_block;
+        using FuseLFS::read_data_block_chain;
+        using FuseLFS::ftruncate;
     };
 
     struct qemucsd::fuse_lfs::data_position NULL_POS = {0};
@@ -967,6 +991,43 @@ BOOST_AUTO_TEST_SUITE(Test_FuseLfsDrive)
         BOOST_CHECK(cur_lba.lba == 192);
     }
 
+    /**
+     * Readers of an inode share its lock while writers are exclusive
+     */
+    BOOST_FIXTURE_TEST_CASE(Test_FuseLFS_lock_inode_shared,
+                            TestFuseLFSFixture)
+    {
+        qemucsd::nvme_zns::NvmeZnsMemoryBackend nvme_memory(
+            16, 256, qemucsd::fuse_lfs::SECTOR_SIZE);
+        TestFuseLFS test_fuse(&nvme_memory);
+
+        std::vector<fuse_ino_t> inodes = {2};
+        test_fuse.update_inode_lba_map(&inodes, 64);
+
+        struct qemucsd::fuse_lfs::lba_inode cur_lba;
+        BOOST_CHECK(test_fuse.get_inode_lba(2, &cur_lba) ==
+                    qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        // Two readers can hold the lock at the same time but no writer
+        BOOST_CHECK(test_fuse.lock_inode(2, false) ==
+                    qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(test_fuse.lock_inode(2, false) ==
+                    qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(cur_lba.l->try_lock() == false);
+
+        test_fuse.unlock_inode(2, false);
+        test_fuse.unlock_inode(2, false);
+
+        // A writer excludes readers
+        BOOST_CHECK(test_fuse.lock_inode(2, true) ==
+                    qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(cur_lba.l->try_lock_shared() == false);
+        test_fuse.unlock_inode(2, true);
+
+        BOOST_CHECK(test_fuse.lock_inode(5, false) ==
+                    qemucsd::fuse_lfs::FLFS_RET_ENOENT);
+    }
+
     /**
      *
      */
@@ -1037,7 +1098,7 @@ BOOST_AUTO_TEST_SUITE(Test_FuseLfsDrive)
 
         // Insert inode 3 entry
         // mutexes need to be unique per inode
-        cur_lba.l = std::make_shared<std::mutex>();
+        cur_lba.l = std::make_shared<std::shared_mutex>();
         test_fuse.update_inode_lba(3, &cur_lba);
         test_fuse.inode_entries.insert(
             std::make_pair(3, std::make_pair(entry, "directory")));
@@ -1058,7 +1119,7 @@ BOOST_AUTO_TEST_SUITE(Test_FuseLfsDrive)
         entry.type = qemucsd::fuse_lfs::INO_T_NONE;
         entry.parent = 1;
         // Insert inode 4 entry
-        cur_lba.l = std::make_shared<std::mutex>();
+        cur_lba.l = std::make_shared<std::shared_mutex>();
         test_fuse.update_inode_lba(4, &cur_lba);
         test_fuse.inode_entries.insert(
             std::make_pair(4, std::make_pair(entry, "none")));
@@ -1079,16 +1140,23 @@ BOOST_AUTO_TEST_SUITE(Test_FuseLfsDrive)
         TestFuseLFS test_fuse(&nvme_memory);
         BOOST_CHECK(test_fuse.run_init() == qemucsd::fuse_lfs::FLFS_RET_NONE);
 
+        // Log streams only claim a zone upon their first append
+        auto &head = test_fuse.log_heads[
+            qemucsd::fuse_lfs::LOG_STREAM_HOT_META][test_fuse.log_head_index()];
+        BOOST_CHECK(test_fuse.claim_log_zone(
+            qemucsd::fuse_lfs::LOG_STREAM_HOT_META,
+            test_fuse.log_head_index()) == qemucsd::fuse_lfs::FLFS_RET_NONE);
+
         uint64_t lba;
-        test_fuse.position_to_lba(test_fuse.log_ptr, lba);
+        test_fuse.position_to_lba(head.ptr, lba);
 
         // Create 2 inodes at the current log_ptr
         struct qemucsd::fuse_lfs::lba_inode cur_lba =
-            {1, lba, std::shared_ptr<std::mutex>()};
+            {1, lba, std::shared_ptr<std::shared_mutex>()};
         test_fuse.update_inode_lba(3, &cur_lba);
 
         // Mutexes need to be unique per inode
-        cur_lba.l = std::shared_ptr<std::mutex>();
+        cur_lba.l = std::shared_ptr<std::shared_mutex>();
         test_fuse.update_inode_lba(4, &cur_lba);
 
         // Create entry for an inode
@@ -1100,7 +1168,7 @@ BOOST_AUTO_TEST_SUITE(Test_FuseLfsDrive)
 
         // We manually write the contents of an inode block and flush it
         // This is to avoid relying on flush_inode method functionality.
-        auto *ino_blk_ptr = (uint8_t*) malloc(
+        auto *ino_blk_ptr = (uint8_t*) calloc(1,
             sizeof(qemucsd::fuse_lfs::inode_block));
 
         // Store offset per entry
@@ -1108,22 +1176,31 @@ BOOST_AUTO_TEST_SUITE(Test_FuseLfsDrive)
         // Store filename for test files
         static const std::string filename = "testfile";
 
+        // Header and index of two entries precede the entries
+        auto *header =
+            (struct qemucsd::fuse_lfs::inode_block_header *) ino_blk_ptr;
+        header->count = 2;
+        auto *index = (struct qemucsd::fuse_lfs::inode_block_index *)
+            (ino_blk_ptr + qemucsd::fuse_lfs::INODE_BLOCK_HEADER_SIZE);
+        uint64_t start = qemucsd::fuse_lfs::INODE_BLOCK_HEADER_SIZE +
+            2 * qemucsd::fuse_lfs::INODE_BLOCK_INDEX_SIZE;
+
         entry.inode = 3;
-        memcpy(ino_blk_ptr, &entry, off);
-        memcpy(ino_blk_ptr + off, filename.c_str(), filename.size() + 1);
+        index[0].inode = 3;
+        index[0].offset = start;
+        memcpy(ino_blk_ptr + start, &entry, off);
+        memcpy(ino_blk_ptr + start + off, filename.c_str(),
+           filename.size() + 1);
 
         entry.inode = 4;
-        memcpy(ino_blk_ptr + off + filename.size() + 1, &entry, off);
-        memcpy(ino_blk_ptr + (off * 2) + filename.size() + 1, filename.c_str(),
+        index[1].inode = 4;
+        index[1].offset = start + off + filename.size() + 1;
+        memcpy(ino_blk_ptr + index[1].offset, &entry, off);
+        memcpy(ino_blk_ptr + index[1].offset + off, filename.c_str(),
            filename.size() + 1);
 
-        uint64_t final_offset = (off * 2) + (filename.size() *2 ) + 2;
-        memset(ino_blk_ptr + final_offset, 0,
-               sizeof(qemucsd::fuse_lfs::inode_block) - final_offset);
-
         uint64_t result_sector = 0;
-        struct qemucsd::fuse_lfs::data_position cpy_log_ptr =
-            test_fuse.log_ptr;
+        struct qemucsd::fuse_lfs::data_position cpy_log_ptr = head.ptr;
         BOOST_CHECK(test_fuse.nvme->append(
             cpy_log_ptr.zone, result_sector, cpy_log_ptr.offset, ino_blk_ptr,
             sizeof(qemucsd::fuse_lfs::inode_block)) == 0);
@@ -1142,12 +1219,19 @@ BOOST_AUTO_TEST_SUITE(Test_FuseLfsDrive)
         BOOST_CHECK(inode_entry.first.inode == 4);
         BOOST_CHECK(inode_entry.second == filename);
 
+        // Both inodes have been decoded from drive and are cached now
+        BOOST_CHECK(test_fuse.inode_cache_size() == 2);
+        BOOST_CHECK(test_fuse.get_inode(3, &inode_entry) ==
+                    qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(inode_entry.first.inode == 3);
+        BOOST_CHECK(inode_entry.second == filename);
+
         // And get the entry that does not exist
         BOOST_CHECK(test_fuse.get_inode(5, &inode_entry) ==
                     qemucsd::fuse_lfs::FLFS_RET_ENOENT);
 
         // Add this invalid entry to the map
-        cur_lba.l = std::make_shared<std::mutex>();
+        cur_lba.l = std::make_shared<std::shared_mutex>();
         test_fuse.update_inode_lba(5, &cur_lba);
 
         // Failing to find this entry now should return an error
@@ -1254,10 +1338,11 @@ BOOST_AUTO_TEST_SUITE(Test_FuseLfsDrive)
         TestFuseLFS test_fuse(&nvme_memory);
         BOOST_CHECK(test_fuse.run_init() == qemucsd::fuse_lfs::FLFS_RET_NONE);
 
-        // Just enough spare for one more inode_entry
-        uint64_t block_size = (qemucsd::fuse_lfs::INODE_BLOCK_SIZE /
-            qemucsd::fuse_lfs::INODE_ENTRY_SIZE) - 2;
-        block_size -= (block_size * 1) / qemucsd::fuse_lfs::INODE_ENTRY_SIZE;
+        // Just enough spare for one more inode_entry, empty names occupy
+        // 1 byte each
+        uint64_t block_size = (qemucsd::fuse_lfs::INODE_BLOCK_SIZE -
+            qemucsd::fuse_lfs::INODE_BLOCK_HEADER_SIZE) /
+            (qemucsd::fuse_lfs::INODE_BLOCK_ENTRY_SIZE + 1) - 1;
 
         qemucsd::fuse_lfs::inode_entry_t entry = {};
         for(uint64_t i = 0; i < block_size; i++) {
@@ -1279,8 +1364,9 @@ BOOST_AUTO_TEST_SUITE(Test_FuseLfsDrive)
         TestFuseLFS test_fuse(&nvme_memory);
         BOOST_CHECK(test_fuse.run_init() == qemucsd::fuse_lfs::FLFS_RET_NONE);
 
-        uint64_t min_block_size = (qemucsd::fuse_lfs::INODE_BLOCK_SIZE /
-            qemucsd::fuse_lfs::INODE_ENTRY_SIZE) + 1;
+        uint64_t min_block_size = (qemucsd::fuse_lfs::INODE_BLOCK_SIZE -
+            qemucsd::fuse_lfs::INODE_BLOCK_HEADER_SIZE) /
+            (qemucsd::fuse_lfs::INODE_BLOCK_ENTRY_SIZE + 1) + 1;
 
         qemucsd::fuse_lfs::inode_entry_t entry = {};
         for(uint64_t i = 0; i < min_block_size; i++) {
@@ -1305,13 +1391,11 @@ BOOST_AUTO_TEST_SUITE(Test_FuseLfsDrive)
         TestFuseLFS test_fuse(&nvme_memory);
         BOOST_CHECK(test_fuse.run_init() == qemucsd::fuse_lfs::FLFS_RET_NONE);
 
-        // -1 so not quite full but names will push it over the limit to fit
-        // an additional entry
-        uint64_t block_size = (qemucsd::fuse_lfs::INODE_BLOCK_SIZE /
-            qemucsd::fuse_lfs::INODE_ENTRY_SIZE) - 1;
-
-        // Empty names should occupy 1 bytes each
-        block_size -= (block_size * 1) / qemucsd::fuse_lfs::INODE_ENTRY_SIZE;
+        // Exactly the number of entries with empty names, occupying 1 byte
+        // each, that fit leaving no space for an additional entry
+        uint64_t block_size = (qemucsd::fuse_lfs::INODE_BLOCK_SIZE -
+            qemucsd::fuse_lfs::INODE_BLOCK_HEADER_SIZE) /
+            (qemucsd::fuse_lfs::INODE_BLOCK_ENTRY_SIZE + 1);
 
         qemucsd::fuse_lfs::inode_entry_t entry = {};
         for(uint64_t i = 0; i < block_size; i++) {
@@ -1336,13 +1420,11 @@ BOOST_AUTO_TEST_SUITE(Test_FuseLfsDrive)
         TestFuseLFS test_fuse(&nvme_memory);
         BOOST_CHECK(test_fuse.run_init() == qemucsd::fuse_lfs::FLFS_RET_NONE);
 
-        // -1 so not quite full but names will push it over the limit to fit
-        // an additional entry
-        uint64_t block_size = (qemucsd::fuse_lfs::INODE_BLOCK_SIZE /
-            qemucsd::fuse_lfs::INODE_ENTRY_SIZE) - 1;
-
-        // Empty names should occupy 1 bytes each
-        block_size -= (block_size * 1) / qemucsd::fuse_lfs::INODE_ENTRY_SIZE;
+        // Exactly the number of entries with empty names, occupying 1 byte
+        // each, that fit leaving no space for an additional entry
+        uint64_t block_size = (qemucsd::fuse_lfs::INODE_BLOCK_SIZE -
+            qemucsd::fuse_lfs::INODE_BLOCK_HEADER_SIZE) /
+            (qemucsd::fuse_lfs::INODE_BLOCK_ENTRY_SIZE + 1);
 
         qemucsd::fuse_lfs::inode_entry_t entry = {};
         for(uint64_t i = 0; i < block_size; i++) {
@@ -1359,6 +1441,59 @@ BOOST_AUTO_TEST_SUITE(Test_FuseLfsDrive)
         for(uint64_t i = 0; i < block_size; i++) {
             BOOST_CHECK(test_fuse.get_inode(i + 2, &entry) ==
                 qemucsd::fuse_lfs::FLFS_RET_NONE);
+            BOOST_CHECK(entry.first.inode == i + 2);
+        }
+    }
+
+    /**
+     * Entries spanning multiple inode_blocks, including a partially filled
+     * last block, are found through the index of their block.
+     */
+    BOOST_FIXTURE_TEST_CASE(Test_FuseLFS_inode_block_index,
+                            TestFuseLFSFixture)
+    {
+        qemucsd::nvme_zns::NvmeZnsMemoryBackend nvme_memory(
+            16, 8, qemucsd::fuse_lfs::SECTOR_SIZE);
+        TestFuseLFS test_fuse(&nvme_memory);
+        BOOST_CHECK(test_fuse.run_init() == qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        qemucsd::fuse_lfs::inode_entry_t entry = {};
+        for(uint64_t i = 2; i < 202; i++) {
+            entry.first.inode = i;
+            entry.first.size = i * 3;
+            entry.second = "name" + std::to_string(i);
+            test_fuse.update_inode_entry(&entry);
+        }
+
+        // First block only holds part of the entries, sorted by inode
+        std::vector<fuse_ino_t> inodes;
+        struct qemucsd::fuse_lfs::inode_block blk;
+        BOOST_CHECK(test_fuse.fill_inode_block(&inodes, &blk) ==
+            qemucsd::fuse_lfs::FLFS_RET_INO_BLK_FULL);
+
+        std::vector<fuse_ino_t> index_inodes;
+        BOOST_CHECK(test_fuse.get_inode_block_inodes(&blk, &index_inodes) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(index_inodes == inodes);
+        BOOST_CHECK(std::is_sorted(index_inodes.begin(), index_inodes.end()));
+
+        BOOST_CHECK(test_fuse.find_inode_block_entry(&blk, inodes.back(),
+            &entry) == qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(entry.first.inode == inodes.back());
+        BOOST_CHECK(entry.second == "name" + std::to_string(inodes.back()));
+        BOOST_CHECK(test_fuse.find_inode_block_entry(&blk, 201, &entry) ==
+            qemucsd::fuse_lfs::FLFS_RET_ENOENT);
+
+        BOOST_CHECK(test_fuse.flush_inodes_always() ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(test_fuse.inode_entries.size() == 0);
+
+        for(uint64_t i = 2; i < 202; i++) {
+            BOOST_CHECK(test_fuse.get_inode(i, &entry) ==
+                qemucsd::fuse_lfs::FLFS_RET_NONE);
+            BOOST_CHECK(entry.first.inode == i);
+            BOOST_CHECK(entry.first.size == i * 3);
+            BOOST_CHECK(entry.second == "name" + std::to_string(i));
         }
     }
 
@@ -1368,9 +1503,9 @@ BOOST_AUTO_TEST_SUITE(Test_FuseLfsDrive)
     BOOST_FIXTURE_TEST_CASE(Test_FuseLFS_log_ptr,
         TestFuseLFSFixture)
     {
-        // Zone capacity is half zone zone size so 4!
+        // Zone capacity is equal to zone size so 4!
         qemucsd::nvme_zns::NvmeZnsMemoryBackend nvme_memory(
-            16, 8, qemucsd::fuse_lfs::SECTOR_SIZE);
+            16, 4, qemucsd::fuse_lfs::SECTOR_SIZE);
         TestFuseLFS test_fuse(&nvme_memory);
         BOOST_CHECK(test_fuse.run_init() == qemucsd::fuse_lfs::FLFS_RET_NONE);
 
@@ -1389,17 +1524,834 @@ BOOST_AUTO_TEST_SUITE(Test_FuseLfsDrive)
             qemucsd::fuse_lfs::SECTOR_SIZE, lba) ==
             qemucsd::fuse_lfs::FLFS_RET_NONE);
 
-        struct qemucsd::fuse_lfs::data_position t_log_ptr = test_fuse.log_ptr;
-        BOOST_CHECK(test_fuse.log_ptr.zone ==
-            qemucsd::fuse_lfs::LOGZ_POS.zone + 1);
+        auto &log_ptr = test_fuse.log_heads[
+            qemucsd::fuse_lfs::LOG_STREAM_HOT_META][
+            test_fuse.log_head_index()].ptr;
+        struct qemucsd::fuse_lfs::data_position t_log_ptr = log_ptr;
+        BOOST_CHECK(log_ptr.zone == qemucsd::fuse_lfs::LOGZ_POS.zone + 1);
 
-        test_fuse.log_ptr = qemucsd::fuse_lfs::LOGZ_POS;
+        log_ptr = qemucsd::fuse_lfs::LOGZ_POS;
         test_fuse.determine_log_ptr();
 
-        BOOST_CHECK(t_log_ptr == test_fuse.log_ptr);
+        BOOST_CHECK(t_log_ptr == log_ptr);
+        BOOST_CHECK(test_fuse.log_zone_next ==
+            qemucsd::fuse_lfs::LOGZ_POS.zone + 2);
+
+        free(data);
+    }
+
+    /**
+     * Append data of different lifetimes and verify every log stream claims
+     * its own zone and is restored from the checkpoint block.
+     */
+    BOOST_FIXTURE_TEST_CASE(Test_FuseLFS_log_streams,
+        TestFuseLFSFixture)
+    {
+        qemucsd::nvme_zns::NvmeZnsMemoryBackend nvme_memory(
+            32, 4, qemucsd::fuse_lfs::SECTOR_SIZE);
+        TestFuseLFS test_fuse(&nvme_memory);
+        BOOST_CHECK(test_fuse.run_init() == qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(test_fuse.log_streams ==
+            qemucsd::fuse_lfs::N_LOG_STREAMS);
+
+        uint64_t lba;
+        qemucsd::fuse_lfs::data_position pos = {0};
+        auto data = malloc(qemucsd::fuse_lfs::SECTOR_SIZE);
+
+        BOOST_CHECK(test_fuse.log_append(data, qemucsd::fuse_lfs::SECTOR_SIZE,
+            lba, qemucsd::fuse_lfs::LOG_STREAM_HOT_META) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        test_fuse.lba_to_position(lba, pos);
+        BOOST_CHECK(pos.zone == qemucsd::fuse_lfs::LOGZ_POS.zone);
+
+        BOOST_CHECK(test_fuse.log_append(data, qemucsd::fuse_lfs::SECTOR_SIZE,
+            lba, qemucsd::fuse_lfs::LOG_STREAM_COLD_DATA) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        test_fuse.lba_to_position(lba, pos);
+        BOOST_CHECK(pos.zone == qemucsd::fuse_lfs::LOGZ_POS.zone + 1);
+
+        // Multi sector appends continue in the zone of their own stream
+        std::vector<uint64_t> lbas;
+        auto sectors = malloc(qemucsd::fuse_lfs::SECTOR_SIZE * 2);
+        BOOST_CHECK(test_fuse.log_append(sectors,
+            qemucsd::fuse_lfs::SECTOR_SIZE * 2, lbas,
+            qemucsd::fuse_lfs::LOG_STREAM_HOT_META) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(lbas.size() == 2);
+        test_fuse.lba_to_position(lbas.back(), pos);
+        BOOST_CHECK(pos.zone == qemucsd::fuse_lfs::LOGZ_POS.zone);
+        BOOST_CHECK(pos.sector == 2);
+
+        // Heads are persisted so a remount restores every stream
+        uint32_t index = test_fuse.log_head_index();
+        qemucsd::fuse_lfs::data_position t_log_ptrs[
+            qemucsd::fuse_lfs::N_LOG_STREAMS];
+        for(uint32_t i = 0; i < qemucsd::fuse_lfs::N_LOG_STREAMS; i++) {
+            t_log_ptrs[i] = test_fuse.log_heads[i][index].ptr;
+            test_fuse.log_heads[i][index].ptr = {0, 0, 0, 0};
+        }
+        test_fuse.determine_log_ptr();
+
+        for(uint32_t i = 0; i < qemucsd::fuse_lfs::N_LOG_STREAMS; i++)
+            BOOST_CHECK(t_log_ptrs[i] == test_fuse.log_heads[i][index].ptr);
+        BOOST_CHECK(!test_fuse.log_heads[
+            qemucsd::fuse_lfs::LOG_STREAM_HOT_DATA][index].ptr.valid());
+        BOOST_CHECK(test_fuse.log_zone_next ==
+            qemucsd::fuse_lfs::LOGZ_POS.zone + 2);
+
+        free(sectors);
+        free(data);
+    }
+
+    /**
+     * Limit the number of open zones and verify the streams share a zone,
+     * also ensure a custom classifier decides the stream of buffered writes.
+     */
+    BOOST_FIXTURE_TEST_CASE(Test_FuseLFS_log_streams_shared,
+        TestFuseLFSFixture)
+    {
+        qemucsd::nvme_zns::NvmeZnsMemoryBackend nvme_memory(
+            32, 4, qemucsd::fuse_lfs::SECTOR_SIZE, 4,
+            qemucsd::fuse_lfs::LOG_RESERVED_OPEN + 1);
+        TestFuseLFS test_fuse(&nvme_memory);
+        BOOST_CHECK(test_fuse.run_init() == qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(test_fuse.log_streams == 1);
+
+        uint64_t hot_lba;
+        uint64_t cold_lba;
+        auto data = malloc(qemucsd::fuse_lfs::SECTOR_SIZE);
+        BOOST_CHECK(test_fuse.log_append(data, qemucsd::fuse_lfs::SECTOR_SIZE,
+            hot_lba, qemucsd::fuse_lfs::LOG_STREAM_HOT_META) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(test_fuse.log_append(data, qemucsd::fuse_lfs::SECTOR_SIZE,
+            cold_lba, qemucsd::fuse_lfs::LOG_STREAM_GC) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(cold_lba == hot_lba + 1);
+
+        uint32_t classified = 0;
+        test_fuse.set_log_classifier(
+            [&classified](qemucsd::fuse_lfs::log_data_type type,
+                          fuse_ino_t ino)
+            {
+                classified += 1;
+                return qemucsd::fuse_lfs::LOG_STREAM_COLD_DATA;
+            });
+        BOOST_CHECK(test_fuse.log_append(data, qemucsd::fuse_lfs::SECTOR_SIZE,
+            cold_lba, test_fuse.classify_log(
+            qemucsd::fuse_lfs::LOG_DATA_BUFFERED, 2)) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(classified == 1);
+        BOOST_CHECK(cold_lba == hot_lba + 2);
 
         free(data);
     }
 
 
+    /**
+     * Build a chain of data_blocks on drive and verify the block index
+     * resolves every block without pending data_blocks in memory.
+     */
+    BOOST_FIXTURE_TEST_CASE(Test_FuseLFS_block_index,
+        TestFuseLFSFixture)
+    {
+        qemucsd::nvme_zns::NvmeZnsMemoryBackend nvme_memory(
+            16, 256, qemucsd::fuse_lfs::SECTOR_SIZE);
+        TestFuseLFS test_fuse(&nvme_memory);
+        BOOST_CHECK(test_fuse.run_init() == qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        // Append the chain in reverse so every next_block is known
+        uint64_t lbas[3];
+        uint64_t next_block = 0;
+        struct qemucsd::fuse_lfs::data_block blk = {0};
+        for(int i = 2; i >= 0; i--) {
+            blk.data_lbas[0] = 1000 + i;
+            blk.next_block = next_block;
+            BOOST_CHECK(test_fuse.log_append(&blk, sizeof(blk), lbas[i]) ==
+                qemucsd::fuse_lfs::FLFS_RET_NONE);
+            next_block = lbas[i];
+        }
+
+        struct qemucsd::fuse_lfs::inode_entry entry = {0};
+        entry.inode = 2;
+        entry.data_lba = lbas[0];
+
+        for(uint64_t i = 0; i < 3; i++) {
+            BOOST_CHECK(test_fuse.get_data_block(entry, i, &blk) ==
+                qemucsd::fuse_lfs::FLFS_RET_NONE);
+            BOOST_CHECK(blk.data_lbas[0] == 1000 + i);
+        }
+        BOOST_CHECK(test_fuse.block_index_size() == 3);
+
+        BOOST_CHECK(test_fuse.get_data_block(entry, 3, &blk) ==
+            qemucsd::fuse_lfs::FLFS_RET_ERR);
+
+        // Pending data_blocks take precedence over the index
+        blk.data_lbas[0] = 2001;
+        test_fuse.assign_data_block(entry.inode, 1, &blk);
+        BOOST_CHECK(test_fuse.get_data_block(entry, 1, &blk) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(blk.data_lbas[0] == 2001);
+
+        // Index is rebuilt once the chain starts elsewhere
+        delete test_fuse.data_blocks->at(entry.inode);
+        test_fuse.data_blocks->erase(entry.inode);
+        entry.data_lba = lbas[1];
+        BOOST_CHECK(test_fuse.get_data_block(entry, 1, &blk) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(blk.data_lbas[0] == 1002);
+        BOOST_CHECK(test_fuse.block_index_size() == 2);
+    }
+
+    BOOST_AUTO_TEST_CASE(Test_FuseLFS_block_index_evict) {
+        qemucsd::fuse_lfs::FuseLFSBlockIndex block_index(4);
+
+        uint64_t lba;
+        block_index.update_block_index(2, 10, {10, 11, 12});
+        block_index.update_block_index(3, 20, {20, 21});
+
+        // Inode 2 is least recently used and evicted to stay within limit
+        BOOST_CHECK(block_index.block_index_size() == 2);
+        BOOST_CHECK(block_index.get_block_index_lba(2, 10, 0, lba) ==
+            qemucsd::fuse_lfs::FLFS_RET_ENOENT);
+        BOOST_CHECK(block_index.get_block_index_lba(3, 20, 1, lba) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(lba == 21);
+        BOOST_CHECK(block_index.get_block_index_lba(3, 20, 2, lba) ==
+            qemucsd::fuse_lfs::FLFS_RET_ERR);
+
+        // Index built for a different chain is ignored
+        BOOST_CHECK(block_index.get_block_index_lba(3, 30, 0, lba) ==
+            qemucsd::fuse_lfs::FLFS_RET_ENOENT);
+
+        // A single inode exceeding the limit is still kept
+        block_index.update_block_index(4, 40, {40, 41, 42, 43, 44});
+        BOOST_CHECK(block_index.block_index_size() == 5);
+        BOOST_CHECK(block_index.get_block_index_lba(4, 40, 4, lba) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        block_index.evict_block_index(0);
+        BOOST_CHECK(block_index.block_index_size() == 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(Test_FuseLFS_inode_cache_evict) {
+        qemucsd::fuse_lfs::FuseLFSInodeCache inode_cache(2);
+
+        qemucsd::fuse_lfs::inode_entry_t entry;
+        entry.first = {0};
+        for(fuse_ino_t ino = 2; ino < 5; ino++) {
+            entry.first.inode = ino;
+            entry.second = "file" + std::to_string(ino);
+            inode_cache.update_inode_cache(ino, ino * 10, entry);
+        }
+
+        // Inode 2 is least recently used and evicted to stay within limit
+        BOOST_CHECK(inode_cache.inode_cache_size() == 2);
+        BOOST_CHECK(inode_cache.get_inode_cache(2, 20, &entry) ==
+            qemucsd::fuse_lfs::FLFS_RET_ENOENT);
+        BOOST_CHECK(inode_cache.get_inode_cache(3, 30, &entry) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(entry.first.inode == 3);
+        BOOST_CHECK(entry.second == "file3");
+
+        // Entry decoded from a different inode_block is ignored
+        BOOST_CHECK(inode_cache.get_inode_cache(3, 31, &entry) ==
+            qemucsd::fuse_lfs::FLFS_RET_ENOENT);
+
+        // Inode 3 was used most recently so inode 4 is evicted
+        entry.first.inode = 5;
+        inode_cache.update_inode_cache(5, 50, entry);
+        BOOST_CHECK(inode_cache.get_inode_cache(4, 40, &entry) ==
+            qemucsd::fuse_lfs::FLFS_RET_ENOENT);
+        BOOST_CHECK(inode_cache.get_inode_cache(3, 30, &entry) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        inode_cache.remove_inode_cache(3);
+        BOOST_CHECK(inode_cache.inode_cache_size() == 1);
+
+        inode_cache.evict_inode_cache(0);
+        BOOST_CHECK(inode_cache.inode_cache_size() == 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(Test_FuseLFS_write_buffer) {
+        qemucsd::fuse_lfs::FuseLFSWriteBuffer write_buffer(4, 2);
+
+        char data[qemucsd::fuse_lfs::SECTOR_SIZE];
+        memset(data, 'a', qemucsd::fuse_lfs::SECTOR_SIZE);
+
+        // Adjacent writes to the same sector are coalesced
+        BOOST_CHECK(write_buffer.buffer_write(2, 100, 0, data, 0, 10) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(write_buffer.buffer_write(2, 100, 0, data, 10, 10) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(write_buffer.write_buffer_size() == 1);
+
+        // Disjoint writes require the sector to be completed first
+        BOOST_CHECK(write_buffer.buffer_write(2, 100, 0, data, 30, 10) ==
+            qemucsd::fuse_lfs::FLFS_RET_WRBUF_FILL);
+
+        uint8_t fill[qemucsd::fuse_lfs::SECTOR_SIZE];
+        memset(fill, 'f', qemucsd::fuse_lfs::SECTOR_SIZE);
+        BOOST_CHECK(write_buffer.fill_write_buffer(2, 0, fill) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(write_buffer.buffer_write(2, 100, 0, data, 30, 10) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        struct qemucsd::fuse_lfs::write_buffer buffer;
+        BOOST_CHECK(write_buffer.get_write_buffer(2, &buffer) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(buffer.size == 100);
+        BOOST_CHECK(buffer.sectors.at(0).start == 0);
+        BOOST_CHECK(buffer.sectors.at(0).end ==
+            qemucsd::fuse_lfs::SECTOR_SIZE);
+        BOOST_CHECK(buffer.sectors.at(0).data[25] == 'f');
+        BOOST_CHECK(buffer.sectors.at(0).data[35] == 'a');
+
+        // Inode limit of two sectors
+        BOOST_CHECK(!write_buffer.write_buffer_flush_due(2, 1));
+        BOOST_CHECK(write_buffer.write_buffer_flush_due(2, 2));
+        BOOST_CHECK(!write_buffer.write_buffer_flush_due(3, 1));
+
+        // Total limit of four sectors applies to inodes without buffers
+        BOOST_CHECK(write_buffer.write_buffer_full(4));
+        BOOST_CHECK(write_buffer.write_buffer_flush_due(3, 4));
+
+        BOOST_CHECK(write_buffer.buffer_write(2, 100, 1, data, 0,
+            qemucsd::fuse_lfs::SECTOR_SIZE) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(write_buffer.write_buffer_size() == 2);
+
+        // Truncation zeroes the tail of the last sector and drops the rest
+        write_buffer.truncate_write_buffer(2, 50);
+        BOOST_CHECK(write_buffer.write_buffer_size() == 1);
+        BOOST_CHECK(write_buffer.get_write_buffer(2, &buffer) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(buffer.size == 50);
+        BOOST_CHECK(buffer.sectors.at(0).end == 50);
+        BOOST_CHECK(buffer.sectors.at(0).data[60] == 0);
+
+        write_buffer.remove_write_buffer(2);
+        BOOST_CHECK(!write_buffer.has_write_buffer(2));
+        BOOST_CHECK(write_buffer.write_buffer_size() == 0);
+    }
+
+    /**
+     * Small writes spread over many inodes never grow the write buffer beyond
+     * its total limit, the buffers of all inodes are flushed once reached.
+     */
+    BOOST_FIXTURE_TEST_CASE(Test_FuseLFS_write_buffer_limit,
+        TestFuseLFSFixture)
+    {
+        qemucsd::nvme_zns::NvmeZnsMemoryBackend nvme_memory(
+            16, 256, qemucsd::fuse_lfs::SECTOR_SIZE);
+        TestFuseLFS test_fuse(&nvme_memory);
+        BOOST_CHECK(test_fuse.run_init() == qemucsd::fuse_lfs::FLFS_RET_NONE);
+        test_fuse.write_buffer_limit = 8;
+
+        char data[qemucsd::fuse_lfs::SECTOR_SIZE];
+        memset(data, 'a', qemucsd::fuse_lfs::SECTOR_SIZE);
+
+        std::vector<fuse_ino_t> inodes;
+        for(uint64_t i = 0; i < 20; i++) {
+            fuse_ino_t ino;
+            BOOST_CHECK(test_fuse.create_inode(1, std::to_string(i).c_str(),
+                qemucsd::fuse_lfs::INO_T_FILE, ino) ==
+                qemucsd::fuse_lfs::FLFS_RET_NONE);
+            inodes.push_back(ino);
+
+            BOOST_CHECK(test_fuse.flush_write_buffers_if_full(1) ==
+                qemucsd::fuse_lfs::FLFS_RET_NONE);
+            BOOST_CHECK(test_fuse.buffer_write(ino, 0, 0, data, 0, 10) ==
+                qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+            qemucsd::fuse_lfs::inode_entry_t entry;
+            BOOST_CHECK(test_fuse.get_inode_entry(ino, &entry) ==
+                qemucsd::fuse_lfs::FLFS_RET_NONE);
+            entry.first.size = 10;
+            test_fuse.update_inode_entry(&entry);
+
+            BOOST_CHECK(test_fuse.write_buffer_size() <=
+                test_fuse.write_buffer_limit);
+        }
+
+        // The limit was reached twice, flushing every inode each time
+        BOOST_CHECK(test_fuse.write_buffer_size() == 4);
+        BOOST_CHECK(!test_fuse.has_write_buffer(inodes.at(0)));
+        BOOST_CHECK(!test_fuse.has_write_buffer(inodes.at(15)));
+        BOOST_CHECK(test_fuse.has_write_buffer(inodes.at(16)));
+    }
+
+    /**
+     * Buffered writes of an inode are appended at once, partially written
+     * sectors are completed with the data already on drive.
+     */
+    BOOST_FIXTURE_TEST_CASE(Test_FuseLFS_flush_write_buffers,
+        TestFuseLFSFixture)
+    {
+        qemucsd::nvme_zns::NvmeZnsMemoryBackend nvme_memory(
+            16, 256, qemucsd::fuse_lfs::SECTOR_SIZE);
+        TestFuseLFS test_fuse(&nvme_memory);
+        BOOST_CHECK(test_fuse.run_init() == qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        fuse_ino_t ino;
+        BOOST_CHECK(test_fuse.create_inode(1, "test",
+            qemucsd::fuse_lfs::INO_T_FILE, ino) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        // Existing sector of data on drive
+        uint8_t data[qemucsd::fuse_lfs::SECTOR_SIZE];
+        memset(data, 'a', qemucsd::fuse_lfs::SECTOR_SIZE);
+        uint64_t old_lba;
+        BOOST_CHECK(test_fuse.log_append(data, qemucsd::fuse_lfs::SECTOR_SIZE,
+            old_lba) == qemucsd::fuse_lfs::FLFS_RET_NONE);
+        struct qemucsd::fuse_lfs::data_block blk = {0};
+        blk.data_lbas[0] = old_lba;
+        test_fuse.assign_data_block(ino, 0, &blk);
+
+        qemucsd::fuse_lfs::inode_entry_t entry;
+        BOOST_CHECK(test_fuse.get_inode_entry(ino, &entry) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        entry.first.size = qemucsd::fuse_lfs::SECTOR_SIZE;
+        test_fuse.update_inode_entry(&entry);
+
+        // Partially overwrite the existing sector and extend into the next
+        memset(data, 'b', qemucsd::fuse_lfs::SECTOR_SIZE);
+        BOOST_CHECK(test_fuse.buffer_write(ino, entry.first.size, 0,
+            (const char*) data, 10, 10) == qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(test_fuse.buffer_write(ino, entry.first.size, 1,
+            (const char*) data, 0, 100) == qemucsd::fuse_lfs::FLFS_RET_NONE);
+        entry.first.size = qemucsd::fuse_lfs::SECTOR_SIZE + 100;
+        test_fuse.update_inode_entry(&entry);
+
+        BOOST_CHECK(test_fuse.flush_write_buffers() ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(!test_fuse.has_write_buffer(ino));
+        BOOST_CHECK(test_fuse.write_buffer_size() == 0);
+
+        // Both sectors are appended consecutively
+        BOOST_CHECK(test_fuse.get_data_block(entry.first, 0, &blk) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(blk.data_lbas[0] != old_lba);
+        BOOST_CHECK(blk.data_lbas[1] == blk.data_lbas[0] + 1);
+
+        struct qemucsd::fuse_lfs::data_position pos = {0};
+        test_fuse.lba_to_position(blk.data_lbas[0], pos);
+        BOOST_CHECK(test_fuse.nvme->read(pos.zone, pos.sector, 0, data,
+            qemucsd::fuse_lfs::SECTOR_SIZE) == 0);
+        BOOST_CHECK(data[9] == 'a');
+        BOOST_CHECK(data[10] == 'b');
+        BOOST_CHECK(data[19] == 'b');
+        BOOST_CHECK(data[20] == 'a');
+
+        test_fuse.lba_to_position(blk.data_lbas[1], pos);
+        BOOST_CHECK(test_fuse.nvme->read(pos.zone, pos.sector, 0, data,
+            qemucsd::fuse_lfs::SECTOR_SIZE) == 0);
+        BOOST_CHECK(data[99] == 'b');
+        BOOST_CHECK(data[100] == 0);
+    }
+
+    /**
+     * Flushing a single inode persists it together with its new parent
+     * directory but leaves the pending state of other inodes untouched.
+     */
+    BOOST_FIXTURE_TEST_CASE(Test_FuseLFS_flush_pending_inode,
+        TestFuseLFSFixture)
+    {
+        qemucsd::nvme_zns::NvmeZnsMemoryBackend nvme_memory(
+            16, 256, qemucsd::fuse_lfs::SECTOR_SIZE);
+        TestFuseLFS test_fuse(&nvme_memory);
+        BOOST_CHECK(test_fuse.run_init() == qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        fuse_ino_t dir;
+        fuse_ino_t file;
+        fuse_ino_t other;
+        BOOST_CHECK(test_fuse.create_inode(1, "dir",
+            qemucsd::fuse_lfs::INO_T_DIR, dir) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(test_fuse.create_inode(dir, "file",
+            qemucsd::fuse_lfs::INO_T_FILE, file) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(test_fuse.create_inode(1, "other",
+            qemucsd::fuse_lfs::INO_T_FILE, other) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        uint8_t data[qemucsd::fuse_lfs::SECTOR_SIZE];
+        memset(data, 'a', qemucsd::fuse_lfs::SECTOR_SIZE);
+        BOOST_CHECK(test_fuse.buffer_write(file, 0, 0,
+            (const char*) data, 0, 100) == qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(test_fuse.buffer_write(other, 0, 0,
+            (const char*) data, 0, 100) == qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        BOOST_CHECK(test_fuse.flush_pending_inode(file) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        qemucsd::fuse_lfs::inode_entry_t entry;
+        BOOST_CHECK(!test_fuse.has_write_buffer(file));
+        BOOST_CHECK(test_fuse.get_inode_entry(file, &entry) ==
+            qemucsd::fuse_lfs::FLFS_RET_ENOENT);
+        BOOST_CHECK(test_fuse.get_inode_entry(dir, &entry) ==
+            qemucsd::fuse_lfs::FLFS_RET_ENOENT);
+        BOOST_CHECK(test_fuse.nat_update_set->count(file) == 0);
+        BOOST_CHECK(test_fuse.nat_update_set->count(dir) == 0);
+
+        BOOST_CHECK(test_fuse.has_write_buffer(other));
+        BOOST_CHECK(test_fuse.get_inode_entry(other, &entry) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+    }
+
+    /**
+     * Point every head of the calling thread at the final sector of the last
+     * zone with no unclaimed log zones left, the next append fills the log.
+     */
+    void fill_log_heads(TestFuseLFS *test_fuse) {
+        uint32_t index = test_fuse->log_head_index();
+        for(uint32_t i = 0; i < qemucsd::fuse_lfs::N_LOG_STREAMS; i++) {
+            test_fuse->log_heads[i][index].ptr = {
+                test_fuse->nvme_info.num_zones - 1,
+                test_fuse->nvme_info.zone_capacity - 1, 0,
+                qemucsd::fuse_lfs::SECTOR_SIZE};
+        }
+        test_fuse->log_zone_next = test_fuse->nvme_info.num_zones;
+    }
+
+    /**
+     * Data appended with the final sectors of the log zone is on drive so the
+     * flush succeeds even though the log zone is full afterwards.
+     */
+    BOOST_FIXTURE_TEST_CASE(Test_FuseLFS_flush_log_full, TestFuseLFSFixture)
+    {
+        qemucsd::nvme_zns::NvmeZnsMemoryBackend nvme_memory(
+            16, 4, qemucsd::fuse_lfs::SECTOR_SIZE);
+        TestFuseLFS test_fuse(&nvme_memory);
+        BOOST_CHECK(test_fuse.run_init() == qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        fuse_ino_t ino;
+        BOOST_CHECK(test_fuse.create_inode(1, "test",
+            qemucsd::fuse_lfs::INO_T_FILE, ino) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        fill_log_heads(&test_fuse);
+        BOOST_CHECK(test_fuse.flush_inodes_always() ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        struct qemucsd::fuse_lfs::data_position pos = {0};
+        test_fuse.lba_to_position(test_fuse.inode_lba_map.at(ino).lba, pos);
+        BOOST_CHECK(pos.zone == test_fuse.nvme_info.num_zones - 1);
+
+        uint64_t lba;
+        uint8_t data[qemucsd::fuse_lfs::SECTOR_SIZE];
+        memset(data, 'a', qemucsd::fuse_lfs::SECTOR_SIZE);
+        fill_log_heads(&test_fuse);
+        BOOST_CHECK(test_fuse.write_sector(10, 0, 0, (const char*) data,
+            lba) == qemucsd::fuse_lfs::FLFS_RET_NONE);
+        test_fuse.lba_to_position(lba, pos);
+        BOOST_CHECK(pos.zone == test_fuse.nvme_info.num_zones - 1);
+
+        BOOST_CHECK(test_fuse.buffer_write(ino, 0, 0, (const char*) data, 0,
+            qemucsd::fuse_lfs::SECTOR_SIZE) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        fill_log_heads(&test_fuse);
+        BOOST_CHECK(test_fuse.flush_write_buffers() ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(!test_fuse.has_write_buffer(ino));
+
+        // The head is retired as no unclaimed log zone remains
+        BOOST_CHECK(!test_fuse.log_heads[test_fuse.classify_log(
+            qemucsd::fuse_lfs::LOG_DATA_BUFFERED, ino)][
+            test_fuse.log_head_index()].ptr.valid());
+    }
+
+    /**
+     * Growing a file must preserve the partially filled last data_block.
+     */
+    BOOST_FIXTURE_TEST_CASE(Test_FuseLFS_ftruncate_grow,
+        TestFuseLFSFixture)
+    {
+        qemucsd::nvme_zns::NvmeZnsMemoryBackend nvme_memory(
+            16, 256, qemucsd::fuse_lfs::SECTOR_SIZE);
+        TestFuseLFS test_fuse(&nvme_memory);
+        BOOST_CHECK(test_fuse.run_init() == qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        fuse_ino_t ino;
+        BOOST_CHECK(test_fuse.create_inode(1, "test",
+            qemucsd::fuse_lfs::INO_T_FILE, ino) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        struct qemucsd::fuse_lfs::data_block blk = {0};
+        blk.data_lbas[0] = 1337;
+        test_fuse.assign_data_block(ino, 0, &blk);
+
+        qemucsd::fuse_lfs::inode_entry_t entry;
+        BOOST_CHECK(test_fuse.get_inode_entry(ino, &entry) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        entry.first.size = 100;
+        test_fuse.update_inode_entry(&entry);
+
+        uint64_t size = (qemucsd::fuse_lfs::DATA_BLK_LBA_NUM + 1) *
+            qemucsd::fuse_lfs::SECTOR_SIZE + 1;
+        BOOST_CHECK(test_fuse.ftruncate(ino, size) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        BOOST_CHECK(test_fuse.get_inode_entry(ino, &entry) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(entry.first.size == size);
+
+        BOOST_CHECK(test_fuse.get_data_block(entry.first, 0, &blk) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(blk.data_lbas[0] == 1337);
+        BOOST_CHECK(test_fuse.get_data_block(entry.first, 1, &blk) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(blk.data_lbas[0] == 0);
+        BOOST_CHECK(test_fuse.get_data_block(entry.first, 2, &blk) ==
+            qemucsd::fuse_lfs::FLFS_RET_ERR);
+    }
+
+
+    /**
+     * Flushed data_blocks must form a chain on drive, rewriting a data_block
+     * only rewrites its predecessors.
+     */
+    BOOST_FIXTURE_TEST_CASE(Test_FuseLFS_flush_data_blocks,
+        TestFuseLFSFixture)
+    {
+        qemucsd::nvme_zns::NvmeZnsMemoryBackend nvme_memory(
+            16, 256, qemucsd::fuse_lfs::SECTOR_SIZE);
+        TestFuseLFS test_fuse(&nvme_memory);
+        BOOST_CHECK(test_fuse.run_init() == qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        fuse_ino_t ino;
+        BOOST_CHECK(test_fuse.create_inode(1, "test",
+            qemucsd::fuse_lfs::INO_T_FILE, ino) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        struct qemucsd::fuse_lfs::data_block blk = {0};
+        for(uint64_t i = 0; i < 3; i++) {
+            blk.data_lbas[0] = 100 + i;
+            test_fuse.assign_data_block(ino, i, &blk);
+        }
+
+        qemucsd::fuse_lfs::inode_entry_t entry;
+        BOOST_CHECK(test_fuse.get_inode_entry(ino, &entry) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        entry.first.size = (qemucsd::fuse_lfs::DATA_BLK_LBA_NUM * 2 + 1) *
+            qemucsd::fuse_lfs::SECTOR_SIZE;
+        test_fuse.update_inode_entry(&entry);
+
+        BOOST_CHECK(test_fuse.flush_data_blocks() ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(test_fuse.data_blocks->empty());
+
+        BOOST_CHECK(test_fuse.get_inode(ino, &entry) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(entry.first.data_lba != 0);
+
+        std::vector<uint64_t> chain;
+        BOOST_CHECK(test_fuse.read_data_block_chain(entry.first.data_lba,
+            chain) == qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(chain.size() == 3);
+
+        for(uint64_t i = 0; i < 3; i++) {
+            BOOST_CHECK(test_fuse.get_data_block(entry.first, i, &blk) ==
+                qemucsd::fuse_lfs::FLFS_RET_NONE);
+            BOOST_CHECK(blk.data_lbas[0] == 100 + i);
+        }
+
+        // Only the modified data_block and its predecessor are rewritten
+        blk.data_lbas[0] = 201;
+        test_fuse.assign_data_block(ino, 1, &blk);
+        BOOST_CHECK(test_fuse.flush_data_blocks() ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        BOOST_CHECK(test_fuse.get_inode(ino, &entry) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        std::vector<uint64_t> new_chain;
+        BOOST_CHECK(test_fuse.read_data_block_chain(entry.first.data_lba,
+            new_chain) == qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(new_chain.size() == 3);
+        BOOST_CHECK(new_chain.at(0) != chain.at(0));
+        BOOST_CHECK(new_chain.at(1) != chain.at(1));
+        BOOST_CHECK(new_chain.at(2) == chain.at(2));
+
+        BOOST_CHECK(test_fuse.get_data_block(entry.first, 0, &blk) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(blk.data_lbas[0] == 100);
+        BOOST_CHECK(test_fuse.get_data_block(entry.first, 1, &blk) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(blk.data_lbas[0] == 201);
+
+        // Remaining stages persist the inode and its location
+        BOOST_CHECK(test_fuse.flush_pending() ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(test_fuse.get_inode_entry(ino, &entry) ==
+            qemucsd::fuse_lfs::FLFS_RET_ENOENT);
+        BOOST_CHECK(test_fuse.nat_update_set->empty());
+        BOOST_CHECK(test_fuse.get_inode(ino, &entry) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(entry.first.data_lba == new_chain.at(0));
+    }
+
+    /**
+     * Create a directory containing a file with a data_block and persist them
+     * to drive.
+     */
+    void setup_remount(TestFuseLFS *test_fuse, fuse_ino_t &dir,
+        fuse_ino_t &file)
+    {
+        BOOST_CHECK(test_fuse->run_init() == qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        BOOST_CHECK(test_fuse->create_inode(1, "dir",
+            qemucsd::fuse_lfs::INO_T_DIR, dir) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(test_fuse->create_inode(dir, "file",
+            qemucsd::fuse_lfs::INO_T_FILE, file) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+
+        struct qemucsd::fuse_lfs::data_block blk = {0};
+        blk.data_lbas[0] = 100;
+        test_fuse->assign_data_block(file, 0, &blk);
+
+        qemucsd::fuse_lfs::inode_entry_t entry;
+        BOOST_CHECK(test_fuse->get_inode_entry(file, &entry) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        entry.first.size = qemucsd::fuse_lfs::SECTOR_SIZE;
+        test_fuse->update_inode_entry(&entry);
+
+        BOOST_CHECK(test_fuse->flush_pending() ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+    }
+
+    /**
+     * Verify the names, parents and data of the inodes from setup_remount are
+     * restored by a remount.
+     */
+    void verify_remount(TestFuseLFS *test_fuse, fuse_ino_t dir,
+        fuse_ino_t file)
+    {
+        BOOST_CHECK(test_fuse->path_inode_map->at(1)->at("dir") == dir);
+        BOOST_CHECK(test_fuse->path_inode_map->at(dir)->at("file") == file);
+        BOOST_CHECK(test_fuse->inode_lba_map.at(file).parent == dir);
+        BOOST_CHECK(test_fuse->ino_ptr > file);
+
+        qemucsd::fuse_lfs::inode_entry_t entry;
+        BOOST_CHECK(test_fuse->get_inode(file, &entry) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(entry.first.size == qemucsd::fuse_lfs::SECTOR_SIZE);
+
+        struct qemucsd::fuse_lfs::data_block blk = {0};
+        BOOST_CHECK(test_fuse->get_data_block(entry.first, 0, &blk) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(blk.data_lbas[0] == 100);
+    }
+
+    /**
+     * Remounting a cleanly unmounted filesystem must not format it and
+     * restore random_ptr and log heads from the checkpoint block.
+     */
+    BOOST_FIXTURE_TEST_CASE(Test_FuseLFS_remount, TestFuseLFSFixture) {
+        qemucsd::nvme_zns::NvmeZnsMemoryBackend nvme_memory(
+            16, 256, qemucsd::fuse_lfs::SECTOR_SIZE);
+        fuse_ino_t dir;
+        fuse_ino_t file;
+
+        struct qemucsd::fuse_lfs::data_position random_ptr;
+        uint64_t log_zone_next;
+        {
+            TestFuseLFS test_fuse(&nvme_memory);
+            setup_remount(&test_fuse, dir, file);
+            random_ptr = test_fuse.random_ptr;
+            log_zone_next = test_fuse.log_zone_next;
+            BOOST_CHECK(test_fuse.remove_dirtyblock() ==
+                qemucsd::fuse_lfs::FLFS_RET_NONE);
+        }
+
+        TestFuseLFS test_fuse(&nvme_memory);
+        BOOST_CHECK(test_fuse.run_init() == qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(test_fuse.random_ptr == random_ptr);
+        BOOST_CHECK(test_fuse.log_zone_next == log_zone_next);
+        verify_remount(&test_fuse, dir, file);
+
+        // New inodes do not reuse numbers handed out before the remount
+        fuse_ino_t ino;
+        BOOST_CHECK(test_fuse.create_inode(1, "new",
+            qemucsd::fuse_lfs::INO_T_FILE, ino) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(ino > file);
+    }
+
+    /**
+     * Remounting a filesystem left dirty rolls forward over NAT blocks
+     * written after the last checkpoint and marks it dirty again.
+     */
+    BOOST_FIXTURE_TEST_CASE(Test_FuseLFS_remount_dirty, TestFuseLFSFixture) {
+        qemucsd::nvme_zns::NvmeZnsMemoryBackend nvme_memory(
+            16, 256, qemucsd::fuse_lfs::SECTOR_SIZE);
+        fuse_ino_t dir;
+        fuse_ino_t file;
+
+        struct qemucsd::fuse_lfs::data_position random_ptr;
+        {
+            TestFuseLFS test_fuse(&nvme_memory);
+            setup_remount(&test_fuse, dir, file);
+
+            // NAT block appended after the checkpoint block
+            qemucsd::fuse_lfs::nat_block nt_blk = {0};
+            nt_blk.type = qemucsd::fuse_lfs::RANDZ_NAT_BLK;
+            nt_blk.inode[0] = file;
+            nt_blk.lba[0] = test_fuse.inode_lba_map.at(file).lba;
+            BOOST_CHECK(test_fuse.append_random_block(nt_blk) ==
+                qemucsd::fuse_lfs::FLFS_RET_NONE);
+            random_ptr = test_fuse.random_ptr;
+        }
+
+        TestFuseLFS test_fuse(&nvme_memory);
+        BOOST_CHECK(test_fuse.run_init() == qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(test_fuse.random_ptr == random_ptr);
+        BOOST_CHECK(test_fuse.verify_dirtyblock() ==
+            qemucsd::fuse_lfs::FLFS_RET_ERR);
+        verify_remount(&test_fuse, dir, file);
+
+        struct qemucsd::fuse_lfs::checkpoint_block cblock = {0};
+        BOOST_CHECK(test_fuse.get_checkpointblock(cblock) ==
+            qemucsd::fuse_lfs::FLFS_RET_NONE);
+        uint64_t randz_ptr;
+        test_fuse.position_to_lba(random_ptr, randz_ptr);
+        BOOST_CHECK(cblock.randz_ptr == randz_ptr);
+    }
+
+    /**
+     * Power loss after the random zone was copied into the random buffer and
+     * reset but before the checkpoint block was updated. The NAT blocks are
+     * restored from the random buffer.
+     */
+    BOOST_FIXTURE_TEST_CASE(Test_FuseLFS_remount_random_buffer,
+        TestFuseLFSFixture)
+    {
+        qemucsd::nvme_zns::NvmeZnsMemoryBackend nvme_memory(
+            16, 256, qemucsd::fuse_lfs::SECTOR_SIZE);
+        fuse_ino_t dir;
+        fuse_ino_t file;
+
+        {
+            TestFuseLFS test_fuse(&nvme_memory);
+            setup_remount(&test_fuse, dir, file);
+
+            uint64_t zones[2] = {qemucsd::fuse_lfs::RANDZ_POS.zone,
+                                 qemucsd::fuse_lfs::RANDZ_POS.zone + 1};
+            BOOST_CHECK(test_fuse.buffer_random_blocks(zones,
+                test_fuse.random_ptr) == qemucsd::fuse_lfs::FLFS_RET_NONE);
+            BOOST_CHECK(nvme_memory.reset(zones[0]) == 0);
+        }
+
+        TestFuseLFS test_fuse(&nvme_memory);
+        BOOST_CHECK(test_fuse.run_init() == qemucsd::fuse_lfs::FLFS_RET_NONE);
+        BOOST_CHECK(test_fuse.random_pos.zone ==
+            qemucsd::fuse_lfs::RANDZ_POS.zone + 2);
+        verify_remount(&test_fuse, dir, file);
+
+        // Random buffer is erased and its NAT entries appended again
+        uint8_t data[qemucsd::fuse_lfs::SECTOR_SIZE];
+        BOOST_CHECK(nvme_memory.read(qemucsd::fuse_lfs::RANDZ_BUFF_POS.zone,
+            0, 0, data, qemucsd::fuse_lfs::SECTOR_SIZE) != 0);
+        BOOST_CHECK(test_fuse.random_ptr != test_fuse.random_pos);
+    }
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
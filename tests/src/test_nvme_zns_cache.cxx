@@ -0,0 +1,216 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Dantali0n
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE TestNvmeZnsCache
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <cstring>
+
+#include "tests.hpp"
+
+#include "nvme_zns_cache.hpp"
+#include "nvme_zns_memory.hpp"
+
+using qemucsd::nvme_zns::NvmeZnsCacheBackend;
+using qemucsd::nvme_zns::NvmeZnsMemoryBackend;
+using qemucsd::nvme_zns::nvme_zns_batch;
+using qemucsd::nvme_zns::nvme_zns_iovec;
+
+/**
+ * Memory backend counting the reads that reach it
+ */
+class CountingBackend : public NvmeZnsMemoryBackend {
+public:
+    std::atomic<uint64_t> reads{0};
+
+    CountingBackend(uint64_t num_zones, uint64_t zone_size,
+        uint64_t sector_size) :
+        NvmeZnsMemoryBackend(num_zones, zone_size, sector_size)
+    {
+
+    }
+
+    int read(uint64_t zone, uint64_t sector, uint64_t offset, void* buffer,
+             uint64_t size) override
+    {
+        reads += 1;
+        return NvmeZnsMemoryBackend::read(zone, sector, offset, buffer, size);
+    }
+
+    int readv(struct nvme_zns_iovec *iov, uint64_t iovcnt) override {
+        reads += 1;
+        return NvmeZnsMemoryBackend::readv(iov, iovcnt);
+    }
+};
+
+BOOST_AUTO_TEST_SUITE(Test_NvmeZnsCacheBackend)
+
+    BOOST_AUTO_TEST_CASE(Test_NvmeZnsCacheBackend_hit) {
+        constexpr uint32_t sector_size = 512;
+        CountingBackend memory(10, 16, sector_size);
+        NvmeZnsCacheBackend backend(&memory, 64 * sector_size, 4);
+
+        unsigned char data[sector_size * 2];
+        for(uint32_t i = 0; i < sizeof(data); i++) data[i] = i % 251;
+
+        uint64_t sector;
+        BOOST_CHECK(backend.append(1, sector, 0, data, sizeof(data)) == 0);
+
+        unsigned char buffer[sector_size * 2] = {0};
+        BOOST_CHECK(backend.read(1, 0, 0, buffer, sizeof(buffer)) == 0);
+        BOOST_CHECK(memcmp(buffer, data, sizeof(data)) == 0);
+        BOOST_CHECK(memory.reads == 1);
+
+        // Aligned, unaligned and sector spanning reads all hit
+        memset(buffer, 0, sizeof(buffer));
+        BOOST_CHECK(backend.read(1, 0, 0, buffer, sizeof(buffer)) == 0);
+        BOOST_CHECK(memcmp(buffer, data, sizeof(data)) == 0);
+        BOOST_CHECK(backend.read(1, 1, 100, buffer, 200) == 0);
+        BOOST_CHECK(memcmp(buffer, data + sector_size + 100, 200) == 0);
+        BOOST_CHECK(backend.read(1, 0, 400, buffer, 300) == 0);
+        BOOST_CHECK(memcmp(buffer, data + 400, 300) == 0);
+        BOOST_CHECK(memory.reads == 1);
+
+        struct nvme_zns_iovec iov[2] = {
+            {1, 1, buffer, sector_size}, {1, 0, buffer + sector_size, 10}
+        };
+        BOOST_CHECK(backend.readv(iov, 2) == 0);
+        BOOST_CHECK(memcmp(buffer, data + sector_size, sector_size) == 0);
+        BOOST_CHECK(memcmp(buffer + sector_size, data, 10) == 0);
+        BOOST_CHECK(memory.reads == 1);
+
+        // Unwritten sectors are never cached
+        BOOST_CHECK(backend.read(1, 2, 0, buffer, sector_size) != 0);
+        BOOST_CHECK(backend.read(1, 2, 0, buffer, sector_size) != 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(Test_NvmeZnsCacheBackend_coherence) {
+        constexpr uint32_t sector_size = 512;
+        CountingBackend memory(10, 16, sector_size);
+        NvmeZnsCacheBackend backend(&memory, 64 * sector_size, 4);
+
+        unsigned char data[sector_size];
+        unsigned char buffer[sector_size];
+        memset(data, 0xAA, sizeof(data));
+
+        uint64_t sector;
+        BOOST_CHECK(backend.append(2, sector, 0, data, sizeof(data)) == 0);
+        BOOST_CHECK(backend.read(2, 0, 0, buffer, sizeof(buffer)) == 0);
+
+        // Reset and rewrite the zone with different data through the cache
+        BOOST_CHECK(backend.reset(2) == 0);
+        BOOST_CHECK(backend.read(2, 0, 0, buffer, sizeof(buffer)) != 0);
+
+        memset(data, 0x55, sizeof(data));
+        BOOST_CHECK(backend.append(2, sector, 0, data, sizeof(data)) == 0);
+        BOOST_CHECK(backend.read(2, 0, 0, buffer, sizeof(buffer)) == 0);
+        BOOST_CHECK(memcmp(buffer, data, sizeof(data)) == 0);
+
+        // Same through the asynchronous interface
+        nvme_zns_batch batch;
+        BOOST_CHECK(backend.submit_reset(2, batch.track()) == 0);
+        BOOST_CHECK(backend.wait(&batch) == 0);
+
+        memset(data, 0x33, sizeof(data));
+        BOOST_CHECK(backend.submit_append(2, 0, data, sizeof(data),
+                                          batch.track()) == 0);
+        BOOST_CHECK(backend.wait(&batch) == 0);
+
+        BOOST_CHECK(backend.read(2, 0, 0, buffer, sizeof(buffer)) == 0);
+        BOOST_CHECK(memcmp(buffer, data, sizeof(data)) == 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(Test_NvmeZnsCacheBackend_async) {
+        constexpr uint32_t sector_size = 512;
+        CountingBackend memory(10, 16, sector_size);
+        NvmeZnsCacheBackend backend(&memory, 64 * sector_size, 4);
+
+        unsigned char data[sector_size * 4];
+        for(uint32_t i = 0; i < sizeof(data); i++) data[i] = i % 253;
+
+        uint64_t sector;
+        BOOST_CHECK(backend.append(3, sector, 0, data, sizeof(data)) == 0);
+
+        unsigned char buffer[sector_size * 4] = {0};
+        nvme_zns_batch batch;
+        BOOST_CHECK(backend.submit_read(3, 0, 0, buffer, sizeof(buffer),
+                                        batch.track()) == 0);
+        BOOST_CHECK(backend.wait(&batch) == 0);
+        BOOST_CHECK(memcmp(buffer, data, sizeof(data)) == 0);
+        uint64_t reads = memory.reads;
+
+        // Served from the cache and completed by wait
+        memset(buffer, 0, sizeof(buffer));
+        struct nvme_zns_iovec iov[2] = {
+            {3, 0, buffer, sector_size * 2},
+            {3, 2, buffer + sector_size * 2, sector_size * 2}
+        };
+        BOOST_CHECK(backend.submit_readv(iov, 2, batch.track()) == 0);
+        BOOST_CHECK(backend.wait(&batch) == 0);
+        BOOST_CHECK(memcmp(buffer, data, sizeof(data)) == 0);
+        BOOST_CHECK(memory.reads == reads);
+    }
+
+    /**
+     * A sector accessed repeatedly survives a scan many times larger than the
+     * cache.
+     */
+    BOOST_AUTO_TEST_CASE(Test_NvmeZnsCacheBackend_scan_resistant) {
+        constexpr uint32_t sector_size = 512;
+        CountingBackend memory(17, 64, sector_size);
+        NvmeZnsCacheBackend backend(&memory, 16 * sector_size, 1);
+
+        unsigned char data[sector_size * 64] = {0};
+        uint64_t sector;
+        for(uint64_t zone = 0; zone < 16; zone++) {
+            BOOST_CHECK(backend.append(zone, sector, 0, data,
+                                       sizeof(data)) == 0);
+        }
+
+        unsigned char buffer[sector_size];
+        BOOST_CHECK(backend.read(0, 0, 0, buffer, sector_size) == 0);
+        for(uint64_t i = 1; i <= 16; i++) {
+            BOOST_CHECK(backend.read(1, i, 0, buffer, sector_size) == 0);
+        }
+
+        // Evicted from A1in but remembered, second access promotes to Am
+        uint64_t reads = memory.reads;
+        BOOST_CHECK(backend.read(0, 0, 0, buffer, sector_size) == 0);
+        BOOST_CHECK(memory.reads == reads + 1);
+
+        for(uint64_t i = 0; i < 64 * 8; i++) {
+            BOOST_CHECK(backend.read(2 + i / 64, i % 64, 0, buffer,
+                                     sector_size) == 0);
+        }
+
+        reads = memory.reads;
+        BOOST_CHECK(backend.read(0, 0, 0, buffer, sector_size) == 0);
+        BOOST_CHECK(memory.reads == reads);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
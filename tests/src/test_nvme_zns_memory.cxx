@@ -32,6 +32,10 @@
 #include "nvme_zns_memory.hpp"
 
 using qemucsd::nvme_zns::NvmeZnsMemoryBackend;
+using qemucsd::nvme_zns::nvme_zns_iovec;
+using qemucsd::nvme_zns::nvme_zns_batch;
+using qemucsd::nvme_zns::nvme_zns_copy_range;
+using qemucsd::nvme_zns::nvme_zns_zone_desc;
 
 BOOST_AUTO_TEST_SUITE(Test_NvmeZnsMemoryBackend)
 
@@ -132,6 +136,37 @@ BOOST_AUTO_TEST_SUITE(Test_NvmeZnsMemoryBackend)
         BOOST_CHECK(backend.append(0, sector, 0, buffer, sector_size) == -1);
     }
 
+    /**
+     * The final sector of the final zone can be appended and read, ending
+     * exactly at the end of the device.
+     */
+    BOOST_AUTO_TEST_CASE(Test_NvmeZnsMemoryBackend_append_read_last) {
+        constexpr uint32_t sector_size = 512;
+
+        NvmeZnsMemoryBackend backend(10,  16, sector_size);
+        qemucsd::nvme_zns::nvme_zns_info info;
+        backend.get_nvme_zns_info(&info);
+
+        unsigned char buffer[sector_size];
+        memset(buffer, 0xaa, sector_size);
+
+        uint64_t sector = 0;
+        for(uint32_t i = 0; i < info.zone_capacity; i++) {
+            BOOST_CHECK(backend.append(info.num_zones - 1, sector, 0, buffer,
+                sector_size) == 0);
+        }
+        BOOST_CHECK(sector == info.zone_capacity - 1);
+
+        memset(buffer, 0, sector_size);
+        BOOST_CHECK(backend.read(info.num_zones - 1, sector, 0, buffer,
+            sector_size) == 0);
+        BOOST_CHECK(buffer[sector_size - 1] == 0xaa);
+
+        // One byte beyond the end of the device
+        BOOST_CHECK(backend.read(info.num_zones - 1, sector, 1, buffer,
+            sector_size) == -1);
+    }
+
     BOOST_AUTO_TEST_CASE(Test_NvmeZnsMemoryBackend_write_reset) {
         constexpr uint32_t sector_size = 512;
 
@@ -195,4 +230,329 @@ BOOST_AUTO_TEST_SUITE(Test_NvmeZnsMemoryBackend)
         }
     }
 
+    BOOST_AUTO_TEST_CASE(Test_NvmeZnsMemoryBackend_appendv_readv) {
+        constexpr uint32_t sector_size = 512;
+
+        NvmeZnsMemoryBackend backend(10,  16, sector_size);
+        qemucsd::nvme_zns::nvme_zns_info info;
+        backend.get_nvme_zns_info(&info);
+
+        backend.reset(0);
+
+        unsigned char buffer[sector_size * 3];
+        for(uint32_t i = 0; i < sector_size * 3; i++) {
+            buffer[i] = i % UINT8_MAX;
+        }
+
+        // Two full sectors followed by a partial sector
+        nvme_zns_iovec iov[2] = {
+            {0, 0, buffer, sector_size * 2},
+            {0, 0, buffer + sector_size * 2, sector_size / 2},
+        };
+
+        uint64_t sector = 0;
+        BOOST_CHECK(backend.appendv(0, sector, iov, 2) == 0);
+        BOOST_CHECK(sector == 0);
+        BOOST_CHECK(iov[0].sector == 0);
+        BOOST_CHECK(iov[1].sector == 2);
+
+        // Partial last sector still advances the write pointer
+        BOOST_CHECK(backend.append(0, sector, 0, buffer, sector_size) == 0);
+        BOOST_CHECK(sector == 3);
+
+        // Scatter read the sectors out of order
+        unsigned char result_buffer[sector_size * 3];
+        memset(result_buffer, 0xff, sector_size * 3);
+        nvme_zns_iovec riov[2] = {
+            {0, 2, result_buffer + sector_size * 2, sector_size},
+            {0, 0, result_buffer, sector_size * 2},
+        };
+        BOOST_CHECK(backend.readv(riov, 2) == 0);
+
+        for(uint32_t i = 0; i < sector_size * 2 + sector_size / 2; i++) {
+            BOOST_CHECK(result_buffer[i] == buffer[i]);
+        }
+
+        // Remainder of the partial sector has been zeroed
+        for(uint32_t i = sector_size / 2; i < sector_size; i++) {
+            BOOST_CHECK(result_buffer[sector_size * 2 + i] == 0);
+        }
+
+        // Refuse to read ranges extending beyond the write pointer
+        nvme_zns_iovec unwritten = {0, 3, result_buffer, sector_size * 2};
+        BOOST_CHECK(backend.readv(&unwritten, 1) == -1);
+
+        // Refuse appends exceeding the zone capacity as a whole
+        unsigned char large_buffer[sector_size * 16];
+        nvme_zns_iovec large = {0, 0, large_buffer,
+                                sector_size * info.zone_capacity};
+        BOOST_CHECK(backend.appendv(0, sector, &large, 1) == -1);
+        BOOST_CHECK(backend.append(0, sector, 0, buffer, sector_size) == 0);
+        BOOST_CHECK(sector == 4);
+    }
+
+    BOOST_AUTO_TEST_CASE(Test_NvmeZnsMemoryBackend_submit_wait) {
+        constexpr uint32_t sector_size = 512;
+        constexpr uint32_t num_sectors = 8;
+
+        NvmeZnsMemoryBackend backend(10,  16, sector_size);
+
+        unsigned char buffer[sector_size * num_sectors];
+        for(uint32_t i = 0; i < sector_size * num_sectors; i++) {
+            buffer[i] = (i / sector_size) + 1;
+        }
+
+        // Keep appends to different zones in flight simultaneously
+        nvme_zns_batch batch;
+        uint64_t sectors[num_sectors] = {0};
+        for(uint32_t i = 0; i < num_sectors; i++) {
+            auto callback = batch.track();
+            BOOST_CHECK(backend.submit_append(i, 0, buffer + i * sector_size,
+                sector_size, [callback, &sectors, i](int res, uint64_t sector) {
+                    sectors[i] = sector;
+                    callback(res, sector);
+                }) == 0);
+        }
+        BOOST_CHECK(backend.wait(&batch) == 0);
+        BOOST_CHECK(batch.pending.load() == 0);
+
+        for(uint32_t i = 0; i < num_sectors; i++) {
+            BOOST_CHECK(sectors[i] == 0);
+        }
+
+        unsigned char result_buffer[sector_size * num_sectors];
+        memset(result_buffer, 0, sector_size * num_sectors);
+        for(uint32_t i = 0; i < num_sectors; i++) {
+            BOOST_CHECK(backend.submit_read(i, 0, 0,
+                result_buffer + i * sector_size, sector_size,
+                batch.track()) == 0);
+        }
+        BOOST_CHECK(backend.wait(&batch) == 0);
+
+        for(uint32_t i = 0; i < sector_size * num_sectors; i++) {
+            BOOST_CHECK(result_buffer[i] == buffer[i]);
+        }
+
+        // Failures are reported through the batch
+        BOOST_CHECK(backend.submit_read(0, 1, 0, result_buffer, sector_size,
+            batch.track()) == 0);
+        BOOST_CHECK(backend.wait(&batch) == -1);
+
+        // Resets complete before the zone can be read again
+        nvme_zns_batch reset_batch;
+        BOOST_CHECK(backend.submit_reset(0, reset_batch.track()) == 0);
+        BOOST_CHECK(backend.wait(&reset_batch) == 0);
+        BOOST_CHECK(backend.read(0, 0, 0, result_buffer, sector_size) == -1);
+
+        // Synchronous backends still complete through poll
+        NvmeZnsMemoryBackend sync_backend(10, 16, sector_size, 0);
+        nvme_zns_batch sync_batch;
+        BOOST_CHECK(sync_backend.submit_append(0, 0, buffer, sector_size,
+            sync_batch.track()) == 0);
+        BOOST_CHECK(sync_batch.pending.load() == 1);
+        BOOST_CHECK(sync_backend.poll() == 1);
+        BOOST_CHECK(sync_batch.pending.load() == 0);
+    }
+
+
+    BOOST_AUTO_TEST_CASE(Test_NvmeZnsMemoryBackend_zone_states) {
+        constexpr uint32_t sector_size = 512;
+        NvmeZnsMemoryBackend backend(10, 16, sector_size);
+
+        struct qemucsd::nvme_zns::nvme_zns_info info;
+        backend.get_nvme_zns_info(&info);
+
+        unsigned char buffer[sector_size] = {0};
+        nvme_zns_zone_desc descs[10];
+        uint64_t count = 10;
+        uint64_t sector;
+
+        BOOST_CHECK(backend.report_zones(0, descs, count) == 0);
+        BOOST_CHECK(count == 10);
+        for(uint64_t i = 0; i < count; i++) {
+            BOOST_CHECK(descs[i].zone == i);
+            BOOST_CHECK(descs[i].state == qemucsd::nvme_zns::ZONE_STATE_EMPTY);
+            BOOST_CHECK(descs[i].write_pointer == 0);
+            BOOST_CHECK(descs[i].capacity == info.zone_capacity);
+        }
+
+        // Appends implicitly open, closing keeps the written data
+        BOOST_CHECK(backend.append(0, sector, 0, buffer, sector_size) == 0);
+        BOOST_CHECK(backend.append(0, sector, 0, buffer, sector_size) == 0);
+        count = 1;
+        BOOST_CHECK(backend.report_zones(0, descs, count) == 0);
+        BOOST_CHECK(
+            descs[0].state == qemucsd::nvme_zns::ZONE_STATE_IMPLICIT_OPEN);
+        BOOST_CHECK(descs[0].write_pointer == 2);
+
+        BOOST_CHECK(backend.close(0) == 0);
+        BOOST_CHECK(backend.report_zones(0, descs, count) == 0);
+        BOOST_CHECK(descs[0].state == qemucsd::nvme_zns::ZONE_STATE_CLOSED);
+
+        BOOST_CHECK(backend.open(0) == 0);
+        BOOST_CHECK(backend.report_zones(0, descs, count) == 0);
+        BOOST_CHECK(
+            descs[0].state == qemucsd::nvme_zns::ZONE_STATE_EXPLICIT_OPEN);
+
+        // Finished zones are readable up to capacity and refuse appends
+        BOOST_CHECK(backend.finish(0) == 0);
+        BOOST_CHECK(backend.report_zones(0, descs, count) == 0);
+        BOOST_CHECK(descs[0].state == qemucsd::nvme_zns::ZONE_STATE_FULL);
+        BOOST_CHECK(descs[0].write_pointer == info.zone_capacity);
+        BOOST_CHECK(backend.read(0, info.zone_capacity - 1, 0, buffer,
+            sector_size) == 0);
+        BOOST_CHECK(backend.append(0, sector, 0, buffer, sector_size) != 0);
+        BOOST_CHECK(backend.open(0) != 0);
+
+        BOOST_CHECK(backend.reset(0) == 0);
+        BOOST_CHECK(backend.report_zones(0, descs, count) == 0);
+        BOOST_CHECK(descs[0].state == qemucsd::nvme_zns::ZONE_STATE_EMPTY);
+
+        // Reports are truncated to the last zone
+        count = 10;
+        BOOST_CHECK(backend.report_zones(8, descs, count) == 0);
+        BOOST_CHECK(count == 2);
+        BOOST_CHECK(backend.report_zones(10, descs, count) != 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(Test_NvmeZnsMemoryBackend_zone_limits) {
+        constexpr uint32_t sector_size = 512;
+        NvmeZnsMemoryBackend backend(10, 16, sector_size, 4, 2, 3);
+
+        struct qemucsd::nvme_zns::nvme_zns_info info;
+        backend.get_nvme_zns_info(&info);
+        BOOST_CHECK(info.max_open == 2);
+        BOOST_CHECK(info.max_active == 3);
+
+        unsigned char buffer[sector_size] = {0};
+        nvme_zns_zone_desc descs[4];
+        uint64_t count = 4;
+        uint64_t sector;
+
+        // Exceeding the open limit closes the implicitly opened zone
+        BOOST_CHECK(backend.open(0) == 0);
+        BOOST_CHECK(backend.append(1, sector, 0, buffer, sector_size) == 0);
+        BOOST_CHECK(backend.append(2, sector, 0, buffer, sector_size) == 0);
+        BOOST_CHECK(backend.report_zones(0, descs, count) == 0);
+        BOOST_CHECK(
+            descs[0].state == qemucsd::nvme_zns::ZONE_STATE_EXPLICIT_OPEN);
+        BOOST_CHECK(descs[1].state == qemucsd::nvme_zns::ZONE_STATE_CLOSED);
+        BOOST_CHECK(
+            descs[2].state == qemucsd::nvme_zns::ZONE_STATE_IMPLICIT_OPEN);
+
+        // Closed zones remain active
+        BOOST_CHECK(backend.append(3, sector, 0, buffer, sector_size) != 0);
+
+        // Explicitly opened zones are never closed implicitly
+        BOOST_CHECK(backend.close(2) == 0);
+        BOOST_CHECK(backend.open(1) == 0);
+        BOOST_CHECK(backend.append(2, sector, 0, buffer, sector_size) != 0);
+
+        // Full zones release their resources
+        BOOST_CHECK(backend.finish(1) == 0);
+        BOOST_CHECK(backend.append(2, sector, 0, buffer, sector_size) == 0);
+        BOOST_CHECK(backend.reset(2) == 0);
+        BOOST_CHECK(backend.append(3, sector, 0, buffer, sector_size) == 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(Test_NvmeZnsMemoryBackend_copy) {
+        constexpr uint32_t sector_size = 512;
+        constexpr uint32_t num_sectors = 4;
+        NvmeZnsMemoryBackend backend(10, 16, sector_size);
+
+        unsigned char buffer[sector_size * num_sectors];
+        unsigned char result_buffer[sector_size * num_sectors];
+        for(uint32_t i = 0; i < sector_size * num_sectors; i++) {
+            buffer[i] = i % UINT8_MAX;
+        }
+
+        uint64_t sector;
+        BOOST_CHECK(backend.append(0, sector, 0, buffer,
+                                   sector_size * num_sectors) == 0);
+        BOOST_CHECK(backend.append(2, sector, 0, buffer, sector_size) == 0);
+
+        // Copy the last two sectors of zone 0 followed by the first sector
+        nvme_zns_copy_range ranges[2] = {{0, 2, 2}, {0, 0, 1}};
+        BOOST_CHECK(backend.copy(ranges, 2, 2, sector) == 0);
+        BOOST_CHECK(sector == 1);
+
+        BOOST_CHECK(backend.read(2, 1, 0, result_buffer,
+                                 sector_size * 3) == 0);
+        BOOST_CHECK(memcmp(result_buffer, buffer + sector_size * 2,
+                           sector_size * 2) == 0);
+        BOOST_CHECK(memcmp(result_buffer + sector_size * 2, buffer,
+                           sector_size) == 0);
+
+        // Unwritten sources and full destinations are refused as a whole
+        nvme_zns_copy_range unwritten = {0, 3, 2};
+        BOOST_CHECK(backend.copy(&unwritten, 1, 3, sector) != 0);
+        struct qemucsd::nvme_zns::nvme_zns_info info;
+        backend.get_nvme_zns_info(&info);
+        nvme_zns_copy_range entire = {0, 0, num_sectors};
+        for(uint64_t i = 0; i < (info.zone_capacity - 4) / num_sectors; i++) {
+            BOOST_CHECK(backend.copy(&entire, 1, 2, sector) == 0);
+        }
+        BOOST_CHECK(backend.copy(&entire, 1, 2, sector) != 0);
+        BOOST_CHECK(backend.read(2, 4, 0, result_buffer, sector_size) == 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(Test_NvmeZnsMemoryBackend_map) {
+        constexpr uint32_t sector_size = 512;
+        constexpr uint32_t num_sectors = 4;
+        NvmeZnsMemoryBackend backend(10, 16, sector_size);
+
+        unsigned char buffer[sector_size * num_sectors];
+        for(uint32_t i = 0; i < sector_size * num_sectors; i++) {
+            buffer[i] = i % UINT8_MAX;
+        }
+
+        uint64_t sector;
+        BOOST_CHECK(backend.append(1, sector, 0, buffer,
+                                   sector_size * num_sectors) == 0);
+
+        const void *data = nullptr;
+        BOOST_CHECK(backend.map(1, 1, sector_size * 2, &data) == 0);
+        BOOST_CHECK(memcmp(data, buffer + sector_size,
+                           sector_size * 2) == 0);
+
+        // Unwritten sectors and ranges beyond the write pointer are refused
+        BOOST_CHECK(backend.map(1, 3, sector_size * 2, &data) != 0);
+        BOOST_CHECK(backend.map(2, 0, sector_size, &data) != 0);
+        BOOST_CHECK(backend.map(10, 0, sector_size, &data) != 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(Test_NvmeZnsMemoryBackend_sparse) {
+        constexpr uint32_t sector_size = 4096;
+        // 64GiB device, only written sectors are backed by memory
+        constexpr uint64_t num_zones = 16384;
+        constexpr uint64_t zone_size = 1024;
+        NvmeZnsMemoryBackend backend(num_zones, zone_size, sector_size);
+
+        struct qemucsd::nvme_zns::nvme_zns_info info;
+        backend.get_nvme_zns_info(&info);
+        BOOST_CHECK(info.zone_capacity == zone_size);
+
+        unsigned char buffer[sector_size];
+        unsigned char result_buffer[sector_size];
+        memset(buffer, 0xff, sector_size);
+
+        uint64_t sector;
+        for(uint64_t zone = 0; zone < num_zones; zone += num_zones / 8) {
+            BOOST_CHECK(backend.append(zone, sector, 0, buffer,
+                                       sector_size) == 0);
+            BOOST_CHECK(backend.read(zone, 0, 0, result_buffer,
+                                     sector_size) == 0);
+            BOOST_CHECK(memcmp(buffer, result_buffer, sector_size) == 0);
+        }
+
+        // Reset zones read as zeroes including partially written sectors
+        BOOST_CHECK(backend.reset(0) == 0);
+        BOOST_CHECK(backend.append(0, sector, 0, buffer, sector_size / 2)
+                    == 0);
+        BOOST_CHECK(backend.read(0, 0, 0, result_buffer, sector_size) == 0);
+        for(uint32_t i = sector_size / 2; i < sector_size; i++) {
+            BOOST_CHECK(result_buffer[i] == 0);
+        }
+    }
+
 BOOST_AUTO_TEST_SUITE_END()
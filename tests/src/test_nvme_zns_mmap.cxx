@@ -0,0 +1,139 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Dantali0n
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE TestNvmeZnsMmap
+
+#include <boost/test/unit_test.hpp>
+
+#include "tests.hpp"
+
+#include "nvme_zns_mmap.hpp"
+
+extern "C" {
+    #include <stdlib.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+}
+
+using qemucsd::nvme_zns::NvmeZnsMmapBackend;
+
+/**
+ * Create an empty temporary file to be used as image, removed upon
+ * destruction.
+ */
+struct TempImage {
+    std::string path;
+
+    TempImage() {
+        char name[] = "/tmp/test_nvme_zns_mmap_XXXXXX";
+        int fd = mkstemp(name);
+        BOOST_REQUIRE(fd >= 0);
+        close(fd);
+        path = name;
+    }
+
+    ~TempImage() {
+        unlink(path.c_str());
+    }
+};
+
+BOOST_AUTO_TEST_SUITE(Test_NvmeZnsMmapBackend)
+
+    BOOST_AUTO_TEST_CASE(Test_NvmeZnsMmapBackend_Defaults) {
+        TempImage image;
+        NvmeZnsMmapBackend backend(image.path, 10, 16, 512);
+
+        struct qemucsd::nvme_zns::nvme_zns_info info;
+        backend.get_nvme_zns_info(&info);
+
+        BOOST_CHECK(info.num_zones == 10);
+        BOOST_CHECK(info.zone_size == 16);
+        BOOST_CHECK(info.zone_capacity == 16);
+        BOOST_CHECK(info.sector_size == 512);
+    }
+
+    BOOST_AUTO_TEST_CASE(Test_NvmeZnsMmapBackend_sparse) {
+        TempImage image;
+        // 1GiB device should not occupy any space until written
+        NvmeZnsMmapBackend backend(image.path, 256, 1024, 4096);
+
+        struct stat st = {0};
+        BOOST_REQUIRE(stat(image.path.c_str(), &st) == 0);
+        BOOST_CHECK((uint64_t) st.st_size > 256ULL * 1024 * 4096);
+        BOOST_CHECK((uint64_t) st.st_blocks * 512 < 1024ULL * 1024);
+    }
+
+    BOOST_AUTO_TEST_CASE(Test_NvmeZnsMmapBackend_persist) {
+        constexpr uint32_t sector_size = 512;
+
+        TempImage image;
+        unsigned char buffer[sector_size];
+        for(uint32_t i = 0; i < sector_size; i++) {
+            buffer[i] = i % UINT8_MAX;
+        }
+
+        {
+            NvmeZnsMmapBackend backend(image.path, 10, 16, sector_size);
+
+            uint64_t sector;
+            BOOST_CHECK(backend.append(3, sector, 0, buffer, sector_size) == 0);
+            BOOST_CHECK(sector == 0);
+            BOOST_CHECK(backend.append(3, sector, 0, buffer, sector_size) == 0);
+            BOOST_CHECK(sector == 1);
+        }
+
+        // Reopen the image, data and write pointers must be retained
+        NvmeZnsMmapBackend backend(image.path, 10, 16, sector_size);
+
+        unsigned char result_buffer[sector_size] = {0};
+        BOOST_CHECK(backend.read(3, 1, 0, result_buffer, sector_size) == 0);
+        BOOST_CHECK(memcmp(buffer, result_buffer, sector_size) == 0);
+        BOOST_CHECK(backend.read(3, 2, 0, result_buffer, sector_size) == -1);
+
+        // Partially written zones are closed after reopening
+        qemucsd::nvme_zns::nvme_zns_zone_desc descs[2];
+        uint64_t count = 2;
+        BOOST_CHECK(backend.report_zones(2, descs, count) == 0);
+        BOOST_CHECK(descs[0].state == qemucsd::nvme_zns::ZONE_STATE_EMPTY);
+        BOOST_CHECK(descs[1].state == qemucsd::nvme_zns::ZONE_STATE_CLOSED);
+        BOOST_CHECK(descs[1].write_pointer == 2);
+
+        uint64_t sector;
+        BOOST_CHECK(backend.append(3, sector, 0, buffer, sector_size) == 0);
+        BOOST_CHECK(sector == 2);
+
+        // Reset zones read as zeroes once written again
+        BOOST_CHECK(backend.reset(3) == 0);
+        BOOST_CHECK(backend.read(3, 0, 0, result_buffer, sector_size) == -1);
+        BOOST_CHECK(backend.append(3, sector, 0, buffer, 1) == 0);
+        BOOST_CHECK(sector == 0);
+        BOOST_CHECK(backend.read(3, 1, 0, result_buffer, sector_size) == -1);
+        BOOST_CHECK(backend.read(3, 0, 0, result_buffer, sector_size) == 0);
+        for(uint32_t i = 1; i < sector_size; i++) {
+            BOOST_CHECK(result_buffer[i] == 0);
+        }
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,114 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Dantali0n
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE TestNvmeZnsModel
+
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+
+#include "tests.hpp"
+
+#include "nvme_zns_memory.hpp"
+#include "nvme_zns_model.hpp"
+
+using qemucsd::nvme_zns::NvmeZnsMemoryBackend;
+using qemucsd::nvme_zns::NvmeZnsModelBackend;
+using qemucsd::nvme_zns::nvme_zns_batch;
+using qemucsd::nvme_zns::nvme_zns_model;
+
+BOOST_AUTO_TEST_SUITE(Test_NvmeZnsModelBackend)
+
+    BOOST_AUTO_TEST_CASE(Test_NvmeZnsModelBackend_Defaults) {
+        NvmeZnsMemoryBackend memory(10, 16, 512);
+        struct nvme_zns_model model = {0};
+        NvmeZnsModelBackend backend(&memory, model);
+
+        struct qemucsd::nvme_zns::nvme_zns_info info;
+        struct qemucsd::nvme_zns::nvme_zns_info memory_info;
+        backend.get_nvme_zns_info(&info);
+        memory.get_nvme_zns_info(&memory_info);
+
+        BOOST_CHECK(info.num_zones == memory_info.num_zones);
+        BOOST_CHECK(info.zone_size == memory_info.zone_size);
+        BOOST_CHECK(info.zone_capacity == memory_info.zone_capacity);
+        BOOST_CHECK(info.sector_size == memory_info.sector_size);
+    }
+
+    BOOST_AUTO_TEST_CASE(Test_NvmeZnsModelBackend_latency) {
+        constexpr uint32_t sector_size = 512;
+
+        NvmeZnsMemoryBackend memory(10, 16, sector_size);
+        // 10ms appends, 1 sector per 10ms read bandwidth
+        struct nvme_zns_model model = {0, 10000, 0, sector_size * 100, 0, 1};
+        NvmeZnsModelBackend backend(&memory, model);
+
+        unsigned char buffer[sector_size] = {0};
+        uint64_t sector;
+
+        auto start = std::chrono::steady_clock::now();
+        BOOST_CHECK(backend.append(0, sector, 0, buffer, sector_size) == 0);
+        BOOST_CHECK(backend.read(0, 0, 0, buffer, sector_size) == 0);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+
+        BOOST_CHECK(elapsed >= std::chrono::milliseconds(20));
+    }
+
+    BOOST_AUTO_TEST_CASE(Test_NvmeZnsModelBackend_channels) {
+        constexpr uint32_t sector_size = 512;
+        constexpr uint32_t num_channels = 4;
+
+        NvmeZnsMemoryBackend memory(10, 16, sector_size);
+        struct nvme_zns_model model = {0, 20000, 0, 0, 0, num_channels};
+        NvmeZnsModelBackend backend(&memory, model);
+
+        unsigned char buffer[sector_size] = {0};
+
+        // Appends to zones on different channels are served in parallel
+        nvme_zns_batch batch;
+        auto start = std::chrono::steady_clock::now();
+        for(uint32_t i = 0; i < num_channels; i++) {
+            BOOST_CHECK(backend.submit_append(i, 0, buffer, sector_size,
+                batch.track()) == 0);
+        }
+        BOOST_CHECK(backend.wait(&batch) == 0);
+        auto parallel = std::chrono::steady_clock::now() - start;
+
+        BOOST_CHECK(parallel >= std::chrono::milliseconds(20));
+
+        // Appends to zones on the same channel are queued
+        start = std::chrono::steady_clock::now();
+        for(uint32_t i = 0; i < 2; i++) {
+            BOOST_CHECK(backend.submit_append(0, 0, buffer, sector_size,
+                batch.track()) == 0);
+        }
+        BOOST_CHECK(backend.wait(&batch) == 0);
+        auto queued = std::chrono::steady_clock::now() - start;
+
+        BOOST_CHECK(queued >= std::chrono::milliseconds(40));
+        BOOST_CHECK(parallel < queued);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
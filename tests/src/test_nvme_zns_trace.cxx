@@ -0,0 +1,167 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2021 Dantali0n
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE TestNvmeZnsTrace
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "tests.hpp"
+
+#include "nvme_zns_memory.hpp"
+#include "nvme_zns_trace.hpp"
+
+using qemucsd::nvme_zns::NvmeZnsMemoryBackend;
+using qemucsd::nvme_zns::NvmeZnsTraceBackend;
+using qemucsd::nvme_zns::nvme_zns_batch;
+using qemucsd::nvme_zns::nvme_zns_trace_header;
+using qemucsd::nvme_zns::nvme_zns_trace_record;
+
+/**
+ * Unique trace path removed upon destruction
+ */
+struct TempTrace {
+    std::string path;
+
+    TempTrace() {
+        char name[] = "/tmp/opencsd-trace-XXXXXX";
+        int fd = mkstemp(name);
+        ::close(fd);
+        path = name;
+    }
+
+    ~TempTrace() {
+        unlink(path.c_str());
+    }
+
+    std::vector<nvme_zns_trace_record> records(nvme_zns_trace_header &header)
+    {
+        std::vector<nvme_zns_trace_record> result;
+        FILE *file = fopen(path.c_str(), "rb");
+        if(fread(&header, sizeof(header), 1, file) != 1) header.magic = 0;
+
+        nvme_zns_trace_record record;
+        while(fread(&record, sizeof(record), 1, file) == 1)
+            result.push_back(record);
+
+        fclose(file);
+        return result;
+    }
+};
+
+BOOST_AUTO_TEST_SUITE(Test_NvmeZnsTraceBackend)
+
+    BOOST_AUTO_TEST_CASE(Test_NvmeZnsTraceBackend_record) {
+        constexpr uint32_t sector_size = 512;
+        TempTrace trace;
+        NvmeZnsMemoryBackend memory(10, 16, sector_size);
+
+        unsigned char buffer[sector_size * 2] = {0};
+        {
+            NvmeZnsTraceBackend backend(&memory, trace.path);
+
+            uint64_t sector;
+            BOOST_CHECK(backend.append(1, sector, 0, buffer,
+                                       sector_size * 2) == 0);
+            BOOST_CHECK(backend.read(1, 1, 0, buffer, sector_size) == 0);
+            BOOST_CHECK(backend.read(1, 2, 0, buffer, sector_size) != 0);
+
+            nvme_zns_batch batch;
+            BOOST_CHECK(backend.submit_append(1, 0, buffer, sector_size,
+                batch.track()) == 0);
+            BOOST_CHECK(backend.wait(&batch) == 0);
+
+            BOOST_CHECK(backend.reset(1) == 0);
+        }
+
+        nvme_zns_trace_header header;
+        auto records = trace.records(header);
+
+        BOOST_CHECK(header.magic == qemucsd::nvme_zns::NVME_ZNS_TRACE_MAGIC);
+        BOOST_CHECK(header.sector_size == sector_size);
+        BOOST_CHECK(header.num_zones == 10);
+        BOOST_REQUIRE(records.size() == 5);
+
+        BOOST_CHECK(records[0].op == qemucsd::nvme_zns::TRACE_OP_APPEND);
+        BOOST_CHECK(records[0].zone == 1);
+        BOOST_CHECK(records[0].sector == 0);
+        BOOST_CHECK(records[0].size == sector_size * 2);
+        BOOST_CHECK(records[1].op == qemucsd::nvme_zns::TRACE_OP_READ);
+        BOOST_CHECK(records[1].sector == 1);
+        BOOST_CHECK(records[1].result == 0);
+        BOOST_CHECK(records[2].result != 0);
+        BOOST_CHECK(records[3].op == qemucsd::nvme_zns::TRACE_OP_APPEND);
+        BOOST_CHECK(records[3].sector == 2);
+        BOOST_CHECK(records[4].op == qemucsd::nvme_zns::TRACE_OP_RESET);
+
+        // Timestamps are monotonic within a single thread
+        for(size_t i = 1; i < records.size(); i++) {
+            BOOST_CHECK(records[i].timestamp >= records[i - 1].timestamp);
+            BOOST_CHECK(records[i].thread == records[0].thread);
+        }
+    }
+
+    /**
+     * Asynchronous operations are attributed to the thread that submitted
+     * them, not the thread that reaps the completion.
+     */
+    BOOST_AUTO_TEST_CASE(Test_NvmeZnsTraceBackend_submitting_thread) {
+        constexpr uint32_t sector_size = 512;
+        TempTrace trace;
+        NvmeZnsMemoryBackend memory(10, 16, sector_size);
+
+        unsigned char buffer[sector_size] = {0};
+        {
+            NvmeZnsTraceBackend backend(&memory, trace.path);
+
+            uint64_t sector;
+            BOOST_CHECK(backend.append(1, sector, 0, buffer,
+                                       sector_size) == 0);
+
+            nvme_zns_batch batch;
+            std::thread submitter([&backend, &batch, &buffer]() {
+                BOOST_CHECK(backend.submit_read(1, 0, 0, buffer, sector_size,
+                    batch.track()) == 0);
+            });
+            submitter.join();
+            BOOST_CHECK(backend.wait(&batch) == 0);
+        }
+
+        nvme_zns_trace_header header;
+        auto records = trace.records(header);
+        BOOST_REQUIRE(records.size() == 2);
+
+        BOOST_CHECK(records[1].op == qemucsd::nvme_zns::TRACE_OP_READ);
+        BOOST_CHECK(records[1].thread != records[0].thread);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()